@@ -163,6 +163,9 @@ void AllocateAndParseFlags() {
 
   ops_flags = new XlaOpsCommonFlags;
   ops_flags->tf_xla_always_defer_compilation = false;
+  ops_flags->tf_xla_compilation_cache_max_entries = 0;
+  ops_flags->tf_xla_compilation_cache_max_bytes = 0;
+  ops_flags->tf_xla_async_compilation = false;
 
   jitter_flags = new IntroduceFloatingPointJitterPassFlags;
   jitter_flags->jitter_amount = 1e-5;
@@ -216,6 +219,31 @@ void AllocateAndParseFlags() {
 
        Flag("tf_xla_always_defer_compilation",
             &ops_flags->tf_xla_always_defer_compilation, ""),
+       Flag("tf_xla_persistent_cache_directory",
+            &ops_flags->tf_xla_persistent_cache_directory,
+            "If non-empty, a directory in which compiled XLA executables are "
+            "stored, and from which later processes load them instead of "
+            "compiling the same clusters again."),
+       Flag("tf_xla_compilation_cache_max_entries",
+            &ops_flags->tf_xla_compilation_cache_max_entries,
+            "If positive, the maximum number of entries in the XLA compilation "
+            "cache of a device. Least recently used entries are evicted."),
+       Flag("tf_xla_compilation_cache_max_bytes",
+            &ops_flags->tf_xla_compilation_cache_max_bytes,
+            "If positive, the maximum size in bytes of the XLA computations "
+            "and executables in the compilation cache of a device. Least "
+            "recently used entries are evicted."),
+       Flag("tf_xla_shape_bucket_boundaries",
+            &ops_flags->tf_xla_shape_bucket_boundaries,
+            "A comma-separated list of increasing sizes. If non-empty, each "
+            "dimension of a cluster's parameters that is at most the largest "
+            "size is padded up to the next size, and the cluster is compiled "
+            "for bounded dynamic shapes."),
+       Flag("tf_xla_async_compilation",
+            &ops_flags->tf_xla_async_compilation,
+            "If true, auto-clustered XLA clusters are compiled in the "
+            "background, and run as TensorFlow functions until their "
+            "compilation completes."),
 
        Flag("tf_introduce_floating_point_jitter_to_tensors",
             setter_for_jitter_tensor_names, "",
@@ -98,6 +98,27 @@ struct XlaOpsCommonFlags {
   // If true, _XlaCompile always refuses to compile the cluster, which means the
   // XLA clusters always run in the TF executor.  Defaults to false.
   bool tf_xla_always_defer_compilation;
+
+  // If non-empty, a directory in which XLA executables are persisted, so that
+  // later processes can load them instead of compiling the same clusters
+  // again. Only backends that can serialize executables (currently CPU) use
+  // it.
+  string tf_xla_persistent_cache_directory;
+
+  // If positive, the number of entries and the number of bytes of XLA
+  // computations and executables above which the compilation cache of a device
+  // evicts its least recently used entries.
+  int64 tf_xla_compilation_cache_max_entries;
+  int64 tf_xla_compilation_cache_max_bytes;
+
+  // If non-empty, a comma-separated list of increasing sizes. Each dimension of
+  // a cluster's parameters that is at most the largest size is padded up to
+  // the next size, so that one executable serves all shapes in a bucket.
+  string tf_xla_shape_bucket_boundaries;
+
+  // If true, _XlaCompile compiles clusters on background threads, and runs
+  // the TensorFlow function of a cluster until its compilation completes.
+  bool tf_xla_async_compilation;
 };
 
 // Flags for the build_xla_ops pass.
@@ -33,17 +33,19 @@ limitations under the License.
 
 namespace tensorflow {
 
-static xla::StatusOr<xla::LocalExecutable*> GetLocalExecutable(
+// Compiles `function`, and sets `*executable` to the executable that stays
+// alive while `*cache_entry` is held.
+static Status GetLocalExecutable(
     const XlaCompiler::Options& options,
     const XlaCompiler::CompileOptions& compile_options,
     const NameAttrList& function, XlaCompilationCache* cache,
-    absl::Span<XlaCompiler::Argument const> args, const XlaCompiler& compiler) {
+    absl::Span<XlaCompiler::Argument const> args, const XlaCompiler& compiler,
+    xla::LocalExecutable** executable,
+    XlaCompilationCache::EntryRef* cache_entry) {
   const XlaCompiler::CompilationResult* compilation_result = nullptr;
-  xla::LocalExecutable* executable = nullptr;
-  TF_RETURN_IF_ERROR(cache->Compile(options, function, args, compile_options,
-                                    XlaCompilationCache::CompileMode::kStrict,
-                                    &compilation_result, &executable));
-  return executable;
+  return cache->Compile(options, function, args, compile_options,
+                        XlaCompilationCache::CompileMode::kStrict,
+                        &compilation_result, executable, cache_entry);
 }
 
 xla::StatusOr<std::string> GetCompilerIr(
@@ -134,17 +136,21 @@ xla::StatusOr<std::string> GetCompilerIr(
       return new_module->ToString();
     }
     case IrExportStage::OPTIMIZED_HLO: {
-      xla::StatusOr<xla::LocalExecutable*> executable = GetLocalExecutable(
-          options, compile_options, function, cache, *args, compiler);
-      TF_RETURN_IF_ERROR(executable.status());
-      return (*executable)->executable()->module().ToString();
+      xla::LocalExecutable* executable;
+      XlaCompilationCache::EntryRef cache_entry;
+      TF_RETURN_IF_ERROR(GetLocalExecutable(options, compile_options, function,
+                                            cache, *args, compiler,
+                                            &executable, &cache_entry));
+      return executable->executable()->module().ToString();
     }
     case IrExportStage::OPTIMIZED_HLO_DOT: {
-      xla::StatusOr<xla::LocalExecutable*> executable = GetLocalExecutable(
-          options, compile_options, function, cache, *args, compiler);
-      TF_RETURN_IF_ERROR(executable.status());
+      xla::LocalExecutable* executable;
+      XlaCompilationCache::EntryRef cache_entry;
+      TF_RETURN_IF_ERROR(GetLocalExecutable(options, compile_options, function,
+                                            cache, *args, compiler,
+                                            &executable, &cache_entry));
       xla::StatusOr<std::string> graph = xla::RenderGraph(
-          *(*executable)->executable()->module().entry_computation(),
+          *executable->executable()->module().entry_computation(),
           "Visualization",
           /*debug_options=*/{}, xla::RenderedGraphFormat::kDot,
           /*hlo_execution_profile=*/nullptr,
@@ -72,15 +72,21 @@ namespace {
 // the initial values for the resource variables (and cannot snapshot them again
 // during execution) because otherwise we risk observing a different snapshot
 // with shapes different from what we compiled for.
+//
+// The closure also holds the compilation cache entry of the executable, so that
+// the executable stays alive until XlaRun is done with it even if the cache
+// evicts it in the meantime.
 class XlaExecutableClosure {
  public:
   explicit XlaExecutableClosure(
       xla::LocalClient* client, xla::LocalExecutable* executable,
       const XlaCompiler::CompilationResult* compilation_result,
+      XlaCompilationCache::EntryRef cache_entry,
       ResourceVarsSnapshot resource_var_snapshots, int num_constant_args)
       : client_(client),
         executable_(executable),
         compilation_result_(compilation_result),
+        cache_entry_(std::move(cache_entry)),
         resource_var_snapshots_(std::move(resource_var_snapshots)),
         num_constant_args_(num_constant_args) {}
 
@@ -101,6 +107,7 @@ class XlaExecutableClosure {
   xla::LocalClient* client_;
   xla::LocalExecutable* executable_;
   const XlaCompiler::CompilationResult* compilation_result_;
+  XlaCompilationCache::EntryRef cache_entry_;
   ResourceVarsSnapshot resource_var_snapshots_;
   int num_constant_args_;
 
@@ -166,10 +173,12 @@ static Status CompileToLocalExecutable(
     const XlaPlatformInfo& platform_info,
     absl::Span<const Tensor* const> inputs,
     absl::Span<VariableInfo const> variable_infos,
-    absl::Span<const int> constants, bool lazy, bool may_alias_resource_update,
-    xla::LocalClient** client,
+    absl::Span<const int> constants,
+    XlaCompilationCache::CompileMode compile_mode,
+    bool may_alias_resource_update, xla::LocalClient** client,
     const XlaCompiler::CompilationResult** compilation_result,
-    xla::LocalExecutable** executable) {
+    xla::LocalExecutable** executable,
+    XlaCompilationCache::EntryRef* cache_entry) {
   // We store information about the JIT-compiled XLA computation
   // in the ResourceMgr.
   ResourceMgr* rm = ctx->resource_manager();
@@ -211,9 +220,8 @@ static Status CompileToLocalExecutable(
           static_cast<Device*>(ctx->device()));
   TF_RETURN_IF_ERROR(args.status());
   return cache->Compile(options, function, *args, compile_options,
-                        lazy ? XlaCompilationCache::CompileMode::kLazy
-                             : XlaCompilationCache::CompileMode::kStrict,
-                        compilation_result, executable);
+                        compile_mode, compilation_result, executable,
+                        cache_entry);
 }
 
 void XlaLocalLaunchBase::Compute(OpKernelContext* ctx) {
@@ -224,6 +232,8 @@ void XlaLocalLaunchBase::Compute(OpKernelContext* ctx) {
   xla::LocalClient* client;
   const XlaCompiler::CompilationResult* compilation_result;
   xla::LocalExecutable* executable;
+  // Keeps the executable alive until it is done running.
+  XlaCompilationCache::EntryRef cache_entry;
 
   std::vector<VariableInfo> variable_infos;
   {
@@ -233,9 +243,9 @@ void XlaLocalLaunchBase::Compute(OpKernelContext* ctx) {
     OP_REQUIRES_OK(ctx, LockVariables(absl::MakeSpan(variable_infos)));
     Status s = CompileToLocalExecutable(
         ctx, function_, /*has_ref_vars=*/has_ref_vars_, platform_info_, inputs,
-        variable_infos, constants_, /*lazy=*/false,
+        variable_infos, constants_, XlaCompilationCache::CompileMode::kStrict,
         /*may_alias_resource_update=*/true, &client, &compilation_result,
-        &executable);
+        &executable, &cache_entry);
     OP_REQUIRES_OK(ctx, s);
   }
 
@@ -373,6 +383,7 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
   xla::LocalClient* client;
   const XlaCompiler::CompilationResult* kernel;
   xla::LocalExecutable* executable;
+  XlaCompilationCache::EntryRef cache_entry;
   ResourceVarsSnapshot variables;
 
   std::vector<const Tensor*> inputs = InputsFromContext(ctx);
@@ -392,13 +403,23 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
                                         inputs, resources_, &variable_infos));
     OP_REQUIRES_OK(ctx, LockVariables(absl::MakeSpan(variable_infos)));
 
+    // Clusters that need not be compiled run as TensorFlow functions until
+    // they are, so they may be compiled in the background.
+    XlaCompilationCache::CompileMode compile_mode =
+        XlaCompilationCache::CompileMode::kStrict;
+    if (!must_compile_) {
+      compile_mode = GetXlaOpsCommonFlags().tf_xla_async_compilation
+                         ? XlaCompilationCache::CompileMode::kAsync
+                         : XlaCompilationCache::CompileMode::kLazy;
+    }
+
     // Do not alias resource updates as locking variables in XlaCompile and
     // unlocking them in XlaRun may lead to deadlocks.
     Status status = CompileToLocalExecutable(
         ctx, function_, has_ref_vars_, platform_info_, inputs, variable_infos,
-        constants_,
-        /*lazy=*/!must_compile_,
-        /*may_alias_resource_update=*/false, &client, &kernel, &executable);
+        constants_, compile_mode,
+        /*may_alias_resource_update=*/false, &client, &kernel, &executable,
+        &cache_entry);
     OP_REQUIRES_OK(ctx, SnapshotResourceVariables(ctx, resources_,
                                                   variable_infos, &variables));
     if (must_compile_ || status.code() != error::UNIMPLEMENTED) {
@@ -440,7 +461,8 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
   // variables.
   XlaExecutableClosureStore::KeyT key =
       XlaExecutableClosureStore::Global()->Produce(XlaExecutableClosure(
-          client, executable, kernel, std::move(variables), constants_.size()));
+          client, executable, kernel, std::move(cache_entry),
+          std::move(variables), constants_.size()));
 
   Tensor compilation_key(cpu_allocator, DT_STRING, TensorShape({}));
   compilation_key.flat<tstring>()(0) = key;
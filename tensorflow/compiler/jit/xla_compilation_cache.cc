@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/compiler/mlir/mlir_bridge_rollout_policy.h"
 #include "absl/base/call_once.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "tensorflow/compiler/jit/flags.h"
 #include "tensorflow/compiler/jit/xla_activity.pb.h"
@@ -31,6 +32,8 @@ limitations under the License.
 #include "tensorflow/compiler/tf2xla/xla_compiler.h"
 #include "tensorflow/compiler/tf2xla/xla_context.h"
 #include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/function.h"
@@ -43,8 +46,13 @@ limitations under the License.
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/protobuf/graph_debug_info.pb.h"
 #include "tensorflow/core/public/version.h"
@@ -53,27 +61,93 @@ limitations under the License.
 namespace tensorflow {
 
 constexpr int64 XlaCompilationCache::kDefaultCompilationThreshold;
+constexpr int XlaCompilationCache::kNumAsyncCompileThreads;
 
-XlaCompilationCache::XlaCompilationCache(xla::LocalClient* client,
-                                         DeviceType device_type)
-    : client_(client), device_type_(std::move(device_type)) {}
-
-XlaCompilationCache::~XlaCompilationCache() {
-  // Ensure any use of our programs have completed by waiting for all stream
-  // executors to complete.
-  for (auto* executor : client_->backend().stream_executors()) {
+// Waits for all programs running on the devices of `client` to complete.
+static void SynchronizeAllActivity(xla::LocalClient* client) {
+  for (auto* executor : client->backend().stream_executors()) {
     bool ok = executor->SynchronizeAllActivity();
     if (!ok) {
       LOG(ERROR) << "Error synchronizing activity while waiting for all "
                     "programs to complete";
     }
   }
+}
+
+// The last reference to an evicted entry may be dropped while its executable
+// is still running, e.g. right after XlaRun enqueued it. Rather than waiting
+// for the devices on that caller's thread, retired entries are collected and
+// freed in batches on a background thread, after the devices have completed
+// all the programs enqueued before.
+class XlaCompilationCache::RetiredEntries {
+ public:
+  explicit RetiredEntries(xla::LocalClient* client) : client_(client) {}
+
+  // Takes ownership of `entry` and frees it once its executable is done.
+  static void Retire(std::shared_ptr<RetiredEntries> retired, Entry* entry) {
+    {
+      mutex_lock lock(retired->mu_);
+      retired->entries_.emplace_back(entry);
+      if (retired->freeing_) return;
+      retired->freeing_ = true;
+    }
+    Env::Default()->SchedClosure([retired]() { retired->FreeAll(); });
+  }
+
+ private:
+  void FreeAll() {
+    while (true) {
+      std::vector<std::unique_ptr<Entry>> entries;
+      {
+        mutex_lock lock(mu_);
+        if (entries_.empty()) {
+          freeing_ = false;
+          return;
+        }
+        entries.swap(entries_);
+      }
+      SynchronizeAllActivity(client_);
+    }
+  }
+
+  xla::LocalClient* const client_;
+  mutex mu_;
+  std::vector<std::unique_ptr<Entry>> entries_ TF_GUARDED_BY(mu_);
+  // Whether FreeAll is scheduled or running.
+  bool freeing_ TF_GUARDED_BY(mu_) = false;
+};
+
+XlaCompilationCache::XlaCompilationCache(xla::LocalClient* client,
+                                         DeviceType device_type)
+    : XlaCompilationCache(client, std::move(device_type), Config()) {}
+
+XlaCompilationCache::XlaCompilationCache(xla::LocalClient* client,
+                                         DeviceType device_type, Config config)
+    : client_(client),
+      device_type_(std::move(device_type)),
+      config_(std::move(config)),
+      retired_entries_(std::make_shared<RetiredEntries>(client)) {}
+
+XlaCompilationCache::~XlaCompilationCache() {
+  // Wait for the pending asynchronous compilations, which still use the cache.
+  std::unique_ptr<thread::ThreadPool> async_compile_threads;
+  {
+    mutex_lock lock(async_compile_mu_);
+    async_compile_threads = std::move(async_compile_threads_);
+  }
+  async_compile_threads.reset();
+  // Ensure any use of our programs have completed by waiting for all stream
+  // executors to complete.
+  SynchronizeAllActivity(client_);
   // TODO(b/110813685): Think about the program ownership model. Programs are
   // currently owned by the compilation cache which means we must wait for
   // program completion in the destructor. There are multiple compilation caches
   // around, which complicates things a little. Perhaps having programs be
   // shared_ptrs (an invasive change) would make the model easier to reason
   // about?
+  mutex_lock lock(compile_cache_mu_);
+  metrics::UpdateXlaCompilationCacheSize(-static_cast<int64>(cache_.size()),
+                                         -cache_bytes_);
 }
 
 string XlaCompilationCache::DebugString() const {
@@ -92,12 +166,16 @@ string XlaCompilationCache::Signature::HumanString() const {
   for (const auto& v : arg_values) {
     absl::StrAppend(&result, "; ", v.DebugString());
   }
+  if (bucketed) {
+    absl::StrAppend(&result, "; bucketed");
+  }
   return result;
 }
 
 bool XlaCompilationCache::Signature::operator==(const Signature& other) const {
   if (name != other.name) return false;
   if (arg_shapes != other.arg_shapes) return false;
+  if (bucketed != other.bucketed) return false;
 
   if (arg_values.size() != other.arg_values.size()) return false;
   for (int i = 0, end = arg_values.size(); i < end; ++i) {
@@ -124,7 +202,7 @@ uint64 XlaCompilationCache::Signature::Hash::operator()(
     h = Hash64Combine(
         h, Hash64(arg.tensor_data().data(), arg.tensor_data().size()));
   }
-  return h;
+  return Hash64Combine(h, signature.bucketed);
 }
 
 xla::StatusOr<XlaCompilationCache::Signature>
@@ -144,6 +222,10 @@ XlaCompilationCache::BuildSignature(
       case XlaCompiler::Argument::kResource:
         signature.arg_shapes.emplace_back(arg.type,
                                           arg.DimensionSizesAsInlinedVector());
+        if (absl::holds_alternative<xla::Shape>(arg.shape) &&
+            absl::get<xla::Shape>(arg.shape).is_dynamic()) {
+          signature.bucketed = true;
+        }
         break;
       default:
         return errors::InvalidArgument(
@@ -154,6 +236,54 @@ XlaCompilationCache::BuildSignature(
   return std::move(signature);
 }
 
+absl::optional<std::vector<XlaCompiler::Argument>>
+XlaCompilationCache::BucketArguments(
+    absl::Span<const XlaCompiler::Argument> args,
+    absl::Span<const int64> bucket_boundaries) {
+  if (bucket_boundaries.empty()) {
+    return absl::nullopt;
+  }
+  std::vector<XlaCompiler::Argument> bucketed(args.begin(), args.end());
+  bool any_bucketed = false;
+  for (XlaCompiler::Argument& arg : bucketed) {
+    if (arg.kind == XlaCompiler::Argument::kResource ||
+        arg.kind == XlaCompiler::Argument::kConstantResource) {
+      return absl::nullopt;
+    }
+    if (arg.kind != XlaCompiler::Argument::kParameter ||
+        !absl::holds_alternative<TensorShape>(arg.shape)) {
+      continue;
+    }
+    const TensorShape& shape = absl::get<TensorShape>(arg.shape);
+    xla::Shape bounded_shape;
+    if (!TensorShapeToXLAShape(arg.type, shape, &bounded_shape).ok()) {
+      continue;
+    }
+    bool arg_bucketed = false;
+    for (int i = 0; i < shape.dims(); ++i) {
+      // Dimensions of size 1 stay static, since TensorFlow broadcasts them.
+      // Together with boundaries above 1 this also keeps the signatures of
+      // bucketed and static dimensions apart.
+      if (shape.dim_size(i) == 1) continue;
+      auto boundary =
+          std::lower_bound(bucket_boundaries.begin(), bucket_boundaries.end(),
+                           shape.dim_size(i));
+      if (boundary == bucket_boundaries.end()) continue;
+      bounded_shape.set_dimensions(i, *boundary);
+      bounded_shape.set_dynamic_dimension(i, true);
+      arg_bucketed = true;
+    }
+    if (arg_bucketed) {
+      arg.shape = bounded_shape;
+      any_bucketed = true;
+    }
+  }
+  if (!any_bucketed) {
+    return absl::nullopt;
+  }
+  return bucketed;
+}
+
 Status XlaCompilationCache::BuildExecutable(
     const XlaCompiler::Options& options,
     const XlaCompiler::CompilationResult& result,
@@ -174,32 +304,179 @@ Status XlaCompilationCache::BuildExecutable(
   build_options.set_alias_passthrough_params(options.alias_passthrough_params);
   build_options.mutable_debug_options()->set_xla_detailed_logging(
       options.detailed_logging);
+
+  std::string persistent_cache_file;
+  if (!config_.persistent_cache_directory.empty()) {
+    // Backends only keep what they need to serialize an executable on request.
+    build_options.mutable_debug_options()->set_xla_cpu_keep_object_files(true);
+    TF_ASSIGN_OR_RETURN(persistent_cache_file,
+                        PersistentCacheFile(*result.computation,
+                                            argument_layouts, build_options));
+    Status status = LoadPersistentExecutable(persistent_cache_file,
+                                             build_options, executable);
+    metrics::RecordXlaPersistentCacheLookup(status.ok());
+    if (status.ok()) {
+      VLOG(1) << "Loaded executable from " << persistent_cache_file;
+      return Status::OK();
+    }
+    if (!errors::IsNotFound(status)) {
+      LOG(WARNING) << "Failed to load executable from " << persistent_cache_file
+                   << ", compiling it instead: " << status;
+    }
+  }
+
   TF_ASSIGN_OR_RETURN(
       auto executables,
       client_->Compile(*result.computation, argument_layouts, build_options));
   TF_RET_CHECK(executables.size() == 1);
   *executable = std::move(executables[0]);
+
+  if (!persistent_cache_file.empty()) {
+    Status status =
+        StorePersistentExecutable(persistent_cache_file, **executable);
+    if (errors::IsUnimplemented(status)) {
+      VLOG(1) << "Not storing executable: " << status;
+    } else if (!status.ok()) {
+      LOG(WARNING) << "Failed to store executable in " << persistent_cache_file
+                   << ": " << status;
+    }
+  }
+  return Status::OK();
+}
+
+xla::StatusOr<std::string> XlaCompilationCache::PersistentCacheFile(
+    const xla::XlaComputation& computation,
+    absl::Span<const xla::Shape* const> argument_layouts,
+    const xla::ExecutableBuildOptions& build_options) const {
+  // The ids in the HloModuleProto depend on what else the process built
+  // before, so the module is fingerprinted in its canonical text form instead.
+  TF_ASSIGN_OR_RETURN(xla::HloModuleConfig config,
+                      xla::HloModule::CreateModuleConfigFromProto(
+                          computation.proto(), build_options.debug_options()));
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<xla::HloModule> module,
+      xla::HloModule::CreateFromProto(computation.proto(), config));
+  std::string key = module->ToString(xla::HloPrintOptions::Fingerprint()
+                                         .set_print_large_constants(true)
+                                         .set_print_backend_config(true)
+                                         .set_print_control_dependencies(true));
+
+  for (const xla::Shape* layout : argument_layouts) {
+    absl::StrAppend(&key, "\n", xla::ShapeUtil::HumanStringWithLayout(*layout));
+  }
+  if (build_options.result_layout() != nullptr) {
+    absl::StrAppend(&key, "\n",
+                    xla::ShapeUtil::HumanStringWithLayout(
+                        *build_options.result_layout()));
+  }
+  std::string debug_options;
+  if (!SerializeToStringDeterministic(build_options.debug_options(),
+                                      &debug_options)) {
+    return errors::Internal("Failed to serialize DebugOptions");
+  }
+  absl::StrAppend(&key, "\n", debug_options, "\n",
+                  build_options.alias_passthrough_params(), "\n",
+                  client_->platform()->Name(), "\n", port::CPUVendorIDString(),
+                  " ", port::CPUFamily(), " ", port::CPUModelNum(), "\n",
+                  TF_VERSION_STRING, " ", tf_git_version());
+
+  const Fprint128 fingerprint = Fingerprint128(key);
+  return io::JoinPath(config_.persistent_cache_directory,
+                      absl::StrFormat("%016x%016x.xla_executable",
+                                      fingerprint.high64, fingerprint.low64));
+}
+
+Status XlaCompilationCache::LoadPersistentExecutable(
+    const std::string& filename,
+    const xla::ExecutableBuildOptions& build_options,
+    std::unique_ptr<xla::LocalExecutable>* executable) {
+  std::string serialized;
+  TF_RETURN_IF_ERROR(ReadFileToString(Env::Default(), filename, &serialized));
+  xla::Backend* backend = client_->mutable_backend();
+  TF_ASSIGN_OR_RETURN(se::StreamExecutor * stream_executor,
+                      backend->stream_executor(build_options.device_ordinal()));
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<xla::Executable> xla_executable,
+      backend->compiler()->DeserializeExecutable(serialized, stream_executor));
+  *executable = absl::make_unique<xla::LocalExecutable>(
+      std::move(xla_executable), backend, build_options);
   return Status::OK();
 }
 
+Status XlaCompilationCache::StorePersistentExecutable(
+    const std::string& filename, const xla::LocalExecutable& executable) {
+  TF_ASSIGN_OR_RETURN(std::string serialized,
+                      client_->backend().compiler()->SerializeExecutable(
+                          *executable.executable()));
+  Env* env = Env::Default();
+  TF_RETURN_IF_ERROR(
+      env->RecursivelyCreateDir(config_.persistent_cache_directory));
+  // Processes that compile the same cluster concurrently each write their own
+  // temporary file, so that a reader only ever sees a complete file.
+  const std::string temp_filename =
+      strings::StrCat(filename, ".tmp-", random::New64());
+  TF_RETURN_IF_ERROR(WriteStringToFile(env, temp_filename, serialized));
+  Status status = env->RenameFile(temp_filename, filename);
+  if (!status.ok()) {
+    env->DeleteFile(temp_filename).IgnoreError();
+  }
+  return status;
+}
+
 Status XlaCompilationCache::Compile(
     const XlaCompiler::Options& options, const NameAttrList& function,
     absl::Span<const XlaCompiler::Argument> args,
     const XlaCompiler::CompileOptions& compile_options,
     CompileMode compile_mode,
     const XlaCompiler::CompilationResult** out_compilation_result,
-    xla::LocalExecutable** out_executable) {
+    xla::LocalExecutable** out_executable, EntryRef* out_entry) {
   absl::optional<int64> compile_threshold;
-  if (compile_mode == CompileMode::kLazy) {
+  if (compile_mode != CompileMode::kStrict) {
     compile_threshold = kDefaultCompilationThreshold;
   }
-  auto compile_fn = [&](XlaCompiler* compiler,
-                        XlaCompiler::CompilationResult* result) {
-    return compiler->CompileFunction(compile_options, function, args, result);
+  const bool async = compile_mode == CompileMode::kAsync;
+  using CompileFn = std::function<Status(XlaCompiler* compiler,
+                                         XlaCompiler::CompilationResult*)>;
+  auto make_compile_fn =
+      [&](absl::Span<const XlaCompiler::Argument> fn_args) -> CompileFn {
+    if (async) {
+      // An asynchronous compilation outlives this call, so it owns its inputs.
+      return [compile_options, function,
+              owned_args = std::vector<XlaCompiler::Argument>(fn_args.begin(),
+                                                              fn_args.end())](
+                 XlaCompiler* compiler,
+                 XlaCompiler::CompilationResult* result) {
+        return compiler->CompileFunction(compile_options, function, owned_args,
+                                         result);
+      };
+    }
+    return [&compile_options, &function, fn_args](
+               XlaCompiler* compiler, XlaCompiler::CompilationResult* result) {
+      return compiler->CompileFunction(compile_options, function, fn_args,
+                                       result);
+    };
   };
-  return CompileImpl(options, function, args, compile_fn,
-                     /*compile_threshold=*/compile_threshold,
-                     out_compilation_result, out_executable);
+  absl::optional<std::vector<XlaCompiler::Argument>> bucketed_args =
+      BucketArguments(args, config_.bucket_boundaries);
+  if (bucketed_args.has_value()) {
+    Status status = CompileImpl(options, function, *bucketed_args,
+                                make_compile_fn(*bucketed_args),
+                                /*compile_threshold=*/compile_threshold, async,
+                                out_compilation_result, out_executable,
+                                out_entry);
+    if (status.ok()) {
+      return status;
+    }
+    // Not every cluster can be compiled for dynamic shapes. The failure is
+    // cached under the bucketed signature, so later calls fall through here
+    // without compiling again.
+    VLOG(1) << "Failed to compile " << function.name()
+            << " for bucketed shapes, compiling it for exact shapes: "
+            << status;
+  }
+  return CompileImpl(options, function, args, make_compile_fn(args),
+                     /*compile_threshold=*/compile_threshold, async,
+                     out_compilation_result, out_executable, out_entry);
 }
 
 static bool ShouldBeMegamorphic(int64 compile_count, int64 execution_count) {
@@ -264,7 +541,7 @@ Status XlaCompilationCache::CompileSingleOp(
     absl::Span<const XlaCompiler::Argument> args, OpKernelContext* ctx,
     const XlaCompiler::CompileOptions& compile_options,
     const XlaCompiler::CompilationResult** out_compilation_result,
-    xla::LocalExecutable** out_executable) {
+    xla::LocalExecutable** out_executable, EntryRef* out_entry) {
   const NodeDef& def = ctx->op_kernel().def();
   NameAttrList name;
   name.set_name(def.op());
@@ -306,8 +583,8 @@ Status XlaCompilationCache::CompileSingleOp(
         *options.flib_def, debug_info, options.shape_representation_fn, result);
   };
   return CompileImpl(options, name, args, compile_op,
-                     /*compile_threshold=*/absl::nullopt,
-                     out_compilation_result, out_executable);
+                     /*compile_threshold=*/absl::nullopt, /*async=*/false,
+                     out_compilation_result, out_executable, out_entry);
 }
 
 namespace {
@@ -329,9 +606,9 @@ Status XlaCompilationCache::CompileImpl(
     absl::Span<const XlaCompiler::Argument> args,
     const std::function<Status(XlaCompiler* compiler,
                                XlaCompiler::CompilationResult*)>& compile_fn,
-    absl::optional<int64> compile_threshold,
+    absl::optional<int64> compile_threshold, bool async,
     const XlaCompiler::CompilationResult** out_compilation_result,
-    xla::LocalExecutable** out_executable) {
+    xla::LocalExecutable** out_executable, EntryRef* out_entry) {
   if (FailOnXlaCompilation()) {
     return errors::Internal("XLA compilation disabled");
   }
@@ -351,16 +628,35 @@ Status XlaCompilationCache::CompileImpl(
 
   // The outer lock protects the existence of the cache entry. It does not
   // protect the contents of the cache entry.
-  Entry* entry;
+  EntryRef entry;
+  std::vector<EntryRef> evicted;
   {
     mutex_lock lock(compile_cache_mu_);
     // Find or create a cache entry.
-    std::unique_ptr<Entry>& e = cache_[signature];
+    EntryRef& e = cache_[signature];
     if (!e) {
-      e.reset(new Entry);
+      // The executable of an evicted entry may still be running when the last
+      // reference to it goes away.
+      std::shared_ptr<RetiredEntries> retired = retired_entries_;
+      e = EntryRef(new Entry(signature), [retired](Entry* entry) {
+        if (entry->in_cache) {
+          delete entry;
+        } else {
+          RetiredEntries::Retire(retired, entry);
+        }
+      });
+      lru_.push_front(e.get());
+      e->lru_position = lru_.begin();
+      metrics::UpdateXlaCompilationCacheSize(/*entries_delta=*/1,
+                                             /*bytes_delta=*/0);
+      entry = e;
+      SetEntrySizeAndEvictLocked(entry.get(), /*size_bytes=*/0, &evicted);
+    } else {
+      entry = e;
+      TouchEntryLocked(entry.get());
     }
-    entry = e.get();
   }
+  evicted.clear();
 
   // We always compile a cluster the very first time it is executed.  This is an
   // optimistic guess that pays off for statically shaped TensorFlow graphs
@@ -394,17 +690,27 @@ Status XlaCompilationCache::CompileImpl(
     is_megamorphic = it->second.is_megamorphic;
   }
 
-  // Acquire the cache entry lock and compile, if necessary.
-  // TODO(phawkins): this locking will need to be restructured when we implement
-  // cache eviction.
+  // Acquire the cache entry lock and compile, if necessary. An entry evicted
+  // meanwhile is still compiled, for this caller only.
   mutex_lock entry_lock(entry->mu);
   int64 current_request_count = ++entry->request_count;
   VLOG(2) << "Compilation cache entry hit: " << entry->compiled
           << " signature: " << signature.HumanString() << " with request count "
           << current_request_count << " and compile threshold "
           << compile_threshold.value_or(0);
+  if (entry->compiling) {
+    if (compile_threshold.has_value()) {
+      // The caller can fall back while the entry compiles in the background.
+      VLOG(2) << "Still compiling signature: " << signature.HumanString();
+      *out_compilation_result = nullptr;
+      *out_executable = nullptr;
+      return Status::OK();
+    }
+    while (entry->compiling) {
+      entry->compiled_cv.wait(entry_lock);
+    }
+  }
   if (!entry->compiled) {
-    XLA_SCOPED_LOGGING_TIMER("Compilation of XLA executable");
     const bool should_compile = [&] {
       if (!compile_threshold.has_value()) {
         // Lazy compilation is disabled.
@@ -443,57 +749,173 @@ Status XlaCompilationCache::CompileImpl(
       return Status::OK();
     }
 
-    tensorflow::Env* env = tensorflow::Env::Default();
-    const uint64 compile_start_us = env->NowMicros();
-    // Do the actual JIT compilation without holding the lock (it can take
-    // a long time.)
+    if (async) {
+      VLOG(2) << "Compiling asynchronously for signature: "
+              << signature.HumanString();
+      entry->compiling = true;
+      CompileAsync(options, function.name(), compile_fn, entry);
+      *out_compilation_result = nullptr;
+      *out_executable = nullptr;
+      return Status::OK();
+    }
 
-    XlaCompiler compiler(options);
     entry->compiled = true;
-
-    entry->compilation_status =
-        compile_fn(&compiler, &entry->compilation_result);
-    TF_RETURN_IF_ERROR(entry->compilation_status);
-    CHECK_EQ(entry->executable.get(), nullptr);
-    entry->compilation_status =
-        BuildExecutable(options, entry->compilation_result, &entry->executable);
-
-    const uint64 compile_end_us = env->NowMicros();
-    const uint64 compile_time_us = compile_end_us - compile_start_us;
-    metrics::UpdateXlaCompilationTime(compile_time_us);
-    {
-      mutex_lock lock(cluster_compile_stats_mu_);
-      auto it = cluster_compile_stats_.find(function.name());
-      it->second.compile_count++;
-      it->second.cumulative_compile_time_us += compile_time_us;
-      LogOnceXlaCompiledFirstCluster();
-      VLOG(1) << "compiled " << function.name() << " "
-              << it->second.compile_count
-              << " times, compile time: " << compile_time_us
-              << " us, cumulative: " << it->second.cumulative_compile_time_us
-              << " us ("
-              << tensorflow::strings::HumanReadableElapsedTime(compile_time_us /
-                                                               1.0e6)
-              << " / "
-              << tensorflow::strings::HumanReadableElapsedTime(
-                     it->second.cumulative_compile_time_us / 1.0e6)
-              << ")";
-
-      XlaJitCompilationActivity jit_compilation_activity;
-      jit_compilation_activity.set_cluster_name(function.name());
-      jit_compilation_activity.set_compile_count(it->second.compile_count);
-      jit_compilation_activity.set_compile_time_us(compile_time_us);
-      jit_compilation_activity.set_cumulative_compile_time_us(
-          it->second.cumulative_compile_time_us);
-
-      TF_RETURN_IF_ERROR(
-          BroadcastXlaActivity(std::move(jit_compilation_activity)));
-    }
+    TF_RETURN_IF_ERROR(CompileAndBuild(
+        options, function.name(), compile_fn, &entry->compilation_status,
+        &entry->compilation_result, &entry->executable));
+    FinishCompilation(entry.get());
   }
   TF_RETURN_IF_ERROR(entry->compilation_status);
   *out_compilation_result = &entry->compilation_result;
   *out_executable = entry->executable.get();
+  if (out_entry != nullptr) {
+    *out_entry = std::move(entry);
+  }
   return Status::OK();
 }
 
+Status XlaCompilationCache::CompileAndBuild(
+    const XlaCompiler::Options& options, const std::string& function_name,
+    const std::function<Status(XlaCompiler* compiler,
+                               XlaCompiler::CompilationResult*)>& compile_fn,
+    Status* compilation_status, XlaCompiler::CompilationResult* result,
+    std::unique_ptr<xla::LocalExecutable>* executable) {
+  XLA_SCOPED_LOGGING_TIMER("Compilation of XLA executable");
+  tensorflow::Env* env = tensorflow::Env::Default();
+  const uint64 compile_start_us = env->NowMicros();
+
+  XlaCompiler compiler(options);
+  *compilation_status = compile_fn(&compiler, result);
+  if (!compilation_status->ok()) {
+    return Status::OK();
+  }
+  CHECK_EQ(executable->get(), nullptr);
+  *compilation_status = BuildExecutable(options, *result, executable);
+
+  const uint64 compile_end_us = env->NowMicros();
+  const uint64 compile_time_us = compile_end_us - compile_start_us;
+  metrics::UpdateXlaCompilationTime(compile_time_us);
+  mutex_lock lock(cluster_compile_stats_mu_);
+  auto it = cluster_compile_stats_.find(function_name);
+  it->second.compile_count++;
+  it->second.cumulative_compile_time_us += compile_time_us;
+  LogOnceXlaCompiledFirstCluster();
+  VLOG(1) << "compiled " << function_name << " " << it->second.compile_count
+          << " times, compile time: " << compile_time_us
+          << " us, cumulative: " << it->second.cumulative_compile_time_us
+          << " us ("
+          << tensorflow::strings::HumanReadableElapsedTime(compile_time_us /
+                                                           1.0e6)
+          << " / "
+          << tensorflow::strings::HumanReadableElapsedTime(
+                 it->second.cumulative_compile_time_us / 1.0e6)
+          << ")";
+
+  XlaJitCompilationActivity jit_compilation_activity;
+  jit_compilation_activity.set_cluster_name(function_name);
+  jit_compilation_activity.set_compile_count(it->second.compile_count);
+  jit_compilation_activity.set_compile_time_us(compile_time_us);
+  jit_compilation_activity.set_cumulative_compile_time_us(
+      it->second.cumulative_compile_time_us);
+
+  return BroadcastXlaActivity(std::move(jit_compilation_activity));
+}
+
+void XlaCompilationCache::CompileAsync(
+    const XlaCompiler::Options& options, const std::string& function_name,
+    std::function<Status(XlaCompiler* compiler,
+                         XlaCompiler::CompilationResult*)>
+        compile_fn,
+    EntryRef entry) {
+  // The caller's allocator and function library may be gone by the time the
+  // compilation runs, so compile with the allocator of the cache and a copy of
+  // the library.
+  XlaCompiler::Options async_options = options;
+  async_options.device_allocator = config_.async_compile_allocator.get();
+  std::shared_ptr<FunctionLibraryDefinition> flib_def;
+  if (options.flib_def != nullptr) {
+    flib_def = std::make_shared<FunctionLibraryDefinition>(*options.flib_def);
+    async_options.flib_def = flib_def.get();
+  }
+
+  mutex_lock lock(async_compile_mu_);
+  if (async_compile_threads_ == nullptr) {
+    async_compile_threads_ = absl::make_unique<thread::ThreadPool>(
+        Env::Default(), "xla_async_compile", kNumAsyncCompileThreads);
+  }
+  async_compile_threads_->Schedule([this, async_options, flib_def,
+                                    function_name,
+                                    compile_fn = std::move(compile_fn),
+                                    entry = std::move(entry)]() {
+    // No caller reads the results of the entry while it is compiling, so they
+    // are written without holding its lock.
+    Status status = CompileAndBuild(
+        async_options, function_name, compile_fn, &entry->compilation_status,
+        &entry->compilation_result, &entry->executable);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to broadcast the compilation of "
+                   << function_name << ": " << status;
+    }
+    {
+      mutex_lock entry_lock(entry->mu);
+      entry->compiled = true;
+      entry->compiling = false;
+      entry->compiled_cv.notify_all();
+    }
+    FinishCompilation(entry.get());
+  });
+}
+
+void XlaCompilationCache::FinishCompilation(Entry* entry) {
+  int64 size_bytes = 0;
+  if (const auto& computation = entry->compilation_result.computation) {
+    size_bytes += computation->proto().ByteSizeLong();
+  }
+  if (entry->executable) {
+    size_bytes += std::max<int64>(
+        0, entry->executable->executable()->SizeOfGeneratedCodeInBytes());
+  }
+  std::vector<EntryRef> evicted;
+  {
+    mutex_lock lock(compile_cache_mu_);
+    SetEntrySizeAndEvictLocked(entry, size_bytes, &evicted);
+  }
+}
+
+void XlaCompilationCache::TouchEntryLocked(Entry* entry) {
+  lru_.splice(lru_.begin(), lru_, entry->lru_position);
+}
+
+void XlaCompilationCache::SetEntrySizeAndEvictLocked(
+    Entry* entry, int64 size_bytes, std::vector<EntryRef>* evicted) {
+  if (entry->in_cache) {
+    cache_bytes_ += size_bytes - entry->size_bytes;
+    metrics::UpdateXlaCompilationCacheSize(
+        /*entries_delta=*/0, /*bytes_delta=*/size_bytes - entry->size_bytes);
+    entry->size_bytes = size_bytes;
+  }
+
+  auto over_budget = [&] {
+    return (config_.max_entries > 0 &&
+            static_cast<int64>(cache_.size()) > config_.max_entries) ||
+           (config_.max_bytes > 0 && cache_bytes_ > config_.max_bytes);
+  };
+  auto it = lru_.end();
+  while (over_budget() && it != lru_.begin()) {
+    Entry* victim = *--it;
+    if (victim == entry) continue;
+    VLOG(1) << "Evicting " << victim->signature.HumanString() << " ("
+            << victim->size_bytes << " bytes) from the compilation cache";
+    it = lru_.erase(it);
+    victim->in_cache = false;
+    cache_bytes_ -= victim->size_bytes;
+    metrics::UpdateXlaCompilationCacheSize(
+        /*entries_delta=*/-1, /*bytes_delta=*/-victim->size_bytes);
+    metrics::RecordXlaCompilationCacheEviction();
+    auto cache_it = cache_.find(victim->signature);
+    evicted->push_back(std::move(cache_it->second));
+    cache_.erase(cache_it);
+  }
+}
+
 }  // namespace tensorflow
@@ -16,6 +16,10 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_JIT_XLA_COMPILATION_CACHE_H_
 #define TENSORFLOW_COMPILER_JIT_XLA_COMPILATION_CACHE_H_
 
+#include <list>
+#include <memory>
+#include <vector>
+
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/types/optional.h"
@@ -40,16 +44,60 @@ namespace tensorflow {
 // Since XLA computations must have static shapes, the cache generates a new
 // XLA computation for each new set of input shapes.
 //
-// Currently no cache eviction policy is implemented and the cache grows without
-// bound.
+// The cache may be bounded by a number of entries and a number of bytes, in
+// which case the least recently used entries are evicted. Callers that keep
+// using a compilation result after Compile returns hold an EntryRef, which
+// keeps an evicted entry alive until they are done with it.
+//
+// With shape buckets, the dimensions of parameters are padded up to the next
+// bucket boundary and the computation is compiled for bounded dynamic shapes,
+// so that one executable serves every shape in a bucket.
+//
+// If a persistent cache directory is given, executables are also stored in
+// files in that directory, keyed by a fingerprint of the XLA computation, its
+// layouts and DebugOptions, the platform and the host CPU. A later process
+// loads an executable from its file instead of compiling it again. This is
+// only possible with backends that can serialize executables; with the others
+// the directory is ignored.
 class XlaCompilationCache : public ResourceBase {
+ private:
+  struct Entry;
+
  public:
+  struct Config {
+    // If non-empty, the directory of the persistent cache.
+    std::string persistent_cache_directory;
+
+    // If positive, the number of entries and the number of bytes of XLA
+    // computations and executables above which least recently used entries
+    // are evicted.
+    int64 max_entries = 0;
+    int64 max_bytes = 0;
+
+    // Increasing bucket boundaries. If non-empty, each dimension of a
+    // kParameter argument of Compile that is at most the last boundary is
+    // padded up to the next boundary.
+    std::vector<int64> bucket_boundaries;
+
+    // The device allocator of background compilations, which may outlive the
+    // allocator passed to Compile. If null, they use the memory allocator of
+    // the client's backend.
+    std::shared_ptr<se::DeviceMemoryAllocator> async_compile_allocator;
+  };
+
+  // Keeps a cache entry, and so the compilation result and executable returned
+  // with it, alive after it is evicted.
+  using EntryRef = std::shared_ptr<Entry>;
+
   XlaCompilationCache(xla::LocalClient* client, DeviceType device_type);
+  XlaCompilationCache(xla::LocalClient* client, DeviceType device_type,
+                      Config config);
   ~XlaCompilationCache() override;
 
   enum class CompileMode {
     kLazy,
     kStrict,
+    kAsync,
   };
 
   // Compiles a function into a XlaCompiler::CompilationResult that can be used
@@ -62,20 +110,32 @@ class XlaCompilationCache : public ResourceBase {
   // heuristics, the compilation cache may decide not to compile the cluster at
   // this time.  In this case it returns null into both `out_compilation_result`
   // and `out_executable`.  If `compile_mode` is `kStrict` then the compilation
-  // cache always attempts the compilation on a cache miss.
+  // cache always attempts the compilation on a cache miss.  If `compile_mode`
+  // is `kAsync` then the cache decides when to compile as with `kLazy`, but
+  // compiles on a background thread and returns null until the compilation has
+  // completed, so that the caller never waits for the compiler.
   //
   // The result of compilation is written to `*out_compilation_result`, which
   // must be non-null. If `out_executable` is non-null, also builds an
   // xla::LocalExecutable and sets `out_executable` to point to it. The
   // resulting executable pointer may be null if the computation has no
   // non-constant outputs.
+  //
+  // The results stay valid while the cache holds the entry. A caller that uses
+  // them after another compilation may have evicted the entry passes
+  // `out_entry`, which keeps them alive while it holds the reference.
+  //
+  // With bucket boundaries configured, the parameters of the executable may
+  // have bounded dynamic shapes; XlaComputationLaunchContext pads the inputs
+  // accordingly.
   Status Compile(const XlaCompiler::Options& options,
                  const NameAttrList& function,
                  absl::Span<const XlaCompiler::Argument> args,
                  const XlaCompiler::CompileOptions& compile_options,
                  CompileMode compile_mode,
                  const XlaCompiler::CompilationResult** out_compilation_result,
-                 xla::LocalExecutable** out_executable);
+                 xla::LocalExecutable** out_executable,
+                 EntryRef* out_entry = nullptr);
 
   // As above, but calls XlaCompiler::CompileSingleOp instead of
   // XlaCompiler::CompileFunction. If MLIR bridge is enabled through ConfigProto
@@ -86,7 +146,7 @@ class XlaCompilationCache : public ResourceBase {
       absl::Span<const XlaCompiler::Argument> args, OpKernelContext* ctx,
       const XlaCompiler::CompileOptions& compile_options,
       const XlaCompiler::CompilationResult** out_compilation_result,
-      xla::LocalExecutable** out_executable);
+      xla::LocalExecutable** out_executable, EntryRef* out_entry = nullptr);
 
   xla::LocalClient* client() const { return client_; }
   const DeviceType& device_type() const { return device_type_; }
@@ -107,6 +167,10 @@ class XlaCompilationCache : public ResourceBase {
     // compilation, ordered by argument number. Tensors must be in host memory.
     absl::InlinedVector<Tensor, 4> arg_values;
 
+    // Whether the arguments were bucketed, in which case arg_shapes holds the
+    // bounds of their dynamic shapes.
+    bool bucketed = false;
+
     bool operator==(const Signature& other) const;
 
     struct Hash {
@@ -122,6 +186,14 @@ class XlaCompilationCache : public ResourceBase {
       const NameAttrList& function,
       absl::Span<const XlaCompiler::Argument> args);
 
+  // Returns `args` with the dimensions of kParameter arguments padded up to
+  // the next of `bucket_boundaries` and marked dynamic, or nullopt if no
+  // argument can be bucketed. Arguments are not bucketed if any of them is a
+  // resource, whose updates must keep their static shapes.
+  static absl::optional<std::vector<XlaCompiler::Argument>> BucketArguments(
+      absl::Span<const XlaCompiler::Argument> args,
+      absl::Span<const int64> bucket_boundaries);
+
  private:
   // Common implementation of Compile and CompileSingleOp.
   Status CompileImpl(
@@ -129,9 +201,44 @@ class XlaCompilationCache : public ResourceBase {
       absl::Span<const XlaCompiler::Argument> args,
       const std::function<Status(XlaCompiler* compiler,
                                  XlaCompiler::CompilationResult*)>& compile_fn,
-      absl::optional<int64> compile_threshold,
+      absl::optional<int64> compile_threshold, bool async,
       const XlaCompiler::CompilationResult** out_compilation_result,
-      xla::LocalExecutable** out_executable);
+      xla::LocalExecutable** out_executable, EntryRef* out_entry);
+
+  // Compiles with `compile_fn` into `result` and builds `executable` from it,
+  // and records the compilation in the statistics of cluster `function_name`.
+  // The outcome of the compilation is stored in `compilation_status`; the
+  // returned status reports failures to broadcast the compilation activity.
+  Status CompileAndBuild(
+      const XlaCompiler::Options& options, const std::string& function_name,
+      const std::function<Status(XlaCompiler* compiler,
+                                 XlaCompiler::CompilationResult*)>& compile_fn,
+      Status* compilation_status, XlaCompiler::CompilationResult* result,
+      std::unique_ptr<xla::LocalExecutable>* executable);
+
+  // Compiles `entry` on a background thread, and publishes the results in it
+  // once done.
+  void CompileAsync(
+      const XlaCompiler::Options& options, const std::string& function_name,
+      std::function<Status(XlaCompiler* compiler,
+                           XlaCompiler::CompilationResult*)>
+          compile_fn,
+      EntryRef entry);
+
+  // Updates the size of the compiled `entry` and evicts entries as needed.
+  void FinishCompilation(Entry* entry);
+
+  // Moves `entry` to the front of the LRU list.
+  void TouchEntryLocked(Entry* entry)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(compile_cache_mu_);
+
+  // Records the final size of the compiled `entry` and evicts least recently
+  // used entries other than `entry` until the cache is within its budget.
+  // Evicted entries are appended to `evicted`, to be released once
+  // compile_cache_mu_ is no longer held.
+  void SetEntrySizeAndEvictLocked(Entry* entry, int64 size_bytes,
+                                  std::vector<EntryRef>* evicted)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(compile_cache_mu_);
 
   // Takes `result` which has been compiled from a Tensorflow subgraph to a
   // XLA computation already, and generates an XLA LocalExecutable `executable`.
@@ -139,16 +246,49 @@ class XlaCompilationCache : public ResourceBase {
                          const XlaCompiler::CompilationResult& result,
                          std::unique_ptr<xla::LocalExecutable>* executable);
 
+  // Returns the file of the persistent cache for the executable built from
+  // `computation` with the given argument layouts and build options.
+  xla::StatusOr<std::string> PersistentCacheFile(
+      const xla::XlaComputation& computation,
+      absl::Span<const xla::Shape* const> argument_layouts,
+      const xla::ExecutableBuildOptions& build_options) const;
+
+  // Loads the executable stored in `filename` by StorePersistentExecutable.
+  Status LoadPersistentExecutable(
+      const std::string& filename,
+      const xla::ExecutableBuildOptions& build_options,
+      std::unique_ptr<xla::LocalExecutable>* executable);
+
+  // Stores `executable` in `filename`, replacing it if it exists.
+  Status StorePersistentExecutable(const std::string& filename,
+                                   const xla::LocalExecutable& executable);
+
   xla::LocalClient* const client_;
   const DeviceType device_type_;
+  const Config config_;
 
   // The value associated with a cache entry.
   struct Entry {
+    explicit Entry(Signature signature) : signature(std::move(signature)) {}
+
+    const Signature signature;
+
+    // The position of the entry in lru_, its size in bytes once compiled, and
+    // whether it is still in the cache. All guarded by compile_cache_mu_.
+    std::list<Entry*>::iterator lru_position;
+    int64 size_bytes = 0;
+    bool in_cache = true;
+
     mutex mu;
 
     // Have we tried compiling this entry?
     bool compiled = false;
 
+    // Whether a background compilation of this entry is running. Its
+    // completion is signalled on `compiled_cv`.
+    bool compiling TF_GUARDED_BY(mu) = false;
+    condition_variable compiled_cv;
+
     // The number of times a compilation with this signature has been requested.
     int64 request_count = 0;
 
@@ -163,10 +303,20 @@ class XlaCompilationCache : public ResourceBase {
     std::unique_ptr<xla::LocalExecutable> executable TF_GUARDED_BY(mu);
   };
 
+  // Frees evicted entries asynchronously once their executables can no longer
+  // be running. Shared with the deleters of the entries, which may outlive
+  // the cache.
+  class RetiredEntries;
+  std::shared_ptr<RetiredEntries> retired_entries_;
+
   mutex compile_cache_mu_;
-  absl::flat_hash_map<Signature, std::unique_ptr<Entry>, Signature::Hash> cache_
+  absl::flat_hash_map<Signature, EntryRef, Signature::Hash> cache_
       TF_GUARDED_BY(compile_cache_mu_);
 
+  // The entries in cache_, most recently used first, and their total size.
+  std::list<Entry*> lru_ TF_GUARDED_BY(compile_cache_mu_);
+  int64 cache_bytes_ TF_GUARDED_BY(compile_cache_mu_) = 0;
+
   struct ClusterCompileStats {
     // Number of times the cluster has been (re-)compiled.
     int64 compile_count = 0;
@@ -183,6 +333,11 @@ class XlaCompilationCache : public ResourceBase {
     bool is_megamorphic = false;
   };
 
+  // Runs asynchronous compilations. Created on first use.
+  mutex async_compile_mu_;
+  std::unique_ptr<thread::ThreadPool> async_compile_threads_
+      TF_GUARDED_BY(async_compile_mu_);
+
   mutex cluster_compile_stats_mu_;
 
   // Maps cluster names to compilation statistics for said cluster.
@@ -193,6 +348,9 @@ class XlaCompilationCache : public ResourceBase {
   // signature before  we attempt to compile it.
   static constexpr int64 kDefaultCompilationThreshold = 2;
 
+  // The number of threads compiling asynchronously.
+  static constexpr int kNumAsyncCompileThreads = 4;
+
   TF_DISALLOW_COPY_AND_ASSIGN(XlaCompilationCache);
 };
 
@@ -17,7 +17,14 @@ limitations under the License.
 
 #include "tensorflow/compiler/jit/flags.h"
 #include "tensorflow/compiler/tf2xla/shape_util.h"
+#include "tensorflow/compiler/tf2xla/xla_op_registry.h"
 #include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/monitoring/collection_registry.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
@@ -54,6 +61,315 @@ TEST(XlaCompilationCacheTest, SignatureEquality) {
   }
 }
 
+// Returns the number of lookups in the persistent cache with `result`.
+int64 PersistentCacheLookups(const std::string& result) {
+  std::unique_ptr<monitoring::CollectedMetrics> metrics =
+      monitoring::CollectionRegistry::Default()->CollectMetrics({});
+  auto it = metrics->point_set_map.find(
+      "/tensorflow/core/xla_persistent_cache_lookups");
+  if (it == metrics->point_set_map.end()) return 0;
+  for (const auto& point : it->second->points) {
+    if (point->labels[0].value == result) return point->int64_value;
+  }
+  return 0;
+}
+
+TEST(XlaCompilationCacheTest, PersistentCache) {
+  XlaOpRegistry::RegisterCompilationKernels();
+  FunctionDefLibrary flib;
+  *flib.add_function() = test::function::XTimesTwo();
+  FunctionLibraryDefinition flib_def(OpRegistry::Global(), flib);
+
+  xla::LocalClient* client = xla::ClientLibrary::LocalClientOrDie();
+  XlaCompiler::Options options;
+  options.device_type = DeviceType(DEVICE_CPU_XLA_JIT);
+  options.client = client;
+  options.flib_def = &flib_def;
+
+  NameAttrList fn;
+  fn.set_name("XTimesTwo");
+  (*fn.mutable_attr())["T"].set_type(DT_FLOAT);
+  std::vector<XlaCompiler::Argument> args(1);
+  args[0].kind = XlaCompiler::Argument::kParameter;
+  args[0].type = DT_FLOAT;
+  args[0].shape = TensorShape({8});
+
+  const std::string directory =
+      io::JoinPath(testing::TmpDir(), "xla_persistent_cache");
+  int64 undeleted_files, undeleted_dirs;
+  Env::Default()
+      ->DeleteRecursively(directory, &undeleted_files, &undeleted_dirs)
+      .IgnoreError();
+  // Each cache stands for a new process, which only finds the executable in
+  // the persistent cache.
+  XlaCompilationCache::Config config;
+  config.persistent_cache_directory = directory;
+  auto compile = [&]() {
+    auto cache = new XlaCompilationCache(client, options.device_type, config);
+    core::ScopedUnref cache_ref(cache);
+    const XlaCompiler::CompilationResult* compilation_result;
+    xla::LocalExecutable* executable;
+    TF_ASSERT_OK(cache->Compile(options, fn, args,
+                                XlaCompiler::CompileOptions{},
+                                XlaCompilationCache::CompileMode::kStrict,
+                                &compilation_result, &executable));
+    EXPECT_NE(executable, nullptr);
+  };
+
+  const int64 hits = PersistentCacheLookups("hit");
+  const int64 misses = PersistentCacheLookups("miss");
+  compile();
+  EXPECT_EQ(PersistentCacheLookups("hit"), hits);
+  EXPECT_EQ(PersistentCacheLookups("miss"), misses + 1);
+  std::vector<string> files;
+  TF_ASSERT_OK(Env::Default()->GetMatchingPaths(
+      io::JoinPath(directory, "*.xla_executable"), &files));
+  ASSERT_EQ(files.size(), 1);
+
+  compile();
+  EXPECT_EQ(PersistentCacheLookups("hit"), hits + 1);
+  EXPECT_EQ(PersistentCacheLookups("miss"), misses + 1);
+
+  // A corrupt file is a miss, and is replaced by the compiled executable.
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), files[0], "corrupt"));
+  compile();
+  EXPECT_EQ(PersistentCacheLookups("miss"), misses + 2);
+  compile();
+  EXPECT_EQ(PersistentCacheLookups("hit"), hits + 2);
+}
+
+// Returns the value of the metric `name`, which has no labels.
+int64 MetricValue(const std::string& name) {
+  std::unique_ptr<monitoring::CollectedMetrics> metrics =
+      monitoring::CollectionRegistry::Default()->CollectMetrics({});
+  auto it = metrics->point_set_map.find(name);
+  if (it == metrics->point_set_map.end() || it->second->points.empty()) {
+    return 0;
+  }
+  return it->second->points[0]->int64_value;
+}
+
+TEST(XlaCompilationCacheTest, EvictsLeastRecentlyUsed) {
+  XlaOpRegistry::RegisterCompilationKernels();
+  FunctionDefLibrary flib;
+  *flib.add_function() = test::function::XTimesTwo();
+  FunctionLibraryDefinition flib_def(OpRegistry::Global(), flib);
+
+  xla::LocalClient* client = xla::ClientLibrary::LocalClientOrDie();
+  XlaCompiler::Options options;
+  options.device_type = DeviceType(DEVICE_CPU_XLA_JIT);
+  options.client = client;
+  options.flib_def = &flib_def;
+
+  NameAttrList fn;
+  fn.set_name("XTimesTwo");
+  (*fn.mutable_attr())["T"].set_type(DT_FLOAT);
+
+  XlaCompilationCache::Config config;
+  config.max_entries = 2;
+  auto cache = new XlaCompilationCache(client, options.device_type, config);
+  core::ScopedUnref cache_ref(cache);
+
+  // Compiles for a vector of `size` elements, and returns whether that
+  // compiled the function rather than finding it in the cache.
+  auto compile = [&](int64 size, xla::LocalExecutable** executable,
+                     XlaCompilationCache::EntryRef* entry) {
+    std::vector<XlaCompiler::Argument> args(1);
+    args[0].kind = XlaCompiler::Argument::kParameter;
+    args[0].type = DT_FLOAT;
+    args[0].shape = TensorShape({size});
+    const int64 compilations = MetricValue("/tensorflow/core/xla_compilations");
+    const XlaCompiler::CompilationResult* compilation_result;
+    TF_CHECK_OK(cache->Compile(options, fn, args,
+                               XlaCompiler::CompileOptions{},
+                               XlaCompilationCache::CompileMode::kStrict,
+                               &compilation_result, executable, entry));
+    return MetricValue("/tensorflow/core/xla_compilations") > compilations;
+  };
+
+  const int64 evictions =
+      MetricValue("/tensorflow/core/xla_compilation_cache_evictions");
+  xla::LocalExecutable* executable;
+  XlaCompilationCache::EntryRef evicted_entry;
+  EXPECT_TRUE(compile(2, &executable, nullptr));
+  EXPECT_TRUE(compile(3, &executable, &evicted_entry));
+  xla::LocalExecutable* evicted_executable = executable;
+  EXPECT_FALSE(compile(2, &executable, nullptr));
+  EXPECT_EQ(MetricValue("/tensorflow/core/xla_compilation_cache_entries"), 2);
+
+  // Size 3 is the least recently used, and is evicted.
+  EXPECT_TRUE(compile(4, &executable, nullptr));
+  EXPECT_EQ(MetricValue("/tensorflow/core/xla_compilation_cache_evictions"),
+            evictions + 1);
+  EXPECT_EQ(MetricValue("/tensorflow/core/xla_compilation_cache_entries"), 2);
+  EXPECT_GT(MetricValue("/tensorflow/core/xla_compilation_cache_bytes"), 0);
+  EXPECT_FALSE(compile(2, &executable, nullptr));
+  EXPECT_FALSE(compile(4, &executable, nullptr));
+
+  // The evicted executable stays alive while its entry is referenced.
+  EXPECT_EQ(evicted_executable->executable()
+                ->module()
+                .entry_computation_layout()
+                .parameter_shape(0)
+                .dimensions(0),
+            3);
+  evicted_entry.reset();
+  EXPECT_TRUE(compile(3, &executable, nullptr));
+}
+
+TEST(XlaCompilationCacheTest, BucketArguments) {
+  std::vector<XlaCompiler::Argument> args(3);
+  args[0].kind = XlaCompiler::Argument::kParameter;
+  args[0].type = DT_FLOAT;
+  args[0].shape = TensorShape({3, 100, 300});
+  args[1].kind = XlaCompiler::Argument::kParameter;
+  args[1].type = DT_INT32;
+  args[1].shape = TensorShape({1, 16});
+  args[2].kind = XlaCompiler::Argument::kConstant;
+  args[2].type = DT_INT32;
+  args[2].shape = TensorShape({});
+  args[2].constant_value = Tensor(DT_INT32, {});
+  const std::vector<int64> boundaries = {16, 64, 256};
+
+  absl::optional<std::vector<XlaCompiler::Argument>> bucketed =
+      XlaCompilationCache::BucketArguments(args, boundaries);
+  ASSERT_TRUE(bucketed.has_value());
+  ASSERT_EQ(bucketed->size(), 3);
+  // Dimensions above the largest boundary, and dimensions of size 1, which
+  // may be broadcast, stay static.
+  xla::Shape expected = xla::ShapeUtil::MakeShape(xla::F32, {16, 256, 300});
+  expected.set_dynamic_dimension(0, true);
+  expected.set_dynamic_dimension(1, true);
+  EXPECT_TRUE(xla::ShapeUtil::Equal(absl::get<xla::Shape>((*bucketed)[0].shape),
+                                    expected));
+  expected = xla::ShapeUtil::MakeShape(xla::S32, {1, 16});
+  expected.set_dynamic_dimension(1, true);
+  EXPECT_TRUE(xla::ShapeUtil::Equal(absl::get<xla::Shape>((*bucketed)[1].shape),
+                                    expected));
+  EXPECT_TRUE(absl::holds_alternative<TensorShape>((*bucketed)[2].shape));
+
+  // Shapes in the same buckets share a signature, which differs from that of
+  // the exact shapes of the bounds.
+  NameAttrList fn;
+  fn.set_name("afunction");
+  TF_ASSERT_OK_AND_ASSIGN(XlaCompilationCache::Signature s1,
+                          XlaCompilationCache::BuildSignature(fn, *bucketed));
+  args[0].shape = TensorShape({16, 200, 300});
+  bucketed = XlaCompilationCache::BucketArguments(args, boundaries);
+  ASSERT_TRUE(bucketed.has_value());
+  TF_ASSERT_OK_AND_ASSIGN(XlaCompilationCache::Signature s2,
+                          XlaCompilationCache::BuildSignature(fn, *bucketed));
+  EXPECT_TRUE(s1 == s2);
+  args[0].shape = TensorShape({16, 256, 300});
+  TF_ASSERT_OK_AND_ASSIGN(XlaCompilationCache::Signature exact,
+                          XlaCompilationCache::BuildSignature(fn, args));
+  EXPECT_FALSE(exact == s1);
+
+  // Clusters with resources are not bucketed.
+  args[1].kind = XlaCompiler::Argument::kResource;
+  args[1].resource_kind = XlaResource::kVariable;
+  args[1].initialized = true;
+  EXPECT_FALSE(
+      XlaCompilationCache::BucketArguments(args, boundaries).has_value());
+  EXPECT_FALSE(XlaCompilationCache::BucketArguments(args, {}).has_value());
+}
+
+TEST(XlaCompilationCacheTest, BucketedShapesShareExecutable) {
+  XlaOpRegistry::RegisterCompilationKernels();
+  FunctionDefLibrary flib;
+  *flib.add_function() = test::function::XTimesTwo();
+  FunctionLibraryDefinition flib_def(OpRegistry::Global(), flib);
+
+  xla::LocalClient* client = xla::ClientLibrary::LocalClientOrDie();
+  XlaCompiler::Options options;
+  options.device_type = DeviceType(DEVICE_CPU_XLA_JIT);
+  options.client = client;
+  options.flib_def = &flib_def;
+
+  NameAttrList fn;
+  fn.set_name("XTimesTwo");
+  (*fn.mutable_attr())["T"].set_type(DT_FLOAT);
+
+  XlaCompilationCache::Config config;
+  config.bucket_boundaries = {8, 64};
+  auto cache = new XlaCompilationCache(client, options.device_type, config);
+  core::ScopedUnref cache_ref(cache);
+
+  auto compile = [&](int64 size) {
+    std::vector<XlaCompiler::Argument> args(1);
+    args[0].kind = XlaCompiler::Argument::kParameter;
+    args[0].type = DT_FLOAT;
+    args[0].shape = TensorShape({size});
+    const XlaCompiler::CompilationResult* compilation_result;
+    xla::LocalExecutable* executable;
+    TF_CHECK_OK(cache->Compile(options, fn, args,
+                               XlaCompiler::CompileOptions{},
+                               XlaCompilationCache::CompileMode::kStrict,
+                               &compilation_result, &executable));
+    return std::make_pair(compilation_result, executable);
+  };
+
+  auto result5 = compile(5);
+  auto result7 = compile(7);
+  auto result40 = compile(40);
+  EXPECT_EQ(result5.second, result7.second);
+  EXPECT_NE(result5.second, result40.second);
+  const xla::Shape& input_shape = result5.first->xla_input_shapes[0];
+  EXPECT_TRUE(input_shape.is_dynamic_dimension(0));
+  EXPECT_EQ(input_shape.dimensions(0), 8);
+}
+
+TEST(XlaCompilationCacheTest, AsyncCompilation) {
+  XlaOpRegistry::RegisterCompilationKernels();
+  FunctionDefLibrary flib;
+  *flib.add_function() = test::function::XTimesTwo();
+  FunctionLibraryDefinition flib_def(OpRegistry::Global(), flib);
+
+  xla::LocalClient* client = xla::ClientLibrary::LocalClientOrDie();
+  XlaCompiler::Options options;
+  options.device_type = DeviceType(DEVICE_CPU_XLA_JIT);
+  options.client = client;
+  options.flib_def = &flib_def;
+
+  NameAttrList fn;
+  fn.set_name("XTimesTwo");
+  (*fn.mutable_attr())["T"].set_type(DT_FLOAT);
+  std::vector<XlaCompiler::Argument> args(1);
+  args[0].kind = XlaCompiler::Argument::kParameter;
+  args[0].type = DT_FLOAT;
+  args[0].shape = TensorShape({8});
+
+  auto cache = new XlaCompilationCache(client, options.device_type);
+  core::ScopedUnref cache_ref(cache);
+  auto compile = [&](XlaCompilationCache::CompileMode compile_mode) {
+    const XlaCompiler::CompilationResult* compilation_result;
+    xla::LocalExecutable* executable;
+    TF_CHECK_OK(cache->Compile(options, fn, args, XlaCompiler::CompileOptions{},
+                               compile_mode, &compilation_result,
+                               &executable));
+    EXPECT_EQ(compilation_result == nullptr, executable == nullptr);
+    return executable;
+  };
+
+  // The first request starts the compilation and returns without waiting for
+  // it; later requests find the executable once it is ready.
+  EXPECT_EQ(compile(XlaCompilationCache::CompileMode::kAsync), nullptr);
+  xla::LocalExecutable* executable = nullptr;
+  for (int i = 0; i < 600 && executable == nullptr; ++i) {
+    executable = compile(XlaCompilationCache::CompileMode::kAsync);
+    if (executable == nullptr) Env::Default()->SleepForMicroseconds(100000);
+  }
+  ASSERT_NE(executable, nullptr);
+  EXPECT_EQ(compile(XlaCompilationCache::CompileMode::kLazy), executable);
+
+  // A strict request waits for a running compilation, which starts once the
+  // new signature reaches the compile threshold.
+  args[0].shape = TensorShape({16});
+  EXPECT_EQ(compile(XlaCompilationCache::CompileMode::kAsync), nullptr);
+  EXPECT_EQ(compile(XlaCompilationCache::CompileMode::kAsync), nullptr);
+  EXPECT_NE(compile(XlaCompilationCache::CompileMode::kStrict), nullptr);
+}
+
 TEST(XlaCompilationCacheTest, TestDisabledXlaCompilation) {
   NameAttrList fn;
   fn.set_name("afunction");
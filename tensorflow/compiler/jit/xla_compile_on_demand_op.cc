@@ -102,7 +102,8 @@ Status XlaCompileOnDemandOp::Run(OpKernelContext* ctx,
 Status XlaCompileOnDemandOp::Compile(
     OpKernelContext* ctx, const XlaCompiler::CompilationResult** result,
     XlaCompilationCache** cache, ResourceVarsSnapshot* variable_args,
-    xla::LocalExecutable** executable) {
+    xla::LocalExecutable** executable,
+    XlaCompilationCache::EntryRef* cache_entry) {
 
   std::vector<int> constant_input_indices;
   TF_RETURN_IF_ERROR(GetCompileTimeConstInputs(
@@ -159,18 +160,19 @@ Status XlaCompileOnDemandOp::Compile(
   }
 
   return (*cache)->CompileSingleOp(options, *args, ctx, compile_options, result,
-                                   executable);
+                                   executable, cache_entry);
 }
 
 void XlaCompileOnDemandOp::Compute(OpKernelContext* ctx) {
   const XlaCompiler::CompilationResult* result;
   xla::LocalExecutable* executable;
+  XlaCompilationCache::EntryRef cache_entry;
   ResourceVarsSnapshot variable_args;
   XlaCompilationCache* cache;
   OP_REQUIRES(ctx, ctx->function_library(),
               errors::Internal("Function library missing"));
-  OP_REQUIRES_OK(ctx,
-                 Compile(ctx, &result, &cache, &variable_args, &executable));
+  OP_REQUIRES_OK(ctx, Compile(ctx, &result, &cache, &variable_args,
+                              &executable, &cache_entry));
 
   // Hold the reference to the JIT during evaluation. (We could probably
   // free it sooner because the ResourceMgr will retain a reference, but
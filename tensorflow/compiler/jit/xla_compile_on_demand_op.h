@@ -47,7 +47,8 @@ class XlaCompileOnDemandOp : public OpKernel {
                  const XlaCompiler::CompilationResult** result,
                  XlaCompilationCache** cache,
                  ResourceVarsSnapshot* variable_args,
-                 xla::LocalExecutable** executable);
+                 xla::LocalExecutable** executable,
+                 XlaCompilationCache::EntryRef* cache_entry);
 
   Status Run(OpKernelContext* ctx, XlaCompilationCache* cache,
              const XlaCompiler::CompilationResult* result,
@@ -200,6 +200,44 @@ static void PopulateExecutionInputBuffer(xla::ExecutionInput& execution_input,
   }
 }
 
+// Enqueues on `stream` a copy of `tensor` into a new buffer in the layout of an
+// XLA parameter with the bounded dynamic shape `shape`: the elements of the
+// tensor, followed, after the size of the bound, by the sizes of its
+// dimensions as int32s. Does not wait for the copy to complete.
+static xla::StatusOr<se::OwningDeviceMemory> CopyToBoundedShape(
+    xla::LocalClient* client, se::DeviceMemoryAllocator* allocator,
+    int device_ordinal, se::Stream* stream, const Tensor& tensor,
+    const xla::Shape& shape) {
+  TF_RET_CHECK(tensor.dims() == shape.rank());
+  auto shape_size_fn = client->backend().compiler()->ShapeSizeBytesFunction();
+  const int64 data_size =
+      shape_size_fn(xla::ShapeUtil::MakeStaticShape(shape));
+  const int64 metadata_size = shape_size_fn(shape) - data_size;
+  TF_RET_CHECK(tensor.TotalBytes() <= data_size);
+  TF_RET_CHECK(metadata_size == shape.rank() * sizeof(int32))
+      << "Unexpected metadata size " << metadata_size;
+
+  TF_ASSIGN_OR_RETURN(
+      se::OwningDeviceMemory buffer,
+      allocator->Allocate(device_ordinal, data_size + metadata_size));
+  auto dim_sizes = std::make_shared<std::vector<int32>>(tensor.dims());
+  for (int i = 0; i < tensor.dims(); ++i) {
+    (*dim_sizes)[i] = tensor.dim_size(i);
+  }
+  se::DeviceMemoryBase data = *buffer;
+  if (tensor.TotalBytes() > 0) {
+    stream->ThenMemcpy(&data, XlaTensor::DeviceMemoryFromTensor(tensor),
+                       tensor.TotalBytes());
+  }
+  se::DeviceMemory<uint8> buffer_8(*buffer);
+  se::DeviceMemory<uint8> metadata =
+      stream->parent()->GetSubBuffer(&buffer_8, data_size, metadata_size);
+  stream->ThenMemcpy(&metadata, dim_sizes->data(), metadata_size);
+  // The host copy of the sizes must outlive the transfer.
+  stream->ThenDoHostCallback([dim_sizes]() {});
+  return std::move(buffer);
+}
+
 xla::StatusOr<std::vector<xla::ExecutionInput>>
 XlaComputationLaunchContext::PopulateInputs(
     OpKernelContext* ctx,
@@ -212,6 +250,12 @@ XlaComputationLaunchContext::PopulateInputs(
 
   xla::TransferManager* transfer_manager =
       client_->backend().transfer_manager();
+  // The stream that inputs of bucketed parameters are copied on. It is the
+  // stream of the op, which runs the computation after the copies, or, if the
+  // op has none, a borrowed stream that is synchronized with once all copies
+  // are enqueued.
+  se::Stream* copy_stream = nullptr;
+  xla::StreamPool::Ptr borrowed_stream;
   for (int i = 0, end = compilation_result->xla_input_shapes.size(); i < end;
        ++i) {
     int arg_num = compilation_result->input_mapping[i];
@@ -251,7 +295,27 @@ XlaComputationLaunchContext::PopulateInputs(
 
     arguments.emplace_back(device_shape, shape);
     xla::ExecutionInput& execution_input = arguments.back();
-    if (xla::Shape::Equal().MinorToMajorOnlyInLayout()(shape, device_shape)) {
+    if (shape.is_dynamic()) {
+      // The computation was compiled for a bucket of shapes, which the input
+      // is copied into.
+      if (copy_stream == nullptr) {
+        copy_stream = ctx->op_device_context()
+                          ? ctx->op_device_context()->stream()
+                          : nullptr;
+      }
+      if (copy_stream == nullptr) {
+        TF_ASSIGN_OR_RETURN(borrowed_stream,
+                            client_->mutable_backend()->BorrowStream(
+                                device_ordinal_));
+        copy_stream = borrowed_stream.get();
+      }
+      TF_ASSIGN_OR_RETURN(
+          se::OwningDeviceMemory buffer,
+          CopyToBoundedShape(client_, xla_allocator_, device_ordinal_,
+                             copy_stream, *t, device_shape));
+      *execution_input.MutableBuffer({}) = std::move(buffer);
+    } else if (xla::Shape::Equal().MinorToMajorOnlyInLayout()(shape,
+                                                              device_shape)) {
       se::DeviceMemoryBase dmem = XlaTensor::DeviceMemoryFromTensor(*t);
       PopulateExecutionInputBuffer(execution_input, xla::ShapeIndex{}, dmem,
                                    donate_buffer, device_ordinal_,
@@ -267,6 +331,9 @@ XlaComputationLaunchContext::PopulateInputs(
           });
     }
   }
+  if (borrowed_stream) {
+    TF_RETURN_IF_ERROR(borrowed_stream->BlockHostUntilDone());
+  }
   return std::move(arguments);
 }
 
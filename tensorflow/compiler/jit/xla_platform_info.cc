@@ -15,17 +15,47 @@ limitations under the License.
 
 #include "tensorflow/compiler/jit/xla_platform_info.h"
 
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/jit/flags.h"
 #include "tensorflow/compiler/xla/client/client_library.h"
 
 namespace tensorflow {
 
+// Returns the configuration of compilation caches given by the flags.
+static xla::StatusOr<XlaCompilationCache::Config> CompilationCacheConfig() {
+  const XlaOpsCommonFlags& flags = GetXlaOpsCommonFlags();
+  XlaCompilationCache::Config config;
+  config.persistent_cache_directory = flags.tf_xla_persistent_cache_directory;
+  config.max_entries = flags.tf_xla_compilation_cache_max_entries;
+  config.max_bytes = flags.tf_xla_compilation_cache_max_bytes;
+  for (absl::string_view boundary :
+       absl::StrSplit(flags.tf_xla_shape_bucket_boundaries, ',',
+                      absl::SkipWhitespace())) {
+    int64 size;
+    if (!absl::SimpleAtoi(boundary, &size) || size <= 1 ||
+        (!config.bucket_boundaries.empty() &&
+         size <= config.bucket_boundaries.back())) {
+      return errors::InvalidArgument(
+          "Invalid --tf_xla_shape_bucket_boundaries=",
+          flags.tf_xla_shape_bucket_boundaries,
+          ": expected increasing sizes greater than 1");
+    }
+    config.bucket_boundaries.push_back(size);
+  }
+  return config;
+}
+
 Status BuildXlaCompilationCache(DeviceBase* device,
                                 const XlaPlatformInfo& platform_info,
                                 XlaCompilationCache** cache) {
+  TF_ASSIGN_OR_RETURN(XlaCompilationCache::Config config,
+                      CompilationCacheConfig());
   if (platform_info.xla_device_metadata()) {
     *cache = new XlaCompilationCache(
         platform_info.xla_device_metadata()->client(),
-        platform_info.xla_device_metadata()->jit_device_type());
+        platform_info.xla_device_metadata()->jit_device_type(),
+        std::move(config));
     return Status::OK();
   }
 
@@ -70,8 +100,21 @@ Status BuildXlaCompilationCache(DeviceBase* device,
     return errors::InvalidArgument("No JIT device registered for ",
                                    platform_info.device_type().type());
   }
+  // Background compilations, e.g. autotuning on GPU, allocate from the
+  // device's allocator like the others, on its compute stream. Both live as
+  // long as the device.
+  const DeviceBase::GpuDeviceInfo* gpu_device_info =
+      device->tensorflow_gpu_device_info();
+  if (gpu_device_info != nullptr && gpu_device_info->stream != nullptr) {
+    config.async_compile_allocator = std::make_shared<se::TfAllocatorAdapter>(
+        device->GetAllocator({}), gpu_device_info->stream);
+  } else {
+    config.async_compile_allocator = std::make_shared<se::TfAllocatorAdapter>(
+        device->GetAllocator({}), platform.ValueOrDie());
+  }
   *cache = new XlaCompilationCache(
-      client.ValueOrDie(), DeviceType(registration->compilation_device_name));
+      client.ValueOrDie(), DeviceType(registration->compilation_device_name),
+      std::move(config));
   return Status::OK();
 }
 
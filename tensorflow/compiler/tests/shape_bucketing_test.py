@@ -0,0 +1,69 @@
+# Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""End-to-end tests for clusters compiled for buckets of input shapes."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import os
+
+import numpy as np
+
+from tensorflow.compiler.tests import xla_test
+from tensorflow.python.eager import def_function
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import ops
+from tensorflow.python.framework import tensor_spec
+from tensorflow.python.ops import math_ops
+from tensorflow.python.platform import test
+
+
+class ShapeBucketingTest(xla_test.XLATestCase):
+
+  def testBucketedOutputsMatchUnbucketed(self):
+    with ops.device('device:{}:0'.format(self.device)):
+
+      def fn(x, y):
+        # Both inputs are copied into bounded buffers on each launch. The
+        # reduction over the padded dimension must ignore the padding.
+        return x * 2.0 + y, math_ops.reduce_sum(x * y, axis=0)
+
+      input_signature = [
+          tensor_spec.TensorSpec([None, 3], dtypes.float32),
+          tensor_spec.TensorSpec([None, 3], dtypes.float32)
+      ]
+      func = def_function.function(
+          fn, jit_compile=False, input_signature=input_signature)
+      xla_func = def_function.function(
+          fn, jit_compile=True, input_signature=input_signature)
+
+      # Sizes in the same bucket, at a boundary, and in the next bucket of the
+      # boundaries set in `TF_XLA_FLAGS` below.
+      for size in [2, 5, 8, 9, 30, 64]:
+        x = np.random.rand(size, 3).astype(np.float32)
+        y = np.random.rand(size, 3).astype(np.float32)
+        expected = func(x, y)
+        actual = xla_func(x, y)
+        for expected_output, actual_output in zip(expected, actual):
+          self.assertEqual(expected_output.shape, actual_output.shape)
+          self.assertAllClose(expected_output, actual_output)
+
+
+if __name__ == '__main__':
+  os.environ['TF_XLA_FLAGS'] = ('--tf_xla_shape_bucket_boundaries=8,64 ' +
+                                os.environ.get('TF_XLA_FLAGS', ''))
+  ops.enable_eager_execution()
+  test.main()
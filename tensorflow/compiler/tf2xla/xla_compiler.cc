@@ -848,6 +848,17 @@ Status XlaCompiler::XLAShapeForArgument(
         TF_RETURN_IF_ERROR(RewriteLayoutWithShardedShape(
             arg_sharding, /*use_fast_memory=*/false,
             options_.shape_representation_fn, xla_shape));
+        // Keep the dynamic dimensions of a parameter with a bounded shape.
+        if (absl::holds_alternative<xla::Shape>(arg.shape)) {
+          const xla::Shape& arg_shape = absl::get<xla::Shape>(arg.shape);
+          if (!arg_shape.is_static() && xla_shape->IsArray() &&
+              xla_shape->rank() == arg_shape.rank()) {
+            for (int i = 0; i < arg_shape.rank(); ++i) {
+              xla_shape->set_dynamic_dimension(
+                  i, arg_shape.is_dynamic_dimension(i));
+            }
+          }
+        }
       } else {
         if (absl::holds_alternative<xla::Shape>(arg.shape)) {
           *xla_shape = absl::get<xla::Shape>(arg.shape);
@@ -1150,7 +1161,11 @@ Status XlaCompiler::BuildArguments(
         // Reshape parameters back to their correct shapes.
         // TODO(b/76097077): propagate device assignments onto arguments and
         // return values of functions, and then reshape unconditionally.
-        if (is_entry_computation) {
+        // Bounded dynamic shapes are kept in their representation, which
+        // has the same dimensions.
+        if (is_entry_computation &&
+            !(absl::holds_alternative<xla::Shape>(arg.shape) &&
+              absl::get<xla::Shape>(arg.shape).is_dynamic())) {
           arg_expression = XlaExpression::XlaOp(
               xla::Reshape(arg_handles[i], arg.DimensionSizes()), arg.type);
         } else {
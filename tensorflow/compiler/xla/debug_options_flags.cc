@@ -600,6 +600,27 @@ static void AllocateFlags() {
       flag_values->xla_gpu_force_compilation_parallelism(),
       "Overrides normal multi-threaded compilation settting to use this many "
       "threads. Setting to 0 (the default value) means no enforcement."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_compilation_parallelism",
+      int32_setter_for(&DebugOptions::set_xla_cpu_compilation_parallelism),
+      flag_values->xla_cpu_compilation_parallelism(),
+      "If greater than one, splits the LLVM module of a program into up to "
+      "this many modules, which are compiled on as many threads and linked "
+      "when the program is loaded. Only used by the CPU backend."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_parallel_cost_profile",
+      string_setter_for(&DebugOptions::set_xla_cpu_parallel_cost_profile),
+      flag_values->xla_cpu_parallel_cost_profile(),
+      "If non-empty, a file holding the measured throughputs of the host, "
+      "from which the CPU backend picks the number of parallel tasks of each "
+      "op. The throughputs are measured and stored in the file if it does not "
+      "hold those of this host yet."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_keep_object_files",
+      bool_setter_for(&DebugOptions::set_xla_cpu_keep_object_files),
+      flag_values->xla_cpu_keep_object_files(),
+      "Keeps the object files of CPU executables, so that they can be "
+      "serialized."));
   flag_objects->push_back(tensorflow::Flag(
       "xla_gpu_deterministic_ops",
       bool_setter_for(&DebugOptions::set_xla_gpu_deterministic_ops),
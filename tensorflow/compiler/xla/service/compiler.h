@@ -269,6 +269,23 @@ class Compiler {
                      const AotCompilationOptions& options,
                      std::unique_ptr<AotCompilationMetadata>* metadata);
 
+  // Serializes an executable returned by RunBackend of this compiler so that
+  // DeserializeExecutable can restore it, e.g. in a later process on the same
+  // kind of host. The serialized form is only meant to be read back by the
+  // same build of XLA.
+  virtual StatusOr<std::string> SerializeExecutable(
+      const Executable& executable) {
+    return Unimplemented("This compiler does not support this method");
+  }
+
+  // Restores an executable serialized by SerializeExecutable, to run on the
+  // device given by the executor. Returns a FailedPrecondition error if the
+  // executable was compiled for a different target than the device.
+  virtual StatusOr<std::unique_ptr<Executable>> DeserializeExecutable(
+      const std::string& serialized, se::StreamExecutor* executor) {
+    return Unimplemented("This compiler does not support this method");
+  }
+
   /////
   // The Compiler class also serves as a point to register compiler objects
   // for the various platforms.
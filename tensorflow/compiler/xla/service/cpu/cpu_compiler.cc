@@ -18,6 +18,7 @@ limitations under the License.
 #include <stddef.h>
 #include <string.h>
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <string>
@@ -29,9 +30,12 @@ limitations under the License.
 // IWYU pragma: no_include "llvm/Config/Targets.def.inc"
 #include "absl/base/call_once.h"
 #include "absl/memory/memory.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_cat.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Mangler.h"
@@ -40,10 +44,12 @@ limitations under the License.
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"  // from @llvm-project
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"  // from @llvm-project
 #include "mlir/Dialect/Linalg/IR/LinalgTypes.h"  // from @llvm-project
@@ -60,6 +66,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/batch_dot_simplification.h"
 #include "tensorflow/compiler/xla/service/batchnorm_expander.h"
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
+#include "tensorflow/compiler/xla/service/call_graph.h"
 #include "tensorflow/compiler/xla/service/call_inliner.h"
 #include "tensorflow/compiler/xla/service/cholesky_expander.h"
 #include "tensorflow/compiler/xla/service/comparison_expander.h"
@@ -76,6 +83,8 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/cpu/cpu_layout_assignment.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
 #include "tensorflow/compiler/xla/service/cpu/dot_op_emitter.h"
+#include "tensorflow/compiler/xla/service/cpu/executable.pb.h"
+#include "tensorflow/compiler/xla/service/cpu/host_profile.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emitter.h"
 #include "tensorflow/compiler/xla/service/cpu/parallel_task_assignment.h"
@@ -129,7 +138,10 @@ limitations under the License.
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/platform/dynamic_annotations.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/threadpool.h"
 
 namespace {
 
@@ -421,8 +433,15 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
     // and thread synchronization dependencies which would likely increase
     // binary size (and most AOT applications are single-threaded).
     // TODO(b/29630486) Support multi-threaded AOT.
+    absl::optional<HostProfile> host_profile;
+    const std::string& host_profile_path =
+        module->config().debug_options().xla_cpu_parallel_cost_profile();
+    if (!host_profile_path.empty()) {
+      host_profile = GetHostProfile(host_profile_path);
+    }
     pipeline.AddPass<ParallelTaskAssigner>(
-        max_parallelism, ShapeSizeBytesFunction(), target_machine_features);
+        max_parallelism, ShapeSizeBytesFunction(), target_machine_features,
+        host_profile.has_value() ? &*host_profile : nullptr);
   }
   // Copy insertion should be performed immediately before IR emission to
   // avoid inserting unnecessary copies (later pass adds an instruction which
@@ -478,7 +497,8 @@ llvm::CodeGenOpt::Level CodeGenOptLevel(const HloModuleConfig& module_config) {
 std::pair<LLVMCompiler::ModuleHook, LLVMCompiler::ModuleHook> GetIRModuleHooks(
     const HloModule& hlo_module,
     const LLVMCompiler::ModuleHook& user_pre_optimization_hook,
-    const LLVMCompiler::ModuleHook& user_post_optimization_hook) {
+    const LLVMCompiler::ModuleHook& user_post_optimization_hook,
+    absl::string_view filename_suffix = "") {
   // Create the IR hooks. If applicable, each IR hook does the following:
   //
   //  * Calls the user supplied module hook.
@@ -486,14 +506,14 @@ std::pair<LLVMCompiler::ModuleHook, LLVMCompiler::ModuleHook> GetIRModuleHooks(
   //    --xla_dump_to
   const HloModule* hlo_module_ptr = &hlo_module;
   auto hook = [user_pre_optimization_hook, user_post_optimization_hook,
-               hlo_module_ptr](bool optimized,
-                               const llvm::Module& llvm_module) {
+               hlo_module_ptr, suffix = std::string(filename_suffix)](
+                  bool optimized, const llvm::Module& llvm_module) {
     const auto& user_hook =
         !optimized ? user_pre_optimization_hook : user_post_optimization_hook;
     if (user_hook) {
       user_hook(llvm_module);
     }
-    llvm_ir::DumpIrIfEnabled(*hlo_module_ptr, llvm_module, optimized);
+    llvm_ir::DumpIrIfEnabled(*hlo_module_ptr, llvm_module, optimized, suffix);
   };
   return {[hook](const llvm::Module& llvm_module) {
             return hook(/*optimized=*/false, llvm_module);
@@ -605,11 +625,15 @@ namespace {
 // Dumps machine code if dumping is enabled for the module.
 struct OrcJITPostCompilationHook {
   // Gets an std::function that implements this hook.
+  //
+  // `filename_suffix` tells apart the object files of the parts of a module
+  // that is compiled in parallel.
   static std::function<void(const llvm::object::ObjectFile& obj_file)> Create(
-      const HloModule* module) {
+      const HloModule* module, absl::string_view filename_suffix = "") {
     // This struct is not copyable, but std::functions must be.  So to create an
     // std::function out of this struct, we have to wrap it in a shared_ptr.
-    auto wrapped = std::make_shared<OrcJITPostCompilationHook>(module);
+    auto wrapped =
+        std::make_shared<OrcJITPostCompilationHook>(module, filename_suffix);
     return [wrapped](const llvm::object::ObjectFile& obj_file) {
       (*wrapped)(obj_file);
     };
@@ -617,22 +641,140 @@ struct OrcJITPostCompilationHook {
 
   // Constructor can't be private because we want to call it from
   // std::make_shared, but users should call Create() instead.
-  explicit OrcJITPostCompilationHook(const HloModule* module)
-      : module(module) {}
+  OrcJITPostCompilationHook(const HloModule* module,
+                            absl::string_view filename_suffix)
+      : module(module),
+        file_suffix(filename_suffix.empty()
+                        ? "o"
+                        : absl::StrCat(filename_suffix, ".o")) {}
 
  private:
   void operator()(const llvm::object::ObjectFile& obj_file) {
     if (!DumpingEnabledForHloModule(*module)) {
       return;
     }
-    DumpToFileInDir(*module, /*file_prefix=*/"", /*file_suffix=*/"o",
+    DumpToFileInDir(*module, /*file_prefix=*/"", file_suffix,
                     absl::string_view(obj_file.getData().data(),
                                       obj_file.getData().size()));
   }
 
   const HloModule* module;
+  const std::string file_suffix;
 };
 
+// Splits `llvm_module` into up to `parallelism` modules and compiles them
+// concurrently, each in its own LLVM context, into object files that the JIT
+// links when it loads them.
+//
+// Only the functions in `split_functions` get external, hidden linkage, so
+// that they can go to different parts and calls to them are resolved at load
+// time. These are the functions of computations that are only called
+// sequentially, such as while bodies and parallel task partitions. They run
+// once per call or loop iteration, so the call that is no longer inlined costs
+// little. All other functions, such as reducers and sort comparators, which
+// are called once per element, stay local and end up in the same part as
+// their callers, where they can be inlined as before. So do global variables,
+// such as constants.
+StatusOr<std::vector<std::unique_ptr<llvm::MemoryBuffer>>>
+CompileModuleInParallel(
+    const HloModule& hlo_module, std::unique_ptr<llvm::Module> llvm_module,
+    const absl::flat_hash_set<const llvm::Function*>& split_functions,
+    int parallelism, const LLVMCompiler::ModuleHook& user_pre_optimization_hook,
+    const LLVMCompiler::ModuleHook& user_post_optimization_hook) {
+  XLA_SCOPED_LOGGING_TIMER("CpuCompiler - Compiling LLVM module in parallel");
+  int num_split_functions = 0;
+  for (llvm::Function& function : llvm_module->functions()) {
+    if (function.isDeclaration() ||
+        (function.hasLocalLinkage() && !split_functions.contains(&function))) {
+      continue;
+    }
+    ++num_split_functions;
+    if (function.hasLocalLinkage()) {
+      function.setLinkage(llvm::GlobalValue::ExternalLinkage);
+      function.setVisibility(llvm::GlobalValue::HiddenVisibility);
+    }
+  }
+
+  // Each part moves to the context of its compilation thread as bitcode.
+  std::vector<std::string> parts;
+  llvm::SplitModule(
+      std::move(llvm_module),
+      std::max(1, std::min(parallelism, num_split_functions)),
+      [&](std::unique_ptr<llvm::Module> part) {
+        const bool has_definitions = std::any_of(
+            part->begin(), part->end(),
+            [](const llvm::Function& f) { return !f.isDeclaration(); });
+        if (!has_definitions) {
+          return;
+        }
+        parts.emplace_back();
+        llvm::raw_string_ostream os(parts.back());
+        llvm::WriteBitcodeToFile(*part, os);
+      },
+      /*PreserveLocals=*/true);
+  VLOG(1) << "Compiling " << num_split_functions << " separable functions in "
+          << parts.size() << " parts";
+
+  const HloModuleConfig& config = hlo_module.config();
+  std::vector<StatusOr<std::unique_ptr<llvm::MemoryBuffer>>> obj_files(
+      parts.size());
+  tensorflow::thread::ThreadPool thread_pool(
+      tensorflow::Env::Default(), "xla_cpu_compile", parts.size());
+  tensorflow::BlockingCounter counter(parts.size());
+  for (int i = 0, end = parts.size(); i < end; ++i) {
+    thread_pool.Schedule([&, i] {
+      auto compile_part =
+          [&]() -> StatusOr<std::unique_ptr<llvm::MemoryBuffer>> {
+        llvm::LLVMContext context;
+        llvm::Expected<std::unique_ptr<llvm::Module>> part =
+            llvm::parseBitcodeFile(
+                llvm::MemoryBufferRef(parts[i], absl::StrCat("part", i)),
+                context);
+        if (!part) {
+          return InternalError("Reading part %d of the module failed: %s", i,
+                               llvm::toString(part.takeError()));
+        }
+        // Target machines are not thread-safe, so each part needs its own.
+        std::unique_ptr<llvm::TargetMachine> target_machine =
+            SimpleOrcJIT::InferTargetMachineForJIT(
+                CompilerTargetOptions(config), CodeGenOptLevel(config));
+        const std::string filename_suffix = absl::StrCat("part", i);
+        LLVMCompiler::ModuleHook pre_optimization_ir_hook;
+        LLVMCompiler::ModuleHook post_optimization_ir_hook;
+        std::tie(pre_optimization_ir_hook, post_optimization_ir_hook) =
+            GetIRModuleHooks(hlo_module, user_pre_optimization_hook,
+                             user_post_optimization_hook, filename_suffix);
+        CompilerFunctor compiler(
+            target_machine.get(), CodeGenOptLevel(config),
+            options::OptimizeForSizeRequested(config),
+            config.debug_options().xla_llvm_disable_expensive_passes(),
+            llvm_ir::GetCpuFastMathFlags(config),
+            std::move(pre_optimization_ir_hook),
+            std::move(post_optimization_ir_hook),
+            OrcJITPostCompilationHook::Create(&hlo_module, filename_suffix));
+        llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> obj_file =
+            compiler(**part);
+        if (!obj_file) {
+          return InternalError("Compiling part %d of the module failed: %s", i,
+                               llvm::toString(obj_file.takeError()));
+        }
+        return std::move(*obj_file);
+      };
+      obj_files[i] = compile_part();
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> result;
+  for (auto& obj_file : obj_files) {
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<llvm::MemoryBuffer> buffer,
+                        std::move(obj_file));
+    result.push_back(std::move(buffer));
+  }
+  return std::move(result);
+}
+
 }  // namespace
 
 StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
@@ -662,14 +804,28 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
   auto llvm_module =
       absl::make_unique<llvm::Module>("__compute_module", *llvm_context);
 
+  // Keep the object files of the module if the executable is to be
+  // serialized; they are as large as its code. The JIT compiles the module
+  // when the CpuExecutable constructor looks up the entry function.
+  const bool keep_obj_files =
+      module->config().debug_options().xla_cpu_keep_object_files();
+  auto obj_files = std::make_shared<std::vector<std::string>>();
+  auto dump_obj_file = OrcJITPostCompilationHook::Create(module.get());
+  auto post_codegen_hook = [obj_files, dump_obj_file, keep_obj_files](
+                               const llvm::object::ObjectFile& obj_file) {
+    dump_obj_file(obj_file);
+    if (keep_obj_files) {
+      obj_files->emplace_back(obj_file.getData().data(),
+                              obj_file.getData().size());
+    }
+  };
   auto jit = SimpleOrcJIT::Create(
       CompilerTargetOptions(module->config()),
       CodeGenOptLevel(module->config()),
       options::OptimizeForSizeRequested(module->config()),
       module->config().debug_options().xla_llvm_disable_expensive_passes(),
       llvm_ir::GetCpuFastMathFlags(module->config()), pre_optimization_ir_hook,
-      post_optimization_ir_hook,
-      OrcJITPostCompilationHook::Create(module.get()));
+      post_optimization_ir_hook, std::move(post_codegen_hook));
   if (!jit) {
     return InternalError("Creating JIT failed: %s",
                          llvm::toString(jit.takeError()));
@@ -702,6 +858,9 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
                       ScheduleModule(module.get(), BufferSizeBytesFunction(),
                                      ComputationSchedulerToModuleScheduler(
                                          DFSMemoryScheduler)));
+  // Keep the schedule with the module, so that a serialized executable can
+  // reproduce its buffer assignment.
+  TF_RETURN_IF_ERROR(module->set_schedule(schedule));
 
   // Run buffer allocation on the HLO graph.
   TF_ASSIGN_OR_RETURN(
@@ -731,18 +890,25 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
 
   TF_RETURN_IF_ERROR(ir_emitter.EmitConstantGlobals());
 
+  // The functions that parallel compilation may place in a different part
+  // than their callers.
+  std::unique_ptr<CallGraph> call_graph = CallGraph::Build(module.get());
+  absl::flat_hash_set<const llvm::Function*> split_functions;
   for (auto embedded_computation :
        entry_computation->MakeEmbeddedComputationsList()) {
     if (embedded_computation->IsFusionComputation()) {
       continue;
     }
-    TF_RETURN_IF_ERROR(
-        ir_emitter
-            .EmitComputation(
-                embedded_computation, embedded_computation->name(),
-                /*is_top_level_computation=*/false,
-                schedule.sequence(embedded_computation).instructions())
-            .status());
+    TF_ASSIGN_OR_RETURN(
+        llvm::Function * function,
+        ir_emitter.EmitComputation(
+            embedded_computation, embedded_computation->name(),
+            /*is_top_level_computation=*/false,
+            schedule.sequence(embedded_computation).instructions()));
+    if (call_graph->GetNode(embedded_computation).context() ==
+        CallContext::kSequential) {
+      split_functions.insert(function);
+    }
   }
   string function_name_prefix = entry_computation->name().empty()
                                     ? "__compute"
@@ -767,13 +933,37 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
 
   TF_RETURN_IF_ERROR(VerifyLlvmModule(*llvm_module));
 
-  // JIT compile the LLVM IR module to in-memory machine code.
-  llvm::orc::ThreadSafeModule thread_safe_module(std::move(llvm_module),
-                                                 std::move(llvm_context));
-  cantFail((*jit)->AddModule(std::move(thread_safe_module)));
+  const int parallelism =
+      module->config().debug_options().xla_cpu_compilation_parallelism();
+  if (parallelism > 1) {
+    TF_ASSIGN_OR_RETURN(
+        std::vector<std::unique_ptr<llvm::MemoryBuffer>> part_obj_files,
+        CompileModuleInParallel(*module, std::move(llvm_module),
+                                split_functions, parallelism,
+                                user_pre_optimization_hook_,
+                                user_post_optimization_hook_));
+    for (std::unique_ptr<llvm::MemoryBuffer>& obj_file : part_obj_files) {
+      if (keep_obj_files) {
+        obj_files->emplace_back(obj_file->getBufferStart(),
+                                obj_file->getBufferSize());
+      }
+      llvm::Error error = (*jit)->AddObjFile(std::move(obj_file));
+      if (error) {
+        return InternalError("Loading an object file failed: %s",
+                             llvm::toString(std::move(error)));
+      }
+    }
+  } else {
+    // JIT compile the LLVM IR module to in-memory machine code.
+    llvm::orc::ThreadSafeModule thread_safe_module(std::move(llvm_module),
+                                                   std::move(llvm_context));
+    cantFail((*jit)->AddModule(std::move(thread_safe_module)));
+  }
   cpu_executable.reset(new CpuExecutable(
       std::move(*jit), std::move(assignment), std::move(module), function_name,
       std::move(hlo_profile_printer_data), std::move(hlo_profile_index_map)));
+  static_cast<CpuExecutable&>(*cpu_executable)
+      .set_obj_files(std::move(*obj_files));
 
   if (embed_ir_in_executable) {
     static_cast<CpuExecutable&>(*cpu_executable)
@@ -784,6 +974,137 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
   return std::move(cpu_executable);
 }
 
+StatusOr<std::string> CpuCompiler::SerializeExecutable(
+    const Executable& executable) {
+  const auto* cpu_executable = dynamic_cast<const CpuExecutable*>(&executable);
+  TF_RET_CHECK(cpu_executable != nullptr);
+  const HloModuleConfig& config = executable.module().config();
+  if (config.hlo_profiling_enabled()) {
+    return Unimplemented(
+        "Serializing a CPU executable with HLO profiling is not supported");
+  }
+  if (cpu_executable->obj_files().empty()) {
+    return FailedPrecondition(
+        "Serializing a CPU executable requires compiling it with "
+        "xla_cpu_keep_object_files");
+  }
+
+  CpuExecutableProto proto;
+  *proto.mutable_hlo() =
+      MakeHloProto(executable.module(), cpu_executable->buffer_assignment());
+  ExecutionOptions* execution_options = proto.mutable_execution_options();
+  *execution_options->mutable_debug_options() = config.debug_options();
+  execution_options->set_num_replicas(config.replica_count());
+  execution_options->set_num_partitions(config.num_partitions());
+  execution_options->set_use_spmd_partitioning(config.use_spmd_partitioning());
+  execution_options->set_deduplicate_hlo(config.deduplicate_hlo());
+  execution_options->set_broadcast_replicated_parameters_via_collectives(
+      config.broadcast_replicated_params());
+  if (config.has_static_device_assignment()) {
+    TF_RETURN_IF_ERROR(config.static_device_assignment().Serialize(
+        execution_options->mutable_device_assignment()));
+  }
+  proto.set_entry_function_name(cpu_executable->entry_function_name());
+  for (const std::string& obj_file : cpu_executable->obj_files()) {
+    proto.add_obj_files(obj_file);
+  }
+  const llvm::TargetMachine* target_machine =
+      cpu_executable->jit().target_machine();
+  proto.set_target_triple(target_machine->getTargetTriple().getTriple());
+  proto.set_cpu_name(target_machine->getTargetCPU().str());
+  proto.set_cpu_features(target_machine->getTargetFeatureString().str());
+  return proto.SerializeAsString();
+}
+
+StatusOr<std::unique_ptr<Executable>> CpuCompiler::DeserializeExecutable(
+    const std::string& serialized, se::StreamExecutor* stream_exec) {
+  TF_RET_CHECK(stream_exec != nullptr);
+  CpuExecutableProto proto;
+  if (!proto.ParseFromString(serialized)) {
+    return InvalidArgument("Failed to parse a serialized CPU executable");
+  }
+  TF_ASSIGN_OR_RETURN(
+      HloModuleConfig config,
+      HloModule::CreateModuleConfigFromProto(
+          proto.hlo().hlo_module(),
+          proto.execution_options().debug_options(),
+          &proto.execution_options()));
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<HloModule> module,
+      HloModule::CreateFromProto(proto.hlo().hlo_module(), config));
+  TF_RET_CHECK(module->has_schedule());
+  absl::call_once(llvm_command_line_options_initialized,
+                  &llvm_ir::InitializeLLVMCommandLineOptions, module->config());
+
+  auto jit = SimpleOrcJIT::Create(
+      CompilerTargetOptions(module->config()),
+      CodeGenOptLevel(module->config()),
+      options::OptimizeForSizeRequested(module->config()),
+      module->config().debug_options().xla_llvm_disable_expensive_passes(),
+      llvm_ir::GetCpuFastMathFlags(module->config()),
+      /*pre_optimization_hook=*/nullptr, /*post_optimization_hook=*/nullptr,
+      /*post_codegen_hook=*/nullptr);
+  if (!jit) {
+    return InternalError("Creating JIT failed: %s",
+                         llvm::toString(jit.takeError()));
+  }
+  const llvm::TargetMachine* target_machine = (*jit)->target_machine();
+  if (target_machine->getTargetTriple().getTriple() != proto.target_triple() ||
+      target_machine->getTargetCPU() != proto.cpu_name() ||
+      target_machine->getTargetFeatureString() != proto.cpu_features()) {
+    return FailedPrecondition(
+        "The executable was compiled for %s (cpu %s, features %s) and cannot "
+        "run on %s (cpu %s, features %s)",
+        proto.target_triple(), proto.cpu_name(), proto.cpu_features(),
+        target_machine->getTargetTriple().getTriple(),
+        target_machine->getTargetCPU().str(),
+        target_machine->getTargetFeatureString().str());
+  }
+
+  // The object code addresses buffers by their allocation index, so it can
+  // only run with the very assignment it was emitted for.
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<BufferAssignment> assignment,
+      BufferAssigner::Run(
+          module.get(),
+          absl::make_unique<SequentialHloOrdering>(module->schedule()),
+          BufferSizeBytesFunction(), memory_alignment,
+          /*allocate_buffers_for_constants=*/true));
+  if (!protobuf_util::ProtobufEquals(assignment->ToProto(),
+                                     proto.hlo().buffer_assignment())) {
+    return FailedPrecondition(
+        "The buffer assignment of module %s differs from the one its "
+        "serialized executable was compiled with",
+        module->name());
+  }
+
+  std::vector<std::string> obj_files(proto.obj_files().begin(),
+                                     proto.obj_files().end());
+  for (const std::string& obj_file : obj_files) {
+    llvm::Error error = (*jit)->AddObjFile(llvm::MemoryBuffer::getMemBufferCopy(
+        llvm::StringRef(obj_file.data(), obj_file.size())));
+    if (error) {
+      return InternalError("Loading an object file failed: %s",
+                           llvm::toString(std::move(error)));
+    }
+  }
+  // CpuExecutable requires the entry function to exist.
+  llvm::Expected<llvm::JITEvaluatedSymbol> entry_function =
+      (*jit)->FindCompiledSymbol(proto.entry_function_name());
+  if (!entry_function) {
+    return InternalError("Entry function %s not found: %s",
+                         proto.entry_function_name(),
+                         llvm::toString(entry_function.takeError()));
+  }
+
+  auto cpu_executable = absl::make_unique<CpuExecutable>(
+      std::move(*jit), std::move(assignment), std::move(module),
+      proto.entry_function_name(), /*hlo_profile_printer_data=*/nullptr,
+      /*hlo_profile_index_map=*/nullptr);
+  cpu_executable->set_obj_files(std::move(obj_files));
+  return std::unique_ptr<Executable>(std::move(cpu_executable));
+}
+
 StatusOr<std::vector<std::unique_ptr<AotCompilationResult>>>
 CpuCompiler::CompileAheadOfTime(std::unique_ptr<HloModuleGroup> module_group,
                                 const AotCompilationOptions& aot_options) {
@@ -150,6 +150,18 @@ class CpuCompiler : public LLVMCompiler {
   CompileAheadOfTime(std::unique_ptr<HloModuleGroup> module_group,
                      const AotCompilationOptions& options) override;
 
+  // Serializes the optimized module, its buffer assignment and the object code
+  // of the JIT into a CpuExecutableProto. Executables with HLO profiling are
+  // not supported.
+  StatusOr<std::string> SerializeExecutable(
+      const Executable& executable) override;
+
+  // Loads the object code of a CpuExecutableProto into a new JIT, after
+  // checking that the JIT targets the same machine and that buffer assignment
+  // of the module reproduces the assignment the code was emitted for.
+  StatusOr<std::unique_ptr<Executable>> DeserializeExecutable(
+      const std::string& serialized, se::StreamExecutor* stream_exec) override;
+
   se::Platform::Id PlatformId() const override;
 
   HloCostAnalysis::ShapeSizeFunction ShapeSizeBytesFunction() const override;
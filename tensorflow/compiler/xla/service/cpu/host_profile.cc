@@ -0,0 +1,272 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/host_profile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+#include <vector>
+
+#include "absl/base/casts.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Buffers are much larger than the caches, so that the kernels measure the
+// throughput of the memory.
+constexpr int64 kNumElements = 4 << 20;
+constexpr int64 kTransposeSize = 2048;
+constexpr int kNumRepetitions = 3;
+
+// Returns the shortest of `kNumRepetitions` run times of `fn`, in nanoseconds.
+double MinRunTimeNs(const std::function<void()>& fn) {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  double min_ns = std::numeric_limits<double>::max();
+  for (int i = 0; i < kNumRepetitions; ++i) {
+    const uint64 start_ns = env->NowNanos();
+    fn();
+    min_ns = std::min<double>(min_ns, env->NowNanos() - start_ns);
+  }
+  return std::max(min_ns, 1.0);
+}
+
+// Keeps the compiler from optimizing away the results of a kernel.
+void Consume(float value) {
+  static volatile float sink;
+  sink = value;
+}
+
+void Add(const float* lhs, const float* rhs, float* out, int64 size) {
+  for (int64 i = 0; i < size; ++i) {
+    out[i] = lhs[i] + rhs[i];
+  }
+}
+
+// Sums `size` elements, a multiple of kNumAccumulators, into independent
+// accumulators. A single accumulator would make the loop one chain of
+// dependent additions; this one vectorizes like the reductions XLA emits.
+constexpr int64 kNumAccumulators = 16;
+float Sum(const float* in, int64 size) {
+  float accumulators[kNumAccumulators] = {};
+  for (int64 i = 0; i < size; i += kNumAccumulators) {
+    for (int64 j = 0; j < kNumAccumulators; ++j) {
+      accumulators[j] += in[i + j];
+    }
+  }
+  float sum = 0.0f;
+  for (float accumulator : accumulators) {
+    sum += accumulator;
+  }
+  return sum;
+}
+
+// Approximates exp(x) for |x| < 87 with a range reduction and a polynomial, as
+// XLA emits it, rather than calling the scalar std::exp, so that loops over it
+// vectorize.
+float PolynomialExp(float x) {
+  // exp(x) = 2^n * exp(r), with n = round(x / ln(2)) and |r| <= ln(2) / 2.
+  const float n = std::floor(x * 1.44269504f + 0.5f);
+  const float r = x - n * 0.693147181f;
+  float p = 1.9875691500e-4f;
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  p = p * r * r + r + 1.0f;
+  return p * absl::bit_cast<float>((static_cast<int32>(n) + 127) << 23);
+}
+
+// Forks `num_tasks - 1` tasks on `thread_pool` and runs the first one inline,
+// as __xla_cpu_runtime_ParallelForkJoin does.
+void ForkJoin(tensorflow::thread::ThreadPool* thread_pool, int num_tasks,
+              const std::function<void(int)>& task) {
+  tensorflow::BlockingCounter counter(num_tasks - 1);
+  for (int i = 1; i < num_tasks; ++i) {
+    thread_pool->Schedule([&task, &counter, i] {
+      task(i);
+      counter.DecrementCount();
+    });
+  }
+  task(0);
+  counter.Wait();
+}
+
+// Returns whether all throughputs of `profile` are positive.
+bool IsComplete(const HostProfile& profile) {
+  return profile.streaming_bytes_per_ns() > 0 &&
+         profile.strided_bytes_per_ns() > 0 &&
+         profile.reduction_bytes_per_ns() > 0 && profile.flops_per_ns() > 0 &&
+         profile.transcendentals_per_ns() > 0 &&
+         profile.max_streaming_bytes_per_ns() > 0;
+}
+
+}  // namespace
+
+std::string HostProfileKey() {
+  return absl::StrCat(tensorflow::port::CPUVendorIDString(), "-",
+                      tensorflow::port::CPUFamily(), "-",
+                      tensorflow::port::CPUModelNum(), "-",
+                      tensorflow::port::MaxParallelism());
+}
+
+HostProfile MeasureHostProfile() {
+  HostProfile profile;
+  profile.set_host(HostProfileKey());
+
+  std::vector<float> lhs(kNumElements, 1.0f);
+  std::vector<float> rhs(kNumElements, 2.0f);
+  std::vector<float> out(kNumElements);
+
+  const double add_ns = MinRunTimeNs(
+      [&] { Add(lhs.data(), rhs.data(), out.data(), kNumElements); });
+  Consume(out[kNumElements - 1]);
+  profile.set_streaming_bytes_per_ns(3 * sizeof(float) * kNumElements /
+                                     add_ns);
+
+  const double transpose_ns = MinRunTimeNs([&] {
+    for (int64 i = 0; i < kTransposeSize; ++i) {
+      for (int64 j = 0; j < kTransposeSize; ++j) {
+        out[j * kTransposeSize + i] = lhs[i * kTransposeSize + j];
+      }
+    }
+  });
+  Consume(out[kTransposeSize]);
+  profile.set_strided_bytes_per_ns(2 * sizeof(float) * kTransposeSize *
+                                   kTransposeSize / transpose_ns);
+
+  float sum = 0.0f;
+  const double reduce_ns =
+      MinRunTimeNs([&] { sum += Sum(lhs.data(), kNumElements); });
+  Consume(sum);
+  profile.set_reduction_bytes_per_ns(sizeof(float) * kNumElements / reduce_ns);
+
+  // Multiply-adds on values that stay in the caches.
+  constexpr int64 kNumCachedElements = 1024;
+  constexpr int64 kNumPasses = 1024;
+  const double fma_ns = MinRunTimeNs([&] {
+    for (int64 pass = 0; pass < kNumPasses; ++pass) {
+      for (int64 i = 0; i < kNumCachedElements; ++i) {
+        out[i] = out[i] * 0.999f + rhs[i];
+      }
+    }
+  });
+  Consume(out[0]);
+  profile.set_flops_per_ns(2 * kNumCachedElements * kNumPasses / fma_ns);
+
+  const double exp_ns = MinRunTimeNs([&] {
+    for (int64 pass = 0; pass < kNumPasses; ++pass) {
+      for (int64 i = 0; i < kNumCachedElements; ++i) {
+        out[i] = PolynomialExp(rhs[i] * out[i] * 1e-6f);
+      }
+    }
+  });
+  Consume(out[0]);
+  profile.set_transcendentals_per_ns(kNumCachedElements * kNumPasses / exp_ns);
+
+  const int num_threads = tensorflow::port::MaxParallelism();
+  tensorflow::thread::ThreadPool thread_pool(tensorflow::Env::Default(),
+                                             "xla_host_profile", num_threads);
+  const int64 elements_per_task = kNumElements / num_threads;
+  const double parallel_add_ns = MinRunTimeNs([&] {
+    ForkJoin(&thread_pool, num_threads, [&](int task) {
+      const int64 offset = task * elements_per_task;
+      Add(lhs.data() + offset, rhs.data() + offset, out.data() + offset,
+          elements_per_task);
+    });
+  });
+  Consume(out[0]);
+  profile.set_max_streaming_bytes_per_ns(std::max(
+      profile.streaming_bytes_per_ns(),
+      3 * sizeof(float) * elements_per_task * num_threads / parallel_add_ns));
+
+  // The cost of a fork/join grows with the number of tasks; fit a line
+  // through the costs of forking one task and all threads' worth of tasks.
+  constexpr int kNumForkJoins = 100;
+  auto fork_join_ns = [&](int num_tasks) {
+    return MinRunTimeNs([&] {
+             for (int i = 0; i < kNumForkJoins; ++i) {
+               ForkJoin(&thread_pool, num_tasks, [](int) {});
+             }
+           }) /
+           kNumForkJoins;
+  };
+  const double single_fork_join_ns = fork_join_ns(2);
+  const double full_fork_join_ns = fork_join_ns(std::max(num_threads, 3));
+  const double ns_per_task =
+      std::max(0.0, (full_fork_join_ns - single_fork_join_ns) /
+                        (std::max(num_threads, 3) - 2));
+  profile.set_fork_join_ns_per_task(ns_per_task);
+  profile.set_fork_join_ns(
+      std::max(0.0, single_fork_join_ns - 2 * ns_per_task));
+
+  VLOG(1) << "Measured host profile: " << profile.ShortDebugString();
+  return profile;
+}
+
+HostProfile GetHostProfile(const std::string& path) {
+  static tensorflow::mutex mu(tensorflow::LINKER_INITIALIZED);
+  static auto* profiles = new std::map<std::string, HostProfile>();
+  tensorflow::mutex_lock lock(mu);
+  auto it = profiles->find(path);
+  if (it != profiles->end()) {
+    return it->second;
+  }
+
+  tensorflow::Env* env = tensorflow::Env::Default();
+  HostProfile profile;
+  tensorflow::Status status = tensorflow::ReadTextProto(env, path, &profile);
+  if (status.ok() && profile.host() == HostProfileKey() &&
+      IsComplete(profile)) {
+    VLOG(1) << "Loaded host profile from " << path;
+  } else {
+    if (status.ok()) {
+      VLOG(1) << "Host profile in " << path << " is not a complete profile "
+              << "of this host, measuring it again";
+    }
+    profile = MeasureHostProfile();
+    // Processes that start concurrently each write their own temporary file,
+    // so that a reader only ever sees a complete profile.
+    const std::string temp_path =
+        absl::StrCat(path, ".tmp-", tensorflow::random::New64());
+    status = tensorflow::WriteTextProto(env, temp_path, profile);
+    if (status.ok()) {
+      status = env->RenameFile(temp_path, path);
+    }
+    if (!status.ok()) {
+      env->DeleteFile(temp_path).IgnoreError();
+      LOG(WARNING) << "Failed to store the host profile in " << path << ": "
+                   << status;
+    }
+  }
+  (*profiles)[path] = profile;
+  return profile;
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,43 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_HOST_PROFILE_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_HOST_PROFILE_H_
+
+#include <string>
+
+#include "tensorflow/compiler/xla/service/cpu/host_profile.pb.h"
+
+namespace xla {
+namespace cpu {
+
+// Returns a string identifying the CPU and thread count of this host.
+std::string HostProfileKey();
+
+// Measures the throughputs of this host by running small native kernels that
+// resemble the code XLA emits for each kind of op, and the cost of forking and
+// joining tasks on a thread pool like the runtime does. Takes a few hundred
+// milliseconds.
+HostProfile MeasureHostProfile();
+
+// Returns the profile of this host stored in the file `path`. If the file does
+// not hold a profile of this host, measures it and stores it in the file.
+// Profiles are only read or measured once per process and path.
+HostProfile GetHostProfile(const std::string& path);
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_HOST_PROFILE_H_
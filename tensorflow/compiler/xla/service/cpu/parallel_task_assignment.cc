@@ -106,17 +106,98 @@ class DefaultCostModel : public ParallelCostModel {
   const std::unique_ptr<HloCostAnalysis> cost_analysis_;
 };
 
+// Picks the parallel task count that minimizes the run time estimated from the
+// measured throughputs of the host, including the cost of forking and joining
+// the tasks.
+class ProfiledCostModel : public ParallelCostModel {
+ public:
+  ProfiledCostModel(const int64 max_parallelism, const HostProfile& profile,
+                    std::unique_ptr<HloCostAnalysis> cost_analysis)
+      : max_parallelism_(max_parallelism),
+        profile_(profile),
+        cost_analysis_(std::move(cost_analysis)) {}
+  ~ProfiledCostModel() override {}
+
+  int64 GetParallelTaskCount(HloInstruction* instruction) override {
+    int64 best_task_count = 1;
+    double best_ns = EstimateRunTimeNs(*instruction, 1);
+    for (int64 task_count = 2; task_count <= max_parallelism_; ++task_count) {
+      const double ns = EstimateRunTimeNs(*instruction, task_count);
+      if (ns < best_ns) {
+        best_task_count = task_count;
+        best_ns = ns;
+      }
+    }
+    return best_task_count;
+  }
+
+  // Estimates the run time of 'instruction' split into 'task_count' tasks.
+  double EstimateRunTimeNs(const HloInstruction& instruction,
+                           int64 task_count) const {
+    // The memory throughput of each thread depends on the access pattern of
+    // the op, and all threads together cannot exceed the bandwidth of the
+    // host.
+    const double bytes_per_ns = BytesPerNs(instruction);
+    const double max_bytes_per_ns = profile_.max_streaming_bytes_per_ns() *
+                                    bytes_per_ns /
+                                    profile_.streaming_bytes_per_ns();
+    const double memory_ns =
+        cost_analysis_->bytes_accessed(instruction) /
+        std::min(task_count * bytes_per_ns, max_bytes_per_ns);
+    const double compute_ns =
+        (cost_analysis_->flop_count(instruction) / profile_.flops_per_ns() +
+         cost_analysis_->transcendental_count(instruction) /
+             profile_.transcendentals_per_ns()) /
+        task_count;
+    double fork_join_ns = 0;
+    if (task_count > 1) {
+      fork_join_ns = profile_.fork_join_ns() +
+                     task_count * profile_.fork_join_ns_per_task();
+    }
+    return std::max(memory_ns, compute_ns) + fork_join_ns;
+  }
+
+ private:
+  // Returns the single-threaded memory throughput of 'instruction'.
+  double BytesPerNs(const HloInstruction& instruction) const {
+    const HloInstruction* op = &instruction;
+    if (op->opcode() == HloOpcode::kFusion) {
+      op = op->fused_expression_root();
+    }
+    switch (op->opcode()) {
+      case HloOpcode::kGather:
+      case HloOpcode::kReverse:
+      case HloOpcode::kTranspose:
+        return profile_.strided_bytes_per_ns();
+      case HloOpcode::kReduce:
+      case HloOpcode::kReduceWindow:
+        return profile_.reduction_bytes_per_ns();
+      default:
+        return profile_.streaming_bytes_per_ns();
+    }
+  }
+
+  const int64 max_parallelism_;
+  const HostProfile profile_;
+  const std::unique_ptr<HloCostAnalysis> cost_analysis_;
+};
+
 ParallelTaskAssignment::ParallelTaskAssignment(
     const int64 max_parallelism,
     const HloCostAnalysis::ShapeSizeFunction& shape_size, HloModule* module,
-    const TargetMachineFeatures* target_machine_features)
+    const TargetMachineFeatures* target_machine_features,
+    const HostProfile* host_profile)
     : target_machine_features_(*target_machine_features) {
   VLOG(1) << "ParallelTaskAssignment max_parallelism: " << max_parallelism;
   // Run cost analysis on 'module'.
   auto cost_analysis = absl::make_unique<HloCostAnalysis>(shape_size);
   HloComputation* computation = module->entry_computation();
   Status status = computation->root_instruction()->Accept(cost_analysis.get());
-  if (status.ok()) {
+  if (status.ok() && host_profile != nullptr) {
+    // Estimate run times from the throughputs of the host.
+    cost_model_.reset(new ProfiledCostModel(max_parallelism, *host_profile,
+                                            std::move(cost_analysis)));
+  } else if (status.ok()) {
     // Set default cost model based on 'cost_analysis'.
     cost_model_.reset(new DefaultCostModel(max_parallelism, shape_size,
                                            std::move(cost_analysis)));
@@ -246,9 +327,10 @@ bool ParallelTaskAssigner::AssignParallelTasksHelper(
 
 void ParallelTaskAssigner::ComputeTargetParallelTasks(
     HloModule* module, HloToParallelTasks* hlo_to_parallel_tasks) {
-  ParallelTaskAssignment parallel_task_assignment(max_parallelism_,
-                                                  shape_size_function_, module,
-                                                  &target_machine_features_);
+  ParallelTaskAssignment parallel_task_assignment(
+      max_parallelism_, shape_size_function_, module,
+      &target_machine_features_,
+      host_profile_.has_value() ? &*host_profile_ : nullptr);
 
   // Compute parallel task counts for all instructions in 'module'.
   for (auto* computation : module->MakeNonfusionComputations()) {
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PARALLEL_TASK_ASSIGNMENT_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PARALLEL_TASK_ASSIGNMENT_H_
 
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/service/cpu/host_profile.pb.h"
 #include "tensorflow/compiler/xla/service/cpu/target_machine_features.h"
 #include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
@@ -38,10 +40,14 @@ class ParallelTaskAssignment {
   // 'shape_size': shape size function used by HloCostAnalysis during parallel
   //               task assignment.
   // 'module': the containing HloModule.
+  // 'host_profile': if not null, the measured throughputs of the host, from
+  //                 which task counts are picked to minimize estimated run
+  //                 times.
   ParallelTaskAssignment(const int64 max_parallelism,
                          const HloCostAnalysis::ShapeSizeFunction& shape_size,
                          HloModule* module,
-                         const TargetMachineFeatures* target_machine_features);
+                         const TargetMachineFeatures* target_machine_features,
+                         const HostProfile* host_profile = nullptr);
   ~ParallelTaskAssignment() {}
 
   // Computes and returns the target parallel task count for 'instruction'.
@@ -65,12 +71,18 @@ class ParallelTaskAssigner : public HloModulePass {
   // 'max_parallelism': the maximum parallel task count per instruction.
   // 'shape_size': shape size function used by HloCostAnalysis during parallel
   //               task assignment.
+  // 'host_profile': if not null, the measured throughputs of the host.
   ParallelTaskAssigner(const int64 max_parallelism,
                        const HloCostAnalysis::ShapeSizeFunction& shape_size,
-                       const TargetMachineFeatures* target_machine_features)
+                       const TargetMachineFeatures* target_machine_features,
+                       const HostProfile* host_profile = nullptr)
       : max_parallelism_(max_parallelism),
         shape_size_function_(shape_size),
-        target_machine_features_(*target_machine_features) {}
+        target_machine_features_(*target_machine_features) {
+    if (host_profile != nullptr) {
+      host_profile_ = *host_profile;
+    }
+  }
   ~ParallelTaskAssigner() override {}
 
   absl::string_view name() const override {
@@ -101,6 +113,7 @@ class ParallelTaskAssigner : public HloModulePass {
   int64 max_parallelism_;
   HloCostAnalysis::ShapeSizeFunction shape_size_function_;
   const TargetMachineFeatures& target_machine_features_;
+  absl::optional<HostProfile> host_profile_;
 };
 
 }  // namespace cpu
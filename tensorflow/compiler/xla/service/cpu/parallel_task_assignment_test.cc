@@ -15,10 +15,14 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/cpu/parallel_task_assignment.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_executable.h"
+#include "tensorflow/compiler/xla/service/cpu/host_profile.h"
+#include "tensorflow/compiler/xla/service/cpu/shape_partition.h"
 #include "tensorflow/compiler/xla/service/cpu/target_machine_features_fake.h"
 #include "tensorflow/compiler/xla/test.h"
 #include "tensorflow/compiler/xla/tests/hlo_test_base.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace xla {
 namespace {
@@ -39,11 +43,36 @@ class ParallelTaskAssignmentTest : public HloTestBase {
           return cpu::TargetMachineFeatures::kEigenExpectedTensorAlignment;
         }) {}
 
-  StatusOr<bool> RunParallelTaskAssigner(HloModule* module) {
+  StatusOr<bool> RunParallelTaskAssigner(
+      HloModule* module, const cpu::HostProfile* host_profile = nullptr) {
     return cpu::ParallelTaskAssigner(max_parallelism_, shape_size_func_,
-                                     &target_machine_features_)
+                                     &target_machine_features_, host_profile)
         .Run(module);
   }
+
+  // Returns a host whose threads together stream four times as many bytes as
+  // one thread does, and that takes 10us to fork and join tasks.
+  static cpu::HostProfile MakeHostProfile() {
+    cpu::HostProfile profile;
+    profile.set_streaming_bytes_per_ns(10);
+    profile.set_strided_bytes_per_ns(2);
+    profile.set_reduction_bytes_per_ns(10);
+    profile.set_flops_per_ns(10);
+    profile.set_transcendentals_per_ns(1);
+    profile.set_max_streaming_bytes_per_ns(40);
+    profile.set_fork_join_ns(10000);
+    profile.set_fork_join_ns_per_task(1000);
+    return profile;
+  }
+
+  // Returns the number of tasks the outlined root of 'module' is split into.
+  static int64 GetRootTaskCount(HloModule* module) {
+    const HloInstruction* root =
+        module->entry_computation()->root_instruction();
+    EXPECT_EQ(root->opcode(), HloOpcode::kCall);
+    return cpu::ShapePartitionAssigner::GetTotalPartitionCount(
+        root->to_apply()->root_instruction()->outer_dimension_partitions());
+  }
 };
 
 TEST_F(ParallelTaskAssignmentTest, DotOperationNotParallelized) {
@@ -205,5 +234,121 @@ TEST_F(ParallelTaskAssignmentTest, ConstantNotParallelized) {
   EXPECT_FALSE(changed);
 }
 
+TEST_F(ParallelTaskAssignmentTest, ProfiledSmallOpNotParallelized) {
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_small_add
+    ENTRY add {
+      lhs = f32[1024] parameter(0)
+      rhs = f32[1024] parameter(1)
+      ROOT add = f32[1024] add(lhs, rhs)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  const cpu::HostProfile profile = MakeHostProfile();
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          RunParallelTaskAssigner(m.get(), &profile));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(ParallelTaskAssignmentTest, ProfiledLargeOpParallelizedUpToBandwidth) {
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_large_add
+    ENTRY add {
+      lhs = f32[4096,4096] parameter(0)
+      rhs = f32[4096,4096] parameter(1)
+      ROOT add = f32[4096,4096] add(lhs, rhs)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  const cpu::HostProfile profile = MakeHostProfile();
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          RunParallelTaskAssigner(m.get(), &profile));
+  EXPECT_TRUE(changed);
+  // Four threads saturate the bandwidth, more only add fork/join overhead.
+  EXPECT_EQ(GetRootTaskCount(m.get()), 4);
+}
+
+TEST_F(ParallelTaskAssignmentTest, ProfiledExpensiveForkJoinNotParallelized) {
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_large_add
+    ENTRY add {
+      lhs = f32[4096,4096] parameter(0)
+      rhs = f32[4096,4096] parameter(1)
+      ROOT add = f32[4096,4096] add(lhs, rhs)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  cpu::HostProfile profile = MakeHostProfile();
+  profile.set_fork_join_ns(1e9);
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          RunParallelTaskAssigner(m.get(), &profile));
+  EXPECT_FALSE(changed);
+}
+
+TEST(HostProfileTest, StoresMeasuredProfile) {
+  const std::string path = tensorflow::io::JoinPath(
+      tensorflow::testing::TmpDir(), "host_profile.pbtxt");
+  const cpu::HostProfile profile = cpu::GetHostProfile(path);
+  EXPECT_EQ(profile.host(), cpu::HostProfileKey());
+  EXPECT_GT(profile.streaming_bytes_per_ns(), 0);
+  EXPECT_GE(profile.max_streaming_bytes_per_ns(),
+            profile.streaming_bytes_per_ns());
+
+  cpu::HostProfile stored;
+  TF_ASSERT_OK(
+      tensorflow::ReadTextProto(tensorflow::Env::Default(), path, &stored));
+  EXPECT_EQ(stored.DebugString(), profile.DebugString());
+}
+
+// Returns a complete profile of `host` with values no measurement produces.
+cpu::HostProfile MakeStoredHostProfile(const std::string& host) {
+  cpu::HostProfile profile;
+  profile.set_host(host);
+  profile.set_streaming_bytes_per_ns(1e6);
+  profile.set_strided_bytes_per_ns(1e6);
+  profile.set_reduction_bytes_per_ns(1e6);
+  profile.set_flops_per_ns(1e6);
+  profile.set_transcendentals_per_ns(1e6);
+  profile.set_max_streaming_bytes_per_ns(1e6);
+  profile.set_fork_join_ns(1e6);
+  profile.set_fork_join_ns_per_task(1e6);
+  return profile;
+}
+
+TEST(HostProfileTest, LoadsStoredProfileOfThisHost) {
+  const std::string path = tensorflow::io::JoinPath(
+      tensorflow::testing::TmpDir(), "this_host_profile.pbtxt");
+  const cpu::HostProfile stored = MakeStoredHostProfile(cpu::HostProfileKey());
+  TF_ASSERT_OK(
+      tensorflow::WriteTextProto(tensorflow::Env::Default(), path, stored));
+
+  const cpu::HostProfile profile = cpu::GetHostProfile(path);
+  EXPECT_EQ(profile.DebugString(), stored.DebugString());
+}
+
+TEST(HostProfileTest, MeasuresProfileOfOtherHostAgain) {
+  const std::string path = tensorflow::io::JoinPath(
+      tensorflow::testing::TmpDir(), "other_host_profile.pbtxt");
+  const cpu::HostProfile stored = MakeStoredHostProfile("other-host");
+  TF_ASSERT_OK(
+      tensorflow::WriteTextProto(tensorflow::Env::Default(), path, stored));
+
+  const cpu::HostProfile profile = cpu::GetHostProfile(path);
+  EXPECT_EQ(profile.host(), cpu::HostProfileKey());
+  EXPECT_NE(profile.streaming_bytes_per_ns(), stored.streaming_bytes_per_ns());
+
+  // The new measurement replaces the stored profile.
+  cpu::HostProfile replaced;
+  TF_ASSERT_OK(
+      tensorflow::ReadTextProto(tensorflow::Env::Default(), path, &replaced));
+  EXPECT_EQ(replaced.DebugString(), profile.DebugString());
+}
+
 }  // namespace
 }  // namespace xla
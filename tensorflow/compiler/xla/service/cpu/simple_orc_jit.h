@@ -28,6 +28,7 @@ limitations under the License.
 #include "llvm/ExecutionEngine/Orc/SymbolStringPool.h"
 #include "llvm/ExecutionEngine/Orc/TargetProcessControl.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Target/TargetMachine.h"
 #include "tensorflow/compiler/xla/service/cpu/compiler_functor.h"
 #include "tensorflow/compiler/xla/types.h"
@@ -81,6 +82,10 @@ class SimpleOrcJIT : public llvm::JITEventListener {
 
   llvm::Error AddModule(llvm::orc::ThreadSafeModule module);
 
+  // Adds machine code that was compiled, by a SimpleOrcJIT for the same target,
+  // into a relocatable object file.
+  llvm::Error AddObjFile(std::unique_ptr<llvm::MemoryBuffer> obj_file);
+
   // Get the runtime address of the compiled symbol whose name is given. Returns
   // nullptr if the symbol cannot be found.
   llvm::Expected<llvm::JITEvaluatedSymbol> FindCompiledSymbol(
@@ -0,0 +1,201 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/substitute.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/service/compiler.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_executable.h"
+#include "tensorflow/compiler/xla/service/cpu/tests/cpu_codegen_test.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/service/llvm_compiler.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Returns a module that runs `num_loops` different while loops, each of which
+// is emitted as three LLVM functions: the body and condition, which are called
+// sequentially, and a reducer called by the body for each element. Loop i adds
+// i to its input i + 1 times.
+std::string MakeHloText(int num_loops) {
+  const char* const kLoop = R"(
+max$0 {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  gt = pred[] compare(a, b), direction=GT
+  ROOT max = f32[] select(gt, a, b)
+}
+
+body$0 {
+  p = (f32[8], s32[]) parameter(0)
+  x = f32[8] get-tuple-element(p), index=0
+  i = s32[] get-tuple-element(p), index=1
+  k = f32[] constant($0)
+  b = f32[8] broadcast(k), dimensions={}
+  sum = f32[8] add(x, b)
+  neg_inf = f32[] constant(-inf)
+  m = f32[] reduce(sum, neg_inf), dimensions={0}, to_apply=max$0
+  bm = f32[8] broadcast(m), dimensions={}
+  next_x = f32[8] minimum(sum, bm)
+  one = s32[] constant(1)
+  next_i = s32[] add(i, one)
+  ROOT t = (f32[8], s32[]) tuple(next_x, next_i)
+}
+
+cond$0 {
+  p = (f32[8], s32[]) parameter(0)
+  i = s32[] get-tuple-element(p), index=1
+  n = s32[] constant($1)
+  ROOT lt = pred[] compare(i, n), direction=LT
+}
+)";
+  std::string text = "HloModule ParallelCodegen\n";
+  std::string entry = R"(
+ENTRY main {
+  x = f32[8] parameter(0)
+  zero = s32[] constant(0)
+  init = (f32[8], s32[]) tuple(x, zero)
+  sum0 = f32[8] copy(x)
+)";
+  for (int i = 1; i <= num_loops; ++i) {
+    absl::StrAppend(&text, absl::Substitute(kLoop, i, i + 1));
+    absl::StrAppend(&entry, "  loop", i,
+                    " = (f32[8], s32[]) while(init), condition=cond", i,
+                    ", body=body", i, "\n  result", i,
+                    " = f32[8] get-tuple-element(loop", i, "), index=0\n  sum",
+                    i, " = f32[8] add(sum", i - 1, ", result", i, ")\n");
+  }
+  absl::StrAppend(&entry, "  ROOT result = f32[8] copy(sum", num_loops,
+                  ")\n}\n");
+  return absl::StrCat(text, entry);
+}
+
+class CpuParallelCodegenTest : public CpuCodegenTest {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = CpuCodegenTest::GetDebugOptionsForTest();
+    debug_options.set_xla_cpu_compilation_parallelism(4);
+    debug_options.set_xla_cpu_keep_object_files(true);
+    return debug_options;
+  }
+};
+
+TEST_F(CpuParallelCodegenTest, MatchesReference) {
+  EXPECT_TRUE(RunAndCompare(MakeHloText(16), ErrorSpec{1e-5}));
+}
+
+TEST_F(CpuParallelCodegenTest, KeepsObjectFileOfEachPart) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(MakeHloText(16)));
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Executable> executable,
+                          CompileToExecutable(std::move(module)));
+  const auto* cpu_executable =
+      static_cast<const CpuExecutable*>(executable.get());
+  EXPECT_GT(cpu_executable->obj_files().size(), 1);
+
+  // The parts are linked again when a serialized executable is loaded.
+  Compiler* compiler = backend().compiler();
+  TF_ASSERT_OK_AND_ASSIGN(std::string serialized,
+                          compiler->SerializeExecutable(*executable));
+  TF_EXPECT_OK(compiler
+                   ->DeserializeExecutable(serialized,
+                                           backend().default_stream_executor())
+                   .status());
+}
+
+TEST_F(CpuParallelCodegenTest, KeepsEmbeddedComputationsWithCallers) {
+  constexpr int kNumLoops = 16;
+  // The functions defined by each part, and whether they have local linkage.
+  tensorflow::mutex mu;
+  std::vector<absl::flat_hash_map<std::string, bool>> parts;
+  auto* compiler = static_cast<LLVMCompiler*>(backend().compiler());
+  compiler->SetPreOptimizationHook([&](const llvm::Module& module) {
+    absl::flat_hash_map<std::string, bool> functions;
+    for (const llvm::Function& function : module.functions()) {
+      if (!function.isDeclaration()) {
+        functions[function.getName().str()] = function.hasLocalLinkage();
+      }
+    }
+    tensorflow::mutex_lock lock(mu);
+    parts.push_back(std::move(functions));
+  });
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(MakeHloText(kNumLoops)));
+  TF_ASSERT_OK(CompileToExecutable(std::move(module)).status());
+  compiler->RemovePreOptimizationHook();
+
+  EXPECT_GT(parts.size(), 1);
+  for (int i = 1; i <= kNumLoops; ++i) {
+    const std::string reducer = absl::StrCat("max", i);
+    const std::string body = absl::StrCat("body", i);
+    int num_definitions = 0;
+    for (const auto& part : parts) {
+      auto it = part.find(reducer);
+      if (it == part.end()) {
+        continue;
+      }
+      ++num_definitions;
+      // The reducer can still be inlined into the loop body.
+      EXPECT_TRUE(it->second) << reducer;
+      EXPECT_TRUE(part.contains(body)) << reducer;
+    }
+    EXPECT_EQ(num_definitions, 1) << reducer;
+  }
+}
+
+// Measures the time to compile a module with many functions, with
+// state.range(0) compilation threads.
+void BM_CompileLargeModule(::testing::benchmark::State& state) {
+  se::Platform* platform = PlatformUtil::GetPlatform("cpu").ValueOrDie();
+  se::StreamExecutor* executor = platform->ExecutorForDevice(0).ValueOrDie();
+  Compiler* compiler = Compiler::GetForPlatform(platform).ValueOrDie();
+
+  HloModuleConfig config;
+  DebugOptions debug_options = GetDebugOptionsFromFlags();
+  debug_options.set_xla_cpu_compilation_parallelism(state.range(0));
+  config.set_debug_options(debug_options);
+  const std::string text = MakeHloText(256);
+  for (auto s : state) {
+    state.PauseTiming();
+    std::unique_ptr<HloModule> module =
+        ParseAndReturnUnverifiedModule(text, config).ValueOrDie();
+    module = compiler
+                 ->RunHloPasses(std::move(module), executor,
+                                /*device_allocator=*/nullptr)
+                 .ValueOrDie();
+    state.ResumeTiming();
+    CHECK(compiler
+              ->RunBackend(std::move(module), executor,
+                           /*device_allocator=*/nullptr)
+              .ok());
+  }
+}
+
+BENCHMARK(BM_CompileLargeModule)->Arg(1)->Arg(4)->Arg(8);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
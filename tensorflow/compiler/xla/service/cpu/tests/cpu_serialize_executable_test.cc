@@ -0,0 +1,148 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <string>
+
+#include "tensorflow/compiler/xla/array2d.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_executable.h"
+#include "tensorflow/compiler/xla/service/cpu/executable.pb.h"
+#include "tensorflow/compiler/xla/service/cpu/tests/cpu_codegen_test.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+class CpuSerializeExecutableTest : public CpuCodegenTest {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = CpuCodegenTest::GetDebugOptionsForTest();
+    debug_options.set_xla_cpu_keep_object_files(true);
+    return debug_options;
+  }
+};
+
+// A module with a loop and a dot, which is emitted as a call into the runtime.
+const char* const kHloText = R"(
+HloModule SerializeExecutable
+
+body {
+  p = (f32[8,8], s32[]) parameter(0)
+  x = f32[8,8] get-tuple-element(p), index=0
+  i = s32[] get-tuple-element(p), index=1
+  half = f32[] constant(0.5)
+  c = f32[8,8] broadcast(half), dimensions={}
+  dot = f32[8,8] dot(x, c), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  one = s32[] constant(1)
+  next = s32[] add(i, one)
+  ROOT t = (f32[8,8], s32[]) tuple(dot, next)
+}
+
+cond {
+  p = (f32[8,8], s32[]) parameter(0)
+  i = s32[] get-tuple-element(p), index=1
+  three = s32[] constant(3)
+  ROOT lt = pred[] compare(i, three), direction=LT
+}
+
+ENTRY main {
+  x = f32[8,8] parameter(0)
+  zero = s32[] constant(0)
+  init = (f32[8,8], s32[]) tuple(x, zero)
+  loop = (f32[8,8], s32[]) while(init), condition=cond, body=body
+  ROOT result = f32[8,8] get-tuple-element(loop), index=0
+}
+)";
+
+TEST_F(CpuSerializeExecutableTest, RoundTrip) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHloText));
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Executable> executable,
+                          CompileToExecutable(std::move(module)));
+  Compiler* compiler = backend().compiler();
+  TF_ASSERT_OK_AND_ASSIGN(std::string serialized,
+                          compiler->SerializeExecutable(*executable));
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<Executable> deserialized,
+      compiler->DeserializeExecutable(serialized,
+                                      backend().default_stream_executor()));
+
+  Array2D<float> values(8, 8);
+  values.FillIota(0.25f);
+  Literal x = LiteralUtil::CreateR2FromArray2D<float>(values);
+  TF_ASSERT_OK_AND_ASSIGN(
+      Literal expected,
+      test_runner_.ExecuteWithExecutable(std::move(executable), {&x}));
+  TF_ASSERT_OK_AND_ASSIGN(
+      Literal actual,
+      test_runner_.ExecuteWithExecutable(std::move(deserialized), {&x}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(expected, actual));
+
+  // A deserialized executable can itself be serialized again.
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Executable> reloaded,
+                          compiler->DeserializeExecutable(
+                              serialized, backend().default_stream_executor()));
+  TF_EXPECT_OK(compiler->SerializeExecutable(*reloaded).status());
+}
+
+TEST_F(CpuSerializeExecutableTest, RequiresObjectFiles) {
+  HloModuleConfig config = GetModuleConfigForTest();
+  DebugOptions debug_options = config.debug_options();
+  debug_options.set_xla_cpu_keep_object_files(false);
+  config.set_debug_options(debug_options);
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHloText, config));
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Executable> executable,
+                          CompileToExecutable(std::move(module)));
+  EXPECT_TRUE(
+      static_cast<const CpuExecutable*>(executable.get())->obj_files().empty());
+  EXPECT_EQ(
+      backend().compiler()->SerializeExecutable(*executable).status().code(),
+      tensorflow::error::FAILED_PRECONDITION);
+}
+
+TEST_F(CpuSerializeExecutableTest, RejectsOtherTargets) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHloText));
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<Executable> executable,
+                          CompileToExecutable(std::move(module)));
+  Compiler* compiler = backend().compiler();
+  TF_ASSERT_OK_AND_ASSIGN(std::string serialized,
+                          compiler->SerializeExecutable(*executable));
+
+  CpuExecutableProto proto;
+  ASSERT_TRUE(proto.ParseFromString(serialized));
+  proto.set_cpu_name("some-other-cpu");
+  EXPECT_EQ(compiler
+                ->DeserializeExecutable(proto.SerializeAsString(),
+                                        backend().default_stream_executor())
+                .status()
+                .code(),
+            tensorflow::error::FAILED_PRECONDITION);
+  EXPECT_EQ(compiler
+                ->DeserializeExecutable("not a serialized executable",
+                                        backend().default_stream_executor())
+                .status()
+                .code(),
+            tensorflow::error::INVALID_ARGUMENT);
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -15,14 +15,17 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/bfc_allocator.h"
 
+#include <algorithm>
 #include <atomic>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/string_view.h"
 #include "tensorflow/core/common_runtime/allocator_retry.h"
 #include "tensorflow/core/lib/core/bits.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -38,9 +41,211 @@ namespace tensorflow {
 
 constexpr BFCAllocator::ChunkHandle BFCAllocator::kInvalidChunkHandle;
 
+namespace {
+
+// Exclusive lock on a mutex that counts the acquisitions which found it held
+// by another thread.
+class TF_SCOPED_LOCKABLE CountingMutexLock {
+ public:
+  CountingMutexLock(mutex& mu, std::atomic<int64>* contentions)
+      TF_EXCLUSIVE_LOCK_FUNCTION(mu)
+      : mu_(mu) {
+    if (!mu_.try_lock()) {
+      contentions->fetch_add(1, std::memory_order_relaxed);
+      mu_.lock();
+    }
+  }
+  ~CountingMutexLock() TF_UNLOCK_FUNCTION() { mu_.unlock(); }
+
+ private:
+  mutex& mu_;
+  TF_DISALLOW_COPY_AND_ASSIGN(CountingMutexLock);
+};
+
+}  // namespace
+
+// Free lists for small allocations, sharded so that threads rarely share a
+// lock. Each thread always frees into and allocates from the same free-list
+// shard. A second set of shards, keyed by address, remembers the size class
+// of every chunk the cache owns, so that DeallocateRaw can route a pointer
+// without looking up its chunk under the allocator lock.
+//
+// A chunk is owned by the cache from the allocation that first takes it from
+// the bins until it is evicted or drained; it is "in use" in the bins all the
+// while. Evicted and drained chunks are untracked before they are returned to
+// the bins, so a pointer the bins hand out again is never mistaken for a
+// cached one.
+class BFCAllocator::ThreadCache {
+ public:
+  // Largest rounded allocation size that is cached.
+  static constexpr size_t kMaxCachedBytes = 64 << 10;
+  // Upper bound on the bytes a single free-list shard may hold.
+  static constexpr size_t kMaxBytesPerShard = 4 << 20;
+  // A free-list shard is emptied after this many frees, so that chunks parked
+  // in size classes that are no longer requested return to the bins.
+  static constexpr int64 kFlushPeriod = 1 << 16;
+
+  ThreadCache(int num_shards, size_t max_bytes_per_shard)
+      : max_bytes_per_shard_(max_bytes_per_shard), shards_(num_shards) {}
+
+  static bool Cacheable(size_t rounded_bytes) {
+    return rounded_bytes <= kMaxCachedBytes;
+  }
+
+  // Returns a cached chunk of exactly 'rounded_bytes', or nullptr.
+  void* Pop(size_t rounded_bytes) {
+    Shard& shard = ThreadShard();
+    {
+      mutex_lock l(shard.mu);
+      std::vector<void*>& list = shard.free_lists[SizeClass(rounded_bytes)];
+      if (!list.empty()) {
+        void* ptr = list.back();
+        list.pop_back();
+        shard.cached_bytes -= rounded_bytes;
+        num_hits_.fetch_add(1, std::memory_order_relaxed);
+        return ptr;
+      }
+    }
+    num_misses_.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  // Hands 'ptr', a chunk of 'rounded_bytes' just taken from the bins, to the
+  // cache.
+  void Track(void* ptr, size_t rounded_bytes) {
+    TrackShard& shard = TrackShardFor(ptr);
+    mutex_lock l(shard.mu);
+    shard.size_classes[ptr] = SizeClass(rounded_bytes);
+  }
+
+  // If the cache owns 'ptr', parks it in the calling thread's free lists and
+  // returns true. Chunks the shard gives up to stay within its byte budget are
+  // appended to 'evicted'; they are no longer owned by the cache and must be
+  // returned to the bins by the caller.
+  bool Push(void* ptr, std::vector<void*>* evicted) {
+    int size_class;
+    {
+      TrackShard& track_shard = TrackShardFor(ptr);
+      tf_shared_lock l(track_shard.mu);
+      auto it = track_shard.size_classes.find(ptr);
+      if (it == track_shard.size_classes.end()) return false;
+      size_class = it->second;
+    }
+    Shard& shard = ThreadShard();
+    {
+      mutex_lock l(shard.mu);
+      shard.free_lists[size_class].push_back(ptr);
+      shard.cached_bytes += ClassBytes(size_class);
+      if (++shard.frees_since_flush >= kFlushPeriod) {
+        shard.frees_since_flush = 0;
+        TakeAll(&shard, evicted);
+      } else if (shard.cached_bytes > max_bytes_per_shard_) {
+        // Evict down to half the budget, starting with the largest size
+        // classes since they return the most bytes per chunk.
+        const size_t target = max_bytes_per_shard_ / 2;
+        for (int c = kNumSizeClasses - 1; c > 0 && shard.cached_bytes > target;
+             --c) {
+          std::vector<void*>& list = shard.free_lists[c];
+          while (!list.empty() && shard.cached_bytes > target) {
+            evicted->push_back(list.back());
+            list.pop_back();
+            shard.cached_bytes -= ClassBytes(c);
+          }
+        }
+      }
+    }
+    Untrack(*evicted);
+    return true;
+  }
+
+  // Empties every free-list shard into 'drained' and gives up ownership of
+  // those chunks.
+  void Drain(std::vector<void*>* drained) {
+    for (Shard& shard : shards_) {
+      mutex_lock l(shard.mu);
+      TakeAll(&shard, drained);
+    }
+    Untrack(*drained);
+  }
+
+  int64 num_hits() const { return num_hits_.load(std::memory_order_relaxed); }
+  int64 num_misses() const {
+    return num_misses_.load(std::memory_order_relaxed);
+  }
+  void ClearCounters() {
+    num_hits_.store(0, std::memory_order_relaxed);
+    num_misses_.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr int kNumSizeClasses =
+      kMaxCachedBytes / kMinAllocationSize + 1;
+  static constexpr int kNumTrackShardBits = 6;
+
+  struct Shard {
+    mutex mu;
+    std::array<std::vector<void*>, kNumSizeClasses> free_lists
+        TF_GUARDED_BY(mu);
+    size_t cached_bytes TF_GUARDED_BY(mu) = 0;
+    int64 frees_since_flush TF_GUARDED_BY(mu) = 0;
+  };
+
+  struct TrackShard {
+    mutex mu;
+    absl::flat_hash_map<const void*, int> size_classes TF_GUARDED_BY(mu);
+  };
+
+  static int SizeClass(size_t rounded_bytes) {
+    return static_cast<int>(rounded_bytes >> kMinAllocationBits);
+  }
+  static size_t ClassBytes(int size_class) {
+    return static_cast<size_t>(size_class) << kMinAllocationBits;
+  }
+
+  static void TakeAll(Shard* shard, std::vector<void*>* out)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(shard->mu) {
+    for (std::vector<void*>& list : shard->free_lists) {
+      out->insert(out->end(), list.begin(), list.end());
+      list.clear();
+    }
+    shard->cached_bytes = 0;
+  }
+
+  void Untrack(const std::vector<void*>& ptrs) {
+    for (void* ptr : ptrs) {
+      TrackShard& shard = TrackShardFor(ptr);
+      mutex_lock l(shard.mu);
+      shard.size_classes.erase(ptr);
+    }
+  }
+
+  Shard& ThreadShard() {
+    static std::atomic<int> next_thread_index{0};
+    static thread_local int thread_index =
+        next_thread_index.fetch_add(1, std::memory_order_relaxed);
+    return shards_[thread_index % shards_.size()];
+  }
+
+  TrackShard& TrackShardFor(const void* ptr) {
+    // Chunk addresses are multiples of kMinAllocationSize and often of much
+    // larger powers of two, so mix the bits before picking a shard.
+    const uint64 bits = reinterpret_cast<uintptr_t>(ptr) >> kMinAllocationBits;
+    return track_shards_[(bits * 0x9E3779B97F4A7C15ull) >>
+                         (64 - kNumTrackShardBits)];
+  }
+
+  const size_t max_bytes_per_shard_;
+  std::vector<Shard> shards_;
+  std::array<TrackShard, 1 << kNumTrackShardBits> track_shards_;
+  std::atomic<int64> num_hits_{0};
+  std::atomic<int64> num_misses_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ThreadCache);
+};
+
 BFCAllocator::BFCAllocator(SubAllocator* sub_allocator, size_t total_memory,
                            bool allow_growth, const string& name,
-                           bool garbage_collection)
+                           bool garbage_collection, bool thread_cache)
     : garbage_collection_(garbage_collection),
       coalesce_regions_(sub_allocator->SupportsCoalescing()),
       sub_allocator_(sub_allocator),
@@ -77,6 +282,15 @@ BFCAllocator::BFCAllocator(SubAllocator* sub_allocator, size_t total_memory,
       CHECK_NE(BinForSize(bin_size * 2), BinFromIndex(b));
     }
   }
+
+  if (thread_cache) {
+    // One free-list shard per core, each allowed to hold a small fraction of
+    // the memory limit.
+    const int num_shards = std::min(std::max(port::MaxParallelism(), 1), 64);
+    thread_cache_.reset(new ThreadCache(
+        num_shards, std::min(ThreadCache::kMaxBytesPerShard,
+                             total_memory / (8 * num_shards))));
+  }
 }
 
 BFCAllocator::~BFCAllocator() {
@@ -254,6 +468,29 @@ void* BFCAllocator::AllocateRawInternalWithRetry(
 void* BFCAllocator::AllocateRaw(size_t unused_alignment, size_t num_bytes,
                                 const AllocationAttributes& allocation_attr) {
   VLOG(1) << "AllocateRaw " << Name() << "  " << num_bytes;
+  if (thread_cache_ != nullptr && num_bytes > 0 &&
+      allocation_attr.freed_by_func == nullptr) {
+    const size_t rounded_bytes = RoundedBytes(num_bytes);
+    if (ThreadCache::Cacheable(rounded_bytes)) {
+      void* ptr = thread_cache_->Pop(rounded_bytes);
+      if (ptr == nullptr) {
+        // Take the whole rounded size so that the chunk can later serve any
+        // request in its size class.
+        ptr = AllocateRawUncached(unused_alignment, rounded_bytes,
+                                  allocation_attr);
+        if (ptr != nullptr) {
+          thread_cache_->Track(ptr, rounded_bytes);
+        }
+      }
+      return ptr;
+    }
+  }
+  return AllocateRawUncached(unused_alignment, num_bytes, allocation_attr);
+}
+
+void* BFCAllocator::AllocateRawUncached(
+    size_t unused_alignment, size_t num_bytes,
+    const AllocationAttributes& allocation_attr) {
   if (!allocation_attr.retry_on_failure) {
     // Return immediately upon the first failure if this is for allocating an
     // optional scratch space.
@@ -402,7 +639,7 @@ void* BFCAllocator::AllocateRawInternal(size_t unused_alignment,
   // The BFC allocator tries to find the best fit first.
   BinNum bin_num = BinNumForSize(rounded_bytes);
 
-  mutex_lock l(lock_);
+  CountingMutexLock l(lock_, &num_lock_contentions_);
   if (!timestamped_chunks_.empty()) {
     // Merge timestamped chunks whose counts have become safe for general use.
     MergeTimestampedChunks(0);
@@ -436,6 +673,16 @@ void* BFCAllocator::AllocateRawInternal(size_t unused_alignment,
     }
   }
 
+  // Chunks parked in the thread cache are in use as far as the bins are
+  // concerned. Return them before concluding that memory is exhausted.
+  if (thread_cache_ != nullptr && DrainThreadCache()) {
+    ptr = FindChunkPtr(bin_num, rounded_bytes, num_bytes, freed_before);
+    if (ptr != nullptr) {
+      AddTraceMe("MemoryAllocation", ptr);
+      return ptr;
+    }
+  }
+
   // Reaching this point means that no chunks can satisfy the request. Also,
   // the unallocated bytes cannot satisfy the request. Before giving up, let's
   // try deallocating free regions so that suballocator can combine them with
@@ -641,6 +888,22 @@ void BFCAllocator::SplitChunk(BFCAllocator::ChunkHandle h, size_t num_bytes) {
 void BFCAllocator::DeallocateRaw(void* ptr) {
   VLOG(1) << "DeallocateRaw " << Name() << " "
           << (ptr ? RequestedSize(ptr) : 0);
+  if (thread_cache_ != nullptr && ptr != nullptr) {
+    std::vector<void*> evicted;
+    if (thread_cache_->Push(ptr, &evicted)) {
+      // Nothing reached the bins unless the push evicted chunks, so there is
+      // no point waking allocations waiting for memory otherwise.
+      if (evicted.empty()) return;
+      {
+        CountingMutexLock l(lock_, &num_lock_contentions_);
+        for (void* evicted_ptr : evicted) {
+          FreeChunkPtr(evicted_ptr);
+        }
+      }
+      retry_helper_.NotifyDealloc();
+      return;
+    }
+  }
   DeallocateRawInternal(ptr);
   retry_helper_.NotifyDealloc();
 }
@@ -650,8 +913,20 @@ void BFCAllocator::DeallocateRawInternal(void* ptr) {
     VLOG(2) << "tried to deallocate nullptr";
     return;
   }
-  mutex_lock l(lock_);
+  CountingMutexLock l(lock_, &num_lock_contentions_);
+  FreeChunkPtr(ptr);
+}
 
+bool BFCAllocator::DrainThreadCache() {
+  std::vector<void*> drained;
+  thread_cache_->Drain(&drained);
+  for (void* ptr : drained) {
+    FreeChunkPtr(ptr);
+  }
+  return !drained.empty();
+}
+
+void BFCAllocator::FreeChunkPtr(void* ptr) {
   // Find the chunk from the ptr.
   BFCAllocator::ChunkHandle h = region_manager_.get_handle(ptr);
   CHECK(h != kInvalidChunkHandle);
@@ -1165,11 +1440,24 @@ MemoryDump BFCAllocator::RecordMemoryMapInternal() {
 
 absl::optional<AllocatorStats> BFCAllocator::GetStats() {
   mutex_lock l(lock_);
-  return stats_;
+  AllocatorStats stats = stats_;
+  stats.num_lock_contentions =
+      num_lock_contentions_.load(std::memory_order_relaxed);
+  if (thread_cache_ != nullptr) {
+    stats.num_cache_hits = thread_cache_->num_hits();
+    stats.num_cache_misses = thread_cache_->num_misses();
+    // Cache hits never reach the bins, so stats_ does not count them.
+    stats.num_allocs += stats.num_cache_hits;
+  }
+  return stats;
 }
 
 void BFCAllocator::ClearStats() {
   mutex_lock l(lock_);
+  num_lock_contentions_.store(0, std::memory_order_relaxed);
+  if (thread_cache_ != nullptr) {
+    thread_cache_->ClearCounters();
+  }
   stats_.num_allocs = 0;
   stats_.peak_bytes_in_use = stats_.bytes_in_use;
   stats_.largest_alloc_size = 0;
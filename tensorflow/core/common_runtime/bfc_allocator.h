@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_COMMON_RUNTIME_BFC_ALLOCATOR_H_
 
 #include <array>
+#include <atomic>
 #include <deque>
 #include <memory>
 #include <string>
@@ -29,6 +30,7 @@ limitations under the License.
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/thread_annotations.h"
@@ -46,12 +48,21 @@ class MemoryDump;
 // coalescing.  One assumption we make is that the process using this
 // allocator owns pretty much all of the memory, and that nearly
 // all requests to allocate memory go through this interface.
+//
+// If 'thread_cache' is true, small allocations are freed into per-thread
+// free lists instead of back into the bins, and later allocations of the same
+// rounded size are served from those lists without taking the allocator lock.
+// Cached chunks stay in use from the point of view of the bins, so
+// RequestedSize() of a cached allocation reports its rounded size, and
+// GetStats().bytes_in_use includes the bytes parked in the cache. The cache is
+// bypassed for allocations with a freed_by_func, and cannot be combined with a
+// timing counter, since both rely on the bins seeing every free.
 class BFCAllocator : public Allocator {
  public:
   // Takes ownership of sub_allocator.
   BFCAllocator(SubAllocator* sub_allocator, size_t total_memory,
                bool allow_growth, const string& name,
-               bool garbage_collection = false);
+               bool garbage_collection = false, bool thread_cache = false);
   ~BFCAllocator() override;
 
   string Name() override { return name_; }
@@ -77,7 +88,10 @@ class BFCAllocator : public Allocator {
 
   void ClearStats() override;
 
-  void SetTimingCounter(SharedCounter* sc) { timing_counter_ = sc; }
+  void SetTimingCounter(SharedCounter* sc) {
+    DCHECK(thread_cache_ == nullptr);
+    timing_counter_ = sc;
+  }
 
   void SetSafeFrontier(uint64 count) override;
 
@@ -92,12 +106,26 @@ class BFCAllocator : public Allocator {
                             bool dump_log_on_failure,
                             uint64 freed_before_count);
 
+  // Allocates from the bins, bypassing the thread cache.
+  void* AllocateRawUncached(size_t alignment, size_t num_bytes,
+                            const AllocationAttributes& allocation_attr);
+
   void* AllocateRawInternalWithRetry(
       size_t alignment, size_t num_bytes,
       const AllocationAttributes& allocation_attr);
 
   void DeallocateRawInternal(void* ptr);
 
+  // Returns the chunk holding 'ptr' to the bins.
+  void FreeChunkPtr(void* ptr) TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Returns every chunk parked in the thread cache to the bins. Returns true
+  // if any chunk was returned.
+  bool DrainThreadCache() TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Per-thread free lists for small allocations; see bfc_allocator.cc.
+  class ThreadCache;
+
   // Chunks whose freed_at_count is later than the safe frontier value are kept
   // on a special list and not subject to merging immediately upon being freed.
   //
@@ -578,6 +606,14 @@ class BFCAllocator : public Allocator {
 
   std::atomic<uint64> safe_frontier_ = {0};
 
+  // Null unless the allocator was constructed with thread_cache set. Its
+  // internal locks may be taken while holding lock_, never the reverse.
+  std::unique_ptr<ThreadCache> thread_cache_;
+
+  // Number of acquisitions of lock_ on the allocation paths that found it
+  // held by another thread.
+  std::atomic<int64> num_lock_contentions_ = {0};
+
   // Structures mutable after construction
   mutable mutex lock_;
   RegionManager region_manager_ TF_GUARDED_BY(lock_);
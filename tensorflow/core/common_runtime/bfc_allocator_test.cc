@@ -0,0 +1,181 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/bfc_allocator.h"
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+BFCAllocator* NewCpuBFCAllocator(size_t total_memory, bool thread_cache) {
+  SubAllocator* sub_allocator =
+      new BasicCPUAllocator(port::kNUMANoAffinity, {}, {});
+  return new BFCAllocator(sub_allocator, total_memory, /*allow_growth=*/false,
+                          "cpu_bfc", /*garbage_collection=*/false,
+                          thread_cache);
+}
+
+TEST(BFCAllocatorTest, ThreadCacheReusesFreedChunks) {
+  std::unique_ptr<BFCAllocator> a(
+      NewCpuBFCAllocator(1 << 20, /*thread_cache=*/true));
+  void* p1 = a->AllocateRaw(1, 100);
+  a->DeallocateRaw(p1);
+  // Same rounded size class, so the freed chunk is handed back.
+  void* p2 = a->AllocateRaw(1, 200);
+  EXPECT_EQ(p1, p2);
+  EXPECT_EQ(size_t{256}, a->RequestedSize(p2));
+  a->DeallocateRaw(p2);
+
+  absl::optional<AllocatorStats> stats = a->GetStats();
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(1, stats->num_cache_hits);
+  EXPECT_EQ(1, stats->num_cache_misses);
+  EXPECT_EQ(2, stats->num_allocs);
+  // The cached chunk is still in use as far as the bins are concerned.
+  EXPECT_EQ(256, stats->bytes_in_use);
+
+  a->ClearStats();
+  stats = a->GetStats();
+  EXPECT_EQ(0, stats->num_cache_hits);
+  EXPECT_EQ(0, stats->num_cache_misses);
+}
+
+TEST(BFCAllocatorTest, ThreadCacheSkipsLargeAllocations) {
+  std::unique_ptr<BFCAllocator> a(
+      NewCpuBFCAllocator(1 << 22, /*thread_cache=*/true));
+  void* p = a->AllocateRaw(1, 1 << 20);
+  a->DeallocateRaw(p);
+  absl::optional<AllocatorStats> stats = a->GetStats();
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(0, stats->num_cache_hits);
+  EXPECT_EQ(0, stats->num_cache_misses);
+  EXPECT_EQ(0, stats->bytes_in_use);
+}
+
+TEST(BFCAllocatorTest, ThreadCacheDrainedBeforeRunningOutOfMemory) {
+  std::unique_ptr<BFCAllocator> a(
+      NewCpuBFCAllocator(1 << 20, /*thread_cache=*/true));
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 100; ++i) {
+    ptrs.push_back(a->AllocateRaw(1, 8192));
+    ASSERT_NE(nullptr, ptrs.back());
+  }
+  for (void* p : ptrs) {
+    a->DeallocateRaw(p);
+  }
+  // Most of the memory is now parked in the cache; a large request has to
+  // return it to the bins to succeed.
+  AllocationAttributes attr;
+  attr.retry_on_failure = false;
+  void* p = a->AllocateRaw(1, 900 << 10, attr);
+  EXPECT_NE(nullptr, p);
+  a->DeallocateRaw(p);
+}
+
+TEST(BFCAllocatorTest, ThreadCacheConcurrentAllocations) {
+  std::unique_ptr<BFCAllocator> a(
+      NewCpuBFCAllocator(1 << 27, /*thread_cache=*/true));
+  constexpr int kNumThreads = 8;
+  std::atomic<int> num_corrupted(0);
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&a, &num_corrupted, t]() {
+        random::PhiloxRandom philox(t, 17);
+        random::SimplePhilox rand(&philox);
+        std::vector<std::pair<char*, size_t>> live;
+        for (int i = 0; i < 10000; ++i) {
+          if (live.size() < 32 && rand.OneIn(2)) {
+            // Mostly cacheable sizes, with the occasional large request.
+            const size_t bytes =
+                1 + rand.Uniform(rand.OneIn(8) ? 200000 : 4096);
+            char* p = static_cast<char*>(a->AllocateRaw(1, bytes));
+            memset(p, t + 1, bytes);
+            live.emplace_back(p, bytes);
+          } else if (!live.empty()) {
+            const size_t k = rand.Uniform(live.size());
+            std::pair<char*, size_t> entry = live[k];
+            live[k] = live.back();
+            live.pop_back();
+            for (size_t j = 0; j < entry.second; ++j) {
+              if (entry.first[j] != t + 1) {
+                ++num_corrupted;
+                break;
+              }
+            }
+            a->DeallocateRaw(entry.first);
+          }
+        }
+        for (const auto& entry : live) {
+          a->DeallocateRaw(entry.first);
+        }
+      });
+    }
+  }
+  EXPECT_EQ(0, num_corrupted);
+  absl::optional<AllocatorStats> stats = a->GetStats();
+  ASSERT_TRUE(stats);
+  EXPECT_GT(stats->num_cache_hits, 0);
+}
+
+static void BM_AllocationThreaded(::testing::benchmark::State& state,
+                                  bool thread_cache) {
+  const int num_threads = state.range(0);
+  constexpr int kAllocsPerThread = 1000;
+  std::unique_ptr<BFCAllocator> a(NewCpuBFCAllocator(1uLL << 30, thread_cache));
+  thread::ThreadPool pool(Env::Default(), "test", num_threads);
+  // Small, host-side sizes such as shapes, scalars and strings.
+  const std::vector<int> sizes = {16, 256, 1024, 4096, 64, 512, 16384, 2048};
+
+  for (auto s : state) {
+    BlockingCounter counter(num_threads);
+    for (int t = 0; t < num_threads; t++) {
+      pool.Schedule([&a, &counter, &sizes]() {
+        for (int i = 0; i < kAllocsPerThread; i++) {
+          void* p = a->AllocateRaw(1, sizes[i % sizes.size()]);
+          a->DeallocateRaw(p);
+        }
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+  state.SetItemsProcessed(static_cast<int64>(state.iterations()) *
+                          num_threads * kAllocsPerThread);
+}
+
+static void BM_AllocationThreadedNoCache(::testing::benchmark::State& state) {
+  BM_AllocationThreaded(state, /*thread_cache=*/false);
+}
+BENCHMARK(BM_AllocationThreadedNoCache)->Arg(1)->Arg(4)->Arg(16);
+
+static void BM_AllocationThreadedWithCache(::testing::benchmark::State& state) {
+  BM_AllocationThreaded(state, /*thread_cache=*/true);
+}
+BENCHMARK(BM_AllocationThreadedWithCache)->Arg(1)->Arg(4)->Arg(16);
+
+}  // namespace
+}  // namespace tensorflow
@@ -45,6 +45,7 @@ limitations under the License.
 #include "tensorflow/core/framework/log_memory.h"
 #include "tensorflow/core/framework/logging.h"
 #include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/run_handler.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/versions.pb.h"
@@ -1414,6 +1415,16 @@ Status DirectSession::CreateExecutors(
 
     item->executor = nullptr;
     item->device = device;
+    if (options_.config.experimental().use_tensor_arena() &&
+        !run_state_args->is_partial_run &&
+        device->device_type() == DEVICE_CPU) {
+      TF_RETURN_IF_ERROR(TensorArenaPlan::Create(
+          *partition_graph, run_state_args->feed_shapes,
+          &item->arena_plan));
+      if (item->arena_plan->num_planned_outputs() > 0) {
+        params.arena_plan = item->arena_plan.get();
+      }
+    }
     auto executor_type = options_.config.experimental().executor_type();
     TF_RETURN_IF_ERROR(
         NewExecutor(executor_type, params, *partition_graph, &item->executor));
@@ -1610,6 +1621,25 @@ Status DirectSession::CreateGraphs(
   }
   *collective_graph_key = client_graph->collective_graph_key;
 
+  if (options_.config.experimental().use_tensor_arena()) {
+    std::unordered_map<StringPiece, const Node*, StringPieceHasher> nodes;
+    for (const Node* n : execution_state_->full_graph()->nodes()) {
+      nodes.emplace(n->name(), n);
+    }
+    run_state_args->feed_shapes.clear();
+    for (const string& feed : subgraph_options.callable_options.feed()) {
+      const TensorId id = ParseTensorName(feed);
+      PartialTensorShape shape;
+      auto it = nodes.find(id.node());
+      // Fed nodes without a "shape" attr have an unknown output shape.
+      if (it == nodes.end() || id.index() != 0 ||
+          !GetNodeAttr(it->second->attrs(), "shape", &shape).ok()) {
+        shape = PartialTensorShape();
+      }
+      run_state_args->feed_shapes.push_back(shape);
+    }
+  }
+
   if (subgraph_options.callable_options.feed_size() !=
       client_graph->feed_types.size()) {
     return errors::Internal(
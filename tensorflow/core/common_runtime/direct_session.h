@@ -32,6 +32,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/process_function_library_runtime.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
 #include "tensorflow/core/common_runtime/session_factory.h"
+#include "tensorflow/core/common_runtime/tensor_arena.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/collective.h"
 #include "tensorflow/core/framework/graph.pb.h"
@@ -147,6 +148,8 @@ class DirectSession : public Session {
     std::unique_ptr<Graph> graph = nullptr;
     Device* device = nullptr;                // not owned.
     FunctionLibraryRuntime* flib = nullptr;  // not owned.
+    // Must outlive `executor`.
+    std::unique_ptr<TensorArenaPlan> arena_plan;
     std::unique_ptr<Executor> executor;
   };
 
@@ -176,6 +179,9 @@ class DirectSession : public Session {
     CallableOptions callable_options;
 
     int64 collective_graph_key = BuildGraphOptions::kNoCollectiveGraphKey;
+    // The shapes of the fed tensors, as declared by the "shape" attr of the
+    // fed nodes. Only filled in when tensor arenas are enabled.
+    std::vector<PartialTensorShape> feed_shapes;
   };
 
   // A FunctionInfo object is created for every unique set of feeds/fetches.
@@ -236,6 +242,9 @@ class DirectSession : public Session {
     std::unique_ptr<Graph> graph;
     const DebugOptions& debug_options;
     int64 collective_graph_key = BuildGraphOptions::kNoCollectiveGraphKey;
+    // The shapes of the fed tensors, as declared by the "shape" attr of the
+    // fed nodes. Only filled in when tensor arenas are enabled.
+    std::vector<PartialTensorShape> feed_shapes;
   };
 
   // Retrieves an already existing set of executors to run 'inputs' and
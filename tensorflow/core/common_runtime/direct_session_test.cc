@@ -2585,6 +2585,107 @@ TEST(DirectSessionTest,
   TestFeedAndFetchTensorsInDeviceMemoryForAllDataTypes(opts);
 }
 
+// Builds a multi-layer perceptron of `depth` layers of width `width`, fed by
+// a placeholder of shape [batch, width].
+GraphDef MultiLayerPerceptron(int batch, int width, int depth, string* input,
+                              string* output) {
+  Graph g(OpRegistry::Global());
+  Node* placeholder;
+  TF_CHECK_OK(NodeBuilder(g.NewName("Placeholder"), "Placeholder")
+                  .Attr("shape", TensorShape({batch, width}))
+                  .Attr("dtype", DT_FLOAT)
+                  .Device("/cpu:0")
+                  .Finalize(&g, &placeholder));
+  Tensor weights(DT_FLOAT, TensorShape({width, width}));
+  test::FillFn<float>(&weights, [width](int i) {
+    return (i % (width + 1) == 0 ? 1.0f : 0.0f) + 0.001f * (i % 7);
+  });
+  Node* n = placeholder;
+  for (int i = 0; i < depth; ++i) {
+    Node* w = test::graph::Constant(&g, weights);
+    n = test::graph::Matmul(&g, n, w, false, false);
+    n = test::graph::Relu(&g, n);
+  }
+  *input = placeholder->name() + ":0";
+  *output = n->name() + ":0";
+  GraphDef def;
+  g.ToGraphDef(&def);
+  return def;
+}
+
+TEST(DirectSessionTest, TensorArena) {
+  string input, output;
+  const GraphDef def = MultiLayerPerceptron(4, 32, 8, &input, &output);
+  Tensor x(DT_FLOAT, TensorShape({4, 32}));
+  test::FillFn<float>(&x, [](int i) { return 0.1f * (i % 11) - 0.5f; });
+
+  std::vector<Tensor> expected;
+  {
+    auto session = CreateSession();
+    TF_ASSERT_OK(session->Create(def));
+    TF_ASSERT_OK(session->Run({{input, x}}, {output}, {}, &expected));
+  }
+
+  SessionOptions options;
+  options.config.mutable_experimental()->set_use_tensor_arena(true);
+  std::unique_ptr<Session> session(NewSession(options));
+  TF_ASSERT_OK(session->Create(def));
+  for (int i = 0; i < 3; ++i) {
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run({{input, x}}, {output}, {}, &outputs));
+    test::ExpectTensorEqual<float>(expected[0], outputs[0]);
+  }
+
+  // A feed whose shape differs from the placeholder's declared shape is not
+  // served from the arena, but must still produce correct results.
+  Tensor y(DT_FLOAT, TensorShape({8, 32}));
+  test::FillFn<float>(&y, [](int i) { return 0.1f * (i % 11) - 0.5f; });
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->Run({{input, y}}, {output}, {}, &outputs));
+  ASSERT_EQ(TensorShape({8, 32}), outputs[0].shape());
+  test::ExpectTensorNear<float>(expected[0], outputs[0].Slice(0, 4), 1e-5);
+}
+
+// Measures the latency and the number of calls to the CPU allocator per step
+// of a small static-shape inference graph, with and without a tensor arena.
+void BM_TensorArena(::testing::benchmark::State& state) {
+  const int depth = state.range(0);
+  const bool use_tensor_arena = state.range(1);
+  string input, output;
+  const GraphDef def = MultiLayerPerceptron(1, 64, depth, &input, &output);
+  Tensor x(DT_FLOAT, TensorShape({1, 64}));
+  x.flat<float>().setConstant(0.5f);
+
+  SessionOptions options;
+  options.config.mutable_experimental()->set_use_tensor_arena(
+      use_tensor_arena);
+  std::unique_ptr<Session> session(NewSession(options));
+  TF_CHECK_OK(session->Create(def));
+  Session::CallableHandle handle;
+  CallableOptions callable_options;
+  callable_options.add_feed(input);
+  callable_options.add_fetch(output);
+  TF_CHECK_OK(session->MakeCallable(callable_options, &handle));
+
+  EnableCPUAllocatorStats();
+  Allocator* allocator = cpu_allocator();
+  const int64 num_allocs_before = allocator->GetStats()->num_allocs;
+  for (auto s : state) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->RunCallable(handle, {x}, &outputs, nullptr));
+  }
+  const int64 num_allocs = allocator->GetStats()->num_allocs - num_allocs_before;
+  DisableCPUAllocatorStats();
+  state.SetLabel(strings::StrCat(
+      "allocs/step: ", num_allocs / std::max<int64>(state.iterations(), 1)));
+  TF_CHECK_OK(session->ReleaseCallable(handle));
+}
+BENCHMARK(BM_TensorArena)
+    ->ArgPair(8, 0)
+    ->ArgPair(8, 1)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 1);
+
 // A simple benchmark for the overhead of `DirectSession::Run()` calls
 // with varying numbers of feeds/fetches.
 void FeedFetchBenchmarkHelper(::testing::benchmark::State& state, int num_feeds,
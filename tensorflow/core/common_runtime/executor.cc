@@ -30,6 +30,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/renamed_device.h"
 #include "tensorflow/core/common_runtime/simple_propagator_state.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/common_runtime/tensor_arena.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/collective.h"
@@ -56,6 +57,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/manual_constructor.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/context.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/logging.h"
@@ -136,7 +138,11 @@ typedef gtl::InlinedVector<AllocatorAttributes, 4> AllocatorAttributeVec;
 
 class ExecutorImpl : public Executor {
  public:
-  explicit ExecutorImpl(const LocalExecutorParams& p) : immutable_state_(p) {}
+  // If "work_stealing" is true, ready nodes that are not run inline go to
+  // per-worker queues drained by a bounded number of closures, instead of each
+  // being scheduled as its own closure on the runner.
+  explicit ExecutorImpl(const LocalExecutorParams& p, bool work_stealing)
+      : immutable_state_(p), work_stealing_(work_stealing) {}
 
   Status Initialize(const Graph& graph) {
     TF_RETURN_IF_ERROR(immutable_state_.Initialize(graph));
@@ -214,6 +220,7 @@ class ExecutorImpl : public Executor {
 
   ImmutableExecutorState immutable_state_;
   KernelStats kernel_stats_;
+  const bool work_stealing_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(ExecutorImpl);
 };
@@ -272,7 +279,7 @@ class ExecutorState {
  public:
   ExecutorState(const Executor::Args& args,
                 const ImmutableExecutorState& immutable_state_,
-                ExecutorImpl::KernelStats* kernel_stats_);
+                ExecutorImpl::KernelStats* kernel_stats_, bool work_stealing);
   ~ExecutorState();
 
   void RunAsync(Executor::DoneCallback done);
@@ -286,8 +293,10 @@ class ExecutorState {
 
   struct AsyncState;
 
-  // Process a ready node in current thread.
-  void Process(TaggedNode node, int64 scheduled_nsec);
+  // Process a ready node in current thread.  When called from a work-stealing
+  // worker (`worker` >= 0), then also processes nodes taken from the worker
+  // queues until they are empty.
+  void Process(TaggedNode node, int64 scheduled_nsec, int worker);
 
   Status ProcessSync(const NodeItem& item, OpKernelContext::Params* params,
                      EntryVector* outputs, NodeExecStatsInterface* stats);
@@ -314,15 +323,31 @@ class ExecutorState {
   // This method will clear `*ready` before returning.
   bool NodeDone(const Status& s, TaggedNodeSeq* ready,
                 NodeExecStatsInterface* stats,
-                TaggedNodeReadyQueue* inline_ready);
+                TaggedNodeReadyQueue* inline_ready, int worker);
 
   // Schedule all the expensive nodes in '*ready', and put all the inexpensive
-  // nodes in 'ready' into 'inline_ready'.
+  // nodes in 'ready' into 'inline_ready'.  In work-stealing mode the expensive
+  // nodes are queued on `worker`'s queue (or spread over all queues if
+  // `worker` < 0) rather than scheduled individually.
   //
   // This method will clear `*ready` before returning.
   //
   // REQUIRES: `!ready->empty()`.
-  void ScheduleReady(TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready);
+  void ScheduleReady(TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready,
+                     int worker);
+
+  // Work-stealing mode: adds `node` to the queue of `worker`, and starts
+  // another worker if fewer than `num_workers_` are active.
+  void PushReadyNode(const TaggedNode& node, int worker, int64 scheduled_nsec);
+
+  // Work-stealing mode: moves a node to `inline_ready`, taking the most
+  // recently pushed node of `worker`'s own queue or else the oldest node of
+  // another queue.  Returns false if all queues are empty.
+  bool PopReadyNode(int worker, TaggedNodeReadyQueue* inline_ready);
+
+  // Work-stealing mode: the body of a worker closure.  Processes queued nodes
+  // until there are none left.
+  void RunWorker(int64 scheduled_nsec);
 
   // A wrapper for runner_ to keep track of the pending queue length. Op
   // execution should dispatch work using this function instead of using runner_
@@ -366,6 +391,9 @@ class ExecutorState {
   CancellationManager* cancellation_manager_;
   // If not null, use this device to schedule intra-op operation
   std::unique_ptr<DeviceBase> user_device_;
+  // If not null, node outputs planned by `params().arena_plan` are allocated
+  // from this arena. Owns one reference.
+  TensorArena* arena_ = nullptr;
   Executor::Args::Runner runner_;
   bool sync_on_finish_;
   const bool run_all_kernels_inline_;
@@ -377,6 +405,23 @@ class ExecutorState {
 
   std::atomic_int_fast32_t num_outstanding_ops_;
 
+  // Work-stealing mode.  Each running worker holds one count in
+  // `num_outstanding_ops_`, so that the step cannot finish (and delete this
+  // state) while a worker still looks at the queues.
+  struct WorkerQueue {
+    mutex mu;
+    // nodes[head, size()) are queued.  The owner takes from the back, thieves
+    // take from the front.
+    std::vector<TaggedNode> nodes TF_GUARDED_BY(mu);
+    size_t head TF_GUARDED_BY(mu) = 0;
+  };
+  const bool work_stealing_;
+  const int num_workers_;
+  std::unique_ptr<WorkerQueue[]> worker_queues_;
+  std::atomic<int> num_active_workers_{0};
+  std::atomic<int> num_queued_nodes_{0};
+  std::atomic<uint32> next_worker_{0};
+
   // Available via OpKernelContext to every OpKernel invocation.
   mutex num_deferred_ops_mu_;
   int64 num_deferred_ops_ TF_GUARDED_BY(num_deferred_ops_mu_) = 0;
@@ -390,7 +435,7 @@ class ExecutorState {
 template <class PropagatorStateType>
 ExecutorState<PropagatorStateType>::ExecutorState(
     const Executor::Args& args, const ImmutableExecutorState& immutable_state,
-    ExecutorImpl::KernelStats* kernel_stats)
+    ExecutorImpl::KernelStats* kernel_stats, bool work_stealing)
     : vlog_(VLOG_IS_ON(1)),
       log_memory_(LogMemory::IsEnabled()),
       step_id_(args.step_id),
@@ -414,12 +459,22 @@ ExecutorState<PropagatorStateType>::ExecutorState(
       sync_on_finish_(args.sync_on_finish),
       run_all_kernels_inline_(args.run_all_kernels_inline),
       propagator_(immutable_state, step_id_, vlog_),
-      num_outstanding_ops_(0) {
+      num_outstanding_ops_(0),
+      work_stealing_(work_stealing && !run_all_kernels_inline_),
+      num_workers_(work_stealing_ ? std::max(port::MaxParallelism(), 1) : 0) {
+  if (work_stealing_) {
+    worker_queues_.reset(new WorkerQueue[num_workers_]);
+  }
   if (args.user_intra_op_threadpool != nullptr) {
     Device* device = immutable_state_.params().device;
     user_device_ = RenamedDevice::NewRenamedDevice(
         device->name(), device, false, false, args.user_intra_op_threadpool);
   }
+  const TensorArenaPlan* arena_plan = immutable_state_.params().arena_plan;
+  if (arena_plan != nullptr) {
+    arena_ = arena_plan->NewArena(
+        immutable_state_.params().device->GetAllocator(AllocatorAttributes()));
+  }
 }
 
 template <class PropagatorStateType>
@@ -428,6 +483,9 @@ ExecutorState<PropagatorStateType>::~ExecutorState() {
     device_context_->Unref();
   }
   delete slice_reader_cache_;
+  if (arena_) {
+    arena_->Unref();
+  }
 }
 
 template <class PropagatorStateType>
@@ -478,7 +536,7 @@ void ExecutorState<PropagatorStateType>::RunAsync(Executor::DoneCallback done) {
   } else {
     done_cb_ = std::move(done);
     // Schedule to run all the ready ops in thread pool.
-    ScheduleReady(&ready, nullptr);
+    ScheduleReady(&ready, nullptr, /*worker=*/-1);
   }
 }
 
@@ -625,7 +683,7 @@ void ExecutorState<PropagatorStateType>::ProcessAsync(
       propagator_.PropagateOutputs(state->tagged_node, &outputs, &ready);
     }
     outputs.clear();
-    const bool completed = NodeDone(s, &ready, stats, nullptr);
+    const bool completed = NodeDone(s, &ready, stats, nullptr, /*worker=*/-1);
     delete state;
     if (completed) ScheduleFinish();
   };
@@ -662,7 +720,8 @@ void ExecutorState<PropagatorStateType>::ProcessConstTensor(
 
 template <class PropagatorStateType>
 void ExecutorState<PropagatorStateType>::Process(TaggedNode tagged_node,
-                                                 int64 scheduled_nsec) {
+                                                 int64 scheduled_nsec,
+                                                 int worker) {
   profiler::TraceMeConsumer activity(
       // From TraceMeProducer in DirectSession::RunInternal,
       // GraphMgr::ExecuteAsync, or FunctionLibraryRuntime::Run.
@@ -741,7 +800,8 @@ void ExecutorState<PropagatorStateType>::Process(TaggedNode tagged_node,
 
   bool completed = false;
   inline_ready.push_back(tagged_node);
-  while (!inline_ready.empty()) {
+  while (!inline_ready.empty() ||
+         (worker >= 0 && PopReadyNode(worker, &inline_ready))) {
     tagged_node = inline_ready.front();
     inline_ready.pop_front();
     const NodeItem& item = tagged_node.get_node_item();
@@ -792,7 +852,7 @@ void ExecutorState<PropagatorStateType>::Process(TaggedNode tagged_node,
         }
         propagator_.MaybeMarkCompleted(tagged_node);
         // Continue to process the nodes in 'inline_ready'.
-        completed = NodeDone(s, &ready, stats, &inline_ready);
+        completed = NodeDone(s, &ready, stats, &inline_ready, worker);
         continue;
       }
 
@@ -803,6 +863,8 @@ void ExecutorState<PropagatorStateType>::Process(TaggedNode tagged_node,
       params.output_attr_array = item.output_attrs();
       params.forward_from_array = item.forward_from();
       params.outputs_required_array = item.outputs_required.get();
+      params.output_allocator_array =
+          arena_ != nullptr ? arena_->output_allocators(item.node_id) : nullptr;
 
       if (item.kernel_is_async) {
         ProcessAsync(item, params, tagged_node, first_input, stats);
@@ -841,9 +903,9 @@ void ExecutorState<PropagatorStateType>::Process(TaggedNode tagged_node,
         scheduled_nsec = nodestats::NowInNsec();
       }
       // Postprocess.
-      completed = NodeDone(s, &ready, stats, &inline_ready);
+      completed = NodeDone(s, &ready, stats, &inline_ready, worker);
     }
-  }  // while !inline_ready.empty()
+  }  // while !inline_ready.empty() || PopReadyNode(...)
 
   // This thread of computation is done if completed = true.
   if (completed) ScheduleFinish();
@@ -1062,7 +1124,7 @@ Status ExecutorState<PropagatorStateType>::ProcessOutputs(
 template <class PropagatorStateType>
 bool ExecutorState<PropagatorStateType>::NodeDone(
     const Status& s, TaggedNodeSeq* ready, NodeExecStatsInterface* stats,
-    TaggedNodeReadyQueue* inline_ready) {
+    TaggedNodeReadyQueue* inline_ready, int worker) {
   if (stats) {
     nodestats::SetAllEnd(stats);
     DCHECK_NE(stats_collector_, nullptr);
@@ -1081,7 +1143,7 @@ bool ExecutorState<PropagatorStateType>::NodeDone(
       }
 
       // Schedule the ready nodes in 'ready'.
-      ScheduleReady(ready, inline_ready);
+      ScheduleReady(ready, inline_ready, worker);
 
       return false;
     }
@@ -1139,7 +1201,7 @@ bool ExecutorState<PropagatorStateType>::NodeDone(
 
 template <class PropagatorStateType>
 void ExecutorState<PropagatorStateType>::ScheduleReady(
-    TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready) {
+    TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready, int worker) {
   DCHECK(!ready->empty());
 
   int64 scheduled_nsec = 0;
@@ -1155,7 +1217,7 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
       // executor mutex contention will be minimized.
       RunTask([this, ready = std::move(*ready), scheduled_nsec]() {
         for (auto& tagged_node : ready) {
-          Process(tagged_node, scheduled_nsec);
+          Process(tagged_node, scheduled_nsec, /*worker=*/-1);
         }
       });
     } else {
@@ -1163,12 +1225,50 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
         inline_ready->push_back(tagged_node);
       }
     }
+  } else if (work_stealing_) {
+    if (inline_ready == nullptr) {
+      // Not on a worker (the step is starting, or an async kernel finished):
+      // spread the nodes over the queues.  Unlike a worker, this thread holds
+      // no count that keeps the step alive once the nodes are queued, so take
+      // one for the duration.
+      num_outstanding_ops_.fetch_add(1, std::memory_order_relaxed);
+      for (auto& tagged_node : *ready) {
+        PushReadyNode(tagged_node, next_worker_++ % num_workers_,
+                      scheduled_nsec);
+      }
+      ready->clear();
+      if (num_outstanding_ops_.fetch_sub(1) == 1) ScheduleFinish();
+      return;
+    } else {
+      DCHECK_GE(worker, 0);
+      // As below, but extra expensive nodes go to this worker's own queue,
+      // where they stay unless another worker is idle and steals them.
+      const TaggedNode* curr_expensive_node = nullptr;
+      for (auto& tagged_node : *ready) {
+        const NodeItem& item = *tagged_node.node_item;
+        if (tagged_node.get_is_dead() || !kernel_stats_->IsExpensive(item)) {
+          inline_ready->push_back(tagged_node);
+        } else {
+          if (curr_expensive_node) {
+            PushReadyNode(*curr_expensive_node, worker, scheduled_nsec);
+          }
+          curr_expensive_node = &tagged_node;
+        }
+      }
+      if (curr_expensive_node) {
+        if (inline_ready->empty()) {
+          inline_ready->push_back(*curr_expensive_node);
+        } else {
+          PushReadyNode(*curr_expensive_node, worker, scheduled_nsec);
+        }
+      }
+    }
   } else {
     const TaggedNode* curr_expensive_node = nullptr;
     if (inline_ready == nullptr) {
       // Schedule to run all the ready ops in thread pool.
       for (auto& tagged_node : *ready) {
-        RunTask([=]() { Process(tagged_node, scheduled_nsec); });
+        RunTask([=]() { Process(tagged_node, scheduled_nsec, -1); });
       }
     } else {
       for (auto& tagged_node : *ready) {
@@ -1181,7 +1281,7 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
             // Dispatch to another thread since there is plenty of work to
             // do for this thread.
             RunTask(std::bind(&ExecutorState::Process, this,
-                              *curr_expensive_node, scheduled_nsec));
+                              *curr_expensive_node, scheduled_nsec, -1));
           }
           curr_expensive_node = &tagged_node;
         }
@@ -1194,13 +1294,89 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
         // There are inline nodes to run already. We dispatch this expensive
         // node to other thread.
         RunTask(std::bind(&ExecutorState::Process, this, *curr_expensive_node,
-                          scheduled_nsec));
+                          scheduled_nsec, -1));
       }
     }
   }
   ready->clear();
 }
 
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::PushReadyNode(const TaggedNode& node,
+                                                       int worker,
+                                                       int64 scheduled_nsec) {
+  DCHECK(work_stealing_);
+  {
+    WorkerQueue& queue = worker_queues_[worker];
+    mutex_lock l(queue.mu);
+    queue.nodes.push_back(node);
+  }
+  num_queued_nodes_.fetch_add(1);
+
+  // Pairs with the exit check in RunWorker(): either an exiting worker sees
+  // `num_queued_nodes_` > 0, or we see it already gone from the active count.
+  int num_active = num_active_workers_.load();
+  while (num_active < num_workers_) {
+    if (num_active_workers_.compare_exchange_weak(num_active,
+                                                  num_active + 1)) {
+      num_outstanding_ops_.fetch_add(1, std::memory_order_relaxed);
+      RunTask([this, scheduled_nsec]() { RunWorker(scheduled_nsec); });
+      return;
+    }
+  }
+}
+
+template <class PropagatorStateType>
+bool ExecutorState<PropagatorStateType>::PopReadyNode(
+    int worker, TaggedNodeReadyQueue* inline_ready) {
+  if (num_queued_nodes_.load(std::memory_order_relaxed) == 0) return false;
+  for (int i = 0; i < num_workers_; ++i) {
+    const bool own = i == 0;
+    WorkerQueue& queue = worker_queues_[(worker + i) % num_workers_];
+    mutex_lock l(queue.mu);
+    if (queue.head == queue.nodes.size()) continue;
+    if (own) {
+      inline_ready->push_back(queue.nodes.back());
+      queue.nodes.pop_back();
+    } else {
+      inline_ready->push_back(queue.nodes[queue.head++]);
+    }
+    if (queue.head == queue.nodes.size()) {
+      queue.nodes.clear();
+      queue.head = 0;
+    }
+    num_queued_nodes_.fetch_sub(1);
+    return true;
+  }
+  return false;
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::RunWorker(int64 scheduled_nsec) {
+  const int worker = next_worker_++ % num_workers_;
+  TaggedNodeReadyQueue inline_ready;
+  while (true) {
+    while (PopReadyNode(worker, &inline_ready)) {
+      const TaggedNode tagged_node = inline_ready.front();
+      inline_ready.pop_front();
+      Process(tagged_node, scheduled_nsec, worker);
+    }
+    // Retire, unless a node was queued after the last look and no other
+    // worker is left to run it.
+    int num_active = num_active_workers_.fetch_sub(1) - 1;
+    bool resumed = false;
+    while (num_queued_nodes_.load() > 0 && num_active < num_workers_) {
+      if (num_active_workers_.compare_exchange_weak(num_active,
+                                                    num_active + 1)) {
+        resumed = true;
+        break;
+      }
+    }
+    if (!resumed) break;
+  }
+  if (num_outstanding_ops_.fetch_sub(1) == 1) ScheduleFinish();
+}
+
 template <class PropagatorStateType>
 void ExecutorState<PropagatorStateType>::ScheduleFinish() {
   // Checks condition to decide if needs to invoke Finish(). If there are
@@ -1338,20 +1514,24 @@ void ExecutorState<PropagatorStateType>::Finish() {
 
 void ExecutorImpl::RunAsync(const Args& args, DoneCallback done) {
   if (immutable_state_.requires_control_flow_support()) {
-    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_))
+    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_,
+                                        work_stealing_))
         ->RunAsync(std::move(done));
   } else {
-    (new ExecutorState<SimplePropagatorState>(args, immutable_state_,
-                                              &kernel_stats_))
+    (new ExecutorState<SimplePropagatorState>(
+         args, immutable_state_, &kernel_stats_, work_stealing_))
         ->RunAsync(std::move(done));
   }
 }
 
 }  // namespace
 
-Status NewLocalExecutor(const LocalExecutorParams& params, const Graph& graph,
-                        Executor** executor) {
-  ExecutorImpl* impl = new ExecutorImpl(params);
+namespace {
+
+Status NewLocalExecutorImpl(const LocalExecutorParams& params,
+                            const Graph& graph, bool work_stealing,
+                            Executor** executor) {
+  ExecutorImpl* impl = new ExecutorImpl(params, work_stealing);
   const Status s = impl->Initialize(graph);
   if (s.ok()) {
     *executor = impl;
@@ -1361,6 +1541,14 @@ Status NewLocalExecutor(const LocalExecutorParams& params, const Graph& graph,
   return s;
 }
 
+}  // namespace
+
+Status NewLocalExecutor(const LocalExecutorParams& params, const Graph& graph,
+                        Executor** executor) {
+  return NewLocalExecutorImpl(params, graph, /*work_stealing=*/false,
+                              executor);
+}
+
 Status CreateNonCachedKernel(Device* device, FunctionLibraryRuntime* flib,
                              const std::shared_ptr<const NodeProperties>& props,
                              int graph_def_version, OpKernel** kernel) {
@@ -1378,20 +1566,29 @@ namespace {
 class DefaultExecutorRegistrar {
  public:
   DefaultExecutorRegistrar() {
-    Factory* factory = new Factory;
+    Factory* factory = new Factory(/*work_stealing=*/false);
     ExecutorFactory::Register("", factory);
     ExecutorFactory::Register("DEFAULT", factory);
+    ExecutorFactory::Register("WORK_STEALING",
+                              new Factory(/*work_stealing=*/true));
   }
 
  private:
   class Factory : public ExecutorFactory {
+   public:
+    explicit Factory(bool work_stealing) : work_stealing_(work_stealing) {}
+
     Status NewExecutor(const LocalExecutorParams& params, const Graph& graph,
                        std::unique_ptr<Executor>* out_executor) override {
       Executor* ret = nullptr;
-      TF_RETURN_IF_ERROR(NewLocalExecutor(params, std::move(graph), &ret));
+      TF_RETURN_IF_ERROR(NewLocalExecutorImpl(params, std::move(graph),
+                                              work_stealing_, &ret));
       out_executor->reset(ret);
       return Status::OK();
     }
+
+   private:
+    const bool work_stealing_;
   };
 };
 static DefaultExecutorRegistrar registrar;
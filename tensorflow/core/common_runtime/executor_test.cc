@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
 #include "tensorflow/core/common_runtime/graph_constructor.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/common_runtime/lower_functional_ops.h"
@@ -67,7 +68,8 @@ class ExecutorTest : public ::testing::Test {
   }
 
   // Resets executor_ with a new executor based on a graph 'gdef'.
-  void Create(std::unique_ptr<const Graph> graph) {
+  void Create(std::unique_ptr<const Graph> graph,
+              const string& executor_type = "") {
     const int version = graph->versions().producer();
     LocalExecutorParams params;
     params.device = device_.get();
@@ -82,7 +84,9 @@ class ExecutorTest : public ::testing::Test {
     };
     rendez_ = NewLocalRendezvous();
     delete exec_;
-    TF_CHECK_OK(NewLocalExecutor(params, *graph, &exec_));
+    std::unique_ptr<Executor> exec;
+    TF_CHECK_OK(NewExecutor(executor_type, params, *graph, &exec));
+    exec_ = exec.release();
     runner_ = [this](std::function<void()> fn) { thread_pool_->Schedule(fn); };
   }
 
@@ -255,6 +259,23 @@ TEST_F(ExecutorTest, RandomTree) {
   EXPECT_EQ(4096.0, V(out));
 }
 
+TEST_F(ExecutorTest, WorkStealingRandomTree) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  Create(std::move(g), "WORK_STEALING");
+  for (int iters = 0; iters < 8; ++iters) {
+    Rendezvous::Args args;
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(4096.0, V(out));
+  }
+}
+
 void BuildConcurrentAddAssign(Graph* g) {
   auto one = test::graph::Constant(g, V(1.0));
   // A variable holds one float.
@@ -292,6 +313,25 @@ TEST_F(ExecutorTest, ConcurrentAddAssign) {
 }
 #endif
 
+#ifndef THREAD_SANITIZER
+TEST_F(ExecutorTest, WorkStealingConcurrentAddAssign) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  BuildConcurrentAddAssign(g.get());
+  Create(std::move(g), "WORK_STEALING");
+  for (int iters = 0; iters < 16; ++iters) {
+    Rendezvous* rendez = NewLocalRendezvous();
+    TF_ASSERT_OK(Run(rendez));
+    Rendezvous::Args args;
+    Tensor out;
+    bool is_dead;
+    TF_ASSERT_OK(rendez->Recv(Key(ALICE, kIncarnation, BOB, "out"), args, &out,
+                              &is_dead));
+    EXPECT_LE(V(out), 1025.0);
+    rendez->Unref();
+  }
+}
+#endif
+
 TEST_F(ExecutorTest, SimpleSwitchLive) {
   auto g = absl::make_unique<Graph>(OpRegistry::Global());
   auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
@@ -484,6 +524,55 @@ BENCHMARK(BM_executor)->UseRealTime()->ArgPair(8192, 32);
 // Tall fat graph
 BENCHMARK(BM_executor)->UseRealTime()->ArgPair(1024, 1024);
 
+// Create a graph of 'width' independent chains, each 'depth' element-wise
+// additions long, on tensors large enough that the additions are expensive and
+// scheduled rather than run inline.
+static void BM_WideDeepHelper(::testing::benchmark::State& state,
+                              const char* executor_type) {
+  const int width = state.range(0);
+  const int depth = state.range(1);
+
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor t(DT_FLOAT, TensorShape({16 << 10}));
+  t.flat<float>().setConstant(1.0f);
+  Node* c = test::graph::Constant(g, t);
+  for (int i = 0; i < width; ++i) {
+    Node* v = c;
+    for (int j = 0; j < depth; ++j) {
+      v = test::graph::Add(g, v, c);
+    }
+  }
+  FixupSourceAndSinkEdges(g);
+  test::Benchmark("cpu", g, /*options=*/nullptr, /*init=*/nullptr,
+                  /*rendez=*/nullptr, executor_type,
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetLabel(strings::StrCat("Nodes = ", 1 + width * depth));
+  state.SetItemsProcessed(static_cast<int64>(state.iterations()) * width *
+                          depth);
+}
+
+static void BM_WideDeepDefaultExecutor(::testing::benchmark::State& state) {
+  BM_WideDeepHelper(state, "");
+}
+
+static void BM_WideDeepWorkStealingExecutor(
+    ::testing::benchmark::State& state) {
+  BM_WideDeepHelper(state, "WORK_STEALING");
+}
+
+// Wide, deep, and both.
+BENCHMARK(BM_WideDeepDefaultExecutor)
+    ->UseRealTime()
+    ->ArgPair(1024, 1)
+    ->ArgPair(4, 256)
+    ->ArgPair(64, 64);
+BENCHMARK(BM_WideDeepWorkStealingExecutor)
+    ->UseRealTime()
+    ->ArgPair(1024, 1)
+    ->ArgPair(4, 256)
+    ->ArgPair(64, 64);
+
 static void BM_const_identity(::testing::benchmark::State& state) {
   const int width = state.range(0);
   const int outputs_per_const = state.range(1);
@@ -257,10 +257,17 @@ Allocator* GPUProcessState::GetGpuHostAllocator(int numa_node) {
       LOG(ERROR) << "GetGpuHostAllocator: " << status.error_message();
     }
     int64 gpu_host_mem_limit = gpu_host_mem_limit_in_mb * (1LL << 20);
+    bool use_thread_cache = false;
+    status = ReadBoolFromEnvVar("TF_GPU_HOST_ENABLE_THREAD_CACHE",
+                                /*default_val=*/false, &use_thread_cache);
+    if (!status.ok()) {
+      LOG(ERROR) << "GetGpuHostAllocator: " << status.error_message();
+    }
 
-    Allocator* allocator =
-        new BFCAllocator(sub_allocator, gpu_host_mem_limit,
-                         /*allow_growth=*/true, /*name=*/"gpu_host_bfc");
+    Allocator* allocator = new BFCAllocator(
+        sub_allocator, gpu_host_mem_limit, /*allow_growth=*/true,
+        /*name=*/"gpu_host_bfc", /*garbage_collection=*/false,
+        use_thread_cache);
 
     if (LogMemory::IsEnabled() && !allocator->TracksAllocationSizes()) {
       // Wrap the allocator to track allocation ids for better logging
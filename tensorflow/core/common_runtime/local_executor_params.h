@@ -28,6 +28,7 @@ class FunctionLibraryRuntime;
 class NodeProperties;
 class OpKernel;
 class Status;
+class TensorArenaPlan;
 
 // LocalExecutorParams provides arguments that will be shared by all invocations
 // of an executor. We expect that different contexts would provide different
@@ -47,6 +48,10 @@ struct LocalExecutorParams {
                        OpKernel**)>
       create_kernel;
   std::function<void(OpKernel*)> delete_kernel;
+
+  // If non-null, the executor serves node outputs from a per-step arena laid
+  // out by this plan. Not owned; must outlive the executor.
+  const TensorArenaPlan* arena_plan = nullptr;
 };
 
 }  // end namespace tensorflow
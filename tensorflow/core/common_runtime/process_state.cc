@@ -99,10 +99,19 @@ Allocator* ProcessState::GetCPUAllocator(int numa_node) {
         LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
       }
       int64 cpu_mem_limit = cpu_mem_limit_in_mb * (1LL << 20);
+      // Serve small host allocations from per-thread free lists instead of
+      // taking the allocator lock for every request.
+      bool use_thread_cache = false;
+      status = ReadBoolFromEnvVar("TF_CPU_BFC_ENABLE_THREAD_CACHE",
+                                  /*default_val=*/false, &use_thread_cache);
+      if (!status.ok()) {
+        LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
+      }
       DCHECK(sub_allocator);
       allocator =
           new BFCAllocator(sub_allocator, cpu_mem_limit, /*allow_growth=*/true,
-                           /*name=*/"bfc_cpu_allocator_for_gpu");
+                           /*name=*/"bfc_cpu_allocator_for_gpu",
+                           /*garbage_collection=*/false, use_thread_cache);
       VLOG(2) << "Using BFCAllocator with memory limit of "
               << cpu_mem_limit_in_mb << " MB for ProcessState CPU allocator";
     } else if (sub_allocator) {
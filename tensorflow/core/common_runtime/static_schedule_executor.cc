@@ -0,0 +1,767 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_schedule_executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/entry.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
+#include "tensorflow/core/common_runtime/graph_view.h"
+#include "tensorflow/core/common_runtime/immutable_executor_state.h"
+#include "tensorflow/core/common_runtime/renamed_device.h"
+#include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/tensor_slice_reader_cache.h"
+
+namespace tensorflow {
+namespace {
+
+typedef gtl::InlinedVector<TensorValue, 4> TensorValueVec;
+typedef gtl::InlinedVector<AllocatorAttributes, 4> AllocatorAttributeVec;
+
+static const string& kStaticScheduleExecutor =
+    *new string("STATIC_SCHEDULE_EXECUTOR");
+
+// Estimated costs used by the scheduler, in units of one inexpensive kernel.
+// Kernels that report `OpKernel::IsExpensive()` are assumed to be an order of
+// magnitude more costly, and handing a value to another thread is assumed to
+// cost about as much as a few inexpensive kernels.
+constexpr int64 kInexpensiveNodeCost = 1;
+constexpr int64 kExpensiveNodeCost = 16;
+constexpr int64 kCrossThreadEdgeCost = 4;
+
+class StaticScheduleExecutorImpl : public Executor {
+ public:
+  explicit StaticScheduleExecutorImpl(const LocalExecutorParams& params)
+      : immutable_state_(params) {}
+
+  Status Initialize(const Graph& graph);
+
+  void RunAsync(const Args& args, DoneCallback done) override;
+
+ private:
+  class RunState;
+
+  ImmutableExecutorState immutable_state_;
+
+  // All following members are read-only after Initialize().
+
+  // `schedule_[t]` contains the IDs of the nodes run by thread `t`, in the
+  // order in which they run. Each list is in topological order.
+  std::vector<std::vector<int32>> schedule_;
+
+  // For each node ID, the thread that runs the node and the index of the node
+  // in `schedule_[thread_of_[id]]`. Unused IDs map to -1.
+  std::vector<int32> thread_of_;
+  std::vector<int32> position_of_;
+
+  // For each node ID, zero if all of the node's producers run on the same
+  // thread as the node. Otherwise, the number of in-edges from other threads
+  // plus one for the arrival of the node's own thread; the node may run once
+  // the per-step counter initialized from this value reaches zero.
+  std::vector<int32> initial_pending_;
+};
+
+Status StaticScheduleExecutorImpl::Initialize(const Graph& graph) {
+  TF_RETURN_IF_ERROR(immutable_state_.Initialize(graph));
+  if (immutable_state_.requires_control_flow_support()) {
+    return errors::FailedPrecondition(
+        "Static-schedule executor does not support low level control flow. "
+        "Perhaps your graph contains old-style control flow primitives? Try "
+        "using tf.compat.v1.enable_control_flow_v2().");
+  }
+
+  const GraphView& gview = immutable_state_.graph_view();
+  const int32 num_nodes = gview.num_nodes();
+
+  // Collect the nodes to run, and the predecessors and successors of each
+  // node. Data and control edges are treated alike; a node appears once per
+  // edge. The sink node is never run by the executor.
+  std::vector<int32> nodes;
+  nodes.reserve(graph.num_nodes());
+  std::vector<std::vector<int32>> preds(num_nodes);
+  std::vector<std::vector<int32>> succs(num_nodes);
+  for (const Node* n : graph.nodes()) {
+    if (n->IsSink()) continue;
+    const NodeItem& item = gview.node_ref(n->id());
+    if (item.kernel_is_async) {
+      return errors::Unimplemented(
+          "Static-schedule executor does not support asynchronous kernels. "
+          "But saw node ",
+          n->name(), " of type ", n->type_string());
+    }
+    bool has_ref_output = false;
+    for (int i = 0; i < item.num_outputs; ++i) {
+      has_ref_output |= IsRefType(item.output_type(i));
+    }
+    if (item.is_any_input_ref_typed || has_ref_output) {
+      return errors::Unimplemented(
+          "Static-schedule executor does not support reference-typed edges. "
+          "But saw node ",
+          n->name(), " of type ", n->type_string());
+    }
+    nodes.push_back(item.node_id);
+    for (const EdgeInfo& e : item.output_edges()) {
+      succs[item.node_id].push_back(e.dst_id);
+      preds[e.dst_id].push_back(item.node_id);
+    }
+    for (const ControlEdgeInfo& e : item.output_control_edges()) {
+      succs[item.node_id].push_back(e.dst_id);
+      preds[e.dst_id].push_back(item.node_id);
+    }
+  }
+
+  // Compute a topological order, then the cost of the most expensive path
+  // from each node to the end of the graph (its "bottom level"), which is the
+  // scheduling priority.
+  std::vector<int32> num_remaining(num_nodes, 0);
+  std::vector<int32> order;
+  order.reserve(nodes.size());
+  for (int32 id : nodes) {
+    num_remaining[id] = preds[id].size();
+    if (num_remaining[id] == 0) order.push_back(id);
+  }
+  for (size_t i = 0; i < order.size(); ++i) {
+    for (int32 dst : succs[order[i]]) {
+      if (--num_remaining[dst] == 0) order.push_back(dst);
+    }
+  }
+  if (order.size() != nodes.size()) {
+    return errors::InvalidArgument("Graph had ", nodes.size(),
+                                   " nodes but topological order had ",
+                                   order.size());
+  }
+
+  std::vector<int64> cost(num_nodes, 0);
+  std::vector<int64> bottom_level(num_nodes, 0);
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    const NodeItem& item = gview.node_ref(*it);
+    cost[*it] = item.kernel->IsExpensive() ? kExpensiveNodeCost
+                                           : kInexpensiveNodeCost;
+    int64 longest_tail = 0;
+    for (int32 dst : succs[*it]) {
+      longest_tail =
+          std::max(longest_tail, bottom_level[dst] + kCrossThreadEdgeCost);
+    }
+    bottom_level[*it] = cost[*it] + longest_tail;
+  }
+
+  // List scheduling. Ready nodes are taken in decreasing order of bottom
+  // level, and each is appended to the thread on which it can start earliest
+  // given the estimated finish times of its producers.
+  const int max_threads = std::max(port::MaxParallelism(), 1);
+  std::vector<std::vector<int32>> schedule(max_threads);
+  std::vector<int64> thread_ready(max_threads, 0);
+  std::vector<int64> finish(num_nodes, 0);
+  std::vector<int32> thread_of(num_nodes, -1);
+
+  // Scratch space: the latest finish time of a node's producers on each
+  // thread, valid for the threads in `producer_threads`.
+  std::vector<int64> local_ready(max_threads, -1);
+  std::vector<int> producer_threads;
+
+  auto lower_priority = [&bottom_level](int32 a, int32 b) {
+    return bottom_level[a] < bottom_level[b] ||
+           (bottom_level[a] == bottom_level[b] && a > b);
+  };
+  std::priority_queue<int32, std::vector<int32>, decltype(lower_priority)>
+      ready(lower_priority);
+  for (int32 id : nodes) {
+    num_remaining[id] = preds[id].size();
+    if (num_remaining[id] == 0) ready.push(id);
+  }
+  while (!ready.empty()) {
+    const int32 id = ready.top();
+    ready.pop();
+
+    // Track the two largest "remote" ready times on distinct threads, so that
+    // the time at which every producer not on thread `t` has delivered its
+    // value is available in constant time for each `t`.
+    int64 remote_ready_1 = 0;
+    int remote_thread_1 = -1;
+    int64 remote_ready_2 = 0;
+    for (int32 p : preds[id]) {
+      const int t = thread_of[p];
+      if (local_ready[t] < 0) producer_threads.push_back(t);
+      local_ready[t] = std::max(local_ready[t], finish[p]);
+    }
+    for (int t : producer_threads) {
+      const int64 remote = local_ready[t] + kCrossThreadEdgeCost;
+      if (remote > remote_ready_1) {
+        if (remote_thread_1 != t) remote_ready_2 = remote_ready_1;
+        remote_ready_1 = remote;
+        remote_thread_1 = t;
+      } else if (remote > remote_ready_2 && t != remote_thread_1) {
+        remote_ready_2 = remote;
+      }
+    }
+    auto start_time = [&](int t) {
+      int64 start = std::max(thread_ready[t],
+                             t == remote_thread_1 ? remote_ready_2
+                                                  : remote_ready_1);
+      if (local_ready[t] >= 0) start = std::max(start, local_ready[t]);
+      return start;
+    };
+
+    // Candidates are the earliest available thread, and every thread that
+    // runs a producer. Ties go to a producer's thread.
+    int best_thread = static_cast<int>(
+        std::min_element(thread_ready.begin(), thread_ready.end()) -
+        thread_ready.begin());
+    int64 best_start = start_time(best_thread);
+    for (int t : producer_threads) {
+      const int64 start = start_time(t);
+      if (start <= best_start) {
+        best_start = start;
+        best_thread = t;
+      }
+      local_ready[t] = -1;
+    }
+    producer_threads.clear();
+
+    thread_of[id] = best_thread;
+    finish[id] = best_start + cost[id];
+    thread_ready[best_thread] = finish[id];
+    schedule[best_thread].push_back(id);
+    for (int32 dst : succs[id]) {
+      if (--num_remaining[dst] == 0) ready.push(dst);
+    }
+  }
+
+  // Drop the threads that were not given any work.
+  std::vector<int32> thread_index(max_threads, -1);
+  for (int t = 0; t < max_threads; ++t) {
+    if (schedule[t].empty()) continue;
+    thread_index[t] = schedule_.size();
+    schedule_.push_back(std::move(schedule[t]));
+  }
+  thread_of_.assign(num_nodes, -1);
+  position_of_.assign(num_nodes, -1);
+  for (size_t t = 0; t < schedule_.size(); ++t) {
+    for (size_t i = 0; i < schedule_[t].size(); ++i) {
+      thread_of_[schedule_[t][i]] = t;
+      position_of_[schedule_[t][i]] = i;
+    }
+  }
+  initial_pending_.assign(num_nodes, 0);
+  for (int32 id : nodes) {
+    int32 num_remote_inputs = 0;
+    for (int32 p : preds[id]) {
+      if (thread_of_[p] != thread_of_[id]) ++num_remote_inputs;
+    }
+    if (num_remote_inputs > 0) initial_pending_[id] = num_remote_inputs + 1;
+  }
+  VLOG(1) << "Static-schedule executor placed " << nodes.size()
+          << " nodes on " << schedule_.size() << " threads.";
+  return Status::OK();
+}
+
+// The state of one step. Deletes itself after invoking the done callback.
+//
+// Each scheduled thread is a continuation rather than an OS thread: a closure
+// runs the thread's nodes in order until it reaches a node whose inputs from
+// other threads are not all available. It then "parks" by returning, and the
+// closure that delivers the last missing input resumes the thread at that
+// node. Consequently no closure ever blocks, and the executor is safe to use
+// with inline or small runners.
+class StaticScheduleExecutorImpl::RunState {
+ public:
+  RunState(const StaticScheduleExecutorImpl* impl, const Args& args,
+           DoneCallback done);
+  ~RunState();
+
+  void Start();
+
+ private:
+  // Runs the nodes of scheduled thread `thread`, starting with the node at
+  // `position`, whose inputs must be available.
+  void RunThread(int32 thread, int32 position);
+
+  Status PrepareInputs(const NodeItem& item, Entry* first_input,
+                       TensorValueVec* inputs,
+                       AllocatorAttributeVec* input_alloc_attrs);
+  Status ProcessOutputs(const NodeItem& item, OpKernelContext* ctx,
+                        Entry* outputs, NodeExecStatsInterface* stats);
+
+  // Delivers the outputs of `item`, which ran on `thread`, to its consumers,
+  // and appends the IDs of nodes on other threads that can now run to
+  // `resumed`.
+  void PropagateOutputs(const NodeItem& item, int32 thread,
+                        EntryVector* outputs, std::vector<int32>* resumed);
+
+  void Abort(const Status& s);
+  void Finish();
+
+  const StaticScheduleExecutorImpl* const impl_;
+  const int64 step_id_;
+  RendezvousInterface* const rendezvous_;
+  CollectiveExecutor* const collective_executor_;
+  SessionState* const session_state_;
+  const string session_handle_;
+  TensorStore* const tensor_store_;
+  ScopedStepContainer* const step_container_;
+  StepStatsCollectorInterface* const stats_collector_;
+  CallFrameInterface* const call_frame_;
+  CancellationManager* const cancellation_manager_;
+  std::unique_ptr<Device> user_device_;
+  checkpoint::TensorSliceReaderCacheWrapper* const slice_reader_cache_;
+  Executor::Args::Runner runner_;
+  const bool sync_on_finish_;
+  const bool run_all_kernels_inline_;
+  DeviceContext* device_context_ = nullptr;
+  DoneCallback done_;
+
+  // The inputs of all nodes, indexed by `NodeItem::input_start`.
+  std::vector<Entry> inputs_;
+
+  // Per-node counters of undelivered inputs from other threads. Only the
+  // entries with a non-zero `impl_->initial_pending_` are used.
+  std::unique_ptr<std::atomic<int32>[]> pending_;
+
+  // The number of scheduled threads that have not yet reached the end of
+  // their schedule. The closure that decrements this to zero finishes the
+  // step.
+  std::atomic<int32> num_running_threads_;
+
+  // Set after the first error. Nodes that have not yet started are then
+  // skipped, but still release their consumers, so that every thread reaches
+  // the end of its schedule.
+  std::atomic<bool> aborted_{false};
+
+  mutex mu_;
+  Status status_ TF_GUARDED_BY(mu_);
+};
+
+StaticScheduleExecutorImpl::RunState::RunState(
+    const StaticScheduleExecutorImpl* impl, const Args& args,
+    DoneCallback done)
+    : impl_(impl),
+      step_id_(args.step_id),
+      rendezvous_(args.rendezvous),
+      collective_executor_(args.collective_executor),
+      session_state_(args.session_state),
+      session_handle_(args.session_handle),
+      tensor_store_(args.tensor_store),
+      step_container_(args.step_container),
+      stats_collector_(args.stats_collector),
+      call_frame_(args.call_frame),
+      cancellation_manager_(args.cancellation_manager),
+      slice_reader_cache_(new checkpoint::TensorSliceReaderCacheWrapper),
+      runner_(args.runner),
+      sync_on_finish_(args.sync_on_finish),
+      run_all_kernels_inline_(args.run_all_kernels_inline),
+      done_(std::move(done)),
+      inputs_(impl->immutable_state_.get_root_frame_info().total_inputs),
+      pending_(new std::atomic<int32>[impl->initial_pending_.size()]),
+      num_running_threads_(impl->schedule_.size()) {
+  if (args.user_intra_op_threadpool != nullptr) {
+    Device* device = impl_->immutable_state_.params().device;
+    user_device_ = RenamedDevice::NewRenamedDevice(
+        device->name(), device, false, false, args.user_intra_op_threadpool);
+  }
+  const std::vector<int32>& initial_pending = impl_->initial_pending_;
+  for (size_t id = 0; id < initial_pending.size(); ++id) {
+    pending_[id].store(initial_pending[id], std::memory_order_relaxed);
+  }
+}
+
+StaticScheduleExecutorImpl::RunState::~RunState() {
+  if (device_context_) {
+    device_context_->Unref();
+  }
+  delete slice_reader_cache_;
+}
+
+void StaticScheduleExecutorImpl::RunState::Start() {
+  Device* device = impl_->immutable_state_.params().device;
+  const Status get_context_status =
+      device->TryGetDeviceContext(&device_context_);
+  if (!get_context_status.ok() || impl_->schedule_.empty()) {
+    DoneCallback done = std::move(done_);
+    delete this;
+    done(get_context_status);
+    return;
+  }
+
+  // A thread whose first node has inputs from other threads records its
+  // arrival now; the producer of the last such input will start it. No
+  // closure is running yet, so the counters cannot reach zero here.
+  std::vector<int32> ready_threads;
+  for (size_t t = 0; t < impl_->schedule_.size(); ++t) {
+    const int32 id = impl_->schedule_[t].front();
+    if (impl_->initial_pending_[id] != 0) {
+      pending_[id].fetch_sub(1, std::memory_order_relaxed);
+    } else {
+      ready_threads.push_back(t);
+    }
+  }
+  // The first node in topological order has no inputs, so at least one
+  // thread is ready.
+  DCHECK(!ready_threads.empty());
+  for (size_t i = 1; i < ready_threads.size(); ++i) {
+    const int32 thread = ready_threads[i];
+    runner_([this, thread]() { RunThread(thread, 0); });
+  }
+  RunThread(ready_threads[0], 0);
+}
+
+void StaticScheduleExecutorImpl::RunState::RunThread(int32 thread,
+                                                     int32 position) {
+  const GraphView& gview = impl_->immutable_state_.graph_view();
+  Device* device = impl_->immutable_state_.params().device;
+
+  // Parameters passed to OpKernel::Compute.
+  TensorValueVec inputs;
+  AllocatorAttributeVec input_alloc_attrs;
+
+  OpKernelContext::Params params;
+  params.step_id = step_id_;
+  // Override device's threadpool if user provides an intra_op_threadpool
+  if (user_device_) {
+    params.device = user_device_.get();
+  } else {
+    params.device = device;
+  }
+  params.log_memory = false;
+  params.rendezvous = rendezvous_;
+  params.collective_executor = collective_executor_;
+  params.session_state = session_state_;
+  params.session_handle = session_handle_;
+  params.session_metadata = impl_->immutable_state_.params().session_metadata;
+  params.tensor_store = tensor_store_;
+  params.cancellation_manager = cancellation_manager_;
+  params.call_frame = call_frame_;
+  params.function_library = impl_->immutable_state_.params().function_library;
+  params.resource_manager = device->resource_manager();
+  params.step_container = step_container_;
+  params.slice_reader_cache = slice_reader_cache_;
+  params.inputs = &inputs;
+  params.input_alloc_attrs = &input_alloc_attrs;
+  params.runner = &runner_;
+  params.run_all_kernels_inline = run_all_kernels_inline_;
+  params.stats_collector = stats_collector_;
+  params.op_device_context = device_context_;
+  params.executor_type = &kStaticScheduleExecutor;
+  // NOTE: The graph has no control flow, so every node runs in the root frame
+  // and no input is dead.
+  params.frame_iter = FrameAndIter(0, 0);
+  params.is_input_dead = false;
+
+  EntryVector outputs;
+  std::vector<int32> resumed;
+  // Threads resumed by this closure that it will run itself.
+  std::deque<int32> inline_resumed;
+
+  while (true) {
+    const std::vector<int32>& schedule = impl_->schedule_[thread];
+    const int32 end = schedule.size();
+    bool parked = false;
+    for (bool first = true; position < end; ++position, first = false) {
+      const int32 id = schedule[position];
+      if (!first && impl_->initial_pending_[id] != 0 &&
+          pending_[id].fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        // The producer of the last missing input resumes this thread.
+        parked = true;
+        break;
+      }
+
+      const NodeItem& item = gview.node_ref(id);
+      Entry* first_input = inputs_.data() + item.input_start;
+      outputs.resize(item.num_outputs);
+      if (!aborted_.load(std::memory_order_relaxed)) {
+        params.track_allocations = false;
+        NodeExecStatsInterface* stats = nullptr;
+        if (stats_collector_) {
+          stats = stats_collector_->CreateNodeExecStats(&item.kernel->def());
+          params.track_allocations = stats ? stats->TrackAllocations() : false;
+          if (stats) stats->RecordExecutorStarted();
+        }
+
+        Status s;
+        if (item.is_noop) {
+          // Nothing to compute.
+        } else if (item.const_tensor != nullptr && !params.track_allocations) {
+          Entry& output = outputs[0];
+          output.state = Entry::State::HAS_CONST_TENSOR;
+          output.const_tensor = item.const_tensor;
+          output.alloc_attr = item.output_attrs()[0];
+        } else {
+          s = PrepareInputs(item, first_input, &inputs, &input_alloc_attrs);
+          if (s.ok()) {
+            params.op_kernel = item.kernel;
+            params.output_attr_array = item.output_attrs();
+            params.forward_from_array = item.forward_from();
+            params.outputs_required_array = item.outputs_required.get();
+            OpKernelContext ctx(&params, item.num_outputs);
+            if (stats) stats->RecordComputeStarted();
+            device->Compute(item.kernel, &ctx);
+            if (stats) stats->RecordComputeEnded();
+            s = ProcessOutputs(item, &ctx, outputs.data(), stats);
+            if (stats) stats->SetMemory(&ctx);
+          }
+        }
+        if (stats) {
+          stats->RecordExecutorEnded();
+          stats->Done(device->name());
+        }
+        if (!s.ok()) Abort(s);
+      }
+
+      // Clears inputs.
+      for (int i = 0; i < item.num_inputs; ++i) {
+        first_input[i].ClearVal();
+      }
+      PropagateOutputs(item, thread, &outputs, &resumed);
+      for (Entry& output : outputs) {
+        output.ClearVal();
+      }
+
+      // Resumed threads run in parallel with this one, except that when this
+      // thread has no more work, it continues with one of them directly.
+      const bool last = position + 1 == end;
+      for (size_t i = 0; i < resumed.size(); ++i) {
+        const int32 resumed_thread = impl_->thread_of_[resumed[i]];
+        if (run_all_kernels_inline_ || (last && i == 0)) {
+          inline_resumed.push_back(resumed[i]);
+        } else {
+          const int32 resumed_position = impl_->position_of_[resumed[i]];
+          runner_([this, resumed_thread, resumed_position]() {
+            RunThread(resumed_thread, resumed_position);
+          });
+        }
+      }
+      resumed.clear();
+    }
+
+    // NOTE: Any thread in `inline_resumed` keeps the step alive. Otherwise,
+    // once this thread has parked or finished, the step may complete (and
+    // `this` be deleted) at any time.
+    if (!parked) {
+      if (num_running_threads_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        DCHECK(inline_resumed.empty());
+        Finish();
+        return;
+      }
+    }
+    if (inline_resumed.empty()) return;
+    const int32 id = inline_resumed.front();
+    inline_resumed.pop_front();
+    thread = impl_->thread_of_[id];
+    position = impl_->position_of_[id];
+  }
+}
+
+Status StaticScheduleExecutorImpl::RunState::PrepareInputs(
+    const NodeItem& item, Entry* first_input, TensorValueVec* inputs,
+    AllocatorAttributeVec* input_alloc_attrs) {
+  inputs->clear();
+  inputs->resize(item.num_inputs);
+  input_alloc_attrs->clear();
+  input_alloc_attrs->resize(item.num_inputs);
+  for (int i = 0; i < item.num_inputs; ++i) {
+    Entry* entry = first_input + i;
+    (*input_alloc_attrs)[i] = entry->alloc_attr;
+    TensorValue* inp = &(*inputs)[i];
+    switch (entry->state) {
+      case Entry::State::HAS_VALUE:
+        inp->tensor = entry->val.get();
+        break;
+      case Entry::State::HAS_CONST_TENSOR:
+        // NOTE(mrry): This `const_cast` is necessary because `TensorValue`
+        // stores a non-const `Tensor*`, and relies on the `OpKernelContext`
+        // accessors making dynamic checks that prevent using an immutable
+        // tensor as a mutable tensor.
+        inp->tensor = const_cast<Tensor*>(entry->const_tensor);
+        break;
+      default:
+        return AttachDef(errors::Internal("Missing ", i, "-th input"),
+                         item.kernel->def());
+    }
+  }
+  return Status::OK();
+}
+
+Status StaticScheduleExecutorImpl::RunState::ProcessOutputs(
+    const NodeItem& item, OpKernelContext* ctx, Entry* outputs,
+    NodeExecStatsInterface* stats) {
+  Status s = ctx->status();
+  if (!s.ok()) {
+    s = AttachDef(s, item.kernel->def());
+    if (s.code() == error::RESOURCE_EXHAUSTED) {
+      if (stats_collector_) {
+        string err = stats_collector_->ReportAllocsOnResourceExhausted(
+            s.error_message());
+        s = Status(s.code(), strings::StrCat(s.error_message(), err));
+      } else {
+        s = Status(
+            s.code(),
+            strings::StrCat(
+                s.error_message(),
+                "\nHint: If you want to see a list of allocated tensors when "
+                "OOM happens, add report_tensor_allocations_upon_oom "
+                "to RunOptions for current allocation info.\n"));
+      }
+    }
+    return s;
+  }
+
+  for (int i = 0; i < item.num_outputs; ++i) {
+    const TensorValue val = ctx->release_output(i);
+    Entry* out = &outputs[i];
+    DCHECK(out->state == Entry::State::NO_VALUE);
+
+    if (val.tensor == nullptr) {
+      // Unless the executor has marked the output as not required, the node
+      // must produce a tensor value at i-th output.
+      if (!(item.outputs_required && !item.outputs_required[i])) {
+        s.Update(errors::Internal("Missing ", i, "-th output from ",
+                                  FormatNodeDefForError(item.kernel->def())));
+      }
+    } else {
+      out->alloc_attr = ctx->output_alloc_attr(i);
+      DataType dtype = val.dtype_safe();
+      if (dtype == item.output_type(i)) {
+        if (stats && val.tensor->IsInitialized()) {
+          stats->SetOutput(i, val.tensor);
+        }
+        out->state = Entry::State::HAS_VALUE;
+        out->val.Init(std::move(*val.tensor));
+      } else {
+        s.Update(
+            errors::Internal("Output ", i, " of type ", DataTypeString(dtype),
+                             " does not match declared output type ",
+                             DataTypeString(item.output_type(i)), " for node ",
+                             FormatNodeDefForError(item.kernel->def())));
+      }
+      delete val.tensor;
+    }
+  }
+  return s;
+}
+
+void StaticScheduleExecutorImpl::RunState::PropagateOutputs(
+    const NodeItem& item, int32 thread, EntryVector* outputs,
+    std::vector<int32>* resumed) {
+  const std::vector<int32>& thread_of = impl_->thread_of_;
+  // The consumer's input must be written before its counter is decremented.
+  for (const EdgeInfo& e : item.output_edges()) {
+    Entry& input = inputs_[e.input_slot];
+    if (e.is_last) {
+      input = std::move((*outputs)[e.output_slot]);
+    } else {
+      input = (*outputs)[e.output_slot];
+    }
+    if (thread_of[e.dst_id] != thread &&
+        pending_[e.dst_id].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      resumed->push_back(e.dst_id);
+    }
+  }
+  for (const ControlEdgeInfo& e : item.output_control_edges()) {
+    if (thread_of[e.dst_id] != thread &&
+        pending_[e.dst_id].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      resumed->push_back(e.dst_id);
+    }
+  }
+}
+
+void StaticScheduleExecutorImpl::RunState::Abort(const Status& s) {
+  {
+    mutex_lock l(mu_);
+    if (!status_.ok()) return;
+    status_ = s;
+  }
+  aborted_.store(true, std::memory_order_relaxed);
+  if (rendezvous_) {
+    rendezvous_->StartAbort(s);
+  }
+  if (cancellation_manager_) {
+    cancellation_manager_->StartCancel();
+  } else if (collective_executor_) {
+    collective_executor_->StartAbort(s);
+  }
+}
+
+void StaticScheduleExecutorImpl::RunState::Finish() {
+  Status status;
+  {
+    mutex_lock l(mu_);
+    status = status_;
+  }
+  if (sync_on_finish_ && status.ok()) {
+    // Block until the device has finished all queued operations.
+    status = impl_->immutable_state_.params().device->Sync();
+  }
+  DoneCallback done = std::move(done_);
+  delete this;
+  done(status);
+}
+
+void StaticScheduleExecutorImpl::RunAsync(const Args& args,
+                                          DoneCallback done) {
+  (new RunState(this, args, std::move(done)))->Start();
+}
+
+class StaticScheduleExecutorRegistrar {
+ public:
+  StaticScheduleExecutorRegistrar() {
+    ExecutorFactory::Register(kStaticScheduleExecutor, new Factory());
+  }
+
+ private:
+  class Factory : public ExecutorFactory {
+    Status NewExecutor(const LocalExecutorParams& params, const Graph& graph,
+                       std::unique_ptr<Executor>* out_executor) override {
+      Executor* ret;
+      TF_RETURN_IF_ERROR(NewStaticScheduleExecutor(params, graph, &ret));
+      out_executor->reset(ret);
+      return Status::OK();
+    }
+  };
+};
+static StaticScheduleExecutorRegistrar registrar;
+
+}  // namespace
+
+Status NewStaticScheduleExecutor(const LocalExecutorParams& params,
+                                 const Graph& graph, Executor** executor) {
+  auto impl = absl::make_unique<StaticScheduleExecutorImpl>(params);
+  TF_RETURN_IF_ERROR(impl->Initialize(graph));
+  *executor = impl.release();
+  return Status::OK();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,53 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_SCHEDULE_EXECUTOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_SCHEDULE_EXECUTOR_H_
+
+#include "tensorflow/core/common_runtime/executor.h"
+#include "tensorflow/core/common_runtime/local_executor_params.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+
+// Creates a new `Executor` that runs `graph` according to a schedule that is
+// fixed when the executor is created.
+//
+// At construction, the nodes of `graph` are partitioned into per-thread
+// linear schedules by a cost-weighted list scheduler: nodes are visited in
+// topological order, prioritized by the length of their longest path to a
+// sink, and each is placed on the thread where it can start earliest,
+// charging a penalty for inputs that are produced on another thread. At run
+// time each thread executes its nodes in order. Dependencies between nodes on
+// the same thread are satisfied by program order, so only edges that cross
+// threads touch a per-node atomic counter; there is no ready queue and no
+// per-step pending-count bookkeeping for the rest of the graph.
+//
+// This suits inference graphs made of many small ops, where the per-node
+// overhead of the default executor is significant. The following are not
+// supported, and cause creation to fail:
+//
+// 1. Low-level control flow (graphs with "Switch", "Merge", "Enter", etc.).
+// 2. Reference-typed tensors.
+// 3. Asynchronous kernels (including "_Recv").
+//
+// Memory logging, deferred device ops and per-kernel cost feedback are not
+// implemented.
+Status NewStaticScheduleExecutor(const LocalExecutorParams& params,
+                                 const Graph& graph, Executor** executor);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_SCHEDULE_EXECUTOR_H_
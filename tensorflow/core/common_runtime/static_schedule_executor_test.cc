@@ -0,0 +1,270 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_schedule_executor.h"
+
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/executor.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
+#include "tensorflow/core/common_runtime/graph_constructor.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+class StaticScheduleExecutorTest : public ::testing::Test {
+ protected:
+  StaticScheduleExecutorTest()
+      : device_(DeviceFactory::NewDevice("CPU", {},
+                                         "/job:localhost/replica:0/task:0")),
+        thread_pool_(new thread::ThreadPool(Env::Default(), "test", 4)) {}
+
+  ~StaticScheduleExecutorTest() override { delete exec_; }
+
+  // Resets exec_ with a new executor based on `graph`.
+  Status Create(std::unique_ptr<const Graph> graph) {
+    const int version = graph->versions().producer();
+    LocalExecutorParams params;
+    params.device = device_.get();
+    params.create_kernel =
+        [this, version](const std::shared_ptr<const NodeProperties>& props,
+                        OpKernel** kernel) {
+          return CreateNonCachedKernel(device_.get(), nullptr, props, version,
+                                       kernel);
+        };
+    params.delete_kernel = [](OpKernel* kernel) {
+      DeleteNonCachedKernel(kernel);
+    };
+    delete exec_;
+    exec_ = nullptr;
+    return NewStaticScheduleExecutor(params, *graph, &exec_);
+  }
+
+  Status Run(CallFrameInterface* call_frame, bool inline_runner = false) {
+    Executor::Args args;
+    args.call_frame = call_frame;
+    if (inline_runner) {
+      args.runner = [](const std::function<void()>& fn) { fn(); };
+    } else {
+      thread::ThreadPool* pool = thread_pool_.get();
+      args.runner = [pool](const std::function<void()>& fn) {
+        pool->Schedule(fn);
+      };
+    }
+    return exec_->Run(args);
+  }
+
+  std::unique_ptr<Device> device_;
+  std::unique_ptr<thread::ThreadPool> thread_pool_;
+  Executor* exec_ = nullptr;
+};
+
+// A float val -> Tensor<float>
+Tensor V(const float val) {
+  Tensor tensor(DT_FLOAT, TensorShape({}));
+  tensor.scalar<float>()() = val;
+  return tensor;
+}
+
+// Tensor<float> -> a float val.
+float V(const Tensor& tensor) {
+  CHECK_EQ(tensor.dtype(), DT_FLOAT);
+  CHECK(TensorShapeUtils::IsScalar(tensor.shape()));
+  return tensor.scalar<float>()();
+}
+
+TEST_F(StaticScheduleExecutorTest, SimpleAdd) {
+  // c = a + b
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto in0 = test::graph::Arg(g.get(), 0, DT_FLOAT);
+  auto in1 = test::graph::Arg(g.get(), 1, DT_FLOAT);
+  auto tmp = test::graph::Add(g.get(), in0, in1);
+  auto ret = test::graph::Retval(g.get(), 0, tmp);
+  g->AddControlEdge(in1, ret);
+  FixupSourceAndSinkEdges(g.get());
+  TF_ASSERT_OK(Create(std::move(g)));
+  FunctionCallFrame call_frame({DT_FLOAT, DT_FLOAT}, {DT_FLOAT});
+  TF_ASSERT_OK(call_frame.SetArgs({V(1.0), V(2.0)}));
+  TF_ASSERT_OK(Run(&call_frame));
+  std::vector<Tensor> retvals;
+  TF_ASSERT_OK(call_frame.ConsumeRetvals(&retvals, false));
+  EXPECT_EQ(3.0, V(retvals[0]));  // out = 1.0 + 2.0 = 3.0
+}
+
+// Builds a graph which adds N copies of one variable "in", parenthesized
+// randomly, so that the scheduler spreads it over several threads.
+void BuildTree(int N, Graph* g) {
+  CHECK_GT(N, 1);
+  auto in = test::graph::Arg(g, 0, DT_FLOAT);
+  std::vector<Node*> nodes;
+  for (int i = 0; i < N; ++i) {
+    nodes.push_back(test::graph::Identity(g, in, 0));
+  }
+  random::PhiloxRandom philox(0, 17);
+  random::SimplePhilox rnd(&philox);
+  while (nodes.size() > 1) {
+    int x = rnd.Uniform(nodes.size());
+    auto in0 = nodes[x];
+    nodes[x] = nodes.back();
+    nodes.resize(nodes.size() - 1);
+    x = rnd.Uniform(nodes.size());
+    auto in1 = nodes[x];
+    nodes[x] = test::graph::Add(g, in0, in1);
+  }
+  test::graph::Retval(g, 0, nodes.back());
+  FixupSourceAndSinkEdges(g);
+}
+
+TEST_F(StaticScheduleExecutorTest, RandomTree) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  TF_ASSERT_OK(Create(std::move(g)));
+  for (int i = 0; i < 10; ++i) {
+    FunctionCallFrame call_frame({DT_FLOAT}, {DT_FLOAT});
+    TF_ASSERT_OK(call_frame.SetArgs({V(1.0)}));
+    TF_ASSERT_OK(Run(&call_frame));
+    std::vector<Tensor> retvals;
+    TF_ASSERT_OK(call_frame.ConsumeRetvals(&retvals, false));
+    EXPECT_EQ(4096.0, V(retvals[0]));
+  }
+}
+
+TEST_F(StaticScheduleExecutorTest, RandomTreeInlineRunner) {
+  // Threads that wait for another thread park instead of blocking, so an
+  // inline runner must not deadlock.
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(512, g.get());
+  TF_ASSERT_OK(Create(std::move(g)));
+  FunctionCallFrame call_frame({DT_FLOAT}, {DT_FLOAT});
+  TF_ASSERT_OK(call_frame.SetArgs({V(1.0)}));
+  TF_ASSERT_OK(Run(&call_frame, /*inline_runner=*/true));
+  std::vector<Tensor> retvals;
+  TF_ASSERT_OK(call_frame.ConsumeRetvals(&retvals, false));
+  EXPECT_EQ(512.0, V(retvals[0]));
+}
+
+TEST_F(StaticScheduleExecutorTest, OpError) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto zero = test::graph::Constant(g.get(), V(0.0));
+  auto inf = test::graph::Unary(g.get(), "Reciprocal", zero);
+  auto check = test::graph::CheckNumerics(g.get(), inf, "message");
+  auto two = test::graph::Constant(g.get(), V(2.0));
+  test::graph::Binary(g.get(), "Mul", check, two);
+  FixupSourceAndSinkEdges(g.get());
+  TF_ASSERT_OK(Create(std::move(g)));
+  FunctionCallFrame call_frame({}, {});
+  EXPECT_TRUE(errors::IsInvalidArgument(Run(&call_frame)));
+}
+
+TEST_F(StaticScheduleExecutorTest, RejectsControlFlow) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto in0 = test::graph::Arg(g.get(), 0, DT_FLOAT);
+  auto pred = test::graph::Constant(g.get(), test::AsScalar<bool>(true));
+  auto sw = test::graph::Switch(g.get(), in0, pred);
+  test::graph::Retval(g.get(), 0, sw);
+  FixupSourceAndSinkEdges(g.get());
+  EXPECT_TRUE(errors::IsFailedPrecondition(Create(std::move(g))));
+}
+
+TEST_F(StaticScheduleExecutorTest, IsRegistered) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(16, g.get());
+  LocalExecutorParams params;
+  params.device = device_.get();
+  params.create_kernel =
+      [this](const std::shared_ptr<const NodeProperties>& props,
+             OpKernel** kernel) {
+        return CreateNonCachedKernel(device_.get(), nullptr, props,
+                                     TF_GRAPH_DEF_VERSION, kernel);
+      };
+  params.delete_kernel = [](OpKernel* kernel) {
+    DeleteNonCachedKernel(kernel);
+  };
+  std::unique_ptr<Executor> executor;
+  TF_ASSERT_OK(
+      NewExecutor("STATIC_SCHEDULE_EXECUTOR", params, *g, &executor));
+}
+
+// Builds `width` independent chains of `depth` small ops each, joined at the
+// end, which is the shape of many small-op serving graphs.
+static Graph* WideDeep(int width, int depth) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor one(DT_FLOAT, TensorShape({}));
+  one.scalar<float>()() = 1.0;
+  Node* c = test::graph::Constant(g, one);
+  std::vector<Node*> tails;
+  for (int i = 0; i < width; ++i) {
+    Node* n = c;
+    for (int j = 0; j < depth; ++j) {
+      n = test::graph::Add(g, n, c);
+    }
+    tails.push_back(n);
+  }
+  test::graph::NoOp(g, tails);
+  FixupSourceAndSinkEdges(g);
+  return g;
+}
+
+static void BM_WideDeep(::testing::benchmark::State& state,
+                        const char* executor_type) {
+  const int width = state.range(0);
+  const int depth = state.range(1);
+  test::Benchmark("cpu", WideDeep(width, depth), /*options=*/nullptr,
+                  /*init=*/nullptr, /*rendez=*/nullptr, executor_type,
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetItemsProcessed(static_cast<int64>(state.iterations()) * width *
+                          depth);
+}
+
+static void BM_WideDeepDefaultExecutor(::testing::benchmark::State& state) {
+  BM_WideDeep(state, "");
+}
+BENCHMARK(BM_WideDeepDefaultExecutor)
+    ->UseRealTime()
+    ->ArgPair(1, 256)
+    ->ArgPair(8, 64)
+    ->ArgPair(64, 8);
+
+static void BM_WideDeepStaticScheduleExecutor(
+    ::testing::benchmark::State& state) {
+  BM_WideDeep(state, "STATIC_SCHEDULE_EXECUTOR");
+}
+BENCHMARK(BM_WideDeepStaticScheduleExecutor)
+    ->UseRealTime()
+    ->ArgPair(1, 256)
+    ->ArgPair(8, 64)
+    ->ArgPair(64, 8);
+
+}  // namespace
+}  // namespace tensorflow
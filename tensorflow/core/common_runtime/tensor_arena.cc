@@ -0,0 +1,319 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/tensor_arena.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace {
+
+// All slots are aligned to the allocator alignment, so that any kernel that
+// could use memory from the device allocator can use memory from the arena.
+constexpr size_t kArenaAlignment = Allocator::kAllocatorAlignment;
+
+size_t RoundUp(size_t bytes) {
+  return (bytes + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+}
+
+// Returns true if the tensors consumed by `n` may outlive the step.
+bool MayRetainInputs(const Node* n) {
+  return n->IsRetval() || n->IsSend() || n->IsHostSend() ||
+         n->op_def().is_stateful();
+}
+
+// Returns true if `n` is not expected to allocate its outputs with
+// `OpKernelContext::allocate_output()`.
+bool DoesNotAllocateOutputs(const Node* n) {
+  return n->IsArg() || n->IsConstant() || n->IsIdentity() ||
+         n->IsControlFlow() || n->IsRecv() || n->IsHostRecv();
+}
+
+// Infers the output shapes of the nodes in `order`, which must be a
+// topological order of `graph`, from the shapes of the `_Arg` nodes and the
+// values of the "Const" nodes. On return, `(*shapes)[id]` holds the output
+// shapes of the node with id `id`, or is empty if inference failed or the op
+// has no shape function.
+void InferShapes(const Graph& graph, const std::vector<Node*>& order,
+                 const std::vector<PartialTensorShape>& arg_shapes,
+                 std::vector<std::vector<PartialTensorShape>>* shapes) {
+  shapes->assign(graph.num_node_ids(), {});
+  std::vector<Tensor> const_values(graph.num_node_ids());
+  std::vector<PartialTensorShape> input_shapes;
+  std::vector<const Tensor*> input_tensors;
+  for (const Node* n : order) {
+    if (!n->IsOp()) continue;
+    std::vector<PartialTensorShape>& output_shapes = (*shapes)[n->id()];
+    if (n->IsArg()) {
+      int32 index;
+      if (GetNodeAttr(n->attrs(), "index", &index).ok() && index >= 0 &&
+          index < static_cast<int32>(arg_shapes.size())) {
+        output_shapes.push_back(arg_shapes[index]);
+      }
+      continue;
+    }
+    if (n->IsConstant()) {
+      const TensorProto* proto;
+      if (GetNodeAttr(n->attrs(), "value", &proto).ok() &&
+          const_values[n->id()].FromProto(*proto)) {
+        output_shapes.push_back(const_values[n->id()].shape());
+      }
+      continue;
+    }
+
+    const OpRegistrationData* op_reg_data;
+    if (!graph.op_registry()->LookUp(n->type_string(), &op_reg_data).ok() ||
+        op_reg_data->shape_inference_fn == nullptr) {
+      continue;
+    }
+    input_shapes.assign(n->num_inputs(), PartialTensorShape());
+    input_tensors.assign(n->num_inputs(), nullptr);
+    for (const Edge* e : n->in_edges()) {
+      if (e->IsControlEdge()) continue;
+      const std::vector<PartialTensorShape>& src_shapes =
+          (*shapes)[e->src()->id()];
+      if (e->src_output() < static_cast<int>(src_shapes.size())) {
+        input_shapes[e->dst_input()] = src_shapes[e->src_output()];
+      }
+      if (e->src()->IsConstant() &&
+          const_values[e->src()->id()].IsInitialized()) {
+        input_tensors[e->dst_input()] = &const_values[e->src()->id()];
+      }
+    }
+    shape_inference::InferenceContext c(
+        graph.versions().producer(), n->attrs(), op_reg_data->op_def,
+        input_shapes, input_tensors, /*input_tensors_as_shapes=*/{},
+        /*input_handle_shapes_and_types=*/{});
+    if (!c.construction_status().ok() ||
+        !c.Run(op_reg_data->shape_inference_fn).ok()) {
+      continue;
+    }
+    for (int i = 0; i < c.num_outputs(); ++i) {
+      TensorShapeProto proto;
+      c.ShapeHandleToProto(c.output(i), &proto);
+      output_shapes.emplace_back(proto);
+    }
+  }
+}
+
+// A planned node output.
+struct Interval {
+  int32 slot;
+  size_t size;
+  // Positions in topological order of the producer and of the last consumer.
+  int32 first;
+  int32 last;
+  int64 offset;
+};
+
+}  // namespace
+
+Status TensorArenaPlan::Create(const Graph& graph,
+                               const std::vector<PartialTensorShape>& arg_shapes,
+                               std::unique_ptr<TensorArenaPlan>* plan) {
+  std::unique_ptr<TensorArenaPlan> p(new TensorArenaPlan);
+
+  std::vector<Node*> order;
+  GetReversePostOrder(graph, &order);
+  std::vector<int32> position(graph.num_node_ids(), -1);
+  for (size_t i = 0; i < order.size(); ++i) {
+    position[order[i]->id()] = i;
+  }
+
+  std::vector<std::vector<PartialTensorShape>> shapes;
+  InferShapes(graph, order, arg_shapes, &shapes);
+
+  std::vector<Interval> intervals;
+  p->first_slot_.assign(graph.num_node_ids(), -1);
+  for (const Node* n : order) {
+    if (DoesNotAllocateOutputs(n) ||
+        static_cast<int>(shapes[n->id()].size()) != n->num_outputs()) {
+      continue;
+    }
+
+    std::vector<int32> last_use(n->num_outputs(), position[n->id()]);
+    std::vector<bool> escapes(n->num_outputs(), false);
+    for (const Edge* e : n->out_edges()) {
+      if (e->IsControlEdge()) continue;
+      if (MayRetainInputs(e->dst())) escapes[e->src_output()] = true;
+      last_use[e->src_output()] =
+          std::max(last_use[e->src_output()], position[e->dst()->id()]);
+    }
+
+    const int32 first_slot = p->slots_.size();
+    bool planned_any = false;
+    for (int i = 0; i < n->num_outputs(); ++i) {
+      p->slots_.emplace_back();
+      const DataType dtype = n->output_type(i);
+      if (escapes[i] || IsRefType(dtype) || !DataTypeCanUseMemcpy(dtype)) {
+        continue;
+      }
+      const PartialTensorShape& shape = shapes[n->id()][i];
+      if (!shape.IsFullyDefined()) continue;
+      const int64 num_elements = shape.num_elements();
+      if (num_elements <= 0) continue;
+      const size_t size = RoundUp(num_elements * DataTypeSize(dtype));
+      intervals.push_back({first_slot + i, size, position[n->id()],
+                           last_use[i], /*offset=*/-1});
+      planned_any = true;
+    }
+    if (planned_any) {
+      p->first_slot_[n->id()] = first_slot;
+    } else {
+      p->slots_.resize(first_slot);
+    }
+  }
+
+  // Place the largest outputs first, each at the lowest offset that does not
+  // overlap an already placed output that is live at the same time.
+  std::sort(intervals.begin(), intervals.end(),
+            [](const Interval& a, const Interval& b) {
+              return a.size > b.size || (a.size == b.size && a.first < b.first);
+            });
+  std::vector<const Interval*> overlapping;
+  for (size_t i = 0; i < intervals.size(); ++i) {
+    Interval& interval = intervals[i];
+    overlapping.clear();
+    for (size_t j = 0; j < i; ++j) {
+      if (intervals[j].first <= interval.last &&
+          interval.first <= intervals[j].last) {
+        overlapping.push_back(&intervals[j]);
+      }
+    }
+    std::sort(overlapping.begin(), overlapping.end(),
+              [](const Interval* a, const Interval* b) {
+                return a->offset < b->offset;
+              });
+    int64 offset = 0;
+    for (const Interval* other : overlapping) {
+      if (offset + static_cast<int64>(interval.size) <= other->offset) break;
+      offset = std::max(offset, other->offset + static_cast<int64>(other->size));
+    }
+    interval.offset = offset;
+    p->total_bytes_ = std::max(p->total_bytes_, offset + interval.size);
+    p->total_planned_bytes_ += interval.size;
+    Slot& slot = p->slots_[interval.slot];
+    slot.offset = offset;
+    slot.size = interval.size;
+  }
+  p->num_planned_outputs_ = intervals.size();
+
+  // Record which slots share memory. Only slots whose lifetimes do not overlap
+  // in the plan can share memory, but at run time that must be checked.
+  std::sort(intervals.begin(), intervals.end(),
+            [](const Interval& a, const Interval& b) {
+              return a.offset < b.offset;
+            });
+  for (size_t i = 0; i < intervals.size(); ++i) {
+    const int64 end = intervals[i].offset + intervals[i].size;
+    for (size_t j = i + 1; j < intervals.size() && intervals[j].offset < end;
+         ++j) {
+      p->slots_[intervals[i].slot].conflicts.push_back(intervals[j].slot);
+      p->slots_[intervals[j].slot].conflicts.push_back(intervals[i].slot);
+    }
+  }
+
+  VLOG(1) << "Planned " << p->num_planned_outputs_ << " outputs totalling "
+          << p->total_planned_bytes_ << " bytes into an arena of "
+          << p->total_bytes_ << " bytes.";
+  *plan = std::move(p);
+  return Status::OK();
+}
+
+TensorArena* TensorArenaPlan::NewArena(Allocator* allocator) const {
+  return new TensorArena(this, allocator);
+}
+
+int64 TensorArenaPlan::offset(int node_id, int index) const {
+  const int32 first_slot = first_slot_[node_id];
+  return first_slot < 0 ? -1 : slots_[first_slot + index].offset;
+}
+
+TensorArena::TensorArena(const TensorArenaPlan* plan, Allocator* allocator)
+    : plan_(plan),
+      allocator_(allocator),
+      total_bytes_(plan->total_bytes_),
+      allocators_(new SlotAllocator[plan->slots_.size()]),
+      allocator_ptrs_(plan->slots_.size(), nullptr),
+      live_(new std::atomic<bool>[plan->slots_.size()]) {
+  if (total_bytes_ > 0) {
+    base_ = static_cast<char*>(
+        allocator_->AllocateRaw(kArenaAlignment, total_bytes_));
+  }
+  for (size_t i = 0; i < plan->slots_.size(); ++i) {
+    live_[i].store(false, std::memory_order_relaxed);
+    if (plan->slots_[i].offset < 0) continue;
+    allocators_[i].arena_ = this;
+    allocators_[i].index_ = i;
+    allocator_ptrs_[i] = &allocators_[i];
+  }
+}
+
+TensorArena::~TensorArena() {
+  if (base_ != nullptr) {
+    allocator_->DeallocateRaw(base_);
+  }
+}
+
+void* TensorArena::AllocateSlot(int32 index, size_t alignment,
+                                size_t num_bytes) {
+  // Each tensor allocated from the arena holds a reference to it.
+  Ref();
+  const TensorArenaPlan::Slot& slot = plan_->slots_[index];
+  if (base_ != nullptr && num_bytes <= slot.size &&
+      alignment <= kArenaAlignment) {
+    // Mark the slot live before checking the slots it shares memory with, so
+    // that of two concurrent allocations at least one sees the other.
+    bool expected = false;
+    if (live_[index].compare_exchange_strong(expected, true)) {
+      bool in_use = false;
+      for (int32 other : slot.conflicts) {
+        if (live_[other].load()) {
+          in_use = true;
+          break;
+        }
+      }
+      if (!in_use) {
+        num_arena_allocations_.fetch_add(1, std::memory_order_relaxed);
+        return base_ + slot.offset;
+      }
+      live_[index].store(false);
+    }
+  }
+  num_fallback_allocations_.fetch_add(1, std::memory_order_relaxed);
+  return allocator_->AllocateRaw(alignment, num_bytes);
+}
+
+void TensorArena::DeallocateSlot(int32 index, void* ptr) {
+  char* p = static_cast<char*>(ptr);
+  if (base_ != nullptr && p >= base_ && p < base_ + total_bytes_) {
+    live_[index].store(false);
+  } else {
+    allocator_->DeallocateRaw(ptr);
+  }
+  Unref();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,172 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_TENSOR_ARENA_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_TENSOR_ARENA_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+class TensorArena;
+
+// A static memory layout for the node outputs of a graph whose shapes are
+// known before it runs.
+//
+// Every output whose size can be inferred statically is given an offset in a
+// single arena. Outputs whose lifetimes do not overlap in a topological order
+// of the graph may share memory; offsets are assigned greedily, largest output
+// first, in the manner of TFLite's ArenaPlanner. At run time, each step
+// allocates the whole arena with a single call to the device allocator (see
+// `TensorArena`), and node outputs are carved out of it.
+//
+// The plan is advisory: if at run time an output has a different size than
+// planned, or the memory it would reuse is still held by another tensor (for
+// example, because the executor ran nodes in a different order, or a kernel
+// forwarded or retained its input), the output is allocated from the device
+// allocator instead.
+class TensorArenaPlan {
+ public:
+  // Computes a plan for `graph`. `arg_shapes[i]` is the shape of the value
+  // fed to the `_Arg` node with index `i`, if known. Outputs whose shapes are
+  // not fully defined after shape inference, that have a type that cannot be
+  // copied with memcpy, or that may outlive the step (because they are
+  // consumed by a `_Retval`, a send, or a stateful op) are not planned.
+  static Status Create(const Graph& graph,
+                       const std::vector<PartialTensorShape>& arg_shapes,
+                       std::unique_ptr<TensorArenaPlan>* plan);
+
+  // Returns a new arena for one step, backed by `allocator`. The caller owns
+  // one reference. Tensors allocated from the arena keep it alive, so it may
+  // outlive both the step and this plan.
+  TensorArena* NewArena(Allocator* allocator) const;
+
+  // Total size of the arena in bytes.
+  size_t total_bytes() const { return total_bytes_; }
+
+  // Number of planned node outputs.
+  int num_planned_outputs() const { return num_planned_outputs_; }
+
+  // Sum of the sizes of all planned node outputs, which is what they would
+  // occupy without memory reuse.
+  size_t total_planned_bytes() const { return total_planned_bytes_; }
+
+  // Returns the offset in the arena of output `index` of the node with id
+  // `node_id`, or -1 if the output is not planned.
+  int64 offset(int node_id, int index) const;
+
+ private:
+  friend class TensorArena;
+
+  struct Slot {
+    // Byte offset in the arena, or -1 if the output is not planned.
+    int64 offset = -1;
+    size_t size = 0;
+    // The slots that share memory with this one.
+    std::vector<int32> conflicts;
+  };
+
+  TensorArenaPlan() = default;
+
+  // For each node id, the index in `slots_` of the node's output 0, or -1 if
+  // no output of the node is planned.
+  std::vector<int32> first_slot_;
+  std::vector<Slot> slots_;
+  size_t total_bytes_ = 0;
+  int num_planned_outputs_ = 0;
+  size_t total_planned_bytes_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(TensorArenaPlan);
+};
+
+// The memory for one step of a `TensorArenaPlan`.
+//
+// `output_allocators(node_id)` returns an array, indexed by output number,
+// suitable for `OpKernelContext::Params::output_allocator_array`.
+class TensorArena : public core::RefCounted {
+ public:
+  ~TensorArena() override;
+
+  // Returns the allocators for the outputs of the node with id `node_id`,
+  // or nullptr if no output of the node is planned. Entries for unplanned
+  // outputs are nullptr.
+  Allocator* const* output_allocators(int node_id) const {
+    const int32 first_slot = plan_->first_slot_[node_id];
+    return first_slot < 0 ? nullptr : allocator_ptrs_.data() + first_slot;
+  }
+
+  // Number of node outputs served from the arena and from the fallback
+  // allocator, respectively.
+  int64 num_arena_allocations() const {
+    return num_arena_allocations_.load(std::memory_order_relaxed);
+  }
+  int64 num_fallback_allocations() const {
+    return num_fallback_allocations_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  friend class TensorArenaPlan;
+
+  class SlotAllocator : public Allocator {
+   public:
+    SlotAllocator() = default;
+    string Name() override { return "tensor_arena"; }
+    void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+      return arena_->AllocateSlot(index_, alignment, num_bytes);
+    }
+    void DeallocateRaw(void* ptr) override {
+      arena_->DeallocateSlot(index_, ptr);
+    }
+
+   private:
+    friend class TensorArena;
+    TensorArena* arena_ = nullptr;
+    int32 index_ = -1;
+  };
+
+  TensorArena(const TensorArenaPlan* plan, Allocator* allocator);
+
+  void* AllocateSlot(int32 index, size_t alignment, size_t num_bytes);
+  void DeallocateSlot(int32 index, void* ptr);
+
+  // Only used while the step that owns the arena is running.
+  const TensorArenaPlan* const plan_;
+  Allocator* const allocator_;  // Not owned.
+  char* base_ = nullptr;
+  const size_t total_bytes_;
+
+  std::unique_ptr<SlotAllocator[]> allocators_;
+  std::vector<Allocator*> allocator_ptrs_;
+  // For each slot, whether a live tensor currently occupies its memory.
+  std::unique_ptr<std::atomic<bool>[]> live_;
+
+  std::atomic<int64> num_arena_allocations_{0};
+  std::atomic<int64> num_fallback_allocations_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(TensorArena);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_TENSOR_ARENA_H_
@@ -0,0 +1,138 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/tensor_arena.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Builds arg -> Tanh -> ... -> Tanh -> retval, with `length` Tanh nodes.
+std::vector<Node*> BuildChain(Graph* g, int length) {
+  std::vector<Node*> chain;
+  Node* n = test::graph::Arg(g, 0, DT_FLOAT);
+  for (int i = 0; i < length; ++i) {
+    n = test::graph::Unary(g, "Tanh", n);
+    chain.push_back(n);
+  }
+  test::graph::Retval(g, 0, n);
+  FixupSourceAndSinkEdges(g);
+  return chain;
+}
+
+TEST(TensorArenaPlanTest, ChainReusesMemory) {
+  Graph g(OpRegistry::Global());
+  std::vector<Node*> chain = BuildChain(&g, 5);
+  std::unique_ptr<TensorArenaPlan> plan;
+  TF_ASSERT_OK(TensorArenaPlan::Create(
+      g, {PartialTensorShape({16, 16})}, &plan));
+
+  // The last Tanh feeds the retval, so its output is not planned.
+  const size_t size = 16 * 16 * sizeof(float);
+  EXPECT_EQ(4, plan->num_planned_outputs());
+  EXPECT_EQ(4 * size, plan->total_planned_bytes());
+  // Only two adjacent outputs of the chain are live at the same time.
+  EXPECT_EQ(2 * size, plan->total_bytes());
+  for (int i = 0; i + 1 < 4; ++i) {
+    EXPECT_NE(plan->offset(chain[i]->id(), 0),
+              plan->offset(chain[i + 1]->id(), 0));
+  }
+  EXPECT_EQ(-1, plan->offset(chain[4]->id(), 0));
+}
+
+TEST(TensorArenaPlanTest, UnknownShapesAreNotPlanned) {
+  Graph g(OpRegistry::Global());
+  std::vector<Node*> chain = BuildChain(&g, 3);
+  std::unique_ptr<TensorArenaPlan> plan;
+  TF_ASSERT_OK(TensorArenaPlan::Create(
+      g, {PartialTensorShape({-1, 16})}, &plan));
+  EXPECT_EQ(0, plan->num_planned_outputs());
+  EXPECT_EQ(0, plan->total_bytes());
+  std::unique_ptr<TensorArena, void (*)(TensorArena*)> arena(
+      plan->NewArena(cpu_allocator()), [](TensorArena* a) { a->Unref(); });
+  EXPECT_EQ(nullptr, arena->output_allocators(chain[0]->id()));
+}
+
+TEST(TensorArenaTest, AllocatesFromArena) {
+  Graph g(OpRegistry::Global());
+  std::vector<Node*> chain = BuildChain(&g, 3);
+  std::unique_ptr<TensorArenaPlan> plan;
+  TF_ASSERT_OK(
+      TensorArenaPlan::Create(g, {PartialTensorShape({4, 4})}, &plan));
+  ASSERT_EQ(2, plan->num_planned_outputs());
+
+  TensorArena* arena = plan->NewArena(cpu_allocator());
+  Allocator* a0 = arena->output_allocators(chain[0]->id())[0];
+  Allocator* a1 = arena->output_allocators(chain[1]->id())[0];
+  {
+    Tensor t0(a0, DT_FLOAT, TensorShape({4, 4}));
+    Tensor t1(a1, DT_FLOAT, TensorShape({4, 4}));
+    EXPECT_NE(t0.tensor_data().data(), t1.tensor_data().data());
+    EXPECT_EQ(2, arena->num_arena_allocations());
+  }
+  // A slot is reused on the next step once it has been released.
+  {
+    Tensor t0(a0, DT_FLOAT, TensorShape({4, 4}));
+    EXPECT_EQ(3, arena->num_arena_allocations());
+  }
+  // Larger outputs than planned use the fallback allocator.
+  {
+    Tensor t0(a0, DT_FLOAT, TensorShape({8, 8}));
+    EXPECT_EQ(1, arena->num_fallback_allocations());
+  }
+
+  // Tensors keep the arena alive.
+  Tensor t(a0, DT_FLOAT, TensorShape({4, 4}));
+  arena->Unref();
+  t.flat<float>().setZero();
+}
+
+TEST(TensorArenaTest, FallsBackWhenMemoryIsInUse) {
+  // a -> Tanh (t0) -> Tanh (t1) -> Tanh (t2) -> retval: t0 and t2 share
+  // memory in the plan, since t0 is dead by the time t2 is produced.
+  Graph g(OpRegistry::Global());
+  std::vector<Node*> chain = BuildChain(&g, 4);
+  std::unique_ptr<TensorArenaPlan> plan;
+  TF_ASSERT_OK(
+      TensorArenaPlan::Create(g, {PartialTensorShape({4, 4})}, &plan));
+  ASSERT_EQ(plan->offset(chain[0]->id(), 0), plan->offset(chain[2]->id(), 0));
+
+  TensorArena* arena = plan->NewArena(cpu_allocator());
+  // If t0 is still alive (e.g. a kernel retained it), t2 must not overwrite
+  // it.
+  Tensor t0(arena->output_allocators(chain[0]->id())[0], DT_FLOAT,
+            TensorShape({4, 4}));
+  Tensor t2(arena->output_allocators(chain[2]->id())[0], DT_FLOAT,
+            TensorShape({4, 4}));
+  EXPECT_NE(t0.tensor_data().data(), t2.tensor_data().data());
+  EXPECT_EQ(1, arena->num_arena_allocations());
+  EXPECT_EQ(1, arena->num_fallback_allocations());
+  arena->Unref();
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,112 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/multi_process_map_worker.h"
+
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/process_function_library_runtime.h"
+#include "tensorflow/core/common_runtime/rendezvous_mgr.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace data {
+
+Status RunMultiProcessMapWorker(const MultiProcessMapWorkerDef& worker_def,
+                                SharedMemoryChannel* input,
+                                SharedMemoryChannel* output) {
+  // Instantiate enough of the TF runtime to run the function on a single CPU
+  // device, as `standalone::Dataset` does for a dataset graph.
+  FunctionLibraryDefinition flib_def(OpRegistry::Global(),
+                                     worker_def.graph().library());
+  auto device_mgr = absl::make_unique<StaticDeviceMgr>(DeviceFactory::NewDevice(
+      "CPU", SessionOptions(), "/job:localhost/replica:0/task:0"));
+  const int num_threads = worker_def.num_threads() > 0
+                              ? worker_def.num_threads()
+                              : port::MaxParallelism();
+  thread::ThreadPool pool(Env::Default(), "multi_process_map_worker",
+                          num_threads);
+  ProcessFunctionLibraryRuntime pflr(
+      device_mgr.get(), Env::Default(), /*config=*/nullptr,
+      TF_GRAPH_DEF_VERSION, &flib_def, OptimizerOptions{}, &pool,
+      /*parent=*/nullptr, /*session_metadata=*/nullptr,
+      Rendezvous::Factory{
+          [](const int64, const DeviceMgr* device_mgr, Rendezvous** r) {
+            *r = new IntraProcessRendezvous(device_mgr);
+            return Status::OK();
+          }});
+  FunctionLibraryRuntime* flr = pflr.GetFLR("/device:CPU:0");
+  FunctionLibraryRuntime::Handle handle;
+  TF_RETURN_IF_ERROR(flr->Instantiate(worker_def.func().name(),
+                                      AttrSlice(&worker_def.func().attr()),
+                                      &handle));
+
+  std::vector<Tensor> captured_inputs(worker_def.captured_inputs_size());
+  for (int i = 0; i < worker_def.captured_inputs_size(); ++i) {
+    if (!captured_inputs[i].FromProto(worker_def.captured_inputs(i))) {
+      return errors::InvalidArgument("Could not parse captured input ", i);
+    }
+  }
+
+  std::function<void(std::function<void()>)> runner =
+      [&pool](std::function<void()> fn) { pool.Schedule(std::move(fn)); };
+  while (true) {
+    std::vector<Tensor> args;
+    bool end_of_sequence;
+    Status s = input->Read(&args, &end_of_sequence);
+    if (!s.ok()) {
+      if (input->IsClosed() && errors::IsCancelled(s)) {
+        return Status::OK();
+      }
+      TF_RETURN_IF_ERROR(output->WriteError(s));
+      continue;
+    }
+    if (end_of_sequence) {
+      return output->WriteEndOfSequence();
+    }
+    args.insert(args.end(), captured_inputs.begin(), captured_inputs.end());
+
+    FunctionLibraryRuntime::Options opts;
+    opts.runner = &runner;
+    opts.create_rendezvous = true;
+    std::vector<Tensor> rets;
+    s = flr->RunSync(std::move(opts), handle, args, &rets);
+    // Release the input slot before waiting for an output slot.
+    args.clear();
+    if (s.ok()) {
+      s = output->Write(rets);
+      if (errors::IsInvalidArgument(s)) {
+        // The result does not fit in a slot.
+        TF_RETURN_IF_ERROR(output->WriteError(s));
+        continue;
+      }
+    } else {
+      s = output->WriteError(s);
+    }
+    TF_RETURN_IF_ERROR(s);
+  }
+}
+
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,42 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_MULTI_PROCESS_MAP_WORKER_H_
+#define TENSORFLOW_CORE_DATA_MULTI_PROCESS_MAP_WORKER_H_
+
+#include "tensorflow/core/data/dataset.pb.h"
+#include "tensorflow/core/data/shared_memory_channel.h"
+#include "tensorflow/core/platform/status.h"
+
+namespace tensorflow {
+namespace data {
+
+// Runs the map function of a `MultiProcessMapDataset` in a worker process.
+//
+// Reads elements from `input` and writes the result of applying the function
+// in `worker_def` to each of them to `output`, in order, until `input` reaches
+// the end of the sequence (which is forwarded to `output`) or is closed.
+// Errors that occur for an element, either in the input pipeline or in the
+// function, are written to `output` in place of the element.
+//
+// Returns an error if the function cannot be instantiated, or if `output` is
+// closed.
+Status RunMultiProcessMapWorker(const MultiProcessMapWorkerDef& worker_def,
+                                SharedMemoryChannel* input,
+                                SharedMemoryChannel* output);
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_MULTI_PROCESS_MAP_WORKER_H_
@@ -0,0 +1,88 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// The worker process of a `MultiProcessMapDataset`. The dataset starts one
+// such process per worker, passing the names of the shared memory channels to
+// read elements from and to write results to.
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/data/dataset.pb.h"
+#include "tensorflow/core/data/multi_process_map_worker.h"
+#include "tensorflow/core/data/shared_memory_channel.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+Status Run(const std::string& worker_def_path,
+           const std::string& input_channel_name,
+           const std::string& output_channel_name) {
+  MultiProcessMapWorkerDef worker_def;
+  TF_RETURN_IF_ERROR(
+      ReadBinaryProto(Env::Default(), worker_def_path, &worker_def));
+  std::unique_ptr<SharedMemoryChannel> input;
+  TF_RETURN_IF_ERROR(SharedMemoryChannel::Open(input_channel_name, &input));
+  std::unique_ptr<SharedMemoryChannel> output;
+  TF_RETURN_IF_ERROR(SharedMemoryChannel::Open(output_channel_name, &output));
+  Status s = RunMultiProcessMapWorker(worker_def, input.get(), output.get());
+  if (!s.ok()) {
+    // Unblock the dataset, which would otherwise wait for this worker.
+    output->Close();
+  }
+  return s;
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  std::string worker_def;
+  std::string input_channel;
+  std::string output_channel;
+  std::vector<tensorflow::Flag> flag_list = {
+      tensorflow::Flag("worker_def", &worker_def,
+                       "Path of a binary MultiProcessMapWorkerDef proto."),
+      tensorflow::Flag("input_channel", &input_channel,
+                       "Name of the shared memory channel to read elements "
+                       "from."),
+      tensorflow::Flag("output_channel", &output_channel,
+                       "Name of the shared memory channel to write results "
+                       "to."),
+  };
+  bool parse_result = tensorflow::Flags::Parse(&argc, argv, flag_list);
+  if (!parse_result || worker_def.empty() || input_channel.empty() ||
+      output_channel.empty()) {
+    std::cerr << tensorflow::Flags::Usage(argv[0], flag_list);
+    return 2;
+  }
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+
+  tensorflow::Status s =
+      tensorflow::data::Run(worker_def, input_channel, output_channel);
+  if (!s.ok()) {
+    LOG(ERROR) << "Multi-process map worker failed: " << s;
+    return 1;
+  }
+  return 0;
+}
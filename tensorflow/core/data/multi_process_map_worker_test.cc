@@ -0,0 +1,91 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/multi_process_map_worker.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+MultiProcessMapWorkerDef XTimesTwoWorkerDef() {
+  MultiProcessMapWorkerDef worker_def;
+  *worker_def.mutable_graph()->mutable_library()->add_function() =
+      test::function::XTimesTwo();
+  worker_def.mutable_func()->set_name("XTimesTwo");
+  (*worker_def.mutable_func()->mutable_attr())["T"].set_type(DT_FLOAT);
+  worker_def.set_num_threads(1);
+  return worker_def;
+}
+
+TEST(MultiProcessMapWorkerTest, AppliesFunction) {
+  const std::string prefix =
+      strings::StrCat("/tf_data_worker_test_", random::New64());
+  std::unique_ptr<SharedMemoryChannel> input;
+  TF_ASSERT_OK(SharedMemoryChannel::Create(
+      strings::StrCat(prefix, "_in"), SharedMemoryChannel::Options(), &input));
+  std::unique_ptr<SharedMemoryChannel> output;
+  TF_ASSERT_OK(SharedMemoryChannel::Create(strings::StrCat(prefix, "_out"),
+                                           SharedMemoryChannel::Options(),
+                                           &output));
+  Status worker_status;
+  std::unique_ptr<Thread> worker(Env::Default()->StartThread(
+      ThreadOptions(), "worker", [&]() {
+        worker_status = RunMultiProcessMapWorker(XTimesTwoWorkerDef(),
+                                                 input.get(), output.get());
+      }));
+
+  TF_ASSERT_OK(input->Write({test::AsTensor<float>({1.0, 2.0})}));
+  TF_ASSERT_OK(input->WriteError(errors::DataLoss("bad element")));
+  TF_ASSERT_OK(input->Write({test::AsTensor<float>({3.0})}));
+  TF_ASSERT_OK(input->WriteEndOfSequence());
+
+  std::vector<Tensor> result;
+  bool end_of_sequence = false;
+  TF_ASSERT_OK(output->Read(&result, &end_of_sequence));
+  test::ExpectTensorEqual<float>(result[0], test::AsTensor<float>({2.0, 4.0}));
+  EXPECT_TRUE(errors::IsDataLoss(output->Read(&result, &end_of_sequence)));
+  TF_ASSERT_OK(output->Read(&result, &end_of_sequence));
+  test::ExpectTensorEqual<float>(result[0], test::AsTensor<float>({6.0}));
+  TF_ASSERT_OK(output->Read(&result, &end_of_sequence));
+  EXPECT_TRUE(end_of_sequence);
+
+  worker.reset();
+  TF_EXPECT_OK(worker_status);
+}
+
+TEST(MultiProcessMapWorkerTest, ClosedInputStopsWorker) {
+  const std::string prefix =
+      strings::StrCat("/tf_data_worker_test_", random::New64());
+  std::unique_ptr<SharedMemoryChannel> input;
+  TF_ASSERT_OK(SharedMemoryChannel::Create(
+      strings::StrCat(prefix, "_in"), SharedMemoryChannel::Options(), &input));
+  std::unique_ptr<SharedMemoryChannel> output;
+  TF_ASSERT_OK(SharedMemoryChannel::Create(strings::StrCat(prefix, "_out"),
+                                           SharedMemoryChannel::Options(),
+                                           &output));
+  input->Close();
+  TF_EXPECT_OK(RunMultiProcessMapWorker(XTimesTwoWorkerDef(), input.get(),
+                                        output.get()));
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
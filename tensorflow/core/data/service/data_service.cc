@@ -33,6 +33,34 @@ constexpr const char kParallelEpochs[] = "parallel_epochs";
 constexpr const char kDistributedEpoch[] = "distributed_epoch";
 }  // namespace
 
+mutex LocalWorkers::mu_(LINKER_INITIALIZED);
+LocalWorkers::AddressToWorkerMap* LocalWorkers::local_workers_ =
+    new AddressToWorkerMap();
+
+void LocalWorkers::Add(const std::string& worker_address,
+                       std::shared_ptr<LocalWorker> worker) {
+  DCHECK(worker != nullptr) << "Adding a nullptr local worker is disallowed.";
+  VLOG(1) << "Register local worker at address " << worker_address;
+  mutex_lock l(mu_);
+  (*local_workers_)[worker_address] = std::move(worker);
+}
+
+std::shared_ptr<LocalWorker> LocalWorkers::Get(
+    const std::string& worker_address) {
+  tf_shared_lock l(mu_);
+  auto it = local_workers_->find(worker_address);
+  if (it == local_workers_->end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+void LocalWorkers::Remove(const std::string& worker_address) {
+  VLOG(1) << "Remove local worker at address " << worker_address;
+  mutex_lock l(mu_);
+  local_workers_->erase(worker_address);
+}
+
 Status ParseProcessingMode(const std::string& s, ProcessingMode& mode) {
   if (s == kParallelEpochs) {
     mode = ProcessingMode::PARALLEL_EPOCHS;
@@ -265,6 +293,24 @@ Status DataServiceWorkerClient::GetElement(int64 task_id,
     req.set_round_index(round_index.value());
   }
   GetElementResponse resp;
+  // Round-robin reads may block in the worker until other consumers catch up,
+  // and unlike an RPC, a local call cannot be cancelled by `TryCancel()`.
+  std::shared_ptr<LocalWorker> local_worker =
+      round_index.has_value() ? nullptr : LocalWorkers::Get(address_);
+  if (local_worker) {
+    TF_RETURN_IF_ERROR(local_worker->GetElement(&req, &resp));
+  } else {
+    TF_RETURN_IF_ERROR(GetElementGrpc(req, resp));
+  }
+  end_of_sequence = resp.end_of_sequence();
+  if (!end_of_sequence) {
+    element = std::move(*resp.mutable_compressed_element());
+  }
+  return Status::OK();
+}
+
+Status DataServiceWorkerClient::GetElementGrpc(const GetElementRequest& req,
+                                               GetElementResponse& resp) {
   grpc::ClientContext ctx;
   {
     mutex_lock l(mu_);
@@ -278,10 +324,6 @@ Status DataServiceWorkerClient::GetElement(int64 task_id,
   if (!s.ok()) {
     return grpc_util::WrapError("Failed to get element", s);
   }
-  end_of_sequence = resp.end_of_sequence();
-  if (!end_of_sequence) {
-    element = std::move(*resp.mutable_compressed_element());
-  }
   return Status::OK();
 }
 
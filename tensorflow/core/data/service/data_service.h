@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_DATA_SERVICE_DATA_SERVICE_H_
 
 #include "grpcpp/impl/codegen/client_context.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/data/service/dispatcher.grpc.pb.h"
 #include "tensorflow/core/data/service/worker.grpc.pb.h"
@@ -43,6 +44,40 @@ Status ParseProcessingMode(const std::string& s, ProcessingMode& mode);
 // Converts a processing mode to its corresponding string.
 std::string ProcessingModeToString(ProcessingMode mode);
 
+// A tf.data service worker running in the current process, which worker
+// clients can call directly instead of through gRPC. Passing elements this way
+// avoids serializing them to and from the wire format, and the gRPC loopback.
+class LocalWorker {
+ public:
+  virtual ~LocalWorker() = default;
+
+  // See worker.proto for API documentation.
+  virtual Status GetElement(const GetElementRequest* request,
+                            GetElementResponse* response) = 0;
+};
+
+// Registry of the tf.data service workers running in the current process,
+// keyed by the addresses they registered with the dispatcher. Worker clients
+// for one of these addresses use the local worker automatically.
+class LocalWorkers {
+ public:
+  // Registers `worker` as the local worker serving `worker_address`,
+  // replacing any worker previously registered for that address.
+  static void Add(const std::string& worker_address,
+                  std::shared_ptr<LocalWorker> worker);
+  // Returns the local worker serving `worker_address`, or nullptr if there is
+  // none.
+  static std::shared_ptr<LocalWorker> Get(const std::string& worker_address);
+  // Unregisters the local worker serving `worker_address`, if any.
+  static void Remove(const std::string& worker_address);
+
+ private:
+  using AddressToWorkerMap =
+      absl::flat_hash_map<std::string, std::shared_ptr<LocalWorker>>;
+  static mutex mu_;
+  static AddressToWorkerMap* local_workers_ TF_GUARDED_BY(mu_);
+};
+
 // Base class for data service clients. Data service clients are
 // threadsafe.
 class DataServiceClientBase {
@@ -146,6 +181,10 @@ class DataServiceWorkerClient : public DataServiceClientBase {
   // round-robin ordering. The element's compressed tensors will be stored in
   // `element`. If no element is available, `end_of_sequence` will be `true`,
   // and `element` will be left unchanged.
+  //
+  // If the worker runs in the current process (see `LocalWorkers`), elements of
+  // tasks without round-robin ordering are fetched from it directly instead of
+  // through gRPC.
   Status GetElement(int64 task_id, absl::optional<int64> consumer_index,
                     absl::optional<int64> round_index,
                     CompressedElement& element, bool& end_of_sequence);
@@ -158,6 +197,9 @@ class DataServiceWorkerClient : public DataServiceClientBase {
   Status EnsureInitialized() override;
 
  private:
+  // Fetches an element through gRPC.
+  Status GetElementGrpc(const GetElementRequest& req, GetElementResponse& resp);
+
   mutex mu_;
   // Initialization is guarded by `mu_`, but using the stub does not require
   // holding `mu_`
@@ -19,6 +19,7 @@ limitations under the License.
 #include "grpcpp/security/credentials.h"
 #include "absl/strings/str_split.h"
 #include "tensorflow/core/data/compression_utils.h"
+#include "tensorflow/core/data/service/credentials_factory.h"
 #include "tensorflow/core/data/service/dispatcher.grpc.pb.h"
 #include "tensorflow/core/data/service/dispatcher.pb.h"
 #include "tensorflow/core/data/service/grpc_util.h"
@@ -27,18 +28,126 @@ limitations under the License.
 #include "tensorflow/core/data/service/test_util.h"
 #include "tensorflow/core/data/service/worker.grpc.pb.h"
 #include "tensorflow/core/data/service/worker.pb.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/kernels/data/dataset_test_base.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace data {
 
 namespace {
 constexpr const char kProtocol[] = "grpc+local";
+
+using test::function::GDef;
+using test::function::NDef;
+
+// Returns the graph of the dataset
+// `tf.data.Dataset.range(tf.int64.max).map(f)`, where `f` compresses a vector
+// of `element_size` copies of its argument, as the datasets that tf.data
+// service workers run do.
+GraphDef CompressedFillGraph(int64 element_size) {
+  FunctionDef compressed_fill = FunctionDefHelper::Create(
+      "CompressedFill", {"x: int64"}, {"y: variant"}, {},
+      {{{"dims"},
+        "Const",
+        {},
+        {{"value", test::AsTensor<int64>({element_size})},
+         {"dtype", DT_INT64}}},
+       {{"fill"},
+        "Fill",
+        {"dims:output:0", "x"},
+        {{"T", DT_INT64}, {"index_type", DT_INT64}}},
+       {{"compressed"},
+        "CompressElement",
+        {"fill:output:0"},
+        {{"input_types", DataTypeSlice{DT_INT64}}}}},
+      {{"y", "compressed:compressed:0"}});
+  std::vector<PartialTensorShape> scalar_shape = {PartialTensorShape({})};
+  return GDef(
+      {NDef("start", "Const", {},
+            {{"value", test::AsScalar<int64>(0)}, {"dtype", DT_INT64}}),
+       NDef("stop", "Const", {},
+            {{"value", test::AsScalar<int64>(kint64max)},
+             {"dtype", DT_INT64}}),
+       NDef("step", "Const", {},
+            {{"value", test::AsScalar<int64>(1)}, {"dtype", DT_INT64}}),
+       NDef("range", "RangeDataset", {"start", "stop", "step"},
+            {{"output_types", DataTypeSlice{DT_INT64}},
+             {"output_shapes", scalar_shape}}),
+       NDef("map", "MapDataset", {"range"},
+            {{"f", FunctionDefHelper::FunctionRef("CompressedFill")},
+             {"Targuments", DataTypeSlice{}},
+             {"output_types", DataTypeSlice{DT_VARIANT}},
+             {"output_shapes", scalar_shape}}),
+       NDef("dataset", "_Retval", {"map"},
+            {{"T", DT_VARIANT}, {"index", 0}})},
+      {compressed_fill});
+}
+
+// Starts a job reading `graph` from `cluster`, and returns the id and worker
+// address of its only task.
+Status StartTask(TestCluster& cluster, const GraphDef& graph, int64& task_id,
+                 std::string& worker_address) {
+  DataServiceDispatcherClient dispatcher(cluster.DispatcherAddress(),
+                                         kProtocol);
+  int64 dataset_id;
+  TF_RETURN_IF_ERROR(dispatcher.RegisterDataset(graph, dataset_id));
+  int64 job_client_id;
+  TF_RETURN_IF_ERROR(dispatcher.GetOrCreateJob(
+      dataset_id, ProcessingMode::PARALLEL_EPOCHS, /*job_key=*/absl::nullopt,
+      /*num_consumers=*/absl::nullopt, job_client_id));
+  std::vector<TaskInfo> tasks;
+  bool job_finished = false;
+  while (tasks.empty()) {
+    TF_RETURN_IF_ERROR(dispatcher.GetTasks(job_client_id, tasks, job_finished));
+    if (job_finished) {
+      return errors::FailedPrecondition("Job finished without tasks");
+    }
+  }
+  task_id = tasks[0].task_id();
+  worker_address = tasks[0].worker_address();
+  return Status::OK();
 }
 
+// Calls `get_element` until the worker has received its task.
+Status GetElementWithRetries(
+    const std::function<Status(CompressedElement&, bool&)>& get_element,
+    CompressedElement& element, bool& end_of_sequence) {
+  while (true) {
+    Status s = get_element(element, end_of_sequence);
+    if (!errors::IsUnavailable(s)) {
+      return s;
+    }
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+}
+
+// Forwards to a local worker, counting the elements it returns. The counts
+// show whether a client used the local fast path or gRPC.
+class CountingLocalWorker : public LocalWorker {
+ public:
+  explicit CountingLocalWorker(std::shared_ptr<LocalWorker> worker)
+      : worker_(std::move(worker)) {}
+
+  Status GetElement(const GetElementRequest* request,
+                    GetElementResponse* response) override {
+    TF_RETURN_IF_ERROR(worker_->GetElement(request, response));
+    num_elements_.fetch_add(1);
+    return Status::OK();
+  }
+
+  int64 num_elements() const { return num_elements_.load(); }
+
+ private:
+  const std::shared_ptr<LocalWorker> worker_;
+  std::atomic<int64> num_elements_{0};
+};
+}  // namespace
+
 TEST(DataService, ParseParallelEpochsProcessingMode) {
   ProcessingMode mode;
   TF_ASSERT_OK(ParseProcessingMode("parallel_epochs", mode));
@@ -74,5 +183,114 @@ TEST(DataService, GetWorkers) {
   EXPECT_EQ(1, workers.size());
 }
 
+TEST(DataService, LocalWorkerFastPath) {
+  TestCluster cluster(1);
+  TF_ASSERT_OK(cluster.Initialize());
+  int64 task_id;
+  std::string worker_address;
+  TF_ASSERT_OK(StartTask(cluster, CompressedFillGraph(/*element_size=*/3),
+                         task_id, worker_address));
+  std::shared_ptr<LocalWorker> local_worker =
+      LocalWorkers::Get(worker_address);
+  ASSERT_NE(local_worker, nullptr);
+  auto counting_worker = std::make_shared<CountingLocalWorker>(local_worker);
+  LocalWorkers::Add(worker_address, counting_worker);
+
+  DataServiceWorkerClient worker(worker_address, kProtocol);
+  for (int64 i = 0; i < 3; ++i) {
+    CompressedElement compressed;
+    bool end_of_sequence;
+    TF_ASSERT_OK(GetElementWithRetries(
+        [&](CompressedElement& element, bool& end_of_sequence) {
+          return worker.GetElement(task_id, /*consumer_index=*/absl::nullopt,
+                                   /*round_index=*/absl::nullopt, element,
+                                   end_of_sequence);
+        },
+        compressed, end_of_sequence));
+    ASSERT_FALSE(end_of_sequence);
+    std::vector<Tensor> element;
+    TF_ASSERT_OK(UncompressElement(compressed, &element));
+    ASSERT_EQ(element.size(), 1);
+    test::ExpectTensorEqual<int64>(element[0],
+                                   test::AsTensor<int64>({i, i, i}));
+  }
+  // Every element came through the local worker rather than gRPC.
+  EXPECT_EQ(counting_worker->num_elements(), 3);
+
+  // Without the local worker, the client falls back to gRPC.
+  LocalWorkers::Remove(worker_address);
+  CompressedElement compressed;
+  bool end_of_sequence;
+  TF_ASSERT_OK(worker.GetElement(task_id, /*consumer_index=*/absl::nullopt,
+                                 /*round_index=*/absl::nullopt, compressed,
+                                 end_of_sequence));
+  ASSERT_FALSE(end_of_sequence);
+  std::vector<Tensor> element;
+  TF_ASSERT_OK(UncompressElement(compressed, &element));
+  test::ExpectTensorEqual<int64>(element[0], test::AsTensor<int64>({3, 3, 3}));
+  EXPECT_EQ(counting_worker->num_elements(), 3);
+}
+
+// Measures the throughput of fetching elements of `state.range(1)` int64s
+// from a worker in the same process, through the local fast path if
+// `state.range(0)` is true, and through gRPC otherwise.
+static void BM_GetElement(::testing::benchmark::State& state) {
+  const bool local = state.range(0);
+  const int64 element_size = state.range(1);
+  TestCluster cluster(1);
+  TF_CHECK_OK(cluster.Initialize());
+  int64 task_id;
+  std::string worker_address;
+  TF_CHECK_OK(StartTask(cluster, CompressedFillGraph(element_size), task_id,
+                        worker_address));
+
+  DataServiceWorkerClient client(worker_address, kProtocol);
+  std::shared_ptr<::grpc::ChannelCredentials> credentials;
+  TF_CHECK_OK(
+      CredentialsFactory::CreateClientCredentials(kProtocol, &credentials));
+  ::grpc::ChannelArguments args;
+  args.SetMaxReceiveMessageSize(-1);
+  std::unique_ptr<WorkerService::Stub> stub = WorkerService::NewStub(
+      ::grpc::CreateCustomChannel(worker_address, credentials, args));
+  auto get_element = [&](CompressedElement& element, bool& end_of_sequence) {
+    if (local) {
+      return client.GetElement(task_id, /*consumer_index=*/absl::nullopt,
+                               /*round_index=*/absl::nullopt, element,
+                               end_of_sequence);
+    }
+    GetElementRequest req;
+    req.set_task_id(task_id);
+    GetElementResponse resp;
+    ::grpc::ClientContext ctx;
+    ::grpc::Status s = stub->GetElement(&ctx, req, &resp);
+    if (!s.ok()) {
+      return grpc_util::WrapError("Failed to get element", s);
+    }
+    end_of_sequence = resp.end_of_sequence();
+    element = std::move(*resp.mutable_compressed_element());
+    return Status::OK();
+  };
+
+  CompressedElement compressed;
+  bool end_of_sequence;
+  // Waits for the worker to receive the task.
+  TF_CHECK_OK(GetElementWithRetries(get_element, compressed, end_of_sequence));
+  for (auto s : state) {
+    TF_CHECK_OK(get_element(compressed, end_of_sequence));
+    std::vector<Tensor> element;
+    TF_CHECK_OK(UncompressElement(compressed, &element));
+  }
+  state.SetLabel(local ? "local" : "grpc");
+  state.SetBytesProcessed(static_cast<int64>(state.iterations()) *
+                          element_size * sizeof(int64));
+}
+
+BENCHMARK(BM_GetElement)
+    ->UseRealTime()
+    ->ArgPair(false, 1 << 10)
+    ->ArgPair(true, 1 << 10)
+    ->ArgPair(false, 1 << 20)
+    ->ArgPair(true, 1 << 20);
+
 }  // namespace data
 }  // namespace tensorflow
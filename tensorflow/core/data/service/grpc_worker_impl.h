@@ -31,8 +31,10 @@ class GrpcWorkerImpl : public WorkerService::Service {
   // `server_builder`.
   explicit GrpcWorkerImpl(const experimental::WorkerConfig& config,
                           ::grpc::ServerBuilder& server_builder);
-  ~GrpcWorkerImpl() override {}
+  ~GrpcWorkerImpl() override;
 
+  // Starts the worker, and registers it as the local worker for
+  // `worker_address` (see `LocalWorkers`).
   Status Start(const std::string& worker_address);
 
 #define HANDLER(method)                                 \
@@ -45,7 +47,10 @@ class GrpcWorkerImpl : public WorkerService::Service {
 #undef HANDLER
 
  private:
-  DataServiceWorkerImpl impl_;
+  std::string worker_address_;
+  // Shared with `LocalWorkers`, so that in-process clients may finish their
+  // calls after this service has been destroyed.
+  std::shared_ptr<DataServiceWorkerImpl> impl_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(GrpcWorkerImpl);
 };
@@ -250,7 +250,9 @@ Status DataServiceWorkerImpl::GetElement(const GetElementRequest* request,
           "it produced ",
           variant.TypeName());
     }
-    *response->mutable_compressed_element() = *compressed;
+    // `outputs` is not used after this, so the element can be moved rather
+    // than copied.
+    *response->mutable_compressed_element() = std::move(*compressed);
   }
   response->set_end_of_sequence(end_of_sequence);
 
@@ -30,11 +30,12 @@ limitations under the License.
 namespace tensorflow {
 namespace data {
 
-// A TensorFlow DataService serves dataset elements over RPC.
-class DataServiceWorkerImpl {
+// A TensorFlow DataService serves dataset elements over RPC, and to clients in
+// the same process through `LocalWorkers`.
+class DataServiceWorkerImpl : public LocalWorker {
  public:
   explicit DataServiceWorkerImpl(const experimental::WorkerConfig& config);
-  ~DataServiceWorkerImpl();
+  ~DataServiceWorkerImpl() override;
 
   // Starts the worker. The worker needs to know its own address so that it can
   // register with the dispatcher. This is set in `Start` instead of in the
@@ -51,7 +52,7 @@ class DataServiceWorkerImpl {
 
   /// Client-facing API.
   Status GetElement(const GetElementRequest* request,
-                    GetElementResponse* response);
+                    GetElementResponse* response) override;
   Status GetWorkerTasks(const GetWorkerTasksRequest* request,
                         GetWorkerTasksResponse* response);
 
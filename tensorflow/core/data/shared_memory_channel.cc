@@ -0,0 +1,533 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/shared_memory_channel.h"
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // _MSC_VER
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>  // NOLINT
+
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/error.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+constexpr uint64 kMagic = 0x7466646174617368;  // "tfdatash"
+constexpr size_t kAlignment = 64;
+
+// Slot states.
+constexpr uint32 kFree = 0;
+constexpr uint32 kFull = 1;
+
+// Element kinds.
+constexpr uint32 kElement = 0;
+constexpr uint32 kEndOfSequence = 1;
+constexpr uint32 kError = 2;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "Shared memory channels need lock-free atomics.");
+
+// The header of the segment, followed by one `SlotState` per slot and then
+// by the slots.
+struct SegmentHeader {
+  uint64 magic;
+  uint64 num_slots;
+  uint64 slot_bytes;
+  uint64 slots_offset;
+  std::atomic<uint32> closed;
+};
+
+// Padded to avoid false sharing between the producer and the consumer.
+struct alignas(kAlignment) SlotState {
+  std::atomic<uint32> state;
+};
+
+// The header of a slot, followed by `num_components` `ComponentHeader`s, by the
+// dimensions of all components, by the error message (if any), and then by
+// the data of each component, aligned to `kAlignment`.
+struct ElementHeader {
+  uint32 kind;
+  uint32 num_components;
+  int32 error_code;
+  uint32 error_message_bytes;
+};
+
+struct ComponentHeader {
+  int32 dtype;
+  int32 rank;
+  // Relative to the start of the slot.
+  uint64 data_offset;
+  uint64 data_bytes;
+};
+
+size_t RoundUp(size_t bytes, size_t alignment) {
+  return (bytes + alignment - 1) / alignment * alignment;
+}
+
+size_t SlotsOffset(uint64 num_slots) {
+  return RoundUp(RoundUp(sizeof(SegmentHeader), kAlignment) +
+                     num_slots * sizeof(SlotState),
+                 kAlignment);
+}
+
+SlotState* SlotStates(SegmentHeader* header) {
+  return reinterpret_cast<SlotState*>(reinterpret_cast<char*>(header) +
+                                      RoundUp(sizeof(SegmentHeader),
+                                              kAlignment));
+}
+
+// Waits until `done()` returns true, or the channel is closed. Waits spin
+// briefly, then yield, then sleep for increasing intervals, so that a waiting
+// side does not burn a core when the other side is slow.
+template <typename Done>
+Status Wait(const SegmentHeader* header, const std::string& name,
+            const Done& done) {
+  int64 sleep_micros = 1;
+  for (int i = 0;; ++i) {
+    if (done()) return Status::OK();
+    if (header->closed.load(std::memory_order_acquire)) {
+      return errors::Cancelled("Shared memory channel ", name,
+                               " was closed.");
+    }
+    if (i < 64) {
+      continue;
+    } else if (i < 128) {
+      std::this_thread::yield();
+    } else {
+      Env::Default()->SleepForMicroseconds(sleep_micros);
+      sleep_micros = std::min<int64>(sleep_micros * 2, 100);
+    }
+  }
+}
+
+}  // namespace
+
+// A mapping of the shared memory segment. Tensors that alias the segment
+// hold a reference to it, so that it stays mapped as long as they live.
+class SharedMemoryChannel::Segment : public core::RefCounted {
+ public:
+  Segment(char* base, size_t size) : base_(base), size_(size) {}
+
+  // Number of slots read by this process that are still aliased by tensors.
+  std::atomic<int64> num_leased{0};
+
+  ~Segment() override {
+#ifndef _MSC_VER
+    munmap(base_, size_);
+#endif  // _MSC_VER
+  }
+
+  SegmentHeader* header() const {
+    return reinterpret_cast<SegmentHeader*>(base_);
+  }
+  SlotState* slot_state(uint64 index) const {
+    return &SlotStates(header())[index % header()->num_slots];
+  }
+  char* slot(uint64 index) const {
+    return base_ + header()->slots_offset +
+           (index % header()->num_slots) * header()->slot_bytes;
+  }
+
+ private:
+  char* const base_;
+  const size_t size_;
+};
+
+// A slot that was read. When the last reference is dropped, the slot is
+// handed back to the producer.
+class SharedMemoryChannel::SlotLease : public core::RefCounted {
+ public:
+  SlotLease(Segment* segment, SlotState* state)
+      : segment_(segment), state_(state) {
+    segment_->Ref();
+    segment_->num_leased.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  ~SlotLease() override {
+    segment_->num_leased.fetch_sub(1, std::memory_order_relaxed);
+    state_->state.store(kFree, std::memory_order_release);
+    segment_->Unref();
+  }
+
+ private:
+  Segment* const segment_;
+  SlotState* const state_;
+};
+
+// A tensor buffer that aliases a component in a slot.
+class SharedMemoryChannel::SlotBuffer : public TensorBuffer {
+ public:
+  SlotBuffer(SlotLease* lease, void* data, size_t size)
+      : TensorBuffer(data), lease_(lease), size_(size) {
+    lease_->Ref();
+  }
+
+  ~SlotBuffer() override { lease_->Unref(); }
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("shared_memory_channel");
+  }
+
+ private:
+  SlotLease* const lease_;
+  const size_t size_;
+};
+
+Status SharedMemoryChannel::Create(
+    const std::string& name, const Options& options,
+    std::unique_ptr<SharedMemoryChannel>* channel) {
+#ifdef _MSC_VER
+  return errors::Unimplemented(
+      "Shared memory channels are not supported on this platform.");
+#else
+  if (options.num_slots <= 0 || options.slot_bytes <= 0) {
+    return errors::InvalidArgument(
+        "Shared memory channels need a positive number of slots and slot "
+        "size, got ",
+        options.num_slots, " and ", options.slot_bytes);
+  }
+  const size_t slot_bytes = RoundUp(options.slot_bytes, kAlignment);
+  const size_t slots_offset = SlotsOffset(options.num_slots);
+  const size_t size = slots_offset + options.num_slots * slot_bytes;
+
+  const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    return IOError("Failed to create shared memory segment " + name, errno);
+  }
+  if (ftruncate(fd, size) != 0) {
+    const int error = errno;
+    close(fd);
+    shm_unlink(name.c_str());
+    return IOError("Failed to resize shared memory segment " + name, error);
+  }
+  void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    const int error = errno;
+    shm_unlink(name.c_str());
+    return IOError("Failed to map shared memory segment " + name, error);
+  }
+
+  // A new segment is zero-filled, so all slots start out free.
+  SegmentHeader* header = new (base) SegmentHeader;
+  header->num_slots = options.num_slots;
+  header->slot_bytes = slot_bytes;
+  header->slots_offset = slots_offset;
+  header->closed.store(0, std::memory_order_relaxed);
+  for (int64 i = 0; i < options.num_slots; ++i) {
+    new (&SlotStates(header)[i]) SlotState;
+    SlotStates(header)[i].state.store(kFree, std::memory_order_relaxed);
+  }
+  // Publish the segment only once it is initialized.
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = kMagic;
+
+  channel->reset(new SharedMemoryChannel(
+      name, new Segment(static_cast<char*>(base), size), /*owns_name=*/true));
+  return Status::OK();
+#endif  // _MSC_VER
+}
+
+Status SharedMemoryChannel::Open(
+    const std::string& name, std::unique_ptr<SharedMemoryChannel>* channel) {
+#ifdef _MSC_VER
+  return errors::Unimplemented(
+      "Shared memory channels are not supported on this platform.");
+#else
+  const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    return IOError("Failed to open shared memory segment " + name, errno);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    const int error = errno;
+    close(fd);
+    return IOError("Failed to stat shared memory segment " + name, error);
+  }
+  const size_t size = st.st_size;
+  void* base = nullptr;
+  if (size >= sizeof(SegmentHeader)) {
+    base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (base == nullptr || base == MAP_FAILED) {
+    return IOError("Failed to map shared memory segment " + name, errno);
+  }
+  core::RefCountPtr<Segment> segment(
+      new Segment(static_cast<char*>(base), size));
+  const SegmentHeader* header = segment->header();
+  if (header->magic != kMagic || header->num_slots == 0 ||
+      header->slots_offset != SlotsOffset(header->num_slots) ||
+      header->slots_offset + header->num_slots * header->slot_bytes > size) {
+    return errors::DataLoss("Shared memory segment ", name,
+                            " is not a valid channel.");
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  channel->reset(
+      new SharedMemoryChannel(name, segment.release(), /*owns_name=*/false));
+  return Status::OK();
+#endif  // _MSC_VER
+}
+
+SharedMemoryChannel::SharedMemoryChannel(const std::string& name,
+                                         Segment* segment, bool owns_name)
+    : name_(name), segment_(segment), owns_name_(owns_name) {}
+
+SharedMemoryChannel::~SharedMemoryChannel() {
+#ifndef _MSC_VER
+  if (owns_name_) {
+    shm_unlink(name_.c_str());
+  }
+#endif  // _MSC_VER
+}
+
+void SharedMemoryChannel::Close() {
+  segment_->header()->closed.store(1, std::memory_order_release);
+}
+
+bool SharedMemoryChannel::IsClosed() const {
+  return segment_->header()->closed.load(std::memory_order_acquire);
+}
+
+Status SharedMemoryChannel::WaitToWrite(char** slot) {
+  const SlotState* state = segment_->slot_state(next_index_);
+  TF_RETURN_IF_ERROR(Wait(segment_->header(), name_, [state]() {
+    return state->state.load(std::memory_order_acquire) == kFree;
+  }));
+  // The consumer does not close the channel while it holds slots, but the
+  // producer must not write into a closed channel.
+  if (IsClosed()) {
+    return errors::Cancelled("Shared memory channel ", name_, " was closed.");
+  }
+  *slot = segment_->slot(next_index_);
+  return Status::OK();
+}
+
+void SharedMemoryChannel::FinishWrite() {
+  segment_->slot_state(next_index_)
+      ->state.store(kFull, std::memory_order_release);
+  ++next_index_;
+}
+
+Status SharedMemoryChannel::Write(const std::vector<Tensor>& element) {
+  // Lay out the slot, serializing the components that cannot be copied with
+  // memcpy.
+  std::vector<TensorProto> protos(element.size());
+  size_t metadata_bytes =
+      sizeof(ElementHeader) + element.size() * sizeof(ComponentHeader);
+  for (const Tensor& component : element) {
+    metadata_bytes += component.dims() * sizeof(int64);
+  }
+  std::vector<ComponentHeader> components(element.size());
+  size_t offset = RoundUp(metadata_bytes, kAlignment);
+  for (size_t i = 0; i < element.size(); ++i) {
+    const Tensor& component = element[i];
+    components[i].dtype = component.dtype();
+    components[i].rank = component.dims();
+    components[i].data_offset = offset;
+    if (DataTypeCanUseMemcpy(component.dtype())) {
+      components[i].data_bytes = component.TotalBytes();
+    } else {
+      component.AsProtoTensorContent(&protos[i]);
+      components[i].data_bytes = protos[i].ByteSizeLong();
+    }
+    offset = RoundUp(offset + components[i].data_bytes, kAlignment);
+  }
+  const uint64 slot_bytes = segment_->header()->slot_bytes;
+  if (offset > slot_bytes) {
+    return errors::InvalidArgument(
+        "An element of ", offset, " bytes does not fit in a slot of ",
+        slot_bytes, " bytes of shared memory channel ", name_,
+        ". Consider increasing the slot size.");
+  }
+
+  char* slot;
+  TF_RETURN_IF_ERROR(WaitToWrite(&slot));
+  ElementHeader* header = reinterpret_cast<ElementHeader*>(slot);
+  header->kind = kElement;
+  header->num_components = element.size();
+  header->error_code = 0;
+  header->error_message_bytes = 0;
+  char* position = slot + sizeof(ElementHeader);
+  memcpy(position, components.data(),
+         components.size() * sizeof(ComponentHeader));
+  position += components.size() * sizeof(ComponentHeader);
+  for (const Tensor& component : element) {
+    for (int d = 0; d < component.dims(); ++d) {
+      const int64 dim = component.dim_size(d);
+      memcpy(position, &dim, sizeof(dim));
+      position += sizeof(dim);
+    }
+  }
+  for (size_t i = 0; i < element.size(); ++i) {
+    char* data = slot + components[i].data_offset;
+    if (DataTypeCanUseMemcpy(element[i].dtype())) {
+      if (components[i].data_bytes > 0) {
+        memcpy(data, DMAHelper::base(&element[i]), components[i].data_bytes);
+      }
+    } else {
+      protos[i].SerializeToArray(data, components[i].data_bytes);
+    }
+  }
+  FinishWrite();
+  return Status::OK();
+}
+
+Status SharedMemoryChannel::WriteEndOfSequence() {
+  char* slot;
+  TF_RETURN_IF_ERROR(WaitToWrite(&slot));
+  ElementHeader* header = reinterpret_cast<ElementHeader*>(slot);
+  header->kind = kEndOfSequence;
+  header->num_components = 0;
+  header->error_code = 0;
+  header->error_message_bytes = 0;
+  FinishWrite();
+  return Status::OK();
+}
+
+Status SharedMemoryChannel::WriteError(const Status& status) {
+  DCHECK(!status.ok());
+  const uint64 max_message_bytes =
+      segment_->header()->slot_bytes - sizeof(ElementHeader);
+  const size_t message_bytes =
+      std::min<size_t>(status.error_message().size(), max_message_bytes);
+  char* slot;
+  TF_RETURN_IF_ERROR(WaitToWrite(&slot));
+  ElementHeader* header = reinterpret_cast<ElementHeader*>(slot);
+  header->kind = kError;
+  header->num_components = 0;
+  header->error_code = status.code();
+  header->error_message_bytes = message_bytes;
+  memcpy(slot + sizeof(ElementHeader), status.error_message().data(),
+         message_bytes);
+  FinishWrite();
+  return Status::OK();
+}
+
+Status SharedMemoryChannel::Read(std::vector<Tensor>* element,
+                                 bool* end_of_sequence) {
+  SlotState* state = segment_->slot_state(next_index_);
+  TF_RETURN_IF_ERROR(Wait(segment_->header(), name_, [state]() {
+    return state->state.load(std::memory_order_acquire) == kFull;
+  }));
+  const char* slot = segment_->slot(next_index_);
+  ++next_index_;
+  // Hands the slot back to the producer once all tensors that alias it are
+  // destroyed.
+  core::RefCountPtr<SlotLease> lease(new SlotLease(segment_.get(), state));
+
+  const uint64 slot_bytes = segment_->header()->slot_bytes;
+  const ElementHeader* header = reinterpret_cast<const ElementHeader*>(slot);
+  *end_of_sequence = false;
+  element->clear();
+  switch (header->kind) {
+    case kEndOfSequence:
+      *end_of_sequence = true;
+      return Status::OK();
+    case kError:
+      return Status(
+          static_cast<error::Code>(header->error_code),
+          StringPiece(slot + sizeof(ElementHeader),
+                      std::min<uint64>(header->error_message_bytes,
+                                       slot_bytes - sizeof(ElementHeader))));
+    case kElement:
+      break;
+    default:
+      return errors::DataLoss("Corrupt element in shared memory channel ",
+                              name_);
+  }
+
+  const uint64 num_components = header->num_components;
+  if (sizeof(ElementHeader) + num_components * sizeof(ComponentHeader) >
+      slot_bytes) {
+    return errors::DataLoss("Corrupt element in shared memory channel ",
+                            name_);
+  }
+  // Copy the element out of the slot rather than alias it if the consumer
+  // already holds on to half of the slots (e.g. in a shuffle buffer), so that
+  // the producer never waits for the consumer's consumer.
+  const bool copy = segment_->num_leased.load(std::memory_order_relaxed) >
+                    static_cast<int64>(segment_->header()->num_slots / 2);
+  const ComponentHeader* components =
+      reinterpret_cast<const ComponentHeader*>(slot + sizeof(ElementHeader));
+  const char* dims = reinterpret_cast<const char*>(components + num_components);
+  element->reserve(num_components);
+  for (uint64 i = 0; i < num_components; ++i) {
+    const ComponentHeader& component = components[i];
+    const DataType dtype = static_cast<DataType>(component.dtype);
+    if (component.rank < 0 ||
+        dims + component.rank * sizeof(int64) > slot + slot_bytes ||
+        component.data_offset > slot_bytes ||
+        component.data_bytes > slot_bytes - component.data_offset) {
+      return errors::DataLoss("Corrupt element in shared memory channel ",
+                              name_);
+    }
+    TensorShape shape;
+    for (int d = 0; d < component.rank; ++d) {
+      int64 dim;
+      memcpy(&dim, dims, sizeof(dim));
+      dims += sizeof(dim);
+      TF_RETURN_IF_ERROR(shape.AddDimWithStatus(dim));
+    }
+    char* data = const_cast<char*>(slot) + component.data_offset;
+    if (!DataTypeCanUseMemcpy(dtype)) {
+      TensorProto proto;
+      element->emplace_back();
+      if (!proto.ParseFromArray(data, component.data_bytes) ||
+          !element->back().FromProto(proto)) {
+        return errors::DataLoss("Corrupt element in shared memory channel ",
+                                name_);
+      }
+    } else if (component.data_bytes == 0) {
+      element->emplace_back(dtype, shape);
+    } else {
+      if (component.data_bytes !=
+          static_cast<uint64>(shape.num_elements() * DataTypeSize(dtype))) {
+        return errors::DataLoss("Corrupt element in shared memory channel ",
+                                name_);
+      }
+      if (copy) {
+        element->emplace_back(dtype, shape);
+        memcpy(DMAHelper::base(&element->back()), data, component.data_bytes);
+        continue;
+      }
+      SlotBuffer* buffer =
+          new SlotBuffer(lease.get(), data, component.data_bytes);
+      element->emplace_back(dtype, shape, buffer);
+      buffer->Unref();
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,121 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_SHARED_MEMORY_CHANNEL_H_
+#define TENSORFLOW_CORE_DATA_SHARED_MEMORY_CHANNEL_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/refcount.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace data {
+
+// A single-producer, single-consumer channel of dataset elements in a named
+// POSIX shared memory segment, for passing elements between processes on one
+// host.
+//
+// The segment is divided into a fixed number of equally sized slots, which
+// are used in ring order; each slot holds one element. Components whose type
+// can be copied with memcpy are written as raw tensor bytes and are read
+// without a copy: the tensors returned by `Read()` alias the slot, which is
+// handed back to the producer once all of them have been destroyed. Once the
+// consumer holds on to more than half of the slots this way, elements are
+// copied out of their slots instead, so that the producer keeps making
+// progress. Other components (e.g. strings) are written as serialized
+// `TensorProto`s.
+//
+// Each side of the channel must be used by a single thread at a time.
+class SharedMemoryChannel {
+ public:
+  struct Options {
+    // Number of slots, i.e. the maximum number of elements written but not
+    // yet released by the consumer.
+    int64 num_slots = 16;
+    // Size of each slot, which bounds the size of an element.
+    int64 slot_bytes = 4 << 20;
+  };
+
+  // Creates a new shared memory segment named `name` for a channel. The name
+  // is removed when the returned channel is destroyed; processes that opened
+  // the segment before then can keep using it.
+  static Status Create(const std::string& name, const Options& options,
+                       std::unique_ptr<SharedMemoryChannel>* channel);
+
+  // Opens the existing channel named `name`.
+  static Status Open(const std::string& name,
+                     std::unique_ptr<SharedMemoryChannel>* channel);
+
+  // Tensors returned by `Read()` remain valid after the channel is destroyed.
+  ~SharedMemoryChannel();
+
+  // Writes `element`, blocking while the next slot is in use. Returns
+  // `InvalidArgument` if the element does not fit in a slot.
+  Status Write(const std::vector<Tensor>& element);
+
+  // Writes the end of the sequence. The consumer's `Read()` sets
+  // `*end_of_sequence` when it gets to it.
+  Status WriteEndOfSequence();
+
+  // Writes `status`, which must not be OK, in place of an element. The
+  // consumer's `Read()` returns it when it gets to it.
+  Status WriteError(const Status& status);
+
+  // Reads the next element, blocking until it is written.
+  Status Read(std::vector<Tensor>* element, bool* end_of_sequence);
+
+  // Closes the channel. Blocked and subsequent calls to `Write*()` fail, as
+  // do calls to `Read()` once all written elements have been read. May be
+  // called from any thread and any process.
+  void Close();
+
+  // Returns true if either side has closed the channel.
+  bool IsClosed() const;
+
+  const std::string& name() const { return name_; }
+
+ private:
+  class Segment;
+  class SlotBuffer;
+  class SlotLease;
+
+  SharedMemoryChannel(const std::string& name, Segment* segment,
+                      bool owns_name);
+
+  // Blocks until the next slot to write is free.
+  Status WaitToWrite(char** slot);
+  // Hands the slot returned by `WaitToWrite()` to the consumer.
+  void FinishWrite();
+
+  const std::string name_;
+  core::RefCountPtr<Segment> segment_;
+  // True if this channel created the segment and must remove its name.
+  const bool owns_name_;
+  // Index of the next slot to write, if this is the producer, and to read, if
+  // this is the consumer.
+  uint64 next_index_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedMemoryChannel);
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_SHARED_MEMORY_CHANNEL_H_
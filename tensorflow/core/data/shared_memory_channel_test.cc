@@ -0,0 +1,142 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/shared_memory_channel.h"
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+class SharedMemoryChannelTest : public ::testing::Test {
+ protected:
+  void CreateChannel(const SharedMemoryChannel::Options& options) {
+    const std::string name =
+        strings::StrCat("/tf_data_channel_test_", random::New64());
+    TF_ASSERT_OK(SharedMemoryChannel::Create(name, options, &producer_));
+    TF_ASSERT_OK(SharedMemoryChannel::Open(name, &consumer_));
+  }
+
+  std::unique_ptr<SharedMemoryChannel> producer_;
+  std::unique_ptr<SharedMemoryChannel> consumer_;
+};
+
+TEST_F(SharedMemoryChannelTest, RoundTrip) {
+  CreateChannel(SharedMemoryChannel::Options());
+  std::vector<Tensor> element = {
+      test::AsTensor<float>({1.0, 2.0, 3.0, 4.0}, TensorShape({2, 2})),
+      test::AsScalar<int64>(42),
+      test::AsTensor<tstring>({"a", "bc", ""}, TensorShape({3})),
+      Tensor(DT_INT32, TensorShape({0, 5})),
+  };
+  TF_ASSERT_OK(producer_->Write(element));
+
+  std::vector<Tensor> result;
+  bool end_of_sequence = true;
+  TF_ASSERT_OK(consumer_->Read(&result, &end_of_sequence));
+  EXPECT_FALSE(end_of_sequence);
+  ASSERT_EQ(result.size(), element.size());
+  test::ExpectTensorEqual<float>(result[0], element[0]);
+  test::ExpectTensorEqual<int64>(result[1], element[1]);
+  test::ExpectTensorEqual<tstring>(result[2], element[2]);
+  EXPECT_EQ(result[3].shape(), element[3].shape());
+}
+
+TEST_F(SharedMemoryChannelTest, EndOfSequenceAndError) {
+  CreateChannel(SharedMemoryChannel::Options());
+  TF_ASSERT_OK(producer_->WriteError(errors::DataLoss("bad element")));
+  TF_ASSERT_OK(producer_->WriteEndOfSequence());
+
+  std::vector<Tensor> result;
+  bool end_of_sequence = false;
+  Status s = consumer_->Read(&result, &end_of_sequence);
+  EXPECT_TRUE(errors::IsDataLoss(s));
+  EXPECT_EQ(s.error_message(), "bad element");
+  TF_ASSERT_OK(consumer_->Read(&result, &end_of_sequence));
+  EXPECT_TRUE(end_of_sequence);
+}
+
+TEST_F(SharedMemoryChannelTest, ElementTooLarge) {
+  SharedMemoryChannel::Options options;
+  options.slot_bytes = 1024;
+  CreateChannel(options);
+  Tensor large(DT_FLOAT, TensorShape({1024}));
+  EXPECT_TRUE(errors::IsInvalidArgument(producer_->Write({large})));
+  // The channel remains usable.
+  TF_ASSERT_OK(producer_->WriteEndOfSequence());
+  std::vector<Tensor> result;
+  bool end_of_sequence = false;
+  TF_ASSERT_OK(consumer_->Read(&result, &end_of_sequence));
+  EXPECT_TRUE(end_of_sequence);
+}
+
+TEST_F(SharedMemoryChannelTest, HeldElementsDoNotBlockProducer) {
+  SharedMemoryChannel::Options options;
+  options.num_slots = 4;
+  CreateChannel(options);
+  constexpr int kNumElements = 100;
+  std::unique_ptr<Thread> producer_thread(Env::Default()->StartThread(
+      ThreadOptions(), "producer", [this]() {
+        for (int i = 0; i < kNumElements; ++i) {
+          TF_ASSERT_OK(producer_->Write({test::AsScalar<int64>(i)}));
+        }
+        TF_ASSERT_OK(producer_->WriteEndOfSequence());
+      }));
+
+  // Keeps every element alive, so most of them must be copied out of their
+  // slots for the producer to make progress.
+  std::vector<std::vector<Tensor>> results;
+  while (true) {
+    std::vector<Tensor> result;
+    bool end_of_sequence = false;
+    TF_ASSERT_OK(consumer_->Read(&result, &end_of_sequence));
+    if (end_of_sequence) break;
+    results.push_back(std::move(result));
+  }
+  producer_thread.reset();
+  ASSERT_EQ(results.size(), kNumElements);
+  for (int i = 0; i < kNumElements; ++i) {
+    test::ExpectTensorEqual<int64>(results[i][0], test::AsScalar<int64>(i));
+  }
+}
+
+TEST_F(SharedMemoryChannelTest, CloseUnblocksRead) {
+  CreateChannel(SharedMemoryChannel::Options());
+  std::unique_ptr<Thread> closer(
+      Env::Default()->StartThread(ThreadOptions(), "closer", [this]() {
+        Env::Default()->SleepForMicroseconds(10000);
+        producer_->Close();
+      }));
+  std::vector<Tensor> result;
+  bool end_of_sequence = false;
+  EXPECT_TRUE(errors::IsCancelled(consumer_->Read(&result, &end_of_sequence)));
+  EXPECT_TRUE(consumer_->IsClosed());
+}
+
+TEST_F(SharedMemoryChannelTest, OpenMissingChannel) {
+  std::unique_ptr<SharedMemoryChannel> channel;
+  EXPECT_FALSE(SharedMemoryChannel::Open(
+                   strings::StrCat("/tf_data_missing_", random::New64()),
+                   &channel)
+                   .ok());
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -164,6 +164,12 @@ struct AllocatorStats {
 
   int64 largest_free_block_bytes;  // Largest free block's size in heap.
 
+  // Stats for allocators that serve small requests from per-thread caches
+  // before falling back to a shared, locked heap.
+  int64 num_cache_hits;        // Allocations served from a cache.
+  int64 num_cache_misses;      // Cacheable allocations that went to the heap.
+  int64 num_lock_contentions;  // Heap lock acquisitions that had to wait.
+
   AllocatorStats()
       : num_allocs(0),
         bytes_in_use(0),
@@ -171,7 +177,10 @@ struct AllocatorStats {
         largest_alloc_size(0),
         bytes_reserved(0),
         peak_bytes_reserved(0),
-        largest_free_block_bytes(0) {}
+        largest_free_block_bytes(0),
+        num_cache_hits(0),
+        num_cache_misses(0),
+        num_lock_contentions(0) {}
 
   std::string DebugString() const;
 };
@@ -15,7 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 namespace metrics {
@@ -67,6 +69,16 @@ auto* graph_unused_outputs = monitoring::Counter<1>::New(
 auto* tf_data_autotune_counter = monitoring::Counter<1>::New(
     "/tensorflow/data/autotune", "tf.data autotuning", "name");
 
+auto* tf_data_autotune_pipelines_gauge = monitoring::Gauge<int64, 0>::New(
+    "/tensorflow/data/autotune_pipelines",
+    "The number of tf.data input pipelines that share the CPU budget of the "
+    "process-wide autotuning coordinator.");
+
+auto* tf_data_autotune_cpu_budget_gauge = monitoring::Gauge<int64, 0>::New(
+    "/tensorflow/data/autotune_cpu_budget",
+    "The total CPU budget allocated to tf.data input pipelines by the "
+    "process-wide autotuning coordinator.");
+
 auto* tf_data_bytes_consumed_counter = monitoring::Counter<1>::New(
     "/tensorflow/data/bytes_consumed",
     "The number of bytes consumed by a tf.data Dataset.", "name");
@@ -153,6 +165,25 @@ auto* xla_compilation_time_usecs = monitoring::Counter<0>::New(
     "/tensorflow/core/xla_compilation_time_usecs",
     "The total time spent on compiling XLA graphs in microseconds.");
 
+auto* xla_persistent_cache_lookups = monitoring::Counter<1>::New(
+    "/tensorflow/core/xla_persistent_cache_lookups",
+    "The number of lookups of XLA executables in the persistent compilation "
+    "cache, by result (hit or miss).",
+    "result");
+
+auto* xla_compilation_cache_entries = monitoring::Gauge<int64, 0>::New(
+    "/tensorflow/core/xla_compilation_cache_entries",
+    "The number of entries in the XLA compilation caches of the process.");
+
+auto* xla_compilation_cache_bytes = monitoring::Gauge<int64, 0>::New(
+    "/tensorflow/core/xla_compilation_cache_bytes",
+    "The size in bytes of the XLA computations and executables held by the XLA "
+    "compilation caches of the process.");
+
+auto* xla_compilation_cache_evictions = monitoring::Counter<0>::New(
+    "/tensorflow/core/xla_compilation_cache_evictions",
+    "The number of entries evicted from XLA compilation caches.");
+
 auto* mlir_import_failure_count = monitoring::Counter<0>::New(
     "/tensorflow/mlir/import_failure_count",
     "The number of jobs that failed during mlir import or verification.");
@@ -168,6 +199,11 @@ void RecordTFDataAutotune(const string& name) {
   tf_data_autotune_counter->GetCell(name)->IncrementBy(1);
 }
 
+void RecordTFDataAutotuneCpuBudget(int64 num_pipelines, int64 cpu_budget) {
+  tf_data_autotune_pipelines_gauge->GetCell()->Set(num_pipelines);
+  tf_data_autotune_cpu_budget_gauge->GetCell()->Set(cpu_budget);
+}
+
 monitoring::CounterCell* GetTFDataBytesConsumedCounter(const string& name) {
   return tf_data_bytes_consumed_counter->GetCell(name);
 }
@@ -302,6 +338,29 @@ void UpdateXlaCompilationTime(const uint64 compilation_time_usecs) {
   }
 }
 
+void RecordXlaPersistentCacheLookup(bool hit) {
+  static auto* hit_cell = xla_persistent_cache_lookups->GetCell("hit");
+  static auto* miss_cell = xla_persistent_cache_lookups->GetCell("miss");
+  (hit ? hit_cell : miss_cell)->IncrementBy(1);
+}
+
+void UpdateXlaCompilationCacheSize(int64 entries_delta, int64 bytes_delta) {
+  static mutex* mu = new mutex;
+  static int64 entries = 0;
+  static int64 bytes = 0;
+  mutex_lock l(*mu);
+  entries += entries_delta;
+  bytes += bytes_delta;
+  xla_compilation_cache_entries->GetCell()->Set(entries);
+  xla_compilation_cache_bytes->GetCell()->Set(bytes);
+}
+
+void RecordXlaCompilationCacheEviction() {
+  static auto* xla_compilation_cache_evictions_cell =
+      xla_compilation_cache_evictions->GetCell();
+  xla_compilation_cache_evictions_cell->IncrementBy(1);
+}
+
 void UpdateBfcAllocatorDelayTime(const uint64 delay_usecs) {
   static auto* bfc_allocator_delay_cell = bfc_allocator_delay->GetCell();
   if (delay_usecs > 0) {
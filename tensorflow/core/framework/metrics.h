@@ -27,6 +27,11 @@ namespace metrics {
 // The `name` argument identifies the Dataset type (e.g. "ParallelMap").
 void RecordTFDataAutotune(const string& name);
 
+// Records the number of tf.data input pipelines registered with the
+// process-wide autotuning coordinator, and the total CPU budget it has
+// allocated to them.
+void RecordTFDataAutotuneCpuBudget(int64 num_pipelines, int64 cpu_budget);
+
 // Returns a counter that can be used to record the number of bytes produced by
 // a tf.data.Dataset.
 //
@@ -127,6 +132,17 @@ void UpdateGrapplerPassTime(const string& pass_name,
 // Updates the metrics stored about time XLA spents compiling graphs.
 void UpdateXlaCompilationTime(const uint64 compilation_time_usecs);
 
+// Records a lookup of an XLA executable in the persistent compilation cache,
+// which either loaded the executable (a hit) or did not (a miss).
+void RecordXlaPersistentCacheLookup(bool hit);
+
+// Updates the total number of entries and bytes held by XLA compilation caches
+// when a cache adds, grows or drops an entry.
+void UpdateXlaCompilationCacheSize(int64 entries_delta, int64 bytes_delta);
+
+// Records that an entry was evicted from an XLA compilation cache.
+void RecordXlaCompilationCacheEviction();
+
 // Updates the metrics stored about time BFC allocator spents during delay.
 void UpdateBfcAllocatorDelayTime(const uint64 delay_usecs);
 
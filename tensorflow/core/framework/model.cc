@@ -15,9 +15,16 @@ limitations under the License.
 
 #include "tensorflow/core/framework/model.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <memory>
+#include <set>
 
 #include "absl/time/clock.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 
 namespace tensorflow {
@@ -119,6 +126,121 @@ inline void UpdateStateValues(
   }
 }
 
+// Gaussian process regression with a squared exponential kernel, used by the
+// Bayesian optimization algorithm as a surrogate of the output time. Points are
+// vectors of coordinates in `[0, 1]`.
+class GaussianProcess {
+ public:
+  explicit GaussianProcess(double length_scale) : length_scale_(length_scale) {}
+
+  // Fits the process to the observations `values` at `points`.
+  void Fit(const std::vector<std::vector<double>>& points,
+           const std::vector<double>& values) {
+    // Variance of the observation noise relative to the signal, which also
+    // keeps the kernel matrix numerically positive definite.
+    constexpr double kNoise = 1e-4L;
+
+    points_ = points;
+    const size_t n = points_.size();
+    mean_ = 0;
+    for (double value : values) {
+      mean_ += value;
+    }
+    mean_ /= n;
+    double variance = 0;
+    for (double value : values) {
+      variance += Square(value - mean_);
+    }
+    scale_ = variance > 0 ? std::sqrt(variance / n) : 1.0;
+
+    // Computes the Cholesky factor of the kernel matrix.
+    cholesky_.assign(n, std::vector<double>(n, 0.0));
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j <= i; ++j) {
+        double sum = Kernel(points_[i], points_[j]) + (i == j ? kNoise : 0.0);
+        for (size_t k = 0; k < j; ++k) {
+          sum -= cholesky_[i][k] * cholesky_[j][k];
+        }
+        cholesky_[i][j] =
+            i == j ? std::sqrt(std::max(sum, kNoise)) : sum / cholesky_[j][j];
+      }
+    }
+
+    // Solves `K alpha = y` for the standardized observations `y`.
+    alpha_.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+      alpha_[i] = (values[i] - mean_) / scale_;
+    }
+    SolveLower(&alpha_);
+    for (size_t i = n; i-- > 0;) {
+      for (size_t k = i + 1; k < n; ++k) {
+        alpha_[i] -= cholesky_[k][i] * alpha_[k];
+      }
+      alpha_[i] /= cholesky_[i][i];
+    }
+  }
+
+  // Returns the posterior mean and standard deviation at `point`.
+  void Predict(const std::vector<double>& point, double* mean,
+               double* stddev) const {
+    std::vector<double> covariances(points_.size());
+    double standardized_mean = 0;
+    for (size_t i = 0; i < points_.size(); ++i) {
+      covariances[i] = Kernel(point, points_[i]);
+      standardized_mean += covariances[i] * alpha_[i];
+    }
+    SolveLower(&covariances);
+    double variance = 1.0;
+    for (double v : covariances) {
+      variance -= v * v;
+    }
+    *mean = mean_ + scale_ * standardized_mean;
+    *stddev = scale_ * std::sqrt(std::max(variance, 0.0));
+  }
+
+ private:
+  double Kernel(const std::vector<double>& a,
+                const std::vector<double>& b) const {
+    double distance = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+      distance += Square(a[i] - b[i]);
+    }
+    return std::exp(-distance / (2 * Square(length_scale_)));
+  }
+
+  // Solves `L x = b` in place, where `L` is the Cholesky factor.
+  void SolveLower(std::vector<double>* b) const {
+    for (size_t i = 0; i < b->size(); ++i) {
+      for (size_t k = 0; k < i; ++k) {
+        (*b)[i] -= cholesky_[i][k] * (*b)[k];
+      }
+      (*b)[i] /= cholesky_[i][i];
+    }
+  }
+
+  const double length_scale_;
+  std::vector<std::vector<double>> points_;
+  std::vector<std::vector<double>> cholesky_;
+  std::vector<double> alpha_;
+  // Mean and standard deviation used to standardize the observations.
+  double mean_ = 0;
+  double scale_ = 1;
+};
+
+// Returns the expected improvement over `best` of a normally distributed value
+// that is to be minimized.
+inline double ExpectedImprovement(double mean, double stddev, double best) {
+  if (stddev <= 0) {
+    return std::max(best - mean, 0.0);
+  }
+  const double z = (best - mean) / stddev;
+  const double cdf = 0.5 * std::erfc(-z / std::sqrt(2.0));
+  // The square root of `2 * pi`.
+  constexpr double kSqrt2Pi = 2.50662827463100050242L;
+  const double pdf = std::exp(-0.5 * z * z) / kSqrt2Pi;
+  return (best - mean) * cdf + stddev * pdf;
+}
+
 // The first input of InterleaveMany corresponds to the input dataset whose
 // elements are used to create the (derived) input datasets whose elements are
 // interleaved as output.
@@ -1470,6 +1592,9 @@ void Model::Optimize(AutotuneAlgorithm algorithm, int64 cpu_budget,
     case AutotuneAlgorithm::GRADIENT_DESCENT:
       OptimizeGradientDescent(cpu_budget, ram_budget, model_input_time);
       break;
+    case AutotuneAlgorithm::BAYESIAN_OPTIMIZATION:
+      OptimizeBayesian(cpu_budget, ram_budget, model_input_time);
+      break;
   }
 }
 
@@ -1483,6 +1608,18 @@ void Model::RemoveNode(std::shared_ptr<Node> node) {
   }
 }
 
+double Model::TotalProcessingTime() {
+  std::shared_ptr<Node> output;
+  {
+    tf_shared_lock lock(mu_);
+    output = output_;
+  }
+  if (!output) {
+    return 0;
+  }
+  return TotalProcessingTime(output);
+}
+
 absl::flat_hash_map<string, std::shared_ptr<Parameter>>
 Model::CollectTunableParameters(std::shared_ptr<Node> node) {
   absl::flat_hash_map<string, std::shared_ptr<Parameter>> parameters;
@@ -1655,6 +1792,252 @@ void Model::OptimizeHillClimb(int64 cpu_budget, int64 ram_budget,
   UpdateStateValues(&parameters);
 }
 
+void Model::OptimizeBayesian(int64 cpu_budget, int64 ram_budget,
+                             double model_input_time) {
+  std::shared_ptr<Node> snapshot;
+  {
+    tf_shared_lock lock(mu_);
+    snapshot = output_->Snapshot();
+  }
+  VLOG(2) << "Starting optimization of tunable parameters with Bayesian "
+             "Optimization.";
+  absl::flat_hash_map<string, double> processing_times;
+  const double processing_time =
+      snapshot->TotalProcessingTime(&processing_times);
+  auto parameters = CollectTunableParameters(snapshot);
+  if (parameters.empty()) {
+    VLOG(2) << "The Bayesian Optimization is terminated since no node with "
+               "tunable parameters has recorded elements.";
+    return;
+  }
+
+  // Maximum number of parameter values for which the output time is evaluated.
+  constexpr int kMaxEvaluations = 40;
+
+  // Number of random candidates considered for the next evaluation, in addition
+  // to the neighbors of the best values found so far.
+  constexpr int kNumRandomCandidates = 256;
+
+  // Optimization is stopped once the expected improvement of the logarithm of
+  // the output time is smaller than this value.
+  constexpr double kMinExpectedImprovement = 1e-3L;
+
+  // Length scale of the surrogate kernel, in the normalized parameter space.
+  constexpr double kLengthScale = 0.3L;
+
+  // Parameters whose range is wider than this value are searched on a
+  // logarithmic scale.
+  constexpr double kLogScaleRange = 64.0L;
+
+  // The searched parameters, in a deterministic order. Parameters whose range
+  // is a single value are left at that value.
+  std::vector<std::pair<string, std::shared_ptr<Parameter>>> searched;
+  std::vector<double> current_values;
+  double min_parallelism = 0;
+  for (auto& pair : parameters) {
+    if (pair.second->name == kParallelism) {
+      min_parallelism += pair.second->min;
+    }
+    if (pair.second->max > pair.second->min) {
+      searched.push_back(pair);
+    }
+  }
+  std::sort(searched.begin(), searched.end(),
+            [](const std::pair<string, std::shared_ptr<Parameter>>& a,
+               const std::pair<string, std::shared_ptr<Parameter>>& b) {
+              return a.first < b.first;
+            });
+  for (auto& pair : searched) {
+    current_values.push_back(std::round(pair.second->value));
+  }
+
+  // Initialize the parameter values to minimal before tuning.
+  for (auto& pair : parameters) {
+    pair.second->value = pair.second->min;
+  }
+
+  // Maps a parameter value to and from the normalized parameter space.
+  auto normalize = [](const Parameter& parameter, double value) {
+    const double range = parameter.max - parameter.min;
+    if (range > kLogScaleRange) {
+      return std::log1p(value - parameter.min) / std::log1p(range);
+    }
+    return (value - parameter.min) / range;
+  };
+  auto denormalize = [](const Parameter& parameter, double x) {
+    const double range = parameter.max - parameter.min;
+    const double value = range > kLogScaleRange
+                             ? std::expm1(x * std::log1p(range))
+                             : x * range;
+    return std::min(parameter.max,
+                    std::max(parameter.min, parameter.min + std::round(value)));
+  };
+
+  // Scales parallelism values down so that their total does not exceed the
+  // CPU budget, unless the minimum values already do.
+  const double max_parallelism =
+      std::max(static_cast<double>(cpu_budget), min_parallelism);
+  auto fit_cpu_budget = [&](std::vector<double>* values) {
+    double total_parallelism = min_parallelism;
+    for (size_t i = 0; i < searched.size(); ++i) {
+      if (searched[i].second->name == kParallelism) {
+        total_parallelism += (*values)[i] - searched[i].second->min;
+      }
+    }
+    if (total_parallelism <= max_parallelism) {
+      return;
+    }
+    const double scale = (max_parallelism - min_parallelism) /
+                         (total_parallelism - min_parallelism);
+    for (size_t i = 0; i < searched.size(); ++i) {
+      const Parameter& parameter = *searched[i].second;
+      if (parameter.name == kParallelism) {
+        (*values)[i] =
+            parameter.min + std::floor(((*values)[i] - parameter.min) * scale);
+      }
+    }
+  };
+  auto set_values = [&](const std::vector<double>& values) {
+    for (size_t i = 0; i < searched.size(); ++i) {
+      searched[i].second->value = values[i];
+    }
+  };
+
+  std::vector<std::vector<double>> points;
+  std::vector<double> observations;
+  std::set<std::vector<double>> evaluated;
+  std::vector<double> best_values;
+  double best_output_time = 0;
+  auto evaluate = [&](const std::vector<double>& values) {
+    set_values(values);
+    const double output_time =
+        OutputTime(snapshot, model_input_time, /*gradients=*/nullptr);
+    std::vector<double> point(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      point[i] = normalize(*searched[i].second, values[i]);
+    }
+    points.push_back(std::move(point));
+    observations.push_back(std::log1p(output_time));
+    evaluated.insert(values);
+    if (best_values.empty() || output_time < best_output_time) {
+      best_values = values;
+      best_output_time = output_time;
+    }
+  };
+  auto within_ram_budget = [&](const std::vector<double>& values) {
+    set_values(values);
+    return TotalMaximumBufferedBytes(snapshot) <= ram_budget;
+  };
+
+  std::vector<double> min_values;
+  for (auto& pair : searched) {
+    min_values.push_back(pair.second->min);
+  }
+  evaluate(min_values);
+  // If even the minimum values do not fit in the RAM budget, we keep them.
+  const bool search = within_ram_budget(min_values);
+
+  // Seeds the search with the current values and with the CPU budget divided
+  // between parallelism parameters in proportion to the processing time of
+  // their nodes. The first approximates the output time of a pipeline of
+  // asynchronous nodes as the maximum of `processing_time / parallelism` over
+  // the nodes.
+  std::vector<double> proportional_values;
+  double parallel_processing_time = 0;
+  for (auto& pair : searched) {
+    if (pair.second->name == kParallelism) {
+      parallel_processing_time += processing_times[pair.first];
+    }
+  }
+  for (auto& pair : searched) {
+    const Parameter& parameter = *pair.second;
+    if (parameter.name == kParallelism && parallel_processing_time > 0) {
+      proportional_values.push_back(std::min(
+          parameter.max,
+          std::max(parameter.min,
+                   std::floor(max_parallelism * processing_times[pair.first] /
+                              parallel_processing_time))));
+    } else {
+      proportional_values.push_back(denormalize(parameter, 0.5));
+    }
+  }
+  for (auto* values : {&current_values, &proportional_values}) {
+    fit_cpu_budget(values);
+    if (search && !evaluated.count(*values) && within_ram_budget(*values)) {
+      evaluate(*values);
+    }
+  }
+
+  random::PhiloxRandom philox(/*seed=*/0);
+  random::SimplePhilox rng(&philox);
+  GaussianProcess surrogate(kLengthScale);
+  while (search && points.size() < kMaxEvaluations &&
+         best_output_time >= processing_time / cpu_budget) {
+    surrogate.Fit(points, observations);
+    const double best_observation = std::log1p(best_output_time);
+
+    // Candidates are random values and the neighbors of the best values.
+    std::vector<std::vector<double>> candidates;
+    for (int i = 0; i < kNumRandomCandidates; ++i) {
+      std::vector<double> values(searched.size());
+      for (size_t j = 0; j < searched.size(); ++j) {
+        values[j] = denormalize(*searched[j].second, rng.RandDouble());
+      }
+      candidates.push_back(std::move(values));
+    }
+    for (size_t j = 0; j < searched.size(); ++j) {
+      const Parameter& parameter = *searched[j].second;
+      const double value = best_values[j];
+      for (double neighbor : {value - 1, value + 1, std::floor(value / 2),
+                              value * 2}) {
+        std::vector<double> values = best_values;
+        values[j] = std::min(parameter.max, std::max(parameter.min, neighbor));
+        candidates.push_back(std::move(values));
+      }
+    }
+
+    std::vector<std::pair<double, std::vector<double>>> ranked;
+    for (auto& values : candidates) {
+      fit_cpu_budget(&values);
+      if (evaluated.count(values)) {
+        continue;
+      }
+      std::vector<double> point(values.size());
+      for (size_t j = 0; j < values.size(); ++j) {
+        point[j] = normalize(*searched[j].second, values[j]);
+      }
+      double mean, stddev;
+      surrogate.Predict(point, &mean, &stddev);
+      ranked.emplace_back(ExpectedImprovement(mean, stddev, best_observation),
+                          std::move(values));
+    }
+    std::sort(ranked.begin(), ranked.end(),
+              [](const std::pair<double, std::vector<double>>& a,
+                 const std::pair<double, std::vector<double>>& b) {
+                return a.first > b.first;
+              });
+    const std::vector<double>* next = nullptr;
+    for (auto& candidate : ranked) {
+      if (candidate.first < kMinExpectedImprovement) {
+        break;
+      }
+      if (within_ram_budget(candidate.second)) {
+        next = &candidate.second;
+        break;
+      }
+    }
+    if (!next) {
+      break;
+    }
+    evaluate(*next);
+  }
+  VLOG(2) << "Bayesian Optimization evaluated " << points.size()
+          << " parameter values.";
+
+  set_values(best_values);
+  UpdateStateValues(&parameters);
+}
+
 double Model::OutputTime(std::shared_ptr<Node> node, double model_input_time,
                          absl::flat_hash_map<string, double>* gradients) {
   // To store the input time for each node.
@@ -1683,6 +2066,121 @@ double Model::TotalProcessingTime(std::shared_ptr<Node> node) {
   return node->TotalProcessingTime(/*processing_times=*/nullptr);
 }
 
+ModelCoordinator* ModelCoordinator::Global() {
+  static ModelCoordinator* coordinator = [] {
+    int64 cpu_budget = port::NumSchedulableCPUs();
+    const char* env_cpu_budget = std::getenv("TF_DATA_AUTOTUNE_CPU_BUDGET");
+    if (env_cpu_budget != nullptr) {
+      int64 value;
+      if (strings::safe_strto64(env_cpu_budget, &value) && value > 0) {
+        cpu_budget = value;
+      } else {
+        LOG(WARNING) << "Ignoring invalid TF_DATA_AUTOTUNE_CPU_BUDGET value: "
+                     << env_cpu_budget;
+      }
+    }
+    return new ModelCoordinator(cpu_budget);
+  }();
+  return coordinator;
+}
+
+void ModelCoordinator::SetCpuBudget(int64 cpu_budget) {
+  mutex_lock l(mu_);
+  cpu_budget_ = cpu_budget;
+  RebalanceLocked();
+}
+
+void ModelCoordinator::Register(const Model* model) {
+  mutex_lock l(mu_);
+  Pipeline pipeline;
+  pipeline.id = next_id_++;
+  pipeline.max_cpu_budget = cpu_budget_;
+  pipelines_.emplace(model, pipeline);
+  RebalanceLocked();
+}
+
+void ModelCoordinator::Unregister(const Model* model) {
+  mutex_lock l(mu_);
+  auto it = pipelines_.find(model);
+  if (it == pipelines_.end()) {
+    return;
+  }
+  pipelines_.erase(it);
+  RebalanceLocked();
+}
+
+int64 ModelCoordinator::UpdateCpuBudget(const Model* model,
+                                        double processing_time,
+                                        double input_time,
+                                        int64 max_cpu_budget) {
+  mutex_lock l(mu_);
+  auto* pipeline = gtl::FindOrNull(pipelines_, model);
+  if (!pipeline) {
+    return max_cpu_budget;
+  }
+  pipeline->processing_time = processing_time;
+  pipeline->input_time = input_time;
+  pipeline->max_cpu_budget = max_cpu_budget;
+  RebalanceLocked();
+  return pipeline->cpu_budget;
+}
+
+void ModelCoordinator::RebalanceLocked() {
+  std::vector<Pipeline*> pipelines;
+  for (auto& pair : pipelines_) {
+    pipelines.push_back(&pair.second);
+  }
+  std::sort(pipelines.begin(), pipelines.end(),
+            [](const Pipeline* a, const Pipeline* b) { return a->id < b->id; });
+
+  // Estimated element cycle time of the given pipeline with the given budget.
+  auto cycle_time = [](const Pipeline& pipeline, int64 cpu_budget) {
+    return std::max(pipeline.processing_time / cpu_budget,
+                    pipeline.input_time);
+  };
+
+  int64 remaining = cpu_budget_;
+  for (Pipeline* pipeline : pipelines) {
+    pipeline->cpu_budget = 1;
+    --remaining;
+  }
+  while (remaining > 0) {
+    Pipeline* best = nullptr;
+    double best_benefit = 0;
+    for (Pipeline* pipeline : pipelines) {
+      if (pipeline->cpu_budget >= pipeline->max_cpu_budget) {
+        continue;
+      }
+      const double benefit = cycle_time(*pipeline, pipeline->cpu_budget) -
+                             cycle_time(*pipeline, pipeline->cpu_budget + 1);
+      if (benefit > best_benefit) {
+        best = pipeline;
+        best_benefit = benefit;
+      }
+    }
+    if (!best) {
+      break;
+    }
+    ++best->cpu_budget;
+    --remaining;
+  }
+  // Spreads the cores that would not benefit any pipeline evenly.
+  bool assigned = true;
+  while (remaining > 0 && assigned) {
+    assigned = false;
+    for (Pipeline* pipeline : pipelines) {
+      if (remaining > 0 && pipeline->cpu_budget < pipeline->max_cpu_budget) {
+        ++pipeline->cpu_budget;
+        --remaining;
+        assigned = true;
+      }
+    }
+  }
+
+  metrics::RecordTFDataAutotuneCpuBudget(pipelines.size(),
+                                         cpu_budget_ - remaining);
+}
+
 }  // namespace model
 }  // namespace data
 }  // namespace tensorflow
@@ -48,6 +48,7 @@ constexpr char kModelInputTimeKey[] = "model_input_time";
 enum class AutotuneAlgorithm {
   HILL_CLIMB = 0,
   GRADIENT_DESCENT = 1,
+  BAYESIAN_OPTIMIZATION = 2,
 };
 
 enum class TraversalOrder {
@@ -642,6 +643,10 @@ class Model {
   // Removes the given node.
   void RemoveNode(std::shared_ptr<Node> node) TF_LOCKS_EXCLUDED(mu_);
 
+  // Returns the per-element processing time of the input pipeline, summed over
+  // the nodes for which autotuning is enabled.
+  double TotalProcessingTime() TF_LOCKS_EXCLUDED(mu_);
+
  private:
   // Collects tunable parameters in the tree rooted in the given node, returning
   // a mapping from a (unique) node name to a tunable parameter.
@@ -679,6 +684,20 @@ class Model {
   void OptimizeGradientDescent(int64 cpu_budget, int64 ram_budget,
                                double model_input_time);
 
+  // This optimization algorithm treats the output time predicted by the model
+  // as an expensive function of the tunable parameters and minimizes it with
+  // Bayesian optimization. It fits a Gaussian process surrogate to the output
+  // times of the parameter values evaluated so far and next evaluates the
+  // values with the largest expected improvement among candidates whose total
+  // parallelism fits in the CPU budget and whose buffers fit in the RAM budget.
+  // The search starts from the minimum values, the current values and an
+  // allocation of the CPU budget proportional to the processing time of each
+  // node. It stops once the expected improvement is negligible, the output time
+  // is less than the processing time needed to produce an element divided by
+  // CPU budget, or after a fixed number of evaluations.
+  void OptimizeBayesian(int64 cpu_budget, int64 ram_budget,
+                        double model_input_time);
+
   // Collects the output time and if `gradients` is not `nullptr`, the output
   // time gradient w.r.t. tunable parameters of the subtree rooted in the given
   // node.
@@ -714,6 +733,64 @@ class Model {
   std::atomic<bool> collect_resource_usage_;
 };
 
+// Divides a process-wide CPU budget among the models of input pipelines that
+// are autotuned concurrently, so that together they do not oversubscribe the
+// CPU. Each input pipeline periodically reports the per-element processing
+// time of its model and the time its consumer spends between requests, and
+// passes the share of the budget it receives to `Model::Optimize`.
+//
+// Every model gets at least one core. The remaining cores are assigned one at
+// a time to the model with the largest marginal benefit, that is the largest
+// decrease of its element cycle time, which is estimated as
+// `max(processing_time / cpu_budget, input_time)`. Cores that would not
+// benefit any model are spread evenly.
+class ModelCoordinator {
+ public:
+  explicit ModelCoordinator(int64 cpu_budget) : cpu_budget_(cpu_budget) {}
+
+  // Returns the coordinator shared by all input pipelines of the process. Its
+  // CPU budget is read from the `TF_DATA_AUTOTUNE_CPU_BUDGET` environment
+  // variable and defaults to the number of schedulable CPUs.
+  static ModelCoordinator* Global();
+
+  // Sets the CPU budget divided among the models.
+  void SetCpuBudget(int64 cpu_budget) TF_LOCKS_EXCLUDED(mu_);
+
+  // Adds the given model to the models among which the budget is divided.
+  void Register(const Model* model) TF_LOCKS_EXCLUDED(mu_);
+
+  // Removes the given model from the models among which the budget is divided.
+  void Unregister(const Model* model) TF_LOCKS_EXCLUDED(mu_);
+
+  // Records the per-element processing time and input time, in nanoseconds, of
+  // the given model and returns its share of the CPU budget, which is at most
+  // `max_cpu_budget`. A model that is registered alone gets the smaller of
+  // `max_cpu_budget` and the budget of the coordinator. Returns
+  // `max_cpu_budget` if the model is not registered.
+  int64 UpdateCpuBudget(const Model* model, double processing_time,
+                        double input_time, int64 max_cpu_budget)
+      TF_LOCKS_EXCLUDED(mu_);
+
+ private:
+  struct Pipeline {
+    // Identifies the model in the metrics; assigned in registration order.
+    int64 id;
+    double processing_time = 0;
+    double input_time = 0;
+    int64 max_cpu_budget = 0;
+    int64 cpu_budget = 1;
+  };
+
+  // Divides `cpu_budget_` among the registered models and records the
+  // allocation in the tf.data metrics.
+  void RebalanceLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  mutex mu_;
+  int64 cpu_budget_ TF_GUARDED_BY(mu_);
+  int64 next_id_ TF_GUARDED_BY(mu_) = 0;
+  absl::flat_hash_map<const Model*, Pipeline> pipelines_ TF_GUARDED_BY(mu_);
+};
+
 }  // namespace model
 }  // namespace data
 }  // namespace tensorflow
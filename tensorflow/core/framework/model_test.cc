@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace data {
@@ -1032,7 +1033,212 @@ TEST_P(OptimizeZeroRamBudgetTest, Model) {
 }
 
 INSTANTIATE_TEST_SUITE_P(Test, OptimizeZeroRamBudgetTest,
-                         ::testing::Values(0, 1));
+                         ::testing::Values(0, 1, 2));
+
+// Adds to `model` a synthetic pipeline of asynchronous nodes with tunable
+// parallelism on top of a source, where node `i` spends `processing_times[i]`
+// nanoseconds on each element and buffers elements of `element_size` bytes.
+// Returns the asynchronous nodes, starting from the output.
+std::vector<std::shared_ptr<Node>> AddSyntheticPipeline(
+    const std::vector<int64>& processing_times, int64 max_parallelism,
+    int64 element_size, Model* model) {
+  std::vector<std::shared_ptr<Node>> nodes;
+  std::shared_ptr<Node> parent;
+  for (int64 i = 0; i < static_cast<int64>(processing_times.size()); ++i) {
+    std::shared_ptr<Node> node = model::MakeAsyncKnownRatioNode(
+        {i, strings::StrCat("map_", i), parent}, 1,
+        {model::MakeParameter(
+            "parallelism",
+            std::make_shared<SharedState>(/*value=*/model::kAutotune,
+                                          std::make_shared<mutex>(),
+                                          std::make_shared<condition_variable>()),
+            /*min=*/1, /*max=*/max_parallelism)});
+    node->add_processing_time(processing_times[i]);
+    node->record_element();
+    node->record_buffer_event(element_size, 1);
+    model->AddNode([&node](model::Node::Args args) { return node; },
+                   node->name(), parent, &node);
+    nodes.push_back(node);
+    parent = node;
+  }
+  std::shared_ptr<Node> source = model::MakeSourceNode({});
+  model->AddNode([&source](model::Node::Args args) { return source; },
+                 "source", parent, &source);
+  return nodes;
+}
+
+TEST(OptimizeBayesianTest, Model) {
+  model::Model model;
+  std::vector<std::shared_ptr<Node>> nodes =
+      AddSyntheticPipeline({100, 400, 200}, /*max_parallelism=*/16,
+                           /*element_size=*/1, &model);
+
+  model.Optimize(model::AutotuneAlgorithm::BAYESIAN_OPTIMIZATION,
+                 /*cpu_budget=*/8, /*ram_budget=*/1000,
+                 /*model_input_time=*/0);
+  double total_parallelism = 0;
+  for (const auto& node : nodes) {
+    const double parallelism = node->parameter_value("parallelism");
+    EXPECT_GE(parallelism, 1);
+    total_parallelism += parallelism;
+  }
+  EXPECT_LE(total_parallelism, 8);
+  // The most expensive node gets the most parallelism.
+  EXPECT_GE(nodes[1]->parameter_value("parallelism"),
+            nodes[0]->parameter_value("parallelism"));
+  EXPECT_GE(nodes[1]->parameter_value("parallelism"),
+            nodes[2]->parameter_value("parallelism"));
+}
+
+TEST(OptimizeBayesianRamBudgetTest, Model) {
+  model::Model model;
+  std::vector<std::shared_ptr<Node>> nodes =
+      AddSyntheticPipeline({100, 400, 200}, /*max_parallelism=*/16,
+                           /*element_size=*/100, &model);
+
+  model.Optimize(model::AutotuneAlgorithm::BAYESIAN_OPTIMIZATION,
+                 /*cpu_budget=*/64, /*ram_budget=*/1000,
+                 /*model_input_time=*/0);
+  double buffered_bytes = 0;
+  for (const auto& node : nodes) {
+    buffered_bytes += node->parameter_value("parallelism") * 100;
+  }
+  EXPECT_LE(buffered_bytes, 1000);
+}
+
+// Optimizes a synthetic pipeline of `state.range(1)` nodes with heterogeneous
+// processing times using the algorithm `state.range(0)`, and reports the
+// output time predicted for the chosen parameters.
+static void BM_OptimizeSyntheticPipeline(::testing::benchmark::State& state) {
+  const auto algorithm = static_cast<model::AutotuneAlgorithm>(state.range(0));
+  std::vector<int64> processing_times;
+  for (int i = 0; i < state.range(1); ++i) {
+    processing_times.push_back(1000 * (1 + (i * 7) % 5));
+  }
+  model::Model model;
+  std::vector<std::shared_ptr<Node>> nodes =
+      AddSyntheticPipeline(processing_times, /*max_parallelism=*/32,
+                           /*element_size=*/1024, &model);
+
+  for (auto s : state) {
+    model.Optimize(algorithm, /*cpu_budget=*/16, /*ram_budget=*/1 << 20,
+                   /*model_input_time=*/0);
+  }
+
+  absl::flat_hash_map<string, double> input_times;
+  input_times[kModelInputTimeKey] = 0;
+  const double output_time = nodes.front()->OutputTime(&input_times, nullptr);
+  state.SetLabel(strings::StrCat("output_time:", output_time, "ns"));
+}
+
+BENCHMARK(BM_OptimizeSyntheticPipeline)
+    ->ArgPair(0, 4)
+    ->ArgPair(1, 4)
+    ->ArgPair(2, 4)
+    ->ArgPair(0, 16)
+    ->ArgPair(1, 16)
+    ->ArgPair(2, 16);
+
+TEST(ModelCoordinatorTest, SingleModelGetsWholeBudget) {
+  ModelCoordinator coordinator(/*cpu_budget=*/8);
+  Model model;
+  coordinator.Register(&model);
+  EXPECT_EQ(coordinator.UpdateCpuBudget(&model, /*processing_time=*/1000,
+                                        /*input_time=*/0,
+                                        /*max_cpu_budget=*/8),
+            8);
+  EXPECT_EQ(coordinator.UpdateCpuBudget(&model, /*processing_time=*/1000,
+                                        /*input_time=*/0,
+                                        /*max_cpu_budget=*/3),
+            3);
+}
+
+TEST(ModelCoordinatorTest, SingleModelIsLimitedToProcessBudget) {
+  ModelCoordinator coordinator(/*cpu_budget=*/4);
+  Model model;
+  coordinator.Register(&model);
+  // A pipeline whose own budget exceeds the process budget gets only the
+  // process budget, even when no other pipeline is running.
+  EXPECT_EQ(coordinator.UpdateCpuBudget(&model, /*processing_time=*/1000,
+                                        /*input_time=*/0,
+                                        /*max_cpu_budget=*/16),
+            4);
+  // Cores that would not speed the pipeline up are still assigned to it.
+  EXPECT_EQ(coordinator.UpdateCpuBudget(&model, /*processing_time=*/1000,
+                                        /*input_time=*/2000,
+                                        /*max_cpu_budget=*/16),
+            4);
+}
+
+TEST(ModelCoordinatorTest, DividesBudgetByMarginalBenefit) {
+  ModelCoordinator coordinator(/*cpu_budget=*/16);
+  Model heavy, light, consumer_bound;
+  coordinator.Register(&heavy);
+  coordinator.Register(&light);
+  coordinator.Register(&consumer_bound);
+  coordinator.UpdateCpuBudget(&heavy, /*processing_time=*/8000,
+                              /*input_time=*/0, /*max_cpu_budget=*/16);
+  coordinator.UpdateCpuBudget(&light, /*processing_time=*/1000,
+                              /*input_time=*/0, /*max_cpu_budget=*/16);
+  // The consumer of this pipeline takes longer than one core needs to produce
+  // an element, so additional cores would not benefit it.
+  coordinator.UpdateCpuBudget(&consumer_bound, /*processing_time=*/1000,
+                              /*input_time=*/2000, /*max_cpu_budget=*/16);
+
+  const int64 heavy_budget = coordinator.UpdateCpuBudget(
+      &heavy, /*processing_time=*/8000, /*input_time=*/0,
+      /*max_cpu_budget=*/16);
+  const int64 light_budget = coordinator.UpdateCpuBudget(
+      &light, /*processing_time=*/1000, /*input_time=*/0,
+      /*max_cpu_budget=*/16);
+  const int64 consumer_bound_budget = coordinator.UpdateCpuBudget(
+      &consumer_bound, /*processing_time=*/1000, /*input_time=*/2000,
+      /*max_cpu_budget=*/16);
+  EXPECT_EQ(heavy_budget + light_budget + consumer_bound_budget, 16);
+  EXPECT_GT(heavy_budget, light_budget);
+  EXPECT_GE(light_budget, 1);
+  EXPECT_EQ(consumer_bound_budget, 1);
+}
+
+TEST(ModelCoordinatorTest, Unregister) {
+  ModelCoordinator coordinator(/*cpu_budget=*/8);
+  Model first, second;
+  coordinator.Register(&first);
+  coordinator.Register(&second);
+  EXPECT_EQ(coordinator.UpdateCpuBudget(&second, /*processing_time=*/1000,
+                                        /*input_time=*/0,
+                                        /*max_cpu_budget=*/8),
+            7);
+  EXPECT_EQ(coordinator.UpdateCpuBudget(&first, /*processing_time=*/1000,
+                                        /*input_time=*/0,
+                                        /*max_cpu_budget=*/8),
+            4);
+  coordinator.Unregister(&second);
+  EXPECT_EQ(coordinator.UpdateCpuBudget(&first, /*processing_time=*/1000,
+                                        /*input_time=*/0,
+                                        /*max_cpu_budget=*/8),
+            8);
+  // Unregistered models keep their own budget.
+  EXPECT_EQ(coordinator.UpdateCpuBudget(&second, /*processing_time=*/1000,
+                                        /*input_time=*/0,
+                                        /*max_cpu_budget=*/8),
+            8);
+}
+
+TEST(ModelCoordinatorTest, BudgetSmallerThanNumberOfModels) {
+  ModelCoordinator coordinator(/*cpu_budget=*/1);
+  Model first, second;
+  coordinator.Register(&first);
+  coordinator.Register(&second);
+  EXPECT_EQ(coordinator.UpdateCpuBudget(&first, /*processing_time=*/1000,
+                                        /*input_time=*/0,
+                                        /*max_cpu_budget=*/8),
+            1);
+  EXPECT_EQ(coordinator.UpdateCpuBudget(&second, /*processing_time=*/1000,
+                                        /*input_time=*/0,
+                                        /*max_cpu_budget=*/8),
+            1);
+}
 
 TEST(RecordTimeTest, RecordTimeTest) {
   std::shared_ptr<Node> source = model::MakeSourceNode({});
@@ -706,7 +706,13 @@ Status OpKernelContext::allocate_output(StringPiece name,
 Status OpKernelContext::allocate_tensor(
     DataType type, const TensorShape& shape, Tensor* out_tensor,
     AllocatorAttributes attr, const AllocationAttributes& allocation_attr) {
-  Allocator* a = get_allocator(attr);
+  return allocate_tensor(get_allocator(attr), type, shape, out_tensor,
+                         allocation_attr);
+}
+
+Status OpKernelContext::allocate_tensor(
+    Allocator* a, DataType type, const TensorShape& shape, Tensor* out_tensor,
+    const AllocationAttributes& allocation_attr) {
   Tensor new_tensor(
       a, type, shape,
       AllocationAttributes(
@@ -764,7 +770,16 @@ Status OpKernelContext::allocate_output(int index, const TensorShape& shape,
   ScopedMemoryDebugAnnotation op_annotation(op_kernel().name_view().data(),
                                             step_id(), "output", type, &shape);
   auto output_tensor = MakeUnique<Tensor>();
-  Status s = allocate_tensor(type, shape, output_tensor.get(), attr);
+  Allocator* output_allocator =
+      params_->output_allocator_array == nullptr || track_allocations() ||
+              attr.scope_id > 0 || attr.gpu_compatible() ||
+              attr.nic_compatible()
+          ? nullptr
+          : params_->output_allocator_array[index];
+  Status s = output_allocator == nullptr
+                 ? allocate_tensor(type, shape, output_tensor.get(), attr)
+                 : allocate_tensor(output_allocator, type, shape,
+                                   output_tensor.get(), AllocationAttributes());
   if (s.ok()) {
     outputs_[index] = TensorValue(output_tensor.release());
     *output = outputs_[index].tensor;
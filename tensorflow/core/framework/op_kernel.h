@@ -635,6 +635,11 @@ class OpKernelContext {
     // Array indexed by output number for this node
     const AllocatorAttributes* output_attr_array = nullptr;
 
+    // If non-null, an array indexed by output number for this node. A non-null
+    // entry is used instead of the device allocator when the output is
+    // allocated with `allocate_output()` and default allocator attributes.
+    Allocator* const* output_allocator_array = nullptr;
+
     // Shared resources accessible by this op kernel invocation.
     ResourceMgr* resource_manager = nullptr;
 
@@ -1275,6 +1280,9 @@ class OpKernelContext {
   Status allocate_tensor(DataType type, const TensorShape& shape,
                          Tensor* out_tensor, AllocatorAttributes allocator_attr,
                          const AllocationAttributes& allocation_attr);
+  Status allocate_tensor(Allocator* a, DataType type, const TensorShape& shape,
+                         Tensor* out_tensor,
+                         const AllocationAttributes& allocation_attr);
 
   // Helpers for `set_output()`.
 
@@ -226,6 +226,13 @@ REGISTER_VECTORIZER("Tan", UnaryCwiseOpVectorizer);
 REGISTER_VECTORIZER("Cast", UnaryCwiseOpVectorizer);
 REGISTER_VECTORIZER("Identity", UnaryCwiseOpVectorizer);
 
+// String decoding unary. These act on each string of the input independently.
+// DecodeRaw is not one of them: the length of its output depends on the length
+// of each string, so the strings of a batch could not be decoded together.
+REGISTER_VECTORIZER("DecodeBase64", UnaryCwiseOpVectorizer);
+REGISTER_VECTORIZER("DecodeCompressed", UnaryCwiseOpVectorizer);
+REGISTER_VECTORIZER("StringToNumber", UnaryCwiseOpVectorizer);
+
 // Bitwise binary
 REGISTER_VECTORIZER("BitwiseAnd", BinaryCwiseOpVectorizer);
 REGISTER_VECTORIZER("BitwiseOr", BinaryCwiseOpVectorizer);
@@ -0,0 +1,104 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/framework/ops.h"
+#include "tensorflow/cc/framework/scope_internal.h"
+#include "tensorflow/cc/ops/array_ops.h"
+#include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+const char* const kImageResizePrefix = "vectorized/image_resize";
+
+// Vectorizes ops that resize a batch of images of shape
+// `[batch, height, width, channels]` to a given size. The stacked images, of
+// shape `[n, batch, height, width, channels]`, are resized in a single batch of
+// `n * batch` images, since all of them are resized to the same size.
+class ImageResizeVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    if (inputs.size() != 2) {
+      return errors::Internal("Failed to vectorize ", node.type_string(),
+                              ". The op should have 2 inputs, but has ",
+                              inputs.size());
+    }
+    Status status;
+    Scope parent = NewInternalScope(outer_scope, &status, nullptr);
+    Scope s = parent.NewSubScope(kImageResizePrefix);
+
+    Output images, size;
+    TF_RETURN_IF_ERROR(inputs.stacked(0, &images));
+    TF_RETURN_IF_ERROR(inputs.unstacked(1, &size));
+
+    Output const_vec_1 = ops::Const(s, {1});
+    Output const_vec_2 = ops::Const(s, {2});
+    Output shape = ops::Shape(s, images);
+
+    // shape[:2]
+    Output leading_dims =
+        ops::StridedSlice(s, shape, const_vec_2, const_vec_2, const_vec_1,
+                          ops::StridedSlice::Attrs().BeginMask(1));
+    // shape[2:]
+    Output image_dims =
+        ops::StridedSlice(s, shape, const_vec_2, const_vec_2, const_vec_1,
+                          ops::StridedSlice::Attrs().EndMask(1));
+    // tf.reshape(images, tf.concat([[-1], shape[2:]], 0))
+    Output flat_images = ops::Reshape(
+        s, images,
+        ops::Concat(s, {ops::Const(s, {-1}), image_dims}, ops::Const(s, 0)));
+    TF_RETURN_IF_ERROR(status);
+
+    // Add new node with the same op type and attrs as the original node
+    Node* resize_node;
+    auto node_builder = NodeBuilder(strings::StrCat("vectorized/", node.name()),
+                                    node.type_string())
+                            .Input(flat_images.node(), flat_images.index())
+                            .Input(size.node(), size.index());
+    for (const auto& attr_slice : node.attrs()) {
+      node_builder = node_builder.Attr(attr_slice.first, attr_slice.second);
+    }
+    TF_RETURN_IF_ERROR(node_builder.Finalize(outer_scope, &resize_node));
+    Output resized(resize_node, 0);
+
+    // tf.reshape(resized, tf.concat([shape[:2], tf.shape(resized)[1:]], 0))
+    Output resized_image_dims = ops::StridedSlice(
+        s, ops::Shape(s, resized), const_vec_1, const_vec_1, const_vec_1,
+        ops::StridedSlice::Attrs().EndMask(1));
+    Output vectorized_resize = ops::Reshape(
+        s, resized,
+        ops::Concat(s, {leading_dims, resized_image_dims}, ops::Const(s, 0)));
+    TF_RETURN_IF_ERROR(status);
+
+    // Add output mappings
+    outputs->push_back({vectorized_resize.node(), 0, true});
+    return Status::OK();
+  }
+};
+
+REGISTER_VECTORIZER("ResizeArea", ImageResizeVectorizer);
+REGISTER_VECTORIZER("ResizeBicubic", ImageResizeVectorizer);
+REGISTER_VECTORIZER("ResizeBilinear", ImageResizeVectorizer);
+REGISTER_VECTORIZER("ResizeNearestNeighbor", ImageResizeVectorizer);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,91 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/framework/ops.h"
+#include "tensorflow/cc/framework/scope_internal.h"
+#include "tensorflow/cc/ops/array_ops.h"
+#include "tensorflow/cc/ops/math_ops.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+const char* const kReductionPrefix = "vectorized/reduction";
+
+// Vectorizes ops that reduce their first input along the axes given by their
+// second input, such as `Sum` or `ArgMax`. The vectorized op is the same as the
+// original, with the axes shifted past the leading stacked dimension.
+class ReductionVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    if (inputs.size() != 2) {
+      return errors::Internal("Failed to vectorize ", node.type_string(),
+                              ". The op should have 2 inputs, but has ",
+                              inputs.size());
+    }
+    Status status;
+    Scope parent = NewInternalScope(outer_scope, &status, nullptr);
+    Scope s = parent.NewSubScope(kReductionPrefix);
+
+    Output tensor, axes;
+    TF_RETURN_IF_ERROR(inputs.stacked(0, &tensor));
+    TF_RETURN_IF_ERROR(inputs.unstacked(1, &axes));
+    DataType axes_type;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node.attrs(), "Tidx", &axes_type));
+
+    // Non-negative axes count from the front, so they move past the leading
+    // stacked dimension. Negative axes count from the back and stay the same.
+    Output vectorized_axes = ops::Add(
+        s, axes,
+        ops::Cast(s, ops::GreaterEqual(s, axes, ops::ZerosLike(s, axes)),
+                  axes_type));
+    TF_RETURN_IF_ERROR(status);
+
+    // Add new node with the same op type and attrs as the original node
+    Node* new_node;
+    auto node_builder = NodeBuilder(strings::StrCat("vectorized/", node.name()),
+                                    node.type_string())
+                            .Input(tensor.node(), tensor.index())
+                            .Input(vectorized_axes.node(),
+                                   vectorized_axes.index());
+    for (const auto& attr_slice : node.attrs()) {
+      node_builder = node_builder.Attr(attr_slice.first, attr_slice.second);
+    }
+    TF_RETURN_IF_ERROR(node_builder.Finalize(outer_scope, &new_node));
+
+    // Add output mappings
+    outputs->push_back({new_node, 0, true});
+    return Status::OK();
+  }
+};
+
+REGISTER_VECTORIZER("All", ReductionVectorizer);
+REGISTER_VECTORIZER("Any", ReductionVectorizer);
+REGISTER_VECTORIZER("ArgMax", ReductionVectorizer);
+REGISTER_VECTORIZER("ArgMin", ReductionVectorizer);
+REGISTER_VECTORIZER("Max", ReductionVectorizer);
+REGISTER_VECTORIZER("Mean", ReductionVectorizer);
+REGISTER_VECTORIZER("Min", ReductionVectorizer);
+REGISTER_VECTORIZER("Prod", ReductionVectorizer);
+REGISTER_VECTORIZER("Sum", ReductionVectorizer);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
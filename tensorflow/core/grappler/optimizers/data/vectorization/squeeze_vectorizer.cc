@@ -0,0 +1,70 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/framework/ops.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+class SqueezeVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    Output tensor;
+    TF_RETURN_IF_ERROR(inputs.stacked(0, &tensor));
+
+    std::vector<int32> squeeze_dims;
+    TF_RETURN_IF_ERROR(
+        GetNodeAttr(node.attrs(), "squeeze_dims", &squeeze_dims));
+    if (squeeze_dims.empty()) {
+      // Without explicit dimensions, the leading stacked dimension would be
+      // squeezed as well when it has size 1.
+      return errors::Unimplemented(
+          "Cannot vectorize Squeeze that squeezes all dimensions of size 1.");
+    }
+    // Non-negative dimensions count from the front, so they move past the
+    // leading stacked dimension. Negative dimensions stay the same.
+    for (int32& dim : squeeze_dims) {
+      if (dim >= 0) ++dim;
+    }
+
+    Node* new_node;
+    auto node_builder =
+        NodeBuilder(strings::StrCat("vectorized/", node.name()), "Squeeze")
+            .Input(tensor.node(), tensor.index());
+    for (const auto& attr_slice : node.attrs()) {
+      if (attr_slice.first != "squeeze_dims") {
+        node_builder = node_builder.Attr(attr_slice.first, attr_slice.second);
+      }
+    }
+    TF_RETURN_IF_ERROR(node_builder.Attr("squeeze_dims", squeeze_dims)
+                           .Finalize(outer_scope, &new_node));
+
+    // Add output mappings
+    outputs->push_back({new_node, 0, true});
+    return Status::OK();
+  }
+};
+
+REGISTER_VECTORIZER("Squeeze", SqueezeVectorizer);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -1353,6 +1353,27 @@ TEST(VectorizerTest, VectorizeTranspose) {
       function_utils::ContainsFunctionNodeWithOp("MapDefun", *vectorized));
 }
 
+TEST(VectorizerTest, DecodeRawIsNotVectorized) {
+  // The strings of a batch may have different lengths, so DecodeRaw must run
+  // on each element separately.
+  FunctionDef inner = FunctionDefHelper::Create(
+      /*function_name=*/"inner_function",
+      /*in_def=*/{"arg0: string"},
+      /*out_def=*/{"ret0: int16"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {{{"DecodeRaw"}, "DecodeRaw", {"arg0"}, {{"out_type", DT_INT16}}}},
+      /*ret_def=*/{{"ret0", "DecodeRaw:output:0"}});
+
+  FunctionDefLibrary lib;
+  FunctionDef* vectorized;
+  TF_ASSERT_OK(WrapAndVectorize(inner, &lib, &vectorized));
+  EXPECT_TRUE(
+      function_utils::ContainsFunctionNodeWithOp("MapDefun", *vectorized));
+  EXPECT_FALSE(
+      function_utils::ContainsFunctionNodeWithOp("DecodeRaw", *vectorized));
+}
+
 TEST(VectorizerTest, VectorizeIdentity) {
   FunctionDef inner = FunctionDefHelper::Create(
       /*function_name=*/"inner_function",
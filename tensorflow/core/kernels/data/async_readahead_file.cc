@@ -0,0 +1,492 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/async_readahead_file.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/error.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define TF_DATA_HAS_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+// Number of threads that perform reads when io_uring is not available.
+constexpr int kNumReadThreads = 16;
+
+// Called with the status of a read and the number of bytes read, which is
+// smaller than requested only at the end of the file.
+using ReadDoneCallback = std::function<void(const Status&, size_t)>;
+
+thread::ThreadPool* ReadThreadPool() {
+  static thread::ThreadPool* pool = new thread::ThreadPool(
+      Env::Default(), "async_file_read", kNumReadThreads);
+  return pool;
+}
+
+#if defined(TF_DATA_HAS_IO_URING)
+
+// A process-wide io_uring, whose completions are reaped by a dedicated thread.
+// Read callbacks run on that thread and must not block. Callbacks of reads
+// that io_uring refuses to accept run on the read thread pool instead.
+class IoUring {
+ public:
+  // Returns the process-wide io_uring, or nullptr if the kernel does not
+  // support it.
+  static IoUring* Get() {
+    static IoUring* ring = Create();
+    return ring;
+  }
+
+  // Reads `n` bytes at `offset` of `fd` into `buffer`.
+  void Read(int fd, uint64 offset, size_t n, char* buffer,
+            ReadDoneCallback done) {
+    auto* request = new Request{fd,           offset,          n,  buffer, 0,
+                                Status::OK(), std::move(done), {}};
+    std::vector<Request*> failed;
+    {
+      mutex_lock l(mu_);
+      pending_.push_back(request);
+      SubmitPendingLocked(&failed);
+    }
+    // The caller may hold locks that the callbacks acquire, so they run on
+    // another thread.
+    for (Request* request : failed) {
+      ReadThreadPool()->Schedule([request]() {
+        request->done(request->status, request->bytes_read);
+        delete request;
+      });
+    }
+  }
+
+ private:
+  struct Request {
+    int fd;
+    uint64 offset;
+    size_t n;
+    char* buffer;
+    size_t bytes_read;
+    Status status;
+    ReadDoneCallback done;
+    struct iovec iov;
+  };
+
+  static IoUring* Create() {
+    // Number of submission queue entries, which bounds the reads in flight.
+    constexpr unsigned kNumEntries = 256;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int fd = syscall(__NR_io_uring_setup, kNumEntries, &params);
+    if (fd < 0) {
+      VLOG(1) << "io_uring is not available: " << strerror(errno);
+      return nullptr;
+    }
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+      sq_size = cq_size = std::max(sq_size, cq_size);
+    }
+    void* sq = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    void* cq = single_mmap ? sq
+                           : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, fd,
+                                  IORING_OFF_CQ_RING);
+    void* sqes = mmap(nullptr, params.sq_entries * sizeof(struct io_uring_sqe),
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                      IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+      VLOG(1) << "Failed to map io_uring queues: " << strerror(errno);
+      close(fd);
+      return nullptr;
+    }
+    return new IoUring(fd, params, static_cast<char*>(sq),
+                       static_cast<char*>(cq),
+                       static_cast<struct io_uring_sqe*>(sqes));
+  }
+
+  IoUring(int fd, const struct io_uring_params& params, char* sq, char* cq,
+          struct io_uring_sqe* sqes)
+      : fd_(fd),
+        num_entries_(params.sq_entries),
+        sq_head_(reinterpret_cast<unsigned*>(sq + params.sq_off.head)),
+        sq_tail_(reinterpret_cast<unsigned*>(sq + params.sq_off.tail)),
+        sq_mask_(*reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask)),
+        sq_array_(reinterpret_cast<unsigned*>(sq + params.sq_off.array)),
+        sqes_(sqes),
+        cq_head_(reinterpret_cast<unsigned*>(cq + params.cq_off.head)),
+        cq_tail_(reinterpret_cast<unsigned*>(cq + params.cq_off.tail)),
+        cq_mask_(*reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask)),
+        cqes_(reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes)) {
+    reaper_.reset(Env::Default()->StartThread(
+        {}, "io_uring_reaper", [this]() { ReapCompletions(); }));
+  }
+
+  // Adds a read of the remaining bytes of `request` to the submission queue
+  // and submits it. Returns an error, leaving the queue unchanged, if io_uring
+  // does not accept the read.
+  Status SubmitLocked(Request* request) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    request->iov.iov_base = request->buffer + request->bytes_read;
+    request->iov.iov_len = request->n - request->bytes_read;
+    // The kernel consumes every entry when it is submitted, so the queue
+    // always has room for one.
+    const unsigned tail = *sq_tail_;
+    const unsigned index = tail & sq_mask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = request->fd;
+    sqe->off = request->offset + request->bytes_read;
+    sqe->addr = reinterpret_cast<uint64>(&request->iov);
+    sqe->len = 1;
+    sqe->user_data = reinterpret_cast<uint64>(request);
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    while (syscall(__NR_io_uring_enter, fd_, 1, 0, 0, nullptr, 0) < 0) {
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        const int error = errno;
+        // A failed call consumes no entries, so the entry can be withdrawn.
+        __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+        return IOError("Failed to submit io_uring read", error);
+      }
+    }
+    return Status::OK();
+  }
+
+  // Submits pending reads while fewer than `num_entries_` are in flight.
+  // Reads that cannot be submitted are completed with an error and appended
+  // to `failed`, whose callbacks the caller must run without holding `mu_`.
+  void SubmitPendingLocked(std::vector<Request*>* failed)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    while (!pending_.empty() && num_in_flight_ < num_entries_) {
+      Request* request = pending_.front();
+      pending_.pop_front();
+      request->status = SubmitLocked(request);
+      if (request->status.ok()) {
+        ++num_in_flight_;
+      } else {
+        failed->push_back(request);
+      }
+    }
+  }
+
+  void ReapCompletions() {
+    // Bounds the backoff between retries of a failing wait for completions.
+    constexpr int64 kMaxBackoffMicros = 1000000;
+    int64 backoff_micros = 0;
+    while (true) {
+      if (syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS,
+                  nullptr, 0) < 0 &&
+          errno != EINTR) {
+        LOG(ERROR) << "Failed to wait for io_uring completions: "
+                   << strerror(errno);
+        // The kernel still posts completions, which are drained below, but
+        // waiting is retried with exponential backoff rather than spinning.
+        backoff_micros =
+            std::min(std::max<int64>(2 * backoff_micros, 1000),
+                     kMaxBackoffMicros);
+        Env::Default()->SleepForMicroseconds(backoff_micros);
+      } else {
+        backoff_micros = 0;
+      }
+      std::vector<std::pair<Request*, int>> completions;
+      unsigned head = *cq_head_;
+      const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      for (; head != tail; ++head) {
+        const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        completions.emplace_back(reinterpret_cast<Request*>(cqe.user_data),
+                                 cqe.res);
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+      std::vector<Request*> done;
+      {
+        mutex_lock l(mu_);
+        for (auto& completion : completions) {
+          Request* request = completion.first;
+          const int result = completion.second;
+          if (result > 0) {
+            request->bytes_read += result;
+          }
+          if (result > 0 && request->bytes_read < request->n) {
+            // Short read; reads the rest.
+            request->status = SubmitLocked(request);
+            if (request->status.ok()) {
+              continue;
+            }
+          } else if (result < 0) {
+            request->status = IOError("io_uring read failed", -result);
+          }
+          done.push_back(request);
+          --num_in_flight_;
+        }
+        SubmitPendingLocked(&done);
+      }
+      for (Request* request : done) {
+        request->done(request->status, request->bytes_read);
+        delete request;
+      }
+    }
+  }
+
+  const int fd_;
+  const unsigned num_entries_;
+  unsigned* const sq_head_;
+  unsigned* const sq_tail_;
+  const unsigned sq_mask_;
+  unsigned* const sq_array_;
+  struct io_uring_sqe* const sqes_;
+  unsigned* const cq_head_;
+  unsigned* const cq_tail_;
+  const unsigned cq_mask_;
+  struct io_uring_cqe* const cqes_;
+  std::unique_ptr<Thread> reaper_;
+
+  mutex mu_;
+  unsigned num_in_flight_ TF_GUARDED_BY(mu_) = 0;
+  // Reads waiting for the number of reads in flight to drop.
+  std::deque<Request*> pending_ TF_GUARDED_BY(mu_);
+};
+
+#endif  // TF_DATA_HAS_IO_URING
+
+}  // namespace
+
+// Buffers of `buffer_size` bytes for blocks, kept for reuse once their
+// blocks are destroyed.
+class AsyncReadaheadFile::BufferPool {
+ public:
+  explicit BufferPool(int64 buffer_size) : buffer_size_(buffer_size) {}
+
+  std::unique_ptr<char[]> Get() {
+    {
+      mutex_lock l(mu_);
+      if (!buffers_.empty()) {
+        std::unique_ptr<char[]> buffer = std::move(buffers_.back());
+        buffers_.pop_back();
+        return buffer;
+      }
+    }
+    return std::unique_ptr<char[]>(new char[buffer_size_]);
+  }
+
+  void Put(std::unique_ptr<char[]> buffer) {
+    mutex_lock l(mu_);
+    buffers_.push_back(std::move(buffer));
+  }
+
+ private:
+  const int64 buffer_size_;
+  mutex mu_;
+  std::vector<std::unique_ptr<char[]>> buffers_ TF_GUARDED_BY(mu_);
+};
+
+struct AsyncReadaheadFile::Block {
+  explicit Block(std::shared_ptr<BufferPool> pool)
+      : pool(std::move(pool)), data(this->pool->Get()) {}
+
+  ~Block() { pool->Put(std::move(data)); }
+
+  const std::shared_ptr<BufferPool> pool;
+  std::unique_ptr<char[]> data;
+  uint64 offset = 0;
+  // The number of bytes read, once `done`.
+  size_t size = 0;
+  bool done = false;
+  Status status;
+};
+
+bool AsyncReadaheadFile::IsLocalFile(const std::string& filename) {
+  StringPiece scheme, host, path;
+  io::ParseURI(filename, &scheme, &host, &path);
+  return scheme.empty() || scheme == "file";
+}
+
+bool AsyncReadaheadFile::UsesIoUring() {
+#if defined(TF_DATA_HAS_IO_URING)
+  return IoUring::Get() != nullptr;
+#else
+  return false;
+#endif
+}
+
+Status AsyncReadaheadFile::Create(const std::string& filename,
+                                  std::unique_ptr<RandomAccessFile> file,
+                                  int64 block_size, int num_blocks,
+                                  bool use_io_uring,
+                                  std::unique_ptr<RandomAccessFile>* result) {
+  if (block_size <= 0 || num_blocks <= 0) {
+    return errors::InvalidArgument(
+        "Readahead block size and number of blocks must be positive, but are ",
+        block_size, " and ", num_blocks, ".");
+  }
+  int fd = -1;
+#if defined(TF_DATA_HAS_IO_URING)
+  if (use_io_uring && UsesIoUring()) {
+    StringPiece scheme, host, path;
+    io::ParseURI(filename, &scheme, &host, &path);
+    fd = open(std::string(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      VLOG(1) << "Failed to open " << filename
+              << " for io_uring, falling back to threads: " << strerror(errno);
+    }
+  }
+#endif
+  result->reset(
+      new AsyncReadaheadFile(std::move(file), fd, block_size, num_blocks));
+  return Status::OK();
+}
+
+AsyncReadaheadFile::AsyncReadaheadFile(std::unique_ptr<RandomAccessFile> file,
+                                       int fd, int64 block_size,
+                                       int num_blocks)
+    : file_(std::move(file)),
+      fd_(fd),
+      block_size_(block_size),
+      num_blocks_(num_blocks),
+      buffer_pool_(std::make_shared<BufferPool>(block_size)) {}
+
+AsyncReadaheadFile::~AsyncReadaheadFile() {
+  {
+    mutex_lock l(mu_);
+    while (num_reads_in_flight_ > 0) {
+      cond_var_.wait(l);
+    }
+  }
+#if defined(TF_DATA_HAS_IO_URING)
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+#endif
+}
+
+Status AsyncReadaheadFile::Name(StringPiece* result) const {
+  return file_->Name(result);
+}
+
+Status AsyncReadaheadFile::Read(uint64 offset, size_t n, StringPiece* result,
+                                char* scratch) const {
+  mutex_lock l(mu_);
+  size_t bytes_read = 0;
+  while (bytes_read < n) {
+    const uint64 position = offset + bytes_read;
+    while (!blocks_.empty() &&
+           position >= blocks_.front()->offset + block_size_) {
+      blocks_.pop_front();
+    }
+    if (blocks_.empty() || position < blocks_.front()->offset) {
+      // Restarts the readahead at the read position. Blocks still in flight
+      // complete in the background.
+      blocks_.clear();
+      next_offset_ = position;
+    }
+    FillReadahead();
+    if (blocks_.empty()) {
+      // The read position is at or past the end of the file.
+      break;
+    }
+    std::shared_ptr<Block> block = blocks_.front();
+    while (!block->done) {
+      cond_var_.wait(l);
+    }
+    TF_RETURN_IF_ERROR(block->status);
+    const uint64 block_offset = position - block->offset;
+    if (block_offset >= block->size) {
+      break;
+    }
+    const size_t size = std::min<uint64>(n - bytes_read,
+                                         block->size - block_offset);
+    memcpy(scratch + bytes_read, block->data.get() + block_offset, size);
+    bytes_read += size;
+  }
+  *result = StringPiece(scratch, bytes_read);
+  if (bytes_read < n) {
+    return errors::OutOfRange("Read less bytes than requested");
+  }
+  return Status::OK();
+}
+
+void AsyncReadaheadFile::FillReadahead() const {
+  while (static_cast<int>(blocks_.size()) < num_blocks_ &&
+         next_offset_ < file_size_) {
+    auto block = std::make_shared<Block>(buffer_pool_);
+    block->offset = next_offset_;
+    next_offset_ += block_size_;
+    blocks_.push_back(block);
+    ++num_reads_in_flight_;
+#if defined(TF_DATA_HAS_IO_URING)
+    if (fd_ >= 0) {
+      IoUring::Get()->Read(fd_, block->offset, block_size_, block->data.get(),
+                           [this, block](const Status& status, size_t size) {
+                             BlockDone(block, status, size);
+                           });
+      continue;
+    }
+#endif
+    ReadThreadPool()->Schedule([this, block]() {
+      StringPiece data;
+      Status status =
+          file_->Read(block->offset, block_size_, &data, block->data.get());
+      if (data.data() != block->data.get()) {
+        memmove(block->data.get(), data.data(), data.size());
+      }
+      if (errors::IsOutOfRange(status)) {
+        status = Status::OK();
+      }
+      BlockDone(block, status, data.size());
+    });
+  }
+}
+
+void AsyncReadaheadFile::BlockDone(const std::shared_ptr<Block>& block,
+                                   const Status& status, size_t size) const {
+  mutex_lock l(mu_);
+  block->status = status;
+  block->size = size;
+  block->done = true;
+  if (status.ok() && static_cast<int64>(size) < block_size_) {
+    file_size_ = std::min<uint64>(file_size_, block->offset + size);
+  }
+  --num_reads_in_flight_;
+  cond_var_.notify_all();
+}
+
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,109 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_KERNELS_DATA_ASYNC_READAHEAD_FILE_H_
+#define TENSORFLOW_CORE_KERNELS_DATA_ASYNC_READAHEAD_FILE_H_
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace data {
+
+// A `RandomAccessFile` that serves sequential reads of a local file from
+// blocks read ahead asynchronously, keeping several large reads in flight so
+// that a single reader can saturate fast local storage.
+//
+// Reads are submitted to a process-wide io_uring on Linux kernels that support
+// it, and otherwise performed by a process-wide thread pool through the
+// wrapped file. A read outside of the blocks read ahead restarts the readahead
+// at its offset, so the file remains correct, but not fast, for random access.
+class AsyncReadaheadFile : public RandomAccessFile {
+ public:
+  // Returns whether `filename` is on the local file system, for which
+  // `Create()` can be used.
+  static bool IsLocalFile(const std::string& filename);
+
+  // Creates a file that reads the local file `filename`, which `file` was
+  // opened from, in blocks of `block_size` bytes, keeping up to `num_blocks`
+  // blocks read ahead of the last read. The buffers of blocks that were read
+  // are reused for later blocks. If `use_io_uring` is false, or io_uring is
+  // not available, the reads run on the thread pool.
+  static Status Create(const std::string& filename,
+                       std::unique_ptr<RandomAccessFile> file,
+                       int64 block_size, int num_blocks, bool use_io_uring,
+                       std::unique_ptr<RandomAccessFile>* result);
+
+  // Waits for the reads in flight to complete.
+  ~AsyncReadaheadFile() override;
+
+  Status Name(StringPiece* result) const override;
+
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const override;
+
+  // Returns whether reads are submitted to io_uring.
+  static bool UsesIoUring();
+
+ private:
+  class BufferPool;
+  struct Block;
+
+  AsyncReadaheadFile(std::unique_ptr<RandomAccessFile> file, int fd,
+                     int64 block_size, int num_blocks);
+
+  // Issues reads of the blocks following the last block read ahead, until
+  // `num_blocks_` blocks are read ahead or the end of the file is reached.
+  void FillReadahead() const TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Records the completion of the read of `block`.
+  void BlockDone(const std::shared_ptr<Block>& block, const Status& status,
+                 size_t size) const TF_LOCKS_EXCLUDED(mu_);
+
+  const std::unique_ptr<RandomAccessFile> file_;
+  // The file descriptor read by io_uring, or -1 if reads use `file_`.
+  const int fd_;
+  const int64 block_size_;
+  const int num_blocks_;
+  // Shared with the blocks, which may outlive the file while their reads
+  // complete.
+  const std::shared_ptr<BufferPool> buffer_pool_;
+
+  mutable mutex mu_;
+  mutable condition_variable cond_var_;
+  // The blocks read ahead, in file order.
+  mutable std::deque<std::shared_ptr<Block>> blocks_ TF_GUARDED_BY(mu_);
+  // Offset of the next block to read ahead.
+  mutable uint64 next_offset_ TF_GUARDED_BY(mu_) = 0;
+  // Size of the file, once a read has reached its end.
+  mutable uint64 file_size_ TF_GUARDED_BY(mu_) = kuint64max;
+  mutable int64 num_reads_in_flight_ TF_GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AsyncReadaheadFile);
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_DATA_ASYNC_READAHEAD_FILE_H_
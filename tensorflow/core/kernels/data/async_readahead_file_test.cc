@@ -0,0 +1,253 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/async_readahead_file.h"
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+// Writes `size` bytes, where byte `i` is a function of `i`, to a temporary
+// file named `name` and returns its contents.
+std::string WriteTestFile(const std::string& name, int64 size,
+                          std::string* filename) {
+  std::string contents(size, 0);
+  for (int64 i = 0; i < size; ++i) {
+    contents[i] = static_cast<char>(i * 31 + i / 251);
+  }
+  *filename = io::JoinPath(testing::TmpDir(), name);
+  TF_CHECK_OK(WriteStringToFile(Env::Default(), *filename, contents));
+  return contents;
+}
+
+std::unique_ptr<RandomAccessFile> OpenReadahead(const std::string& filename,
+                                                int64 block_size,
+                                                int num_blocks,
+                                                bool use_io_uring) {
+  std::unique_ptr<RandomAccessFile> file;
+  TF_CHECK_OK(Env::Default()->NewRandomAccessFile(filename, &file));
+  std::unique_ptr<RandomAccessFile> result;
+  TF_CHECK_OK(AsyncReadaheadFile::Create(filename, std::move(file), block_size,
+                                         num_blocks, use_io_uring, &result));
+  return result;
+}
+
+// A file whose reads fail at and after `error_offset`.
+class FailingFile : public RandomAccessFile {
+ public:
+  FailingFile(std::unique_ptr<RandomAccessFile> file, uint64 error_offset)
+      : file_(std::move(file)), error_offset_(error_offset) {}
+
+  Status Name(StringPiece* result) const override {
+    return file_->Name(result);
+  }
+
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const override {
+    if (offset + n > error_offset_) {
+      *result = StringPiece();
+      return errors::DataLoss("Injected read error");
+    }
+    return file_->Read(offset, n, result, scratch);
+  }
+
+ private:
+  const std::unique_ptr<RandomAccessFile> file_;
+  const uint64 error_offset_;
+};
+
+// Runs each test with reads submitted to io_uring, where it is available, and
+// with reads on the thread pool.
+class AsyncReadaheadFileTest : public ::testing::TestWithParam<bool> {
+ protected:
+  bool use_io_uring() const { return GetParam(); }
+};
+
+INSTANTIATE_TEST_SUITE_P(IoUringOrThreads, AsyncReadaheadFileTest,
+                         ::testing::Bool());
+
+TEST(AsyncReadaheadFileStaticTest, IsLocalFile) {
+  EXPECT_TRUE(AsyncReadaheadFile::IsLocalFile("/tmp/data.tfrecord"));
+  EXPECT_TRUE(AsyncReadaheadFile::IsLocalFile("data.tfrecord"));
+  EXPECT_TRUE(AsyncReadaheadFile::IsLocalFile("file:///tmp/data.tfrecord"));
+  EXPECT_FALSE(AsyncReadaheadFile::IsLocalFile("gs://bucket/data.tfrecord"));
+  EXPECT_FALSE(AsyncReadaheadFile::IsLocalFile("s3://bucket/data.tfrecord"));
+}
+
+TEST_P(AsyncReadaheadFileTest, SequentialReads) {
+  std::string filename;
+  const std::string contents =
+      WriteTestFile("sequential", /*size=*/100000, &filename);
+  auto file = OpenReadahead(filename, /*block_size=*/4096, /*num_blocks=*/4,
+                            use_io_uring());
+  // Reads of sizes that straddle blocks in various ways.
+  for (size_t n : {1, 100, 4096, 5000, 20000}) {
+    std::string scratch(n, 0);
+    uint64 offset = 0;
+    while (offset < contents.size()) {
+      StringPiece result;
+      Status s = file->Read(offset, n, &result, &scratch[0]);
+      const size_t expected = std::min(n, contents.size() - offset);
+      if (expected < n) {
+        EXPECT_TRUE(errors::IsOutOfRange(s)) << s;
+      } else {
+        TF_ASSERT_OK(s);
+      }
+      ASSERT_EQ(result, StringPiece(contents).substr(offset, expected));
+      offset += n;
+    }
+  }
+}
+
+TEST_P(AsyncReadaheadFileTest, RandomReads) {
+  std::string filename;
+  const std::string contents =
+      WriteTestFile("random", /*size=*/100000, &filename);
+  auto file = OpenReadahead(filename, /*block_size=*/1000, /*num_blocks=*/3,
+                            use_io_uring());
+  for (uint64 offset : {50000, 10, 70000, 69990, 0, 99000, 3000}) {
+    std::string scratch(1500, 0);
+    StringPiece result;
+    TF_ASSERT_OK(file->Read(offset, scratch.size(), &result, &scratch[0]));
+    EXPECT_EQ(result, StringPiece(contents).substr(offset, scratch.size()));
+  }
+}
+
+TEST_P(AsyncReadaheadFileTest, ReadPastEnd) {
+  std::string filename;
+  const std::string contents = WriteTestFile("past_end", /*size=*/5000,
+                                             &filename);
+  auto file = OpenReadahead(filename, /*block_size=*/4096, /*num_blocks=*/2,
+                            use_io_uring());
+  char scratch[100];
+  StringPiece result;
+  EXPECT_TRUE(errors::IsOutOfRange(file->Read(4950, 100, &result, scratch)));
+  EXPECT_EQ(result, StringPiece(contents).substr(4950));
+  EXPECT_TRUE(errors::IsOutOfRange(file->Read(5000, 100, &result, scratch)));
+  EXPECT_TRUE(result.empty());
+  EXPECT_TRUE(errors::IsOutOfRange(file->Read(8192, 100, &result, scratch)));
+  EXPECT_TRUE(result.empty());
+  // Reads before the end still succeed once the size is known.
+  TF_ASSERT_OK(file->Read(0, 100, &result, scratch));
+  EXPECT_EQ(result, StringPiece(contents).substr(0, 100));
+}
+
+TEST_P(AsyncReadaheadFileTest, EmptyFile) {
+  std::string filename;
+  WriteTestFile("empty", /*size=*/0, &filename);
+  auto file = OpenReadahead(filename, /*block_size=*/4096, /*num_blocks=*/2,
+                            use_io_uring());
+  char scratch[10];
+  StringPiece result;
+  EXPECT_TRUE(errors::IsOutOfRange(file->Read(0, 10, &result, scratch)));
+  EXPECT_TRUE(result.empty());
+}
+
+TEST_P(AsyncReadaheadFileTest, DestroyWithReadsInFlight) {
+  std::string filename;
+  WriteTestFile("in_flight", /*size=*/1 << 20, &filename);
+  auto file = OpenReadahead(filename, /*block_size=*/65536,
+                            /*num_blocks=*/16, use_io_uring());
+  char scratch[10];
+  StringPiece result;
+  TF_ASSERT_OK(file->Read(0, 10, &result, scratch));
+  file.reset();
+}
+
+TEST_P(AsyncReadaheadFileTest, InvalidArguments) {
+  std::string filename;
+  WriteTestFile("invalid", /*size=*/10, &filename);
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(Env::Default()->NewRandomAccessFile(filename, &file));
+  std::unique_ptr<RandomAccessFile> result;
+  EXPECT_EQ(AsyncReadaheadFile::Create(filename, std::move(file),
+                                       /*block_size=*/0, /*num_blocks=*/4,
+                                       use_io_uring(), &result)
+                .code(),
+            error::INVALID_ARGUMENT);
+}
+
+TEST(AsyncReadaheadFileStaticTest, ReadErrorOnThreadPool) {
+  std::string filename;
+  const std::string contents =
+      WriteTestFile("read_error", /*size=*/100000, &filename);
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(Env::Default()->NewRandomAccessFile(filename, &file));
+  std::unique_ptr<RandomAccessFile> readahead;
+  // Reads through the wrapped file, on the thread pool, so that its errors
+  // reach the reader.
+  TF_ASSERT_OK(AsyncReadaheadFile::Create(
+      filename, absl::make_unique<FailingFile>(std::move(file), 50000),
+      /*block_size=*/4096, /*num_blocks=*/4, /*use_io_uring=*/false,
+      &readahead));
+  std::string scratch(1000, 0);
+  StringPiece result;
+  TF_ASSERT_OK(readahead->Read(0, scratch.size(), &result, &scratch[0]));
+  EXPECT_EQ(result, StringPiece(contents).substr(0, scratch.size()));
+  EXPECT_TRUE(
+      errors::IsDataLoss(readahead->Read(60000, 1000, &result, &scratch[0])));
+  // A failed block does not prevent reading other parts of the file, and the
+  // failed reads are no longer in flight, so destroying the file does not
+  // hang.
+  TF_ASSERT_OK(readahead->Read(1000, scratch.size(), &result, &scratch[0]));
+  EXPECT_EQ(result, StringPiece(contents).substr(1000, scratch.size()));
+  readahead.reset();
+}
+
+// Reads a 64MB local file sequentially in chunks of `state.range(0)` bytes,
+// with readahead in 4 blocks of `state.range(1)` bytes or, if it is 0,
+// directly.
+static void BM_SequentialRead(::testing::benchmark::State& state) {
+  const int64 read_size = state.range(0);
+  const int64 block_size = state.range(1);
+  constexpr int64 kFileSize = 64 << 20;
+  std::string filename;
+  WriteTestFile("benchmark", kFileSize, &filename);
+  std::string scratch(read_size, 0);
+
+  for (auto s : state) {
+    std::unique_ptr<RandomAccessFile> file;
+    if (block_size > 0) {
+      file = OpenReadahead(filename, block_size, /*num_blocks=*/4,
+                           /*use_io_uring=*/true);
+    } else {
+      TF_CHECK_OK(Env::Default()->NewRandomAccessFile(filename, &file));
+    }
+    for (int64 offset = 0; offset < kFileSize; offset += read_size) {
+      StringPiece result;
+      Status status = file->Read(offset, read_size, &result, &scratch[0]);
+      CHECK(status.ok() || errors::IsOutOfRange(status)) << status;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * kFileSize);
+  state.SetLabel(block_size == 0 ? "direct"
+                 : AsyncReadaheadFile::UsesIoUring() ? "io_uring"
+                                                     : "threads");
+}
+
+BENCHMARK(BM_SequentialRead)
+    ->ArgPair(256 << 10, 0)
+    ->ArgPair(256 << 10, 1 << 20)
+    ->ArgPair(256 << 10, 4 << 20);
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
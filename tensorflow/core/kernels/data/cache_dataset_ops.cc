@@ -18,6 +18,7 @@ limitations under the License.
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/data/cache_ops.h"
+#include "tensorflow/core/kernels/data/chunked_cache_file.h"
 #include "tensorflow/core/kernels/data/dataset_utils.h"
 #include "tensorflow/core/kernels/data/name_utils.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -37,6 +38,9 @@ namespace data {
 /* static */ constexpr const char* const CacheDatasetOp::kFileName;
 /* static */ constexpr const char* const CacheDatasetOp::kOutputTypes;
 /* static */ constexpr const char* const CacheDatasetOp::kOutputShapes;
+/* static */ constexpr const char* const CacheDatasetOp::kFileFormat;
+/* static */ constexpr const char* const CacheDatasetOp::kCompression;
+/* static */ constexpr const char* const CacheDatasetOp::kMaxMemoryBytes;
 
 namespace {
 
@@ -59,6 +63,13 @@ constexpr char kCacheCompleted[] = "cache_completed";
 constexpr char kIndex[] = "index";
 constexpr char kImpl[] = "Impl";
 constexpr char kCacheDataset[] = "CacheDataset";
+constexpr char kBundleFormat[] = "bundle";
+constexpr char kChunkedFormat[] = "chunked";
+constexpr char kChunkedFileSuffix[] = ".chunks";
+constexpr char kSnappy[] = "SNAPPY";
+constexpr char kBoundedMemoryDatasetPrefix[] = "BoundedMemory";
+constexpr char kNumToSkip[] = "num_to_skip";
+constexpr char kInputImplEmpty[] = "input_impl_empty";
 constexpr char kIncompleteCacheErrorMessage[] =
     "The calling iterator did not fully read the dataset being cached. In "
     "order to avoid unexpected truncation of the dataset, the partially cached "
@@ -71,10 +82,13 @@ constexpr char kIncompleteCacheErrorMessage[] =
 class CacheDatasetOp::FileDatasetBase : public DatasetBase {
  public:
   FileDatasetBase(OpKernelContext* ctx, const DatasetBase* input,
-                  string filename, Env* env)
+                  string filename, Env* env, bool chunked = false,
+                  string compression = "")
       : DatasetBase(DatasetContext(ctx)),
         input_(input),
         filename_(std::move(filename)),
+        chunked_(chunked),
+        compression_(std::move(compression)),
         env_(env),
         num_tensors_(input->output_dtypes().size()),
         tensor_index_padding_size_(StringPaddingSize(num_tensors_)),
@@ -124,6 +138,11 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
  protected:
   const DatasetBase* const input_;
   const tstring filename_;
+  // Whether the cache is a chunked cache file (see `ChunkedCacheWriter` and
+  // `ChunkedCacheReader`) rather than a tensor bundle, and the compression of
+  // its chunks.
+  const bool chunked_;
+  const string compression_;
 
  private:
   static size_t StringPaddingSize(size_t num_tensors) {
@@ -135,12 +154,20 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
                            tensor_index);
   }
 
+  // The file whose existence means that the cache is complete.
+  string CompletedFilename() const {
+    if (chunked_) {
+      return strings::StrCat(filename_, kChunkedFileSuffix);
+    }
+    return MetaFilename(filename_);
+  }
+
   class FileIterator : public DatasetIterator<FileDatasetBase> {
    public:
     explicit FileIterator(const Params& params)
         : DatasetIterator<FileDatasetBase>(params) {
       if (params.dataset->env_
-              ->FileExists(MetaFilename(params.dataset->filename_))
+              ->FileExists(params.dataset->CompletedFilename())
               .ok()) {
         mode_ = Mode::read;
       } else {
@@ -182,14 +209,12 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
         mode_ = static_cast<Mode>(temp);
       }
       if (mode_ == Mode::write &&
-          dataset()
-              ->env_->FileExists(MetaFilename(dataset()->filename_))
-              .ok()) {
+          dataset()->env_->FileExists(dataset()->CompletedFilename()).ok()) {
         // This could happen if the cache was completely written after the
         // checkpoint was saved.
         LOG(WARNING)
             << "It looks like the cache was already completely written("
-            << MetaFilename(dataset()->filename_)
+            << dataset()->CompletedFilename()
             << ") after the last checkpoint was saved. Attempting to read "
             << "the cache instead of continuing to write. If this is a "
             << "mistake, please remove the above file and try running again.";
@@ -575,8 +600,159 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
       bool iterator_restored_ TF_GUARDED_BY(mu_);
     };  // FileReaderIterator
 
+    // ChunkedWriterIterator passes through and caches items from the input
+    // FileDatasetBase in a `ChunkedCacheWriter`.
+    //
+    // The cache file is written under a temporary name and only gets its
+    // final name once the input has been exhausted, so concurrent writers do
+    // not need to coordinate. Checkpointing a partially written cache is not
+    // supported.
+    class ChunkedWriterIterator : public DatasetIterator<FileDatasetBase> {
+     public:
+      explicit ChunkedWriterIterator(const Params& params)
+          : DatasetIterator<FileDatasetBase>(params) {}
+
+      ~ChunkedWriterIterator() override {
+        if (writer_ != nullptr && cur_index_ > 0 && !iteration_completed_) {
+          LOG(WARNING) << kIncompleteCacheErrorMessage;
+        }
+      }
+
+      Status Initialize(IteratorContext* ctx) override {
+        mutex_lock l(mu_);
+        ChunkedCacheWriter::Options options;
+        options.compression = dataset()->compression_;
+        TF_RETURN_IF_ERROR(ChunkedCacheWriter::Create(
+            dataset()->env_, dataset()->CompletedFilename(), options,
+            &writer_));
+        return dataset()->input_->MakeIterator(ctx, this, prefix(),
+                                               &input_impl_);
+      }
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        if (iteration_completed_) {
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+        TF_RETURN_IF_ERROR(
+            input_impl_->GetNext(ctx, out_tensors, end_of_sequence));
+        if (*end_of_sequence) {
+          iteration_completed_ = true;
+          return writer_->Finish();
+        }
+        if (out_tensors->size() != dataset()->num_tensors_) {
+          return errors::Internal(
+              "Upstream iterator returned invalid number of tensors. "
+              "Expected ",
+              dataset()->num_tensors_, " got: ", out_tensors->size());
+        }
+        TF_RETURN_IF_ERROR(writer_->Write(*out_tensors));
+        cur_index_++;
+        return Status::OK();
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeKnownRatioNode(std::move(args),
+                                         /*ratio=*/1);
+      }
+
+      Status SaveInternal(SerializationContext* ctx,
+                          IteratorStateWriter* writer) override {
+        return errors::Unimplemented(
+            "Checkpointing a cache while it is being written in the ",
+            kChunkedFormat, " format is not supported.");
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        return errors::Unimplemented(
+            "Checkpointing a cache while it is being written in the ",
+            kChunkedFormat, " format is not supported.");
+      }
+
+     private:
+      mutex mu_;
+      size_t cur_index_ TF_GUARDED_BY(mu_) = 0;
+      std::unique_ptr<IteratorBase> input_impl_ TF_GUARDED_BY(mu_);
+      std::unique_ptr<ChunkedCacheWriter> writer_ TF_GUARDED_BY(mu_);
+      bool iteration_completed_ TF_GUARDED_BY(mu_) = false;
+    };  // ChunkedWriterIterator
+
+    // ChunkedReaderIterator reads the elements of a complete cache with a
+    // `ChunkedCacheReader`.
+    class ChunkedReaderIterator : public DatasetIterator<FileDatasetBase> {
+     public:
+      explicit ChunkedReaderIterator(const Params& params)
+          : DatasetIterator<FileDatasetBase>(params) {}
+
+      Status Initialize(IteratorContext* ctx) override {
+        mutex_lock l(mu_);
+        return ChunkedCacheReader::Open(
+            dataset()->env_, dataset()->CompletedFilename(), &reader_);
+      }
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(reader_->GetNext(out_tensors, end_of_sequence));
+        if (!*end_of_sequence) {
+          cur_index_++;
+        }
+        return Status::OK();
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeKnownRatioNode(std::move(args),
+                                         /*ratio=*/1);
+      }
+
+      Status SaveInternal(SerializationContext* ctx,
+                          IteratorStateWriter* writer) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name(kCurIndex), cur_index_));
+        return Status::OK();
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kCurIndex), &cur_index_));
+        return reader_->Seek(cur_index_);
+      }
+
+     private:
+      mutex mu_;
+      int64 cur_index_ TF_GUARDED_BY(mu_) = 0;
+      std::unique_ptr<ChunkedCacheReader> reader_ TF_GUARDED_BY(mu_);
+    };  // ChunkedReaderIterator
+
     Status InitializeIterator(IteratorContext* ctx)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (dataset()->chunked_) {
+        switch (mode_) {
+          case Mode::read:
+            iterator_ = absl::make_unique<ChunkedReaderIterator>(
+                ChunkedReaderIterator::Params{
+                    dataset(), strings::StrCat(prefix(), kImpl)});
+            break;
+          case Mode::write:
+            iterator_ = absl::make_unique<ChunkedWriterIterator>(
+                ChunkedWriterIterator::Params{
+                    dataset(), strings::StrCat(prefix(), kImpl)});
+        }
+        TF_RETURN_IF_ERROR(iterator_->InitializeBase(ctx, this));
+        return iterator_->Initialize(ctx);
+      }
       // We intentionally use the same prefix for both `FileReaderIterator` and
       // `FileWriterIterator`. Since at any time there will be at most one of
       // them alive, there should be no conflicts. This allows both iterators to
@@ -635,8 +811,10 @@ class CacheDatasetOp::FileDatasetV2 : public CacheDatasetOp::FileDatasetBase {
  public:
   explicit FileDatasetV2(OpKernelContext* ctx, const DatasetBase* input,
                          string filename, Env* env,
-                         const Tensor& resource_handle)
-      : FileDatasetBase(ctx, input, filename, env),
+                         const Tensor& resource_handle, bool chunked,
+                         string compression)
+      : FileDatasetBase(ctx, input, filename, env, chunked,
+                        std::move(compression)),
         resource_handle_(resource_handle) {}
 
  protected:
@@ -649,8 +827,20 @@ class CacheDatasetOp::FileDatasetV2 : public CacheDatasetOp::FileDatasetBase {
     TF_RETURN_IF_ERROR(b->AddScalar(filename_, &filename_node));
     Node* resource_handle_node = nullptr;
     TF_RETURN_IF_ERROR(b->AddTensor(resource_handle_, &resource_handle_node));
+    // The attrs are only added for the chunked format, so that graphs that
+    // use the default format remain readable by older binaries.
+    std::vector<std::pair<StringPiece, AttrValue>> attrs;
+    if (chunked_) {
+      AttrValue file_format;
+      b->BuildAttrValue<string>(kChunkedFormat, &file_format);
+      attrs.emplace_back(kFileFormat, file_format);
+      AttrValue compression;
+      b->BuildAttrValue(compression_, &compression);
+      attrs.emplace_back(kCompression, compression);
+    }
     TF_RETURN_IF_ERROR(b->AddDataset(
-        this, {input_node, filename_node, resource_handle_node}, output));
+        this, {input_node, filename_node, resource_handle_node}, attrs,
+        output));
     return Status::OK();
   }
 
@@ -1016,15 +1206,261 @@ class CacheDatasetOp::MemoryDatasetV2
   ResourceMgr* const resource_mgr_;  // Not owned.
 };
 
+// This version of memory dataset caches as many elements as fit in a byte
+// budget, and produces all other elements from its input. It shares the cache
+// across different iterations of the `repeat` transformation and across
+// different iterators, like `MemoryDatasetV2`.
+class CacheDatasetOp::BoundedMemoryDataset : public DatasetBase {
+ public:
+  BoundedMemoryDataset(OpKernelContext* ctx, const DatasetBase* input,
+                       MemoryCacheManager* manager,
+                       std::shared_ptr<BoundedMemoryCache> cache,
+                       ResourceHandle&& resource_handle, bool owns_resource)
+      : DatasetBase(DatasetContext(ctx)),
+        input_(input),
+        manager_(manager),
+        cache_(std::move(cache)),
+        owns_resource_(owns_resource),
+        resource_handle_(std::move(resource_handle)),
+        resource_mgr_(ctx->resource_manager()) {
+    input_->Ref();
+  }
+
+  ~BoundedMemoryDataset() override {
+    input_->Unref();
+    manager_->Unref();
+    if (owns_resource_) {
+      Status s = resource_mgr_->Delete<MemoryCacheManager>(
+          resource_handle_.container(), resource_handle_.name());
+      if (!s.ok()) {
+        LOG(WARNING) << "Failed to delete cache resource: " << s.ToString();
+      }
+    }
+  }
+
+  std::unique_ptr<IteratorBase> MakeIteratorInternal(
+      const string& prefix) const override {
+    name_utils::IteratorPrefixParams params;
+    params.dataset_prefix = kBoundedMemoryDatasetPrefix;
+    return absl::make_unique<Iterator>(Iterator::Params{
+        this, name_utils::IteratorPrefix(kDatasetType, prefix, params)});
+  }
+
+  const DataTypeVector& output_dtypes() const override {
+    return input_->output_dtypes();
+  }
+
+  const std::vector<PartialTensorShape>& output_shapes() const override {
+    return input_->output_shapes();
+  }
+
+  string DebugString() const override {
+    name_utils::DatasetDebugStringParams params;
+    params.dataset_prefix = kBoundedMemoryDatasetPrefix;
+    return name_utils::DatasetDebugString(kDatasetType, params);
+  }
+
+  int64 Cardinality() const override { return input_->Cardinality(); }
+
+  Status InputDatasets(std::vector<const DatasetBase*>* inputs) const override {
+    inputs->push_back(input_);
+    return Status::OK();
+  }
+
+  Status CheckExternalState() const override {
+    return input_->CheckExternalState();
+  }
+
+ protected:
+  Status AsGraphDefInternal(SerializationContext* ctx,
+                            DatasetGraphDefBuilder* b,
+                            Node** output) const override {
+    Node* input_node = nullptr;
+    TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_node));
+    Node* filename_node = nullptr;
+    TF_RETURN_IF_ERROR(b->AddScalar(tstring(""), &filename_node));
+    Node* resource_handle_node = nullptr;
+    Tensor handle(DT_RESOURCE, TensorShape({}));
+    handle.scalar<ResourceHandle>()() = resource_handle_;
+    TF_RETURN_IF_ERROR(b->AddTensor(handle, &resource_handle_node));
+    AttrValue max_memory_bytes;
+    b->BuildAttrValue(cache_->max_bytes(), &max_memory_bytes);
+    AttrValue compression;
+    b->BuildAttrValue<string>(cache_->compress() ? kSnappy : "", &compression);
+    TF_RETURN_IF_ERROR(b->AddDataset(
+        this, {input_node, filename_node, resource_handle_node},
+        {{kMaxMemoryBytes, max_memory_bytes}, {kCompression, compression}},
+        output));
+    return Status::OK();
+  }
+
+ private:
+  // Produces element `i` from the cache if it is there, and from the input
+  // otherwise. The input iterator is only created on the first miss, and the
+  // input elements that were produced from the cache are skipped lazily, so
+  // an epoch that is served entirely from the cache never runs the input.
+  class Iterator : public DatasetIterator<BoundedMemoryDataset> {
+   public:
+    explicit Iterator(const Params& params)
+        : DatasetIterator<BoundedMemoryDataset>(params) {}
+
+    Status GetNextInternal(IteratorContext* ctx,
+                           std::vector<Tensor>* out_tensors,
+                           bool* end_of_sequence) override {
+      mutex_lock l(mu_);
+      BoundedMemoryCache* cache = dataset()->cache_.get();
+      const int64 num_elements = cache->num_elements();
+      if (num_elements != kUnknownCardinality && index_ >= num_elements) {
+        EndEpoch();
+        *end_of_sequence = true;
+        return Status::OK();
+      }
+      bool found;
+      TF_RETURN_IF_ERROR(cache->Lookup(index_, out_tensors, &found));
+      if (found) {
+        index_++;
+        num_to_skip_++;
+        *end_of_sequence = false;
+        return Status::OK();
+      }
+
+      if (!input_impl_) {
+        TF_RETURN_IF_ERROR(
+            dataset()->input_->MakeIterator(ctx, this, prefix(), &input_impl_));
+      }
+      while (num_to_skip_ > 0) {
+        int num_skipped;
+        TF_RETURN_IF_ERROR(input_impl_->Skip(
+            ctx, static_cast<int>(std::min<int64>(num_to_skip_, kint32max)),
+            end_of_sequence, &num_skipped));
+        num_to_skip_ -= num_skipped;
+        if (*end_of_sequence) {
+          return errors::FailedPrecondition(
+              "The input of the cache produced fewer elements than in a "
+              "previous epoch. A cache with a memory budget requires its "
+              "input to produce the same elements in every epoch.");
+        }
+      }
+      TF_RETURN_IF_ERROR(
+          input_impl_->GetNext(ctx, out_tensors, end_of_sequence));
+      if (*end_of_sequence) {
+        EndEpoch();
+        return Status::OK();
+      }
+      TF_RETURN_IF_ERROR(cache->Insert(index_, *out_tensors));
+      index_++;
+      return Status::OK();
+    }
+
+   protected:
+    std::shared_ptr<model::Node> CreateNode(
+        IteratorContext* ctx, model::Node::Args args) const override {
+      return model::MakeKnownRatioNode(std::move(args),
+                                       /*ratio=*/1);
+    }
+
+    // The cache itself is not checkpointed: elements that are missing from
+    // it after restoring are produced from the input.
+    Status SaveInternal(SerializationContext* ctx,
+                        IteratorStateWriter* writer) override {
+      mutex_lock l(mu_);
+      TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kIndex), index_));
+      TF_RETURN_IF_ERROR(
+          writer->WriteScalar(full_name(kNumToSkip), num_to_skip_));
+      if (!input_impl_) {
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name(kInputImplEmpty), ""));
+        return Status::OK();
+      }
+      return SaveInput(ctx, writer, input_impl_);
+    }
+
+    Status RestoreInternal(IteratorContext* ctx,
+                           IteratorStateReader* reader) override {
+      mutex_lock l(mu_);
+      TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kIndex), &index_));
+      TF_RETURN_IF_ERROR(
+          reader->ReadScalar(full_name(kNumToSkip), &num_to_skip_));
+      epoch_ended_ = false;
+      input_impl_.reset();
+      if (reader->Contains(full_name(kInputImplEmpty))) {
+        return Status::OK();
+      }
+      TF_RETURN_IF_ERROR(
+          dataset()->input_->MakeIterator(ctx, this, prefix(), &input_impl_));
+      return RestoreInput(ctx, reader, input_impl_);
+    }
+
+   private:
+    void EndEpoch() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (!epoch_ended_) {
+        dataset()->cache_->EndEpoch(index_);
+        epoch_ended_ = true;
+      }
+    }
+
+    mutex mu_;
+    // Index of the next element to produce.
+    int64 index_ TF_GUARDED_BY(mu_) = 0;
+    // Number of input elements to skip before the next one is read from the
+    // input, because they were produced from the cache.
+    int64 num_to_skip_ TF_GUARDED_BY(mu_) = 0;
+    bool epoch_ended_ TF_GUARDED_BY(mu_) = false;
+    std::unique_ptr<IteratorBase> input_impl_ TF_GUARDED_BY(mu_);
+  };
+
+  const DatasetBase* const input_;
+  MemoryCacheManager* const manager_;  // Owned.
+  const std::shared_ptr<BoundedMemoryCache> cache_;
+  const bool owns_resource_;
+  const ResourceHandle resource_handle_;
+  ResourceMgr* const resource_mgr_;  // Not owned.
+};
+
 CacheDatasetOp::CacheDatasetOp(OpKernelConstruction* ctx)
     : UnaryDatasetOpKernel(ctx),
-      op_version_(ctx->def().op() == kCacheDataset ? 1 : 2) {}
+      op_version_(ctx->def().op() == kCacheDataset ? 1 : 2),
+      file_format_(kBundleFormat) {
+  if (ctx->HasAttr(kFileFormat)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kFileFormat, &file_format_));
+  }
+  if (ctx->HasAttr(kCompression)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kCompression, &compression_));
+  }
+  if (ctx->HasAttr(kMaxMemoryBytes)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kMaxMemoryBytes, &max_memory_bytes_));
+  }
+  OP_REQUIRES(ctx,
+              file_format_ == kBundleFormat || file_format_ == kChunkedFormat,
+              errors::InvalidArgument("Unsupported cache file format: ",
+                                      file_format_));
+  OP_REQUIRES(ctx, compression_.empty() || compression_ == kSnappy,
+              errors::InvalidArgument("Unsupported cache compression: ",
+                                      compression_));
+  OP_REQUIRES(ctx, max_memory_bytes_ >= 0,
+              errors::InvalidArgument("`max_memory_bytes` must be >= 0 but "
+                                      "is ",
+                                      max_memory_bytes_));
+}
 
 void CacheDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
                                  DatasetBase** output) {
   // Parse out the filenames tensor.
   tstring filename;
   OP_REQUIRES_OK(ctx, ParseScalarArgument<tstring>(ctx, kFileName, &filename));
+  if (filename.empty()) {
+    OP_REQUIRES(ctx, compression_.empty() || max_memory_bytes_ > 0,
+                errors::InvalidArgument(
+                    "Compression of a memory cache requires a memory budget."));
+  } else {
+    OP_REQUIRES(ctx, compression_.empty() || file_format_ == kChunkedFormat,
+                errors::InvalidArgument("Compression of a cache file requires "
+                                        "the ",
+                                        kChunkedFormat, " format."));
+    OP_REQUIRES(ctx, max_memory_bytes_ == 0,
+                errors::InvalidArgument(
+                    "A cache file cannot have a memory budget."));
+  }
   if (filename.empty()) {
     static std::atomic<int64> resource_id_counter(0);
     const string& container = ctx->resource_manager()->default_container();
@@ -1049,6 +1485,21 @@ void CacheDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
       } else {
         OP_REQUIRES_OK(ctx, s);
       }
+      if (max_memory_bytes_ > 0) {
+        std::shared_ptr<BoundedMemoryCache> cache;
+        s = manager->GetBounded(max_memory_bytes_, !compression_.empty(),
+                                &cache);
+        if (!s.ok()) {
+          manager->Unref();
+          ctx->CtxFailure(s);
+          return;
+        }
+        // Ownership of manager is transferred onto `BoundedMemoryDataset`.
+        *output = new BoundedMemoryDataset(ctx, input, manager,
+                                           std::move(cache), std::move(handle),
+                                           owns_resource);
+        return;
+      }
       // Ownership of manager is transferred onto `MemoryDatasetV2`.
       *output = new MemoryDatasetV2(ctx, input, manager, std::move(handle),
                                     owns_resource);
@@ -1067,8 +1518,9 @@ void CacheDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
     }
   } else {
     if (op_version_ == 2) {
-      *output =
-          new FileDatasetV2(ctx, input, filename, ctx->env(), ctx->input(2));
+      *output = new FileDatasetV2(ctx, input, filename, ctx->env(),
+                                  ctx->input(2),
+                                  file_format_ == kChunkedFormat, compression_);
     } else {
       *output = new FileDataset(ctx, input, filename, ctx->env());
     }
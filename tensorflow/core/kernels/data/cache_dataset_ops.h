@@ -30,6 +30,9 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
   static constexpr const char* const kFileName = "filename";
   static constexpr const char* const kOutputTypes = "output_types";
   static constexpr const char* const kOutputShapes = "output_shapes";
+  static constexpr const char* const kFileFormat = "file_format";
+  static constexpr const char* const kCompression = "compression";
+  static constexpr const char* const kMaxMemoryBytes = "max_memory_bytes";
 
   explicit CacheDatasetOp(OpKernelConstruction* ctx);
 
@@ -42,8 +45,13 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
   class FileDatasetV2;
   class MemoryDataset;
   class MemoryDatasetV2;
+  class BoundedMemoryDataset;
 
   const int op_version_;
+  // Only supported by `CacheDatasetV2`.
+  std::string file_format_;
+  std::string compression_;
+  int64 max_memory_bytes_ = 0;
 };
 
 }  // namespace data
@@ -13,6 +13,7 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/data/dataset_test_base.h"
 #include "tensorflow/core/kernels/data/dataset_utils.h"
+#include "tensorflow/core/kernels/data/text_line_dataset_op.h"
 #include "tensorflow/core/platform/path.h"
 
 namespace tensorflow {
@@ -64,6 +65,90 @@ class CacheDatasetParams : public DatasetParams {
   string filename_;
 };
 
+// Parameters of a `CacheDatasetV2`, which supports more cache formats.
+class CacheDatasetV2Params : public CacheDatasetParams {
+ public:
+  template <typename T>
+  CacheDatasetV2Params(T input_dataset_params, string filename,
+                       string file_format, string compression,
+                       int64 max_memory_bytes, DataTypeVector output_dtypes,
+                       std::vector<PartialTensorShape> output_shapes,
+                       string node_name)
+      : CacheDatasetParams(std::move(input_dataset_params),
+                           std::move(filename), std::move(output_dtypes),
+                           std::move(output_shapes), std::move(node_name)),
+        file_format_(std::move(file_format)),
+        compression_(std::move(compression)),
+        max_memory_bytes_(max_memory_bytes) {
+    op_version_ = 2;
+  }
+
+  std::vector<Tensor> GetInputTensors() const override {
+    std::vector<Tensor> input_tensors = CacheDatasetParams::GetInputTensors();
+    // An empty handle does not name a memory cache, so the dataset creates
+    // its own if it needs one.
+    Tensor cache(DT_RESOURCE, TensorShape({}));
+    cache.scalar<ResourceHandle>()() = ResourceHandle();
+    input_tensors.push_back(cache);
+    return input_tensors;
+  }
+
+  Status GetInputNames(std::vector<string>* input_names) const override {
+    *input_names = {CacheDatasetOp::kInputDataset, CacheDatasetOp::kFileName,
+                    "cache"};
+    return Status::OK();
+  }
+
+  Status GetAttributes(AttributeVector* attr_vector) const override {
+    *attr_vector = {{CacheDatasetOp::kOutputTypes, output_dtypes_},
+                    {CacheDatasetOp::kOutputShapes, output_shapes_},
+                    {CacheDatasetOp::kFileFormat, file_format_},
+                    {CacheDatasetOp::kCompression, compression_},
+                    {CacheDatasetOp::kMaxMemoryBytes, max_memory_bytes_}};
+    return Status::OK();
+  }
+
+ private:
+  string file_format_;
+  string compression_;
+  int64 max_memory_bytes_;
+};
+
+// Reads the lines of a single uncompressed text file.
+class TextLineDatasetParams : public DatasetParams {
+ public:
+  TextLineDatasetParams(string filename, string node_name)
+      : DatasetParams({DT_STRING}, {PartialTensorShape({})},
+                      std::move(node_name)),
+        filename_(std::move(filename)) {}
+
+  std::vector<Tensor> GetInputTensors() const override {
+    return {CreateTensor<tstring>(TensorShape({1}), {filename_}),
+            CreateTensor<tstring>(TensorShape({}),
+                                  {ToString(CompressionType::UNCOMPRESSED)}),
+            CreateTensor<int64>(TensorShape({}), {0})};
+  }
+
+  Status GetInputNames(std::vector<string>* input_names) const override {
+    *input_names = {TextLineDatasetOp::kFileNames,
+                    TextLineDatasetOp::kCompressionType,
+                    TextLineDatasetOp::kBufferSize};
+    return Status::OK();
+  }
+
+  Status GetAttributes(AttributeVector* attr_vector) const override {
+    *attr_vector = {};
+    return Status::OK();
+  }
+
+  string dataset_type() const override {
+    return TextLineDatasetOp::kDatasetType;
+  }
+
+ private:
+  string filename_;
+};
+
 class CacheDatasetOpTest : public DatasetOpsTestBase {
  public:
   Status Initialize(const DatasetParams& dataset_params) {
@@ -365,6 +450,198 @@ INSTANTIATE_TEST_CASE_P(CacheDatasetOpTest,
                         ParameterizedIteratorSaveAndRestoreTest,
                         ::testing::ValuesIn(IteratorSaveAndRestoreTestCases()));
 
+CacheDatasetV2Params ChunkedCacheDatasetParams(const string& compression) {
+  auto tensor_slice_dataset_params = TensorSliceDatasetParams(
+      /*components=*/{CreateTensor<int64>(TensorShape{3, 3, 1},
+                                          {0, 1, 2, 3, 4, 5, 6, 7, 8}),
+                      CreateTensor<tstring>(TensorShape{3}, {"a", "b", "c"})},
+      /*node_name=*/"tensor_slice");
+  return CacheDatasetV2Params(
+      std::move(tensor_slice_dataset_params),
+      /*filename=*/io::JoinPath(testing::TmpDir(), "chunked_cache_data"),
+      /*file_format=*/"chunked", compression,
+      /*max_memory_bytes=*/0,
+      /*output_dtypes=*/{DT_INT64, DT_STRING},
+      /*output_shapes=*/{PartialTensorShape({3, 1}), PartialTensorShape({})},
+      kNodeName);
+}
+
+TEST_F(CacheDatasetOpTest, ChunkedFileFormat) {
+  for (const string& compression : {"", "SNAPPY"}) {
+    auto dataset_params = ChunkedCacheDatasetParams(compression);
+    TF_ASSERT_OK(Initialize(dataset_params));
+    std::vector<Tensor> expected_outputs = {
+        CreateTensor<int64>(TensorShape({3, 1}), {0, 1, 2}),
+        CreateTensor<tstring>(TensorShape({}), {"a"}),
+        CreateTensor<int64>(TensorShape({3, 1}), {3, 4, 5}),
+        CreateTensor<tstring>(TensorShape({}), {"b"}),
+        CreateTensor<int64>(TensorShape({3, 1}), {6, 7, 8}),
+        CreateTensor<tstring>(TensorShape({}), {"c"})};
+
+    // The first iterator writes the cache, and the second one reads it.
+    for (int i = 0; i < 2; ++i) {
+      TF_ASSERT_OK(dataset_->MakeIterator(
+          iterator_ctx_.get(), /*parent=*/nullptr,
+          dataset_params.iterator_prefix(), &iterator_));
+      bool end_of_sequence = false;
+      std::vector<Tensor> out_tensors;
+      while (!end_of_sequence) {
+        std::vector<Tensor> next;
+        TF_EXPECT_OK(
+            iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+        out_tensors.insert(out_tensors.end(), next.begin(), next.end());
+      }
+      TF_EXPECT_OK(ExpectEqual(out_tensors, expected_outputs,
+                               /*compare_order=*/true));
+      TF_EXPECT_OK(device_->env()->FileExists(
+          strings::StrCat(dataset_params.filename(), ".chunks")));
+    }
+
+    iterator_.reset();
+    TF_ASSERT_OK(device_->env()->DeleteFile(
+        strings::StrCat(dataset_params.filename(), ".chunks")));
+  }
+}
+
+TEST_F(CacheDatasetOpTest, ChunkedFileFormatInvalidCompression) {
+  EXPECT_EQ(Initialize(ChunkedCacheDatasetParams("ZLIB")).code(),
+            tensorflow::error::INVALID_ARGUMENT);
+}
+
+// Caches 5 of the 10 elements of the range.
+CacheDatasetV2Params BoundedMemoryCacheDatasetParams(
+    const string& compression, int64 max_memory_bytes) {
+  return CacheDatasetV2Params(RangeDatasetParams(0, 10, 1),
+                              /*filename=*/"",
+                              /*file_format=*/"bundle", compression,
+                              max_memory_bytes,
+                              /*output_dtypes=*/{DT_INT64},
+                              /*output_shapes=*/{PartialTensorShape({})},
+                              kNodeName);
+}
+
+TEST_F(CacheDatasetOpTest, BoundedMemory) {
+  // A compressed scalar takes more space than an uncompressed one.
+  for (const auto& budget : std::vector<std::pair<string, int64>>{
+           {"", 5 * sizeof(int64)}, {"SNAPPY", 1 << 10}}) {
+    auto dataset_params =
+        BoundedMemoryCacheDatasetParams(budget.first, budget.second);
+    TF_ASSERT_OK(Initialize(dataset_params));
+    // The cache is filled during the first epoch, and partially serves the
+    // following ones.
+    for (int epoch = 0; epoch < 3; ++epoch) {
+      TF_ASSERT_OK(dataset_->MakeIterator(
+          iterator_ctx_.get(), /*parent=*/nullptr,
+          dataset_params.iterator_prefix(), &iterator_));
+      bool end_of_sequence = false;
+      std::vector<Tensor> out_tensors;
+      while (!end_of_sequence) {
+        std::vector<Tensor> next;
+        TF_EXPECT_OK(
+            iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+        out_tensors.insert(out_tensors.end(), next.begin(), next.end());
+      }
+      TF_EXPECT_OK(ExpectEqual(
+          out_tensors,
+          CreateTensors<int64>(TensorShape({}), {{0}, {1}, {2}, {3}, {4}, {5},
+                                                 {6}, {7}, {8}, {9}}),
+          /*compare_order=*/true));
+    }
+  }
+}
+
+TEST_F(CacheDatasetOpTest, BoundedMemoryServesCachedElementsWithoutInput) {
+  // The input file is rewritten after the first epoch, so elements that are
+  // read from the input again have the new contents.
+  const string filename =
+      io::JoinPath(testing::TmpDir(), "bounded_memory_input.txt");
+  TF_ASSERT_OK(WriteDataToFile(filename, "a0\na1\na2\na3\na4\na5\n"));
+  const int64 element_bytes =
+      CreateTensor<tstring>(TensorShape({}), {"a0"}).TotalBytes();
+  auto dataset_params = CacheDatasetV2Params(
+      TextLineDatasetParams(filename, "text_line"),
+      /*filename=*/"",
+      /*file_format=*/"bundle", /*compression=*/"",
+      /*max_memory_bytes=*/3 * element_bytes,
+      /*output_dtypes=*/{DT_STRING},
+      /*output_shapes=*/{PartialTensorShape({})}, kNodeName);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    TF_ASSERT_OK(dataset_->MakeIterator(
+        iterator_ctx_.get(), /*parent=*/nullptr,
+        dataset_params.iterator_prefix(), &iterator_));
+    bool end_of_sequence = false;
+    std::vector<Tensor> out_tensors;
+    while (!end_of_sequence) {
+      std::vector<Tensor> next;
+      TF_EXPECT_OK(
+          iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+      out_tensors.insert(out_tensors.end(), next.begin(), next.end());
+    }
+    // The first three elements fit in the cache and are never read from the
+    // input again.
+    std::vector<Tensor> expected =
+        epoch == 0 ? CreateTensors<tstring>(
+                         TensorShape({}),
+                         {{"a0"}, {"a1"}, {"a2"}, {"a3"}, {"a4"}, {"a5"}})
+                   : CreateTensors<tstring>(
+                         TensorShape({}),
+                         {{"a0"}, {"a1"}, {"a2"}, {"b3"}, {"b4"}, {"b5"}});
+    TF_EXPECT_OK(ExpectEqual(out_tensors, expected, /*compare_order=*/true));
+    TF_ASSERT_OK(
+        WriteDataToFile(filename, "b0\nb1\nb2\nb3\nb4\nb5\n"));
+  }
+}
+
+TEST_F(CacheDatasetOpTest, BoundedMemorySaveAndRestore) {
+  auto dataset_params =
+      BoundedMemoryCacheDatasetParams("", /*max_memory_bytes=*/24);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  std::unique_ptr<SerializationContext> serialization_ctx;
+  TF_ASSERT_OK(CreateSerializationContext(&serialization_ctx));
+  std::vector<Tensor> out_tensors;
+  bool end_of_sequence = false;
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    TF_ASSERT_OK(dataset_->MakeIterator(
+        iterator_ctx_.get(), /*parent=*/nullptr,
+        dataset_params.iterator_prefix(), &iterator_));
+    for (int i = 0; i < 10; ++i) {
+      // Checkpoint both while elements come from the cache and while they
+      // come from the input.
+      if (i == 2 || i == 6) {
+        VariantTensorDataWriter writer;
+        TF_ASSERT_OK(iterator_->Save(serialization_ctx.get(), &writer));
+        std::vector<const VariantTensorData*> data;
+        writer.GetData(&data);
+        VariantTensorDataReader reader(data);
+        TF_ASSERT_OK(RestoreIterator(iterator_ctx_.get(), &reader,
+                                     dataset_params.iterator_prefix(),
+                                     *dataset_, &iterator_));
+      }
+      std::vector<Tensor> next;
+      TF_ASSERT_OK(
+          iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+      ASSERT_FALSE(end_of_sequence);
+      out_tensors.insert(out_tensors.end(), next.begin(), next.end());
+    }
+  }
+  std::vector<Tensor> expected_outputs;
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    for (int64 i = 0; i < 10; ++i) {
+      expected_outputs.push_back(CreateTensor<int64>(TensorShape({}), {i}));
+    }
+  }
+  TF_EXPECT_OK(ExpectEqual(out_tensors, expected_outputs,
+                           /*compare_order=*/true));
+}
+
+TEST_F(CacheDatasetOpTest, BoundedMemoryInvalidArguments) {
+  EXPECT_EQ(Initialize(BoundedMemoryCacheDatasetParams("", -1)).code(),
+            tensorflow::error::INVALID_ARGUMENT);
+  EXPECT_EQ(Initialize(BoundedMemoryCacheDatasetParams("SNAPPY", 0)).code(),
+            tensorflow::error::INVALID_ARGUMENT);
+}
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
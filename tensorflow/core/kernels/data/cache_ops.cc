@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/cache_ops.h"
 
+#include "tensorflow/core/data/compression_utils.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/resource_mgr.h"
@@ -33,6 +34,115 @@ constexpr char kMemoryCache[] = "MemoryCache";
 
 string MemoryCacheManager::DebugString() const { return kMemoryCache; }
 
+Status MemoryCacheManager::GetBounded(
+    int64 max_bytes, bool compress,
+    std::shared_ptr<BoundedMemoryCache>* cache) {
+  mutex_lock l(mu_);
+  if (!bounded_cache_) {
+    bounded_cache_ = std::make_shared<BoundedMemoryCache>(max_bytes, compress);
+  } else if (bounded_cache_->max_bytes() != max_bytes ||
+             bounded_cache_->compress() != compress) {
+    return errors::InvalidArgument(
+        "The memory cache is already used with a budget of ",
+        bounded_cache_->max_bytes(), " bytes",
+        bounded_cache_->compress() ? " and compression" : "");
+  }
+  *cache = bounded_cache_;
+  return Status::OK();
+}
+
+BoundedMemoryCache::BoundedMemoryCache(int64 max_bytes, bool compress)
+    : max_bytes_(max_bytes), compress_(compress) {}
+
+Status BoundedMemoryCache::Lookup(int64 index, std::vector<Tensor>* element,
+                                  bool* found) {
+  std::shared_ptr<const CompressedElement> compressed;
+  {
+    mutex_lock l(mu_);
+    auto it = entries_.find(index);
+    *found = it != entries_.end();
+    if (!*found) {
+      return Status::OK();
+    }
+    Touch(index, &it->second);
+    if (!compress_) {
+      *element = it->second.element;
+      return Status::OK();
+    }
+    compressed = it->second.compressed;
+  }
+  // Uncompress without holding the lock.
+  return UncompressElement(*compressed, element);
+}
+
+Status BoundedMemoryCache::Insert(int64 index,
+                                  const std::vector<Tensor>& element) {
+  Entry entry;
+  if (compress_) {
+    auto compressed = std::make_shared<CompressedElement>();
+    TF_RETURN_IF_ERROR(CompressElement(element, compressed.get()));
+    entry.bytes = compressed->ByteSizeLong();
+    entry.compressed = std::move(compressed);
+  } else {
+    entry.bytes = 0;
+    for (const Tensor& t : element) {
+      entry.bytes += t.TotalBytes();
+    }
+    entry.element = element;
+  }
+  if (entry.bytes > max_bytes_) {
+    return Status::OK();
+  }
+
+  mutex_lock l(mu_);
+  if (entries_.contains(index)) {
+    return Status::OK();
+  }
+  while (bytes_ + entry.bytes > max_bytes_ && !lru_.empty()) {
+    const int64 victim = lru_.back();
+    auto it = entries_.find(victim);
+    if (it->second.last_epoch + 1 >= epoch_) {
+      // All remaining elements were used recently.
+      return Status::OK();
+    }
+    bytes_ -= it->second.bytes;
+    entries_.erase(it);
+    lru_.pop_back();
+  }
+  bytes_ += entry.bytes;
+  lru_.push_front(index);
+  entry.lru_position = lru_.begin();
+  entry.last_epoch = epoch_;
+  entries_.emplace(index, std::move(entry));
+  return Status::OK();
+}
+
+void BoundedMemoryCache::Touch(int64 index, Entry* entry) {
+  lru_.splice(lru_.begin(), lru_, entry->lru_position);
+  entry->last_epoch = epoch_;
+}
+
+void BoundedMemoryCache::EndEpoch(int64 num_elements) {
+  mutex_lock l(mu_);
+  ++epoch_;
+  num_elements_ = num_elements;
+}
+
+int64 BoundedMemoryCache::num_elements() {
+  mutex_lock l(mu_);
+  return num_elements_;
+}
+
+int64 BoundedMemoryCache::size() {
+  mutex_lock l(mu_);
+  return entries_.size();
+}
+
+int64 BoundedMemoryCache::bytes() {
+  mutex_lock l(mu_);
+  return bytes_;
+}
+
 void MemoryCache::Complete(std::vector<std::vector<Tensor>>&& cache) {
   mutex_lock l(mu_);
   if (!completed_) {
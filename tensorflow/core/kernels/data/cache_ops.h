@@ -16,6 +16,10 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_DATA_CACHE_OPS_H_
 #define TENSORFLOW_CORE_KERNELS_DATA_CACHE_OPS_H_
 
+#include <list>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/data/dataset.pb.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/kernels/data/dataset_utils.h"
 
@@ -57,6 +61,69 @@ class MemoryCache {
   std::vector<std::vector<Tensor>> cache_ TF_GUARDED_BY(mu_);
 };
 
+// A thread-safe cache of dataset elements, keyed by their index in the
+// dataset, which holds at most `max_bytes` bytes of elements.
+//
+// Unlike `MemoryCache`, the cache does not need to hold all elements: the
+// expected use is that a `CacheDatasetOp::BoundedMemoryDataset::Iterator`
+// produces cached elements from the cache and all others from its input,
+// inserting them into the cache as it goes.
+//
+// Elements are evicted in least recently used order, but only once they have
+// not been used for a whole epoch. For the cyclic access of repeated epochs,
+// evicting an element that was used in the current or the previous epoch
+// would only replace it with one that is needed no sooner, so elements that
+// do not fit are not inserted instead, and the cache settles on a fixed
+// subset of the dataset.
+class BoundedMemoryCache {
+ public:
+  // If `compress` is true, elements are cached in compressed form.
+  BoundedMemoryCache(int64 max_bytes, bool compress);
+
+  // Returns whether element `index` is cached, and if so, stores it in
+  // `element`.
+  Status Lookup(int64 index, std::vector<Tensor>* element, bool* found);
+
+  // Caches `element` as element `index` if it fits, evicting elements that
+  // were not used during the last epoch as needed.
+  Status Insert(int64 index, const std::vector<Tensor>& element);
+
+  // Marks the end of an epoch of `num_elements` elements.
+  void EndEpoch(int64 num_elements);
+
+  // Returns the number of elements of the dataset, or `kUnknownCardinality`
+  // until an epoch has ended.
+  int64 num_elements();
+
+  // Returns the number of cached elements and their size.
+  int64 size();
+  int64 bytes();
+
+  int64 max_bytes() const { return max_bytes_; }
+  bool compress() const { return compress_; }
+
+ private:
+  struct Entry {
+    std::vector<Tensor> element;
+    std::shared_ptr<const CompressedElement> compressed;
+    int64 bytes;
+    int64 last_epoch;
+    std::list<int64>::iterator lru_position;
+  };
+
+  void Touch(int64 index, Entry* entry) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int64 max_bytes_;
+  const bool compress_;
+  mutex mu_;
+  absl::flat_hash_map<int64, Entry> entries_ TF_GUARDED_BY(mu_);
+  // Indices of the cached elements, most recently used first.
+  std::list<int64> lru_ TF_GUARDED_BY(mu_);
+  int64 bytes_ TF_GUARDED_BY(mu_) = 0;
+  int64 epoch_ TF_GUARDED_BY(mu_) = 0;
+  int64 num_elements_ TF_GUARDED_BY(mu_) = kUnknownCardinality;
+};
+
 // A resource wrapping a shared instance of a memory cache.
 class MemoryCacheManager : public ResourceBase {
  public:
@@ -66,8 +133,15 @@ class MemoryCacheManager : public ResourceBase {
 
   std::shared_ptr<MemoryCache> get() { return cache_; }
 
+  // Returns the bounded cache of this resource, creating it on first use.
+  // Fails if the bounded cache was already created with other parameters.
+  Status GetBounded(int64 max_bytes, bool compress,
+                    std::shared_ptr<BoundedMemoryCache>* cache);
+
  private:
   std::shared_ptr<MemoryCache> cache_;
+  mutex mu_;
+  std::shared_ptr<BoundedMemoryCache> bounded_cache_ TF_GUARDED_BY(mu_);
 };
 
 // Creates an instance of cache resource and transfers ownership to the caller.
@@ -0,0 +1,120 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/cache_ops.h"
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+// An element of 8 bytes.
+std::vector<Tensor> Element(int64 i) { return {test::AsScalar<int64>(i)}; }
+
+bool Contains(BoundedMemoryCache* cache, int64 index) {
+  std::vector<Tensor> element;
+  bool found;
+  TF_CHECK_OK(cache->Lookup(index, &element, &found));
+  if (found) {
+    test::ExpectTensorEqual<int64>(element[0], test::AsScalar<int64>(index));
+  }
+  return found;
+}
+
+TEST(BoundedMemoryCacheTest, KeepsElementsThatFit) {
+  BoundedMemoryCache cache(/*max_bytes=*/32, /*compress=*/false);
+  for (int64 i = 0; i < 10; ++i) {
+    TF_ASSERT_OK(cache.Insert(i, Element(i)));
+  }
+  cache.EndEpoch(10);
+  EXPECT_EQ(cache.size(), 4);
+  EXPECT_EQ(cache.bytes(), 32);
+  EXPECT_EQ(cache.num_elements(), 10);
+
+  // Repeated epochs keep hitting the same elements, rather than replacing
+  // them with ones that are needed no sooner.
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    for (int64 i = 0; i < 10; ++i) {
+      if (!Contains(&cache, i)) {
+        TF_ASSERT_OK(cache.Insert(i, Element(i)));
+      }
+    }
+    cache.EndEpoch(10);
+    for (int64 i = 0; i < 4; ++i) {
+      EXPECT_TRUE(Contains(&cache, i));
+    }
+  }
+}
+
+TEST(BoundedMemoryCacheTest, EvictsElementsUnusedForAnEpoch) {
+  BoundedMemoryCache cache(/*max_bytes=*/32, /*compress=*/false);
+  for (int64 i = 0; i < 4; ++i) {
+    TF_ASSERT_OK(cache.Insert(i, Element(i)));
+  }
+  cache.EndEpoch(10);
+  // Only elements 2 and 3 are used during the next two epochs.
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    EXPECT_TRUE(Contains(&cache, 2));
+    EXPECT_TRUE(Contains(&cache, 3));
+    cache.EndEpoch(10);
+  }
+  TF_ASSERT_OK(cache.Insert(4, Element(4)));
+  TF_ASSERT_OK(cache.Insert(5, Element(5)));
+  TF_ASSERT_OK(cache.Insert(6, Element(6)));
+  EXPECT_FALSE(Contains(&cache, 0));
+  EXPECT_FALSE(Contains(&cache, 1));
+  EXPECT_TRUE(Contains(&cache, 2));
+  EXPECT_TRUE(Contains(&cache, 3));
+  EXPECT_TRUE(Contains(&cache, 4));
+  EXPECT_TRUE(Contains(&cache, 5));
+  EXPECT_FALSE(Contains(&cache, 6));
+}
+
+TEST(BoundedMemoryCacheTest, SkipsElementsLargerThanTheBudget) {
+  BoundedMemoryCache cache(/*max_bytes=*/16, /*compress=*/false);
+  TF_ASSERT_OK(cache.Insert(0, {test::AsTensor<int64>({1, 2, 3})}));
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(BoundedMemoryCacheTest, Compressed) {
+  BoundedMemoryCache cache(/*max_bytes=*/1 << 20, /*compress=*/true);
+  Tensor zeros(DT_FLOAT, TensorShape({1000}));
+  zeros.flat<float>().setZero();
+  TF_ASSERT_OK(cache.Insert(0, {zeros}));
+  // The zeros compress well.
+  EXPECT_LT(cache.bytes(), zeros.TotalBytes());
+  std::vector<Tensor> element;
+  bool found;
+  TF_ASSERT_OK(cache.Lookup(0, &element, &found));
+  ASSERT_TRUE(found);
+  test::ExpectTensorEqual<float>(element[0], zeros);
+}
+
+TEST(MemoryCacheManagerTest, GetBounded) {
+  core::RefCountPtr<MemoryCacheManager> manager(new MemoryCacheManager());
+  std::shared_ptr<BoundedMemoryCache> cache;
+  TF_ASSERT_OK(manager->GetBounded(100, /*compress=*/false, &cache));
+  std::shared_ptr<BoundedMemoryCache> same_cache;
+  TF_ASSERT_OK(manager->GetBounded(100, /*compress=*/false, &same_cache));
+  EXPECT_EQ(cache, same_cache);
+  EXPECT_EQ(manager->GetBounded(200, /*compress=*/false, &cache).code(),
+            error::INVALID_ARGUMENT);
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,589 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/chunked_cache_file.h"
+
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // _MSC_VER
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/snappy.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+constexpr uint64 kMagic = 0x7466636163686531;  // "tfcache1"
+// Alignment of chunks, and of component data of at least this size.
+constexpr size_t kAlignment = 64;
+// Alignment of component headers and of smaller component data.
+constexpr size_t kHeaderAlignment = 8;
+
+// Compression of chunks.
+constexpr uint32 kNoCompression = 0;
+constexpr uint32 kSnappy = 1;
+
+// The last bytes of the file.
+struct Footer {
+  uint64 index_offset;
+  uint64 num_chunks;
+  uint64 num_elements;
+  uint32 compression;
+  uint32 num_components;
+  uint64 magic;
+};
+
+// Each component of an element is a `ComponentHeader`, followed by `rank`
+// dimensions and then by `data_bytes` bytes of data. The data is the raw
+// tensor content if the type can be copied with memcpy, and a serialized
+// `TensorProto` otherwise.
+struct ComponentHeader {
+  int32 dtype;
+  int32 rank;
+  uint64 data_bytes;
+};
+
+size_t RoundUp(size_t bytes, size_t alignment) {
+  return (bytes + alignment - 1) / alignment * alignment;
+}
+
+size_t DataAlignment(uint64 data_bytes) {
+  return data_bytes >= kAlignment ? kAlignment : kHeaderAlignment;
+}
+
+// The contents of a file that cannot be memory-mapped, e.g. because its file
+// system does not support it.
+class FileContents : public ReadOnlyMemoryRegion {
+ public:
+  static Status Read(Env* env, const std::string& filename,
+                     std::unique_ptr<ReadOnlyMemoryRegion>* region) {
+    uint64 size;
+    TF_RETURN_IF_ERROR(env->GetFileSize(filename, &size));
+    std::unique_ptr<RandomAccessFile> file;
+    TF_RETURN_IF_ERROR(env->NewRandomAccessFile(filename, &file));
+    std::unique_ptr<FileContents> contents(new FileContents(size));
+    StringPiece result;
+    TF_RETURN_IF_ERROR(file->Read(0, size, &result, contents->data_));
+    if (result.size() != size) {
+      return errors::DataLoss("Failed to read all of ", filename);
+    }
+    if (result.data() != contents->data_) {
+      memmove(contents->data_, result.data(), size);
+    }
+    *region = std::move(contents);
+    return Status::OK();
+  }
+
+  ~FileContents() override { port::AlignedFree(data_); }
+
+  const void* data() override { return data_; }
+  uint64 length() override { return length_; }
+
+ private:
+  explicit FileContents(uint64 length)
+      : data_(static_cast<char*>(
+            port::AlignedMalloc(std::max<uint64>(length, 1), kAlignment))),
+        length_(length) {}
+
+  char* const data_;
+  const uint64 length_;
+};
+
+}  // namespace
+
+Status ChunkedCacheWriter::Create(Env* env, const std::string& filename,
+                                  const Options& options,
+                                  std::unique_ptr<ChunkedCacheWriter>* writer) {
+  uint32 compression;
+  if (options.compression.empty()) {
+    compression = kNoCompression;
+  } else if (options.compression == "SNAPPY") {
+    compression = kSnappy;
+  } else {
+    return errors::InvalidArgument("Unsupported cache compression: ",
+                                   options.compression);
+  }
+  if (options.chunk_bytes <= 0) {
+    return errors::InvalidArgument("Cache chunks must have a positive size.");
+  }
+  // Concurrent writers of the same cache each write their own temporary file;
+  // whichever finishes last replaces the file of the others.
+  const std::string temp_filename =
+      strings::StrCat(filename, ".tmp-", random::New64());
+  std::unique_ptr<WritableFile> file;
+  TF_RETURN_IF_ERROR(env->NewWritableFile(temp_filename, &file));
+  writer->reset(new ChunkedCacheWriter(env, filename, temp_filename,
+                                       compression, options.chunk_bytes,
+                                       std::move(file)));
+  return Status::OK();
+}
+
+ChunkedCacheWriter::ChunkedCacheWriter(Env* env, const std::string& filename,
+                                       const std::string& temp_filename,
+                                       uint32 compression, int64 chunk_bytes,
+                                       std::unique_ptr<WritableFile> file)
+    : env_(env),
+      filename_(filename),
+      temp_filename_(temp_filename),
+      compression_(compression),
+      chunk_bytes_(chunk_bytes),
+      file_(std::move(file)) {}
+
+ChunkedCacheWriter::~ChunkedCacheWriter() {
+  if (!finished_) {
+    file_->Close().IgnoreError();
+    Status s = env_->DeleteFile(temp_filename_);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to delete " << temp_filename_ << " : " << s;
+    }
+  }
+}
+
+Status ChunkedCacheWriter::Write(const std::vector<Tensor>& element) {
+  if (finished_) {
+    return errors::FailedPrecondition("Cache file ", filename_,
+                                      " is already finished.");
+  }
+  if (num_components_ == -1) {
+    num_components_ = element.size();
+  } else if (num_components_ != static_cast<int64>(element.size())) {
+    return errors::InvalidArgument("Expected elements of ", num_components_,
+                                   " components but got ", element.size());
+  }
+  for (const Tensor& component : element) {
+    std::string proto_bytes;
+    StringPiece data;
+    if (DataTypeCanUseMemcpy(component.dtype())) {
+      data = component.tensor_data();
+    } else {
+      TensorProto proto;
+      component.AsProtoTensorContent(&proto);
+      proto.SerializeToString(&proto_bytes);
+      data = proto_bytes;
+    }
+    ComponentHeader header;
+    header.dtype = component.dtype();
+    header.rank = component.dims();
+    header.data_bytes = data.size();
+    chunk_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (int d = 0; d < component.dims(); ++d) {
+      const int64 dim = component.dim_size(d);
+      chunk_.append(reinterpret_cast<const char*>(&dim), sizeof(dim));
+    }
+    chunk_.resize(RoundUp(chunk_.size(), DataAlignment(data.size())));
+    chunk_.append(data.data(), data.size());
+    chunk_.resize(RoundUp(chunk_.size(), kHeaderAlignment));
+  }
+  ++num_chunk_elements_;
+  ++num_elements_;
+  if (chunk_.size() >= static_cast<size_t>(chunk_bytes_)) {
+    TF_RETURN_IF_ERROR(FlushChunk());
+  }
+  return Status::OK();
+}
+
+Status ChunkedCacheWriter::FlushChunk() {
+  if (num_chunk_elements_ == 0) {
+    return Status::OK();
+  }
+  std::string compressed;
+  StringPiece stored = chunk_;
+  if (compression_ == kSnappy) {
+    if (!port::Snappy_Compress(chunk_.data(), chunk_.size(), &compressed)) {
+      return errors::Unimplemented(
+          "Snappy compression is not supported on this platform.");
+    }
+    stored = compressed;
+  }
+  // Chunks start at aligned offsets so that aligned component data in an
+  // uncompressed chunk is also aligned in memory once the file is mapped.
+  TF_RETURN_IF_ERROR(
+      Append(std::string(RoundUp(offset_, kAlignment) - offset_, '\0')));
+  ChunkedCacheIndexEntry entry;
+  entry.offset = offset_;
+  entry.stored_bytes = stored.size();
+  entry.raw_bytes = chunk_.size();
+  entry.first_element = num_elements_ - num_chunk_elements_;
+  entry.num_elements = num_chunk_elements_;
+  entry.crc = crc32c::Mask(crc32c::Value(stored.data(), stored.size()));
+  TF_RETURN_IF_ERROR(Append(stored));
+  chunks_.push_back(entry);
+  chunk_.clear();
+  num_chunk_elements_ = 0;
+  return Status::OK();
+}
+
+Status ChunkedCacheWriter::Append(StringPiece data) {
+  TF_RETURN_IF_ERROR(file_->Append(data));
+  offset_ += data.size();
+  return Status::OK();
+}
+
+Status ChunkedCacheWriter::Finish() {
+  if (finished_) {
+    return Status::OK();
+  }
+  TF_RETURN_IF_ERROR(FlushChunk());
+  TF_RETURN_IF_ERROR(Append(
+      std::string(RoundUp(offset_, kHeaderAlignment) - offset_, '\0')));
+  Footer footer;
+  footer.index_offset = offset_;
+  footer.num_chunks = chunks_.size();
+  footer.num_elements = num_elements_;
+  footer.compression = compression_;
+  footer.num_components = std::max<int64>(num_components_, 0);
+  footer.magic = kMagic;
+  TF_RETURN_IF_ERROR(
+      Append(StringPiece(reinterpret_cast<const char*>(chunks_.data()),
+                         chunks_.size() * sizeof(ChunkedCacheIndexEntry))));
+  TF_RETURN_IF_ERROR(Append(
+      StringPiece(reinterpret_cast<const char*>(&footer), sizeof(footer))));
+  TF_RETURN_IF_ERROR(file_->Close());
+  TF_RETURN_IF_ERROR(env_->RenameFile(temp_filename_, filename_));
+  finished_ = true;
+  return Status::OK();
+}
+
+// The contents of the file, which tensors that alias it keep alive.
+class ChunkedCacheReader::Mapping : public core::RefCounted {
+ public:
+  explicit Mapping(std::unique_ptr<ReadOnlyMemoryRegion> region)
+      : region_(std::move(region)) {}
+
+  const char* data() const {
+    return static_cast<const char*>(region_->data());
+  }
+  uint64 length() const { return region_->length(); }
+
+ private:
+  const std::unique_ptr<ReadOnlyMemoryRegion> region_;
+};
+
+// The uncompressed contents of a chunk, which either alias the mapping or are
+// owned.
+class ChunkedCacheReader::Chunk : public core::RefCounted {
+ public:
+  Chunk(Mapping* mapping, const char* data, size_t size)
+      : mapping_(mapping), owned_(nullptr), data_(data), size_(size) {
+    mapping_->Ref();
+  }
+
+  explicit Chunk(size_t size)
+      : mapping_(nullptr),
+        owned_(static_cast<char*>(
+            port::AlignedMalloc(std::max<size_t>(size, 1), kAlignment))),
+        data_(owned_),
+        size_(size) {}
+
+  ~Chunk() override {
+    if (mapping_ != nullptr) {
+      mapping_->Unref();
+    }
+    port::AlignedFree(owned_);
+  }
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  char* mutable_data() { return owned_; }
+
+ private:
+  Mapping* const mapping_;
+  char* const owned_;
+  const char* const data_;
+  const size_t size_;
+};
+
+// A tensor buffer that aliases a component in a chunk.
+class ChunkedCacheReader::ChunkBuffer : public TensorBuffer {
+ public:
+  ChunkBuffer(Chunk* chunk, const char* data, size_t size)
+      : TensorBuffer(const_cast<char*>(data)), chunk_(chunk), size_(size) {
+    chunk_->Ref();
+  }
+
+  ~ChunkBuffer() override { chunk_->Unref(); }
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("chunked_cache_file");
+  }
+  // The chunk may alias a read-only mapping, so it must never be written
+  // through, even if this buffer is the only reference to it.
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  Chunk* const chunk_;
+  const size_t size_;
+};
+
+Status ChunkedCacheReader::Open(Env* env, const std::string& filename,
+                                std::unique_ptr<ChunkedCacheReader>* reader) {
+  std::unique_ptr<ReadOnlyMemoryRegion> region;
+  Status s = env->NewReadOnlyMemoryRegionFromFile(filename, &region);
+  if (errors::IsUnimplemented(s)) {
+    TF_RETURN_IF_ERROR(FileContents::Read(env, filename, &region));
+  } else {
+    TF_RETURN_IF_ERROR(s);
+#ifndef _MSC_VER
+    // Chunks are read in order, so let the kernel read ahead aggressively.
+    if (region->length() > 0) {
+      posix_madvise(const_cast<void*>(region->data()), region->length(),
+                    POSIX_MADV_SEQUENTIAL);
+    }
+#endif  // _MSC_VER
+  }
+  core::RefCountPtr<Mapping> mapping(new Mapping(std::move(region)));
+
+  const uint64 length = mapping->length();
+  Footer footer;
+  if (length < sizeof(footer)) {
+    return errors::DataLoss("Cache file ", filename, " is truncated.");
+  }
+  memcpy(&footer, mapping->data() + length - sizeof(footer), sizeof(footer));
+  const uint64 index_end = length - sizeof(footer);
+  if (footer.magic != kMagic) {
+    return errors::DataLoss("Cache file ", filename,
+                            " is not a chunked cache file.");
+  }
+  if (footer.compression != kNoCompression && footer.compression != kSnappy) {
+    return errors::DataLoss("Cache file ", filename,
+                            " has an unknown compression ",
+                            footer.compression);
+  }
+  if (footer.index_offset > index_end ||
+      footer.num_chunks !=
+          (index_end - footer.index_offset) / sizeof(ChunkedCacheIndexEntry) ||
+      (index_end - footer.index_offset) % sizeof(ChunkedCacheIndexEntry) !=
+          0) {
+    return errors::DataLoss("Cache file ", filename, " has a corrupt index.");
+  }
+  std::vector<ChunkedCacheIndexEntry> chunks(footer.num_chunks);
+  if (!chunks.empty()) {
+    memcpy(chunks.data(), mapping->data() + footer.index_offset,
+           chunks.size() * sizeof(ChunkedCacheIndexEntry));
+  }
+  uint64 num_elements = 0;
+  for (const ChunkedCacheIndexEntry& chunk : chunks) {
+    if (chunk.offset > footer.index_offset ||
+        chunk.stored_bytes > footer.index_offset - chunk.offset ||
+        chunk.offset % kAlignment != 0 ||
+        chunk.first_element != num_elements) {
+      return errors::DataLoss("Cache file ", filename,
+                              " has a corrupt index.");
+    }
+    num_elements += chunk.num_elements;
+  }
+  if (num_elements != footer.num_elements) {
+    return errors::DataLoss("Cache file ", filename, " has a corrupt index.");
+  }
+  reader->reset(new ChunkedCacheReader(
+      filename, mapping.release(), footer.compression, footer.num_components,
+      footer.num_elements, std::move(chunks)));
+  return Status::OK();
+}
+
+ChunkedCacheReader::ChunkedCacheReader(
+    const std::string& filename, Mapping* mapping, uint32 compression,
+    int64 num_components, int64 num_elements,
+    std::vector<ChunkedCacheIndexEntry> chunks)
+    : filename_(filename),
+      mapping_(mapping),
+      compression_(compression),
+      num_components_(num_components),
+      num_elements_(num_elements),
+      chunks_(std::move(chunks)) {}
+
+ChunkedCacheReader::~ChunkedCacheReader() {}
+
+Status ChunkedCacheReader::LoadChunk(int64 index) {
+  const ChunkedCacheIndexEntry& entry = chunks_[index];
+  const char* stored = mapping_->data() + entry.offset;
+#ifndef _MSC_VER
+  // Start reading the following chunk while this one is decoded.
+  if (index + 1 < static_cast<int64>(chunks_.size())) {
+    const ChunkedCacheIndexEntry& next = chunks_[index + 1];
+    const uintptr_t page_size = getpagesize();
+    const uintptr_t start =
+        reinterpret_cast<uintptr_t>(mapping_->data() + next.offset) /
+        page_size * page_size;
+    const uintptr_t end =
+        reinterpret_cast<uintptr_t>(mapping_->data() + next.offset) +
+        next.stored_bytes;
+    posix_madvise(reinterpret_cast<void*>(start), end - start,
+                  POSIX_MADV_WILLNEED);
+  }
+#endif  // _MSC_VER
+  if (crc32c::Unmask(entry.crc) !=
+      crc32c::Value(stored, entry.stored_bytes)) {
+    return errors::DataLoss("Checksum mismatch in chunk ", index,
+                            " of cache file ", filename_);
+  }
+  if (compression_ == kNoCompression) {
+    if (entry.raw_bytes != entry.stored_bytes) {
+      return errors::DataLoss("Corrupt chunk ", index, " of cache file ",
+                              filename_);
+    }
+    chunk_.reset(new Chunk(mapping_.get(), stored, entry.stored_bytes));
+  } else {
+    size_t raw_bytes;
+    if (!port::Snappy_GetUncompressedLength(stored, entry.stored_bytes,
+                                            &raw_bytes) ||
+        raw_bytes != entry.raw_bytes) {
+      return errors::DataLoss("Corrupt chunk ", index, " of cache file ",
+                              filename_);
+    }
+    core::RefCountPtr<Chunk> chunk(new Chunk(raw_bytes));
+    if (!port::Snappy_Uncompress(stored, entry.stored_bytes,
+                                 chunk->mutable_data())) {
+      return errors::DataLoss("Failed to uncompress chunk ", index,
+                              " of cache file ", filename_);
+    }
+    chunk_ = std::move(chunk);
+  }
+  chunk_index_ = index;
+  chunk_offset_ = 0;
+  return Status::OK();
+}
+
+Status ChunkedCacheReader::ReadElement(std::vector<Tensor>* element) {
+  const char* data = chunk_->data();
+  const uint64 size = chunk_->size();
+  auto corrupt = [this]() {
+    return errors::DataLoss("Corrupt element in chunk ", chunk_index_,
+                            " of cache file ", filename_);
+  };
+  if (element != nullptr) {
+    element->clear();
+    element->reserve(num_components_);
+  }
+  for (int64 i = 0; i < num_components_; ++i) {
+    ComponentHeader header;
+    if (chunk_offset_ + sizeof(header) > size) return corrupt();
+    memcpy(&header, data + chunk_offset_, sizeof(header));
+    chunk_offset_ += sizeof(header);
+    if (header.rank < 0 ||
+        chunk_offset_ + header.rank * sizeof(int64) > size) {
+      return corrupt();
+    }
+    const uint64 dims_offset = chunk_offset_;
+    chunk_offset_ = RoundUp(chunk_offset_ + header.rank * sizeof(int64),
+                            DataAlignment(header.data_bytes));
+    if (chunk_offset_ > size || header.data_bytes > size - chunk_offset_) {
+      return corrupt();
+    }
+    const char* component_data = data + chunk_offset_;
+    chunk_offset_ =
+        RoundUp(chunk_offset_ + header.data_bytes, kHeaderAlignment);
+    if (element == nullptr) continue;
+
+    const DataType dtype = static_cast<DataType>(header.dtype);
+    if (!DataType_IsValid(header.dtype)) return corrupt();
+    if (!DataTypeCanUseMemcpy(dtype)) {
+      TensorProto proto;
+      element->emplace_back();
+      if (!proto.ParseFromArray(component_data, header.data_bytes) ||
+          !element->back().FromProto(proto)) {
+        return corrupt();
+      }
+      continue;
+    }
+    TensorShape shape;
+    for (int d = 0; d < header.rank; ++d) {
+      int64 dim;
+      memcpy(&dim, data + dims_offset + d * sizeof(dim), sizeof(dim));
+      TF_RETURN_IF_ERROR(shape.AddDimWithStatus(dim));
+    }
+    if (header.data_bytes !=
+        static_cast<uint64>(shape.num_elements() * DataTypeSize(dtype))) {
+      return corrupt();
+    }
+    if (header.data_bytes == 0 ||
+        reinterpret_cast<uintptr_t>(component_data) % EIGEN_MAX_ALIGN_BYTES !=
+            0) {
+      // Small components are not aligned, so they are copied.
+      element->emplace_back(dtype, shape);
+      if (header.data_bytes > 0) {
+        memcpy(const_cast<char*>(element->back().tensor_data().data()),
+               component_data, header.data_bytes);
+      }
+      continue;
+    }
+    ChunkBuffer* buffer =
+        new ChunkBuffer(chunk_.get(), component_data, header.data_bytes);
+    element->emplace_back(dtype, shape, buffer);
+    buffer->Unref();
+  }
+  ++next_element_;
+  return Status::OK();
+}
+
+Status ChunkedCacheReader::GetNext(std::vector<Tensor>* element,
+                                   bool* end_of_sequence) {
+  if (next_element_ >= num_elements_) {
+    *end_of_sequence = true;
+    return Status::OK();
+  }
+  *end_of_sequence = false;
+  while (chunk_index_ < 0 ||
+         next_element_ >=
+             static_cast<int64>(chunks_[chunk_index_].first_element +
+                                chunks_[chunk_index_].num_elements)) {
+    TF_RETURN_IF_ERROR(LoadChunk(chunk_index_ + 1));
+  }
+  return ReadElement(element);
+}
+
+Status ChunkedCacheReader::Seek(int64 index) {
+  if (index < 0 || index > num_elements_) {
+    return errors::OutOfRange("Cannot seek to element ", index,
+                              " of cache file ", filename_, " with ",
+                              num_elements_, " elements.");
+  }
+  // Find the last chunk that starts at or before `index`.
+  auto it = std::upper_bound(
+      chunks_.begin(), chunks_.end(), index,
+      [](int64 index, const ChunkedCacheIndexEntry& chunk) {
+        return index < static_cast<int64>(chunk.first_element);
+      });
+  if (it == chunks_.begin() || index == num_elements_) {
+    chunk_.reset();
+    chunk_index_ = -1;
+    next_element_ = index;
+    return Status::OK();
+  }
+  const int64 chunk_index = it - chunks_.begin() - 1;
+  TF_RETURN_IF_ERROR(LoadChunk(chunk_index));
+  next_element_ = chunks_[chunk_index].first_element;
+  while (next_element_ < index) {
+    TF_RETURN_IF_ERROR(ReadElement(/*element=*/nullptr));
+  }
+  return Status::OK();
+}
+
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,166 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_KERNELS_DATA_CHUNKED_CACHE_FILE_H_
+#define TENSORFLOW_CORE_KERNELS_DATA_CHUNKED_CACHE_FILE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/refcount.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace data {
+
+// An append-only file of dataset elements, used by `CacheDataset` as an
+// alternative to tensor bundles.
+//
+// Elements are appended to chunks of roughly `chunk_bytes` bytes, which are
+// optionally compressed and each start at an aligned offset. The file ends
+// with an index of the chunks and a fixed-size footer. A file is written
+// under a temporary name and renamed once complete, so a file with the final
+// name is always complete.
+//
+// Readers map the file into memory, so processes on one host that read the
+// same cache share a single copy in the page cache. Components of
+// uncompressed chunks whose type can be copied with memcpy alias the mapping
+// rather than being copied.
+
+// The index entry of a chunk.
+struct ChunkedCacheIndexEntry {
+  // Offset of the chunk in the file.
+  uint64 offset;
+  // Size of the chunk in the file, and once uncompressed.
+  uint64 stored_bytes;
+  uint64 raw_bytes;
+  // Index of the first element of the chunk in the file.
+  uint64 first_element;
+  uint32 num_elements;
+  // Masked CRC32C of the stored chunk.
+  uint32 crc;
+};
+
+// Writes a chunked cache file.
+class ChunkedCacheWriter {
+ public:
+  struct Options {
+    // One of "" (no compression) or "SNAPPY".
+    std::string compression;
+    // The uncompressed size after which a chunk is closed.
+    int64 chunk_bytes = 4 << 20;
+  };
+
+  // Creates a writer of the file `filename`, which only exists once
+  // `Finish()` returns.
+  static Status Create(Env* env, const std::string& filename,
+                       const Options& options,
+                       std::unique_ptr<ChunkedCacheWriter>* writer);
+
+  // Deletes the temporary file unless `Finish()` was called.
+  ~ChunkedCacheWriter();
+
+  // Appends `element`.
+  Status Write(const std::vector<Tensor>& element);
+
+  // Writes the index and footer, and renames the file to its final name.
+  Status Finish();
+
+ private:
+  ChunkedCacheWriter(Env* env, const std::string& filename,
+                     const std::string& temp_filename, uint32 compression,
+                     int64 chunk_bytes, std::unique_ptr<WritableFile> file);
+
+  // Compresses and appends the current chunk, if it is not empty.
+  Status FlushChunk();
+  Status Append(StringPiece data);
+
+  Env* const env_;
+  const std::string filename_;
+  const std::string temp_filename_;
+  const uint32 compression_;
+  const int64 chunk_bytes_;
+  std::unique_ptr<WritableFile> file_;
+  // Bytes written to `file_` so far.
+  uint64 offset_ = 0;
+  // The uncompressed contents of the current chunk.
+  std::string chunk_;
+  uint32 num_chunk_elements_ = 0;
+  uint64 num_elements_ = 0;
+  // Number of components of each element, or -1 before the first element.
+  int64 num_components_ = -1;
+  std::vector<ChunkedCacheIndexEntry> chunks_;
+  bool finished_ = false;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ChunkedCacheWriter);
+};
+
+// Reads a chunked cache file, sequentially from a given position.
+class ChunkedCacheReader {
+ public:
+  // Opens the complete file `filename`.
+  static Status Open(Env* env, const std::string& filename,
+                     std::unique_ptr<ChunkedCacheReader>* reader);
+
+  ~ChunkedCacheReader();
+
+  // Reads the next element, or sets `*end_of_sequence` after the last one.
+  Status GetNext(std::vector<Tensor>* element, bool* end_of_sequence);
+
+  // Positions the reader so that the next element read is element `index`.
+  Status Seek(int64 index);
+
+  // The total number of elements in the file.
+  int64 num_elements() const { return num_elements_; }
+
+ private:
+  class Mapping;
+  class Chunk;
+  class ChunkBuffer;
+
+  ChunkedCacheReader(const std::string& filename, Mapping* mapping,
+                     uint32 compression, int64 num_components,
+                     int64 num_elements,
+                     std::vector<ChunkedCacheIndexEntry> chunks);
+
+  // Verifies and, if needed, decompresses chunk `index` into `chunk_`.
+  Status LoadChunk(int64 index);
+  // Decodes the element at `chunk_offset_`, or only skips it if `element` is
+  // null.
+  Status ReadElement(std::vector<Tensor>* element);
+
+  const std::string filename_;
+  core::RefCountPtr<Mapping> mapping_;
+  const uint32 compression_;
+  const int64 num_components_;
+  const int64 num_elements_;
+  const std::vector<ChunkedCacheIndexEntry> chunks_;
+  // The loaded chunk, and the position of the next element in it.
+  core::RefCountPtr<Chunk> chunk_;
+  int64 chunk_index_ = -1;
+  uint64 chunk_offset_ = 0;
+  int64 next_element_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ChunkedCacheReader);
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_DATA_CHUNKED_CACHE_FILE_H_
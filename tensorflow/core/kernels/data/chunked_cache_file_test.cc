@@ -0,0 +1,254 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/chunked_cache_file.h"
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+std::string TestFilename(const std::string& name) {
+  return io::JoinPath(testing::TmpDir(), name);
+}
+
+// Element `i` has a scalar, a large vector and a string.
+std::vector<Tensor> TestElement(int64 i) {
+  Tensor vector(DT_FLOAT, TensorShape({100}));
+  vector.flat<float>().setConstant(i);
+  return {test::AsScalar<int64>(i), vector,
+          test::AsScalar<tstring>(strings::StrCat("element ", i))};
+}
+
+Status WriteElements(const std::string& filename,
+                     const ChunkedCacheWriter::Options& options,
+                     int64 num_elements) {
+  std::unique_ptr<ChunkedCacheWriter> writer;
+  TF_RETURN_IF_ERROR(
+      ChunkedCacheWriter::Create(Env::Default(), filename, options, &writer));
+  for (int64 i = 0; i < num_elements; ++i) {
+    TF_RETURN_IF_ERROR(writer->Write(TestElement(i)));
+  }
+  return writer->Finish();
+}
+
+void ExpectElement(const std::vector<Tensor>& element, int64 i) {
+  std::vector<Tensor> expected = TestElement(i);
+  ASSERT_EQ(element.size(), expected.size());
+  test::ExpectTensorEqual<int64>(element[0], expected[0]);
+  test::ExpectTensorEqual<float>(element[1], expected[1]);
+  test::ExpectTensorEqual<tstring>(element[2], expected[2]);
+}
+
+class ChunkedCacheFileTest : public ::testing::TestWithParam<std::string> {};
+
+TEST_P(ChunkedCacheFileTest, ReadAll) {
+  const std::string filename = TestFilename(
+      strings::StrCat("read_all_", GetParam().empty() ? "none" : GetParam()));
+  ChunkedCacheWriter::Options options;
+  options.compression = GetParam();
+  options.chunk_bytes = 4096;
+  TF_ASSERT_OK(WriteElements(filename, options, /*num_elements=*/100));
+
+  std::unique_ptr<ChunkedCacheReader> reader;
+  TF_ASSERT_OK(ChunkedCacheReader::Open(Env::Default(), filename, &reader));
+  EXPECT_EQ(reader->num_elements(), 100);
+  for (int64 i = 0; i < 100; ++i) {
+    std::vector<Tensor> element;
+    bool end_of_sequence;
+    TF_ASSERT_OK(reader->GetNext(&element, &end_of_sequence));
+    ASSERT_FALSE(end_of_sequence);
+    ExpectElement(element, i);
+  }
+  std::vector<Tensor> element;
+  bool end_of_sequence;
+  TF_ASSERT_OK(reader->GetNext(&element, &end_of_sequence));
+  EXPECT_TRUE(end_of_sequence);
+}
+
+TEST_P(ChunkedCacheFileTest, Seek) {
+  const std::string filename = TestFilename(
+      strings::StrCat("seek_", GetParam().empty() ? "none" : GetParam()));
+  ChunkedCacheWriter::Options options;
+  options.compression = GetParam();
+  options.chunk_bytes = 4096;
+  TF_ASSERT_OK(WriteElements(filename, options, /*num_elements=*/100));
+
+  std::unique_ptr<ChunkedCacheReader> reader;
+  TF_ASSERT_OK(ChunkedCacheReader::Open(Env::Default(), filename, &reader));
+  for (int64 index : {57, 3, 99, 0}) {
+    TF_ASSERT_OK(reader->Seek(index));
+    std::vector<Tensor> element;
+    bool end_of_sequence;
+    TF_ASSERT_OK(reader->GetNext(&element, &end_of_sequence));
+    ASSERT_FALSE(end_of_sequence);
+    ExpectElement(element, index);
+  }
+  TF_ASSERT_OK(reader->Seek(100));
+  std::vector<Tensor> element;
+  bool end_of_sequence;
+  TF_ASSERT_OK(reader->GetNext(&element, &end_of_sequence));
+  EXPECT_TRUE(end_of_sequence);
+  EXPECT_EQ(reader->Seek(101).code(), error::OUT_OF_RANGE);
+}
+
+TEST_P(ChunkedCacheFileTest, ElementsOutliveReader) {
+  const std::string filename = TestFilename(
+      strings::StrCat("outlive_", GetParam().empty() ? "none" : GetParam()));
+  ChunkedCacheWriter::Options options;
+  options.compression = GetParam();
+  TF_ASSERT_OK(WriteElements(filename, options, /*num_elements=*/10));
+
+  std::vector<std::vector<Tensor>> elements(10);
+  {
+    std::unique_ptr<ChunkedCacheReader> reader;
+    TF_ASSERT_OK(ChunkedCacheReader::Open(Env::Default(), filename, &reader));
+    for (auto& element : elements) {
+      bool end_of_sequence;
+      TF_ASSERT_OK(reader->GetNext(&element, &end_of_sequence));
+    }
+  }
+  for (int64 i = 0; i < 10; ++i) {
+    ExpectElement(elements[i], i);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Compression, ChunkedCacheFileTest,
+                         ::testing::Values("", "SNAPPY"));
+
+TEST(ChunkedCacheFileTest, Empty) {
+  const std::string filename = TestFilename("empty");
+  TF_ASSERT_OK(WriteElements(filename, {}, /*num_elements=*/0));
+  std::unique_ptr<ChunkedCacheReader> reader;
+  TF_ASSERT_OK(ChunkedCacheReader::Open(Env::Default(), filename, &reader));
+  std::vector<Tensor> element;
+  bool end_of_sequence;
+  TF_ASSERT_OK(reader->GetNext(&element, &end_of_sequence));
+  EXPECT_TRUE(end_of_sequence);
+}
+
+TEST(ChunkedCacheFileTest, UnfinishedFileIsDeleted) {
+  const std::string filename = TestFilename("unfinished");
+  {
+    std::unique_ptr<ChunkedCacheWriter> writer;
+    TF_ASSERT_OK(
+        ChunkedCacheWriter::Create(Env::Default(), filename, {}, &writer));
+    TF_ASSERT_OK(writer->Write(TestElement(0)));
+  }
+  std::vector<string> files;
+  TF_ASSERT_OK(Env::Default()->GetMatchingPaths(
+      strings::StrCat(filename, "*"), &files));
+  EXPECT_TRUE(files.empty());
+}
+
+TEST(ChunkedCacheFileTest, DetectsCorruption) {
+  const std::string filename = TestFilename("corrupt");
+  TF_ASSERT_OK(WriteElements(filename, {}, /*num_elements=*/10));
+  std::string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), filename, &contents));
+  // Flip a byte of the first element's data.
+  contents[100] ^= 1;
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), filename, contents));
+
+  std::unique_ptr<ChunkedCacheReader> reader;
+  TF_ASSERT_OK(ChunkedCacheReader::Open(Env::Default(), filename, &reader));
+  std::vector<Tensor> element;
+  bool end_of_sequence;
+  EXPECT_EQ(reader->GetNext(&element, &end_of_sequence).code(),
+            error::DATA_LOSS);
+}
+
+TEST(ChunkedCacheFileTest, NotACacheFile) {
+  const std::string filename = TestFilename("not_a_cache_file");
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), filename,
+                                 std::string(100, 'x')));
+  std::unique_ptr<ChunkedCacheReader> reader;
+  EXPECT_EQ(ChunkedCacheReader::Open(Env::Default(), filename, &reader).code(),
+            error::DATA_LOSS);
+}
+
+TEST(ChunkedCacheFileTest, UnsupportedCompression) {
+  ChunkedCacheWriter::Options options;
+  options.compression = "LZ77";
+  std::unique_ptr<ChunkedCacheWriter> writer;
+  EXPECT_EQ(ChunkedCacheWriter::Create(Env::Default(), TestFilename("lz77"),
+                                       options, &writer)
+                .code(),
+            error::INVALID_ARGUMENT);
+}
+
+class ChunkedCacheFileOpTest : public OpsTestBase {};
+
+TEST_F(ChunkedCacheFileOpTest, InPlaceOpDoesNotWriteToFile) {
+  const std::string filename = TestFilename("in_place");
+  TF_ASSERT_OK(WriteElements(filename, {}, /*num_elements=*/1));
+  std::unique_ptr<ChunkedCacheReader> reader;
+  TF_ASSERT_OK(ChunkedCacheReader::Open(Env::Default(), filename, &reader));
+  std::vector<Tensor> element;
+  bool end_of_sequence;
+  TF_ASSERT_OK(reader->GetNext(&element, &end_of_sequence));
+
+  TF_ASSERT_OK(NodeDefBuilder("add", "AddV2")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  // The input holds the only reference to the cached vector, so the op could
+  // otherwise forward it as its output and add in place.
+  *AddInput(DT_FLOAT, element[1].shape()) = std::move(element[1]);
+  AddInputFromArray<float>(TensorShape({100}), std::vector<float>(100, 1.0f));
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(DT_FLOAT, TensorShape({100}));
+  expected.flat<float>().setConstant(1.0f);
+  test::ExpectTensorEqual<float>(*GetOutput(0), expected);
+
+  TF_ASSERT_OK(reader->Seek(0));
+  TF_ASSERT_OK(reader->GetNext(&element, &end_of_sequence));
+  ExpectElement(element, 0);
+}
+
+// Reads `state.range(0)` small elements from a cache file, with snappy
+// compression if `state.range(1)` is non-zero.
+static void BM_ChunkedCacheRead(::testing::benchmark::State& state) {
+  const int64 num_elements = state.range(0);
+  ChunkedCacheWriter::Options options;
+  if (state.range(1)) options.compression = "SNAPPY";
+  const std::string filename = TestFilename("benchmark");
+  TF_CHECK_OK(WriteElements(filename, options, num_elements));
+
+  for (auto s : state) {
+    std::unique_ptr<ChunkedCacheReader> reader;
+    TF_CHECK_OK(ChunkedCacheReader::Open(Env::Default(), filename, &reader));
+    bool end_of_sequence = false;
+    while (!end_of_sequence) {
+      std::vector<Tensor> element;
+      TF_CHECK_OK(reader->GetNext(&element, &end_of_sequence));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_elements);
+}
+
+BENCHMARK(BM_ChunkedCacheRead)->ArgPair(100000, 0)->ArgPair(100000, 1);
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,422 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include <signal.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/input_colocation_exemption_registry.h"
+#include "tensorflow/core/data/dataset.pb.h"
+#include "tensorflow/core/data/shared_memory_channel.h"
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/data/captured_function.h"
+#include "tensorflow/core/kernels/data/dataset_utils.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/subprocess.h"
+#include "tensorflow/core/util/ptr_util.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+constexpr char kDatasetType[] = "MultiProcessMap";
+constexpr char kOtherArguments[] = "other_arguments";
+constexpr char kNumWorkers[] = "num_workers";
+constexpr char kWorkerBinary[] = "worker_binary";
+constexpr char kFunc[] = "f";
+constexpr char kTarguments[] = "Targuments";
+constexpr char kOutputTypes[] = "output_types";
+constexpr char kOutputShapes[] = "output_shapes";
+constexpr char kSlotsPerWorker[] = "slots_per_worker";
+constexpr char kSlotBytes[] = "slot_bytes";
+
+// Applies a function to the elements of its input in `num_workers` separate
+// processes, which run `worker_binary` (see
+// `tensorflow/core/data/multi_process_map_worker_main.cc`). This sidesteps
+// contention on the producing process (e.g. on the Python GIL for
+// `tf.py_function`) for expensive map functions.
+//
+// The input pipeline runs in this process; the i-th element is sent to worker
+// `i % num_workers` through a shared memory channel, and results are read back
+// in the same order, so the output order is deterministic.
+class MultiProcessMapDatasetOp : public UnaryDatasetOpKernel {
+ public:
+  explicit MultiProcessMapDatasetOp(OpKernelConstruction* ctx)
+      : UnaryDatasetOpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, FunctionMetadata::Create(ctx, kFunc, /*params=*/{},
+                                                 &func_metadata_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kOutputTypes, &output_types_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kOutputShapes, &output_shapes_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kSlotsPerWorker,
+                                     &channel_options_.num_slots));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kSlotBytes, &channel_options_.slot_bytes));
+    OP_REQUIRES(ctx, channel_options_.num_slots > 0,
+                errors::InvalidArgument("`slots_per_worker` must be > 0"));
+    OP_REQUIRES(ctx, channel_options_.slot_bytes > 0,
+                errors::InvalidArgument("`slot_bytes` must be > 0"));
+  }
+
+  void MakeDataset(OpKernelContext* ctx, DatasetBase* input,
+                   DatasetBase** output) override {
+    int64 num_workers;
+    OP_REQUIRES_OK(ctx,
+                   ParseScalarArgument(ctx, kNumWorkers, &num_workers));
+    OP_REQUIRES(
+        ctx, num_workers > 0 || num_workers == model::kAutotune,
+        errors::InvalidArgument("`num_workers` must be > 0 or AUTOTUNE"));
+    if (num_workers == model::kAutotune) {
+      num_workers = port::MaxParallelism();
+    }
+    tstring worker_binary;
+    OP_REQUIRES_OK(ctx,
+                   ParseScalarArgument(ctx, kWorkerBinary, &worker_binary));
+    OP_REQUIRES(ctx, !worker_binary.empty(),
+                errors::InvalidArgument("`worker_binary` must not be empty"));
+
+    std::unique_ptr<CapturedFunction> captured_func;
+    OP_REQUIRES_OK(ctx,
+                   CapturedFunction::Create(ctx, func_metadata_,
+                                            kOtherArguments, &captured_func));
+    for (const Tensor& t : captured_func->captured_inputs()) {
+      // Resources live in this process and cannot be used by the workers.
+      OP_REQUIRES(ctx, t.dtype() != DT_RESOURCE,
+                  errors::InvalidArgument(
+                      "The function of a MultiProcessMapDataset cannot "
+                      "capture resources."));
+    }
+    *output = new Dataset(ctx, input, std::move(captured_func), num_workers,
+                          worker_binary, output_types_, output_shapes_,
+                          channel_options_);
+  }
+
+ private:
+  class Dataset : public DatasetBase {
+   public:
+    Dataset(OpKernelContext* ctx, const DatasetBase* input,
+            std::unique_ptr<CapturedFunction> captured_func, int64 num_workers,
+            const tstring& worker_binary,
+            const DataTypeVector& output_types,
+            const std::vector<PartialTensorShape>& output_shapes,
+            const SharedMemoryChannel::Options& channel_options)
+        : DatasetBase(DatasetContext(ctx)),
+          input_(input),
+          captured_func_(std::move(captured_func)),
+          num_workers_(num_workers),
+          worker_binary_(worker_binary),
+          output_types_(output_types),
+          output_shapes_(output_shapes),
+          channel_options_(channel_options) {
+      input_->Ref();
+    }
+
+    ~Dataset() override { input_->Unref(); }
+
+    std::unique_ptr<IteratorBase> MakeIteratorInternal(
+        const string& prefix) const override {
+      return MakeUnique<Iterator>(Iterator::Params{
+          this, strings::StrCat(prefix, "::", kDatasetType)});
+    }
+
+    const DataTypeVector& output_dtypes() const override {
+      return output_types_;
+    }
+
+    const std::vector<PartialTensorShape>& output_shapes() const override {
+      return output_shapes_;
+    }
+
+    string DebugString() const override {
+      return "MultiProcessMapDatasetOp::Dataset";
+    }
+
+    int64 Cardinality() const override { return input_->Cardinality(); }
+
+    Status InputDatasets(
+        std::vector<const DatasetBase*>* inputs) const override {
+      inputs->push_back(input_);
+      return Status::OK();
+    }
+
+    Status CheckExternalState() const override {
+      TF_RETURN_IF_ERROR(captured_func_->CheckExternalState());
+      return input_->CheckExternalState();
+    }
+
+   protected:
+    Status AsGraphDefInternal(SerializationContext* ctx,
+                              DatasetGraphDefBuilder* b,
+                              Node** output) const override {
+      Node* input_node;
+      TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_node));
+
+      std::vector<Node*> other_arguments;
+      DataTypeVector other_arguments_types;
+      TF_RETURN_IF_ERROR(captured_func_->AddToGraph(ctx, b, &other_arguments,
+                                                    &other_arguments_types));
+      Node* num_workers_node;
+      TF_RETURN_IF_ERROR(b->AddScalar(num_workers_, &num_workers_node));
+      Node* worker_binary_node;
+      TF_RETURN_IF_ERROR(b->AddScalar(worker_binary_, &worker_binary_node));
+
+      AttrValue f_attr;
+      b->BuildAttrValue(captured_func_->func(), &f_attr);
+      AttrValue other_arguments_types_attr;
+      b->BuildAttrValue(other_arguments_types, &other_arguments_types_attr);
+      AttrValue slots_per_worker_attr;
+      b->BuildAttrValue(channel_options_.num_slots, &slots_per_worker_attr);
+      AttrValue slot_bytes_attr;
+      b->BuildAttrValue(channel_options_.slot_bytes, &slot_bytes_attr);
+
+      TF_RETURN_IF_ERROR(b->AddDataset(
+          this,
+          {std::make_pair(0, input_node), std::make_pair(2, num_workers_node),
+           std::make_pair(3, worker_binary_node)},
+          {std::make_pair(1, other_arguments)},
+          {std::make_pair(kFunc, f_attr),
+           std::make_pair(kTarguments, other_arguments_types_attr),
+           std::make_pair(kSlotsPerWorker, slots_per_worker_attr),
+           std::make_pair(kSlotBytes, slot_bytes_attr)},
+          output));
+      return Status::OK();
+    }
+
+   private:
+    class Iterator : public DatasetIterator<Dataset> {
+     public:
+      explicit Iterator(const Params& params)
+          : DatasetIterator<Dataset>(params) {}
+
+      ~Iterator() override {
+        if (deregister_fn_) deregister_fn_();
+        cancellation_manager_.StartCancel();
+        CancelThreads();
+        for (auto& worker : workers_) {
+          if (worker->process) worker->process->Kill(SIGTERM);
+        }
+        // Joins the threads.
+        feeder_thread_.reset();
+        for (auto& worker : workers_) {
+          worker->waiter_thread.reset();
+        }
+        if (!worker_def_path_.empty()) {
+          Env::Default()->DeleteFile(worker_def_path_).IgnoreError();
+        }
+      }
+
+      Status Initialize(IteratorContext* ctx) override {
+        IteratorContext::Params params(ctx);
+        params.cancellation_manager = &cancellation_manager_;
+        auto input_ctx = std::make_shared<IteratorContext>(params);
+        TF_RETURN_IF_ERROR(dataset()->input_->MakeIterator(
+            input_ctx.get(), this, prefix(), &input_impl_));
+        TF_RETURN_IF_ERROR(WriteWorkerDef(ctx));
+
+        const std::string channel_prefix = strings::StrCat(
+            "/tf_data_", kDatasetType, "_", random::New64(), "_");
+        for (int64 i = 0; i < dataset()->num_workers_; ++i) {
+          auto worker = std::make_shared<Worker>();
+          TF_RETURN_IF_ERROR(SharedMemoryChannel::Create(
+              strings::StrCat(channel_prefix, i, "_in"),
+              dataset()->channel_options_, &worker->input));
+          TF_RETURN_IF_ERROR(SharedMemoryChannel::Create(
+              strings::StrCat(channel_prefix, i, "_out"),
+              dataset()->channel_options_, &worker->output));
+          worker->process = absl::make_unique<SubProcess>();
+          worker->process->SetChannelAction(CHAN_STDERR, ACTION_DUPPARENT);
+          worker->process->SetProgram(
+              dataset()->worker_binary_,
+              {dataset()->worker_binary_,
+               strings::StrCat("--worker_def=", worker_def_path_),
+               strings::StrCat("--input_channel=", worker->input->name()),
+               strings::StrCat("--output_channel=", worker->output->name())});
+          if (!worker->process->Start()) {
+            return errors::Internal("Failed to start worker process ",
+                                    dataset()->worker_binary_);
+          }
+          // Closes the channels when the worker exits, so that neither side
+          // of this iterator waits for it forever.
+          worker->waiter_thread = ctx->StartThread(
+              "tf_data_multi_process_map_waiter", [worker]() {
+                worker->process->Wait();
+                worker->input->Close();
+                worker->output->Close();
+              });
+          workers_.push_back(std::move(worker));
+        }
+        feeder_thread_ =
+            ctx->StartThread("tf_data_multi_process_map_feeder",
+                             [this, input_ctx]() { FeederThread(input_ctx); });
+        return RegisterCancellationCallback(
+            ctx->cancellation_manager(), [this]() { CancelThreads(); },
+            &deregister_fn_);
+      }
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        if (end_of_sequence_) {
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+        const int64 index = next_index_ % workers_.size();
+        SharedMemoryChannel* output = workers_[index]->output.get();
+        Status s = output->Read(out_tensors, end_of_sequence);
+        if (errors::IsCancelled(s) && output->IsClosed()) {
+          if (cancelled_) {
+            return errors::Cancelled("Iterator was cancelled");
+          }
+          end_of_sequence_ = true;
+          return errors::Unavailable("Worker process ", index,
+                                     " of MultiProcessMapDataset exited "
+                                     "unexpectedly.");
+        }
+        ++next_index_;
+        TF_RETURN_IF_ERROR(s);
+        if (*end_of_sequence) {
+          end_of_sequence_ = true;
+          return Status::OK();
+        }
+        return VerifyTypesMatch(dataset()->output_types_, *out_tensors);
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeKnownRatioNode(std::move(args),
+                                         /*ratio=*/1);
+      }
+
+      Status SaveInternal(SerializationContext* ctx,
+                          IteratorStateWriter* writer) override {
+        return errors::Unimplemented("SaveInternal is not yet supported");
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        return errors::Unimplemented("RestoreInternal is not yet supported");
+      }
+
+     private:
+      struct Worker {
+        std::unique_ptr<SharedMemoryChannel> input;
+        std::unique_ptr<SharedMemoryChannel> output;
+        std::unique_ptr<SubProcess> process;
+        std::unique_ptr<Thread> waiter_thread;
+      };
+
+      // Writes the function and its captured inputs to a temporary file that
+      // the workers read at startup.
+      Status WriteWorkerDef(IteratorContext* ctx) {
+        MultiProcessMapWorkerDef worker_def;
+        *worker_def.mutable_graph()->mutable_library() =
+            dataset()->captured_func_->lib_def()->ToProto();
+        *worker_def.mutable_func() = dataset()->captured_func_->func();
+        for (const Tensor& t : dataset()->captured_func_->captured_inputs()) {
+          t.AsProtoTensorContent(worker_def.add_captured_inputs());
+        }
+        worker_def.set_num_threads(std::max<int64>(
+            1, port::MaxParallelism() / dataset()->num_workers_));
+        if (!ctx->env()->LocalTempFilename(&worker_def_path_)) {
+          return errors::Internal("Failed to create a temporary file name");
+        }
+        return WriteBinaryProto(ctx->env(), worker_def_path_, worker_def);
+      }
+
+      // Sends the elements of the input to the workers in round-robin order.
+      void FeederThread(const std::shared_ptr<IteratorContext>& ctx) {
+        const int64 num_workers = workers_.size();
+        for (int64 i = 0;; ++i) {
+          SharedMemoryChannel* input = workers_[i % num_workers]->input.get();
+          std::vector<Tensor> element;
+          bool end_of_sequence;
+          Status s = input_impl_->GetNext(ctx.get(), &element,
+                                          &end_of_sequence);
+          if (s.ok() && end_of_sequence) {
+            // Every worker forwards the end of the sequence; the reader stops
+            // at the first one, which belongs to worker `i % num_workers`.
+            for (int64 j = 0; j < num_workers; ++j) {
+              workers_[(i + j) % num_workers]
+                  ->input->WriteEndOfSequence()
+                  .IgnoreError();
+            }
+            return;
+          }
+          if (s.ok()) {
+            s = input->Write(element);
+            if (!errors::IsInvalidArgument(s)) {
+              // Either written, or the channel was closed.
+              if (!s.ok()) return;
+              continue;
+            }
+          }
+          if (!input->WriteError(s).ok()) return;
+        }
+      }
+
+      void CancelThreads() TF_LOCKS_EXCLUDED(mu_) {
+        cancelled_ = true;
+        for (auto& worker : workers_) {
+          worker->input->Close();
+          worker->output->Close();
+        }
+      }
+
+      mutex mu_;
+      // Used by the feeder thread only.
+      std::unique_ptr<IteratorBase> input_impl_;
+      // Cancels the input pipeline when the iterator is destroyed.
+      CancellationManager cancellation_manager_;
+      std::function<void()> deregister_fn_;
+      std::atomic<bool> cancelled_{false};
+      std::string worker_def_path_;
+      // Set in `Initialize()` and not modified afterwards.
+      std::vector<std::shared_ptr<Worker>> workers_;
+      std::unique_ptr<Thread> feeder_thread_;
+      // Index of the next element to return.
+      int64 next_index_ TF_GUARDED_BY(mu_) = 0;
+      bool end_of_sequence_ TF_GUARDED_BY(mu_) = false;
+    };
+
+    const DatasetBase* const input_;
+    const std::unique_ptr<CapturedFunction> captured_func_;
+    const int64 num_workers_;
+    const tstring worker_binary_;
+    const DataTypeVector output_types_;
+    const std::vector<PartialTensorShape> output_shapes_;
+    const SharedMemoryChannel::Options channel_options_;
+  };
+
+  std::shared_ptr<FunctionMetadata> func_metadata_ = nullptr;
+  DataTypeVector output_types_;
+  std::vector<PartialTensorShape> output_shapes_;
+  SharedMemoryChannel::Options channel_options_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("MultiProcessMapDataset").Device(DEVICE_CPU),
+                        MultiProcessMapDatasetOp);
+
+REGISTER_INPUT_COLOCATION_EXEMPTION("MultiProcessMapDataset");
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,259 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include <limits>
+
+#include "tensorflow/core/kernels/data/dataset_test_base.h"
+#include "tensorflow/core/lib/io/path.h"
+
+namespace tensorflow {
+namespace data {
+namespace experimental {
+namespace {
+
+constexpr char kNodeName[] = "multi_process_map_dataset";
+constexpr char kDatasetType[] = "MultiProcessMap";
+
+// Returns the path of the worker binary, which the test depends on as data.
+string WorkerBinary() {
+  return io::JoinPath(testing::TensorFlowSrcRoot(),
+                      "core/data/multi_process_map_worker");
+}
+
+class MultiProcessMapDatasetParams : public DatasetParams {
+ public:
+  template <typename T>
+  MultiProcessMapDatasetParams(T input_dataset_params,
+                               std::vector<Tensor> other_arguments,
+                               int64 num_workers, string worker_binary,
+                               FunctionDefHelper::AttrValueWrapper func,
+                               std::vector<FunctionDef> func_lib,
+                               DataTypeVector type_arguments,
+                               DataTypeVector output_dtypes,
+                               std::vector<PartialTensorShape> output_shapes,
+                               string node_name)
+      : DatasetParams(std::move(output_dtypes), std::move(output_shapes),
+                      std::move(node_name)),
+        other_arguments_(std::move(other_arguments)),
+        num_workers_(num_workers),
+        worker_binary_(std::move(worker_binary)),
+        func_(std::move(func)),
+        func_lib_(std::move(func_lib)),
+        type_arguments_(std::move(type_arguments)) {
+    input_dataset_params_.push_back(absl::make_unique<T>(input_dataset_params));
+    iterator_prefix_ =
+        name_utils::IteratorPrefix(input_dataset_params.dataset_type(),
+                                   input_dataset_params.iterator_prefix());
+  }
+
+  std::vector<Tensor> GetInputTensors() const override {
+    std::vector<Tensor> inputs = other_arguments_;
+    inputs.emplace_back(CreateTensor<int64>(TensorShape({}), {num_workers_}));
+    inputs.emplace_back(
+        CreateTensor<tstring>(TensorShape({}), {worker_binary_}));
+    return inputs;
+  }
+
+  Status GetInputNames(std::vector<string>* input_names) const override {
+    input_names->reserve(input_dataset_params_.size() +
+                         other_arguments_.size() + 2);
+    input_names->emplace_back("input_dataset");
+    for (int i = 0; i < other_arguments_.size(); ++i) {
+      input_names->emplace_back(absl::StrCat("other_arguments_", i));
+    }
+    input_names->emplace_back("num_workers");
+    input_names->emplace_back("worker_binary");
+    return Status::OK();
+  }
+
+  Status GetAttributes(AttributeVector* attr_vector) const override {
+    *attr_vector = {{"f", func_},
+                    {"Targuments", type_arguments_},
+                    {"output_shapes", output_shapes_},
+                    {"output_types", output_dtypes_},
+                    {"slots_per_worker", 4},
+                    {"slot_bytes", 1 << 16}};
+    return Status::OK();
+  }
+
+  std::vector<FunctionDef> func_lib() const override { return func_lib_; }
+
+  string dataset_type() const override { return kDatasetType; }
+
+ private:
+  std::vector<Tensor> other_arguments_;
+  int64 num_workers_;
+  string worker_binary_;
+  FunctionDefHelper::AttrValueWrapper func_;
+  std::vector<FunctionDef> func_lib_;
+  DataTypeVector type_arguments_;
+};
+
+class MultiProcessMapDatasetOpTest : public DatasetOpsTestBase {};
+
+// Returns a function that forwards its input unless it is NaN or infinite.
+FunctionDef CheckNumericsFunc() {
+  return FunctionDefHelper::Create(
+      "CheckNumericsFunc", {"x: float"}, {"y: float"}, {},
+      {{{"check"},
+        "CheckNumerics",
+        {"x"},
+        {{"T", DT_FLOAT}, {"message", "Not finite"}}}},
+      {{"y", "check:output:0"}});
+}
+
+MultiProcessMapDatasetParams XTimesTwoParams(int64 num_workers) {
+  return MultiProcessMapDatasetParams(
+      RangeDatasetParams(0, 10, 1),
+      /*other_arguments=*/{},
+      /*num_workers=*/num_workers,
+      /*worker_binary=*/WorkerBinary(),
+      /*func=*/FunctionDefHelper::FunctionRef("XTimesTwo", {{"T", DT_INT64}}),
+      /*func_lib=*/{test::function::XTimesTwo()},
+      /*type_arguments=*/{},
+      /*output_dtypes=*/{DT_INT64},
+      /*output_shapes=*/{PartialTensorShape({})},
+      /*node_name=*/kNodeName);
+}
+
+MultiProcessMapDatasetParams CheckNumericsParams(string worker_binary) {
+  return MultiProcessMapDatasetParams(
+      TensorSliceDatasetParams(
+          {CreateTensor<float>(
+              TensorShape({3}),
+              {1.0f, std::numeric_limits<float>::quiet_NaN(), 3.0f})},
+          /*node_name=*/"tensor_slice"),
+      /*other_arguments=*/{},
+      /*num_workers=*/2,
+      /*worker_binary=*/std::move(worker_binary),
+      /*func=*/FunctionDefHelper::FunctionRef("CheckNumericsFunc"),
+      /*func_lib=*/{CheckNumericsFunc()},
+      /*type_arguments=*/{},
+      /*output_dtypes=*/{DT_FLOAT},
+      /*output_shapes=*/{PartialTensorShape({})},
+      /*node_name=*/kNodeName);
+}
+
+MultiProcessMapDatasetParams InvalidNumWorkersParams() {
+  return MultiProcessMapDatasetParams(
+      RangeDatasetParams(0, 10, 1),
+      /*other_arguments=*/{},
+      /*num_workers=*/-2,
+      /*worker_binary=*/WorkerBinary(),
+      /*func=*/FunctionDefHelper::FunctionRef("XTimesTwo", {{"T", DT_INT64}}),
+      /*func_lib=*/{test::function::XTimesTwo()},
+      /*type_arguments=*/{},
+      /*output_dtypes=*/{DT_INT64},
+      /*output_shapes=*/{PartialTensorShape({})},
+      /*node_name=*/kNodeName);
+}
+
+// The elements are spread over the workers round-robin but must come back in
+// input order.
+std::vector<GetNextTestCase<MultiProcessMapDatasetParams>> GetNextTestCases() {
+  return {{/*dataset_params=*/XTimesTwoParams(/*num_workers=*/1),
+           /*expected_outputs=*/
+           CreateTensors<int64>(TensorShape({}),
+                                {{0}, {2}, {4}, {6}, {8}, {10}, {12}, {14},
+                                 {16}, {18}})},
+          {/*dataset_params=*/XTimesTwoParams(/*num_workers=*/3),
+           /*expected_outputs=*/
+           CreateTensors<int64>(TensorShape({}),
+                                {{0}, {2}, {4}, {6}, {8}, {10}, {12}, {14},
+                                 {16}, {18}})}};
+}
+
+ITERATOR_GET_NEXT_TEST_P(MultiProcessMapDatasetOpTest,
+                         MultiProcessMapDatasetParams, GetNextTestCases())
+
+TEST_F(MultiProcessMapDatasetOpTest, DatasetTypeString) {
+  auto dataset_params = XTimesTwoParams(/*num_workers=*/2);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  TF_ASSERT_OK(CheckDatasetTypeString(name_utils::OpName(kDatasetType)));
+}
+
+TEST_F(MultiProcessMapDatasetOpTest, Cardinality) {
+  auto dataset_params = XTimesTwoParams(/*num_workers=*/2);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  TF_ASSERT_OK(CheckDatasetCardinality(10));
+}
+
+TEST_F(MultiProcessMapDatasetOpTest, FunctionErrorIsReturnedInOrder) {
+  auto dataset_params = CheckNumericsParams(WorkerBinary());
+  TF_ASSERT_OK(Initialize(dataset_params));
+  std::vector<Tensor> out_tensors;
+  bool end_of_sequence = false;
+  TF_ASSERT_OK(iterator_->GetNext(iterator_ctx_.get(), &out_tensors,
+                                  &end_of_sequence));
+  test::ExpectTensorEqual<float>(out_tensors[0],
+                                 CreateTensor<float>(TensorShape({}), {1.0f}));
+  EXPECT_TRUE(errors::IsInvalidArgument(iterator_->GetNext(
+      iterator_ctx_.get(), &out_tensors, &end_of_sequence)));
+  // The error only affects its own element.
+  TF_ASSERT_OK(iterator_->GetNext(iterator_ctx_.get(), &out_tensors,
+                                  &end_of_sequence));
+  test::ExpectTensorEqual<float>(out_tensors[0],
+                                 CreateTensor<float>(TensorShape({}), {3.0f}));
+  TF_ASSERT_OK(iterator_->GetNext(iterator_ctx_.get(), &out_tensors,
+                                  &end_of_sequence));
+  EXPECT_TRUE(end_of_sequence);
+}
+
+TEST_F(MultiProcessMapDatasetOpTest, ExitedWorkerIsUnavailable) {
+  // The worker process exits as soon as it fails to run the binary.
+  auto dataset_params = CheckNumericsParams(
+      io::JoinPath(testing::TmpDir(), "nonexistent_worker_binary"));
+  TF_ASSERT_OK(Initialize(dataset_params));
+  std::vector<Tensor> out_tensors;
+  bool end_of_sequence = false;
+  EXPECT_TRUE(errors::IsUnavailable(iterator_->GetNext(
+      iterator_ctx_.get(), &out_tensors, &end_of_sequence)));
+}
+
+TEST_F(MultiProcessMapDatasetOpTest, Cancellation) {
+  auto dataset_params = MultiProcessMapDatasetParams(
+      RangeDatasetParams(0, std::numeric_limits<int64>::max(), 1),
+      /*other_arguments=*/{},
+      /*num_workers=*/2,
+      /*worker_binary=*/WorkerBinary(),
+      /*func=*/FunctionDefHelper::FunctionRef("XTimesTwo", {{"T", DT_INT64}}),
+      /*func_lib=*/{test::function::XTimesTwo()},
+      /*type_arguments=*/{},
+      /*output_dtypes=*/{DT_INT64},
+      /*output_shapes=*/{PartialTensorShape({})},
+      /*node_name=*/kNodeName);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  std::vector<Tensor> out_tensors;
+  bool end_of_sequence = false;
+  TF_ASSERT_OK(iterator_->GetNext(iterator_ctx_.get(), &out_tensors,
+                                  &end_of_sequence));
+
+  cancellation_manager_->StartCancel();
+  // Elements already read back from the workers may still be returned, but
+  // the infinite input must not keep the iterator going.
+  Status s;
+  for (int i = 0; s.ok() && i < 1000; ++i) {
+    s = iterator_->GetNext(iterator_ctx_.get(), &out_tensors,
+                           &end_of_sequence);
+  }
+  EXPECT_TRUE(errors::IsCancelled(s)) << s;
+}
+
+TEST_F(MultiProcessMapDatasetOpTest, InvalidNumWorkers) {
+  auto dataset_params = InvalidNumWorkersParams();
+  EXPECT_EQ(Initialize(dataset_params).code(),
+            tensorflow::error::INVALID_ARGUMENT);
+}
+
+}  // namespace
+}  // namespace experimental
+}  // namespace data
+}  // namespace tensorflow
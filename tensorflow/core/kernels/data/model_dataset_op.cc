@@ -37,6 +37,19 @@ constexpr int64 kOptimizationPeriodThresholdMs = 60 * EnvTime::kSecondsToMillis;
 // Default share of available RAM that can be used by model's internal buffers.
 constexpr double kRamBudgetShare = 0.5;
 
+// Returns a human-readable name of the given autotuning algorithm.
+const char* AlgorithmName(model::AutotuneAlgorithm algorithm) {
+  switch (algorithm) {
+    case model::AutotuneAlgorithm::HILL_CLIMB:
+      return "hill climb";
+    case model::AutotuneAlgorithm::GRADIENT_DESCENT:
+      return "gradient descent";
+    case model::AutotuneAlgorithm::BAYESIAN_OPTIMIZATION:
+      return "bayesian optimization";
+  }
+  return "unknown";
+}
+
 }  // namespace
 
 /* static */ constexpr const char* const ModelDatasetOp::kAlgorithm;
@@ -54,9 +67,7 @@ class ModelDatasetOp::Dataset : public DatasetBase {
         cpu_budget_(cpu_budget),
         ram_budget_(ram_budget),
         traceme_metadata_(
-            {{"algorithm", algorithm == model::AutotuneAlgorithm::HILL_CLIMB
-                               ? "hill climb"
-                               : "gradient descent"},
+            {{"algorithm", AlgorithmName(algorithm)},
              {"cpu_budget",
               strings::Printf("%lld", static_cast<long long>(cpu_budget))},
              {"ram_budget",
@@ -134,6 +145,9 @@ class ModelDatasetOp::Dataset : public DatasetBase {
       mutex_lock l(mu_);
       cancelled_ = true;
       cond_var_.notify_all();
+      if (model_thread_) {
+        model::ModelCoordinator::Global()->Unregister(model_.get());
+      }
     }
 
     Status Initialize(IteratorContext* ctx) override {
@@ -191,6 +205,7 @@ class ModelDatasetOp::Dataset : public DatasetBase {
     Status EnsureModelThreadStarted(IteratorContext* ctx)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       if (!model_thread_) {
+        model::ModelCoordinator::Global()->Register(model_.get());
         model_thread_ =
             ctx->StartThread("tf_data_model", [this]() { ModelThread(); });
       }
@@ -220,8 +235,15 @@ class ModelDatasetOp::Dataset : public DatasetBase {
           model_input_time = SelfInputTime();
         }
 
+        // Pipelines that run concurrently in this process share the CPU
+        // budget of the process.
+        const int64 cpu_budget =
+            model::ModelCoordinator::Global()->UpdateCpuBudget(
+                model_.get(), model_->TotalProcessingTime(), model_input_time,
+                cpu_budget_);
+
         int64 optimization_start_us = EnvTime::NowMicros();
-        model_->Optimize(dataset()->algorithm_, cpu_budget_, ram_budget_,
+        model_->Optimize(dataset()->algorithm_, cpu_budget, ram_budget_,
                          /*model_input_time=*/0);
         VLOG(2) << "Optimized for "
                 << (EnvTime::NowMicros() - optimization_start_us) << " us.";
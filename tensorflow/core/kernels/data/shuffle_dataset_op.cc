@@ -18,6 +18,7 @@ limitations under the License.
 #include <tuple>
 #include <vector>
 
+#include "tensorflow/core/data/compression_utils.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/resource_mgr.h"
@@ -26,6 +27,9 @@ limitations under the License.
 #include "tensorflow/core/kernels/data/name_utils.h"
 #include "tensorflow/core/kernels/data/random_seed_ops.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/record_writer.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/random/random_distributions.h"
@@ -46,6 +50,8 @@ namespace data {
 /* static */ constexpr const char* const ShuffleDatasetOpBase::kOutputShapes;
 /* static */ constexpr const char* const
     ShuffleDatasetOpBase::kReshuffleEachIteration;
+/* static */ constexpr const char* const ShuffleDatasetOpBase::kMaxBufferBytes;
+/* static */ constexpr const char* const ShuffleDatasetOpBase::kSpillDirectory;
 
 /* static */ constexpr const char* const ShuffleDatasetOp::kDatasetType;
 
@@ -55,6 +61,8 @@ namespace data {
 
 const int64 kLogIntervalMicros = 10 * 1000000;  // 10 seconds.
 const int64 kMaxEpochsInBuffer = 3;
+// Size of the read buffer of each spilled run.
+const int64 kSpillReadBufferSize = 256 << 10;  // 256 KB.
 
 constexpr char kNumRandomSamples[] = "num_random_samples";
 constexpr char kDataProduced[] = "data_produced";
@@ -81,14 +89,21 @@ ShuffleDatasetOpBase::ShuffleDatasetOpBase(OpKernelConstruction* ctx)
 // Abstract base dataset that implements a shuffling iterator.
 class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
  public:
+  // If `max_buffer_bytes` is positive, the dataset spills its buffer to
+  // `spill_directory` (see `SpillingIterator`). This is only supported if
+  // `count` is 1.
   ShuffleDatasetBase(OpKernelContext* ctx, const DatasetBase* input,
                      int64 buffer_size,
-                     std::shared_ptr<SeedGenerator> seed_generator, int64 count)
+                     std::shared_ptr<SeedGenerator> seed_generator, int64 count,
+                     int64 max_buffer_bytes = 0,
+                     const std::string& spill_directory = "")
       : DatasetBase(DatasetContext(ctx)),
         input_(input),
         buffer_size_(buffer_size),
         seed_generator_(std::move(seed_generator)),
         count_(count),
+        max_buffer_bytes_(max_buffer_bytes),
+        spill_directory_(spill_directory),
         traceme_metadata_(
             {{"buffer_size",
               strings::Printf("%lld", static_cast<long long>(buffer_size))}}) {
@@ -135,6 +150,12 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
 
   std::unique_ptr<IteratorBase> MakeIteratorInternal(
       const string& prefix) const override {
+    if (max_buffer_bytes_ > 0) {
+      return absl::make_unique<SpillingIterator>(
+          SpillingIterator::Params{
+              this, name_utils::IteratorPrefix(op_type(), prefix)},
+          seed_generator_.get());
+    }
     return absl::make_unique<Iterator>(
         Iterator::Params{this, name_utils::IteratorPrefix(op_type(), prefix)},
         seed_generator_.get());
@@ -424,6 +445,232 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
     bool data_produced_ TF_GUARDED_BY(mu_) = false;
   };
 
+  // An iterator that bounds the memory used by the shuffle buffer to roughly
+  // `max_buffer_bytes_`.
+  //
+  // The input is shuffled in windows of `buffer_size_` elements. While a
+  // window is being filled, each time the buffered elements exceed
+  // `max_buffer_bytes_` they are shuffled and written to a file in
+  // `spill_directory_`, called a run. The elements of the window are then
+  // produced by repeatedly choosing a run, or the elements still in memory,
+  // with probability proportional to the number of elements left in it and
+  // taking its next element (or, for the elements in memory, a uniformly
+  // random one), which yields a uniformly random permutation of the window.
+  //
+  // Runs are stored as a TFRecord file of `CompressedElement`s.
+  class SpillingIterator : public DatasetIterator<ShuffleDatasetBase> {
+   public:
+    explicit SpillingIterator(const Params& params,
+                              SeedGenerator* seed_generator)
+        : DatasetIterator<ShuffleDatasetBase>(params),
+          seed_generator_(seed_generator),
+          parent_generator_(seed_generator->seed(), seed_generator->seed2()),
+          generator_(&parent_generator_) {}
+
+    ~SpillingIterator() override {
+      mutex_lock l(mu_);
+      DeleteRuns();
+    }
+
+    Status Initialize(IteratorContext* ctx) override {
+      mutex_lock l(mu_);
+      DCHECK_EQ(dataset()->count_, 1);
+      seed_generator_->GenerateSeeds(&seed_, &seed2_);
+      parent_generator_ = random::PhiloxRandom(seed_, seed2_);
+      generator_ =
+          random::SingleSampleAdapter<random::PhiloxRandom>(&parent_generator_);
+      spill_directory_ = dataset()->spill_directory_;
+      if (spill_directory_.empty()) {
+        std::vector<string> directories;
+        ctx->env()->GetLocalTempDirectories(&directories);
+        if (directories.empty()) {
+          return errors::FailedPrecondition(
+              "No local temporary directory to spill the shuffle buffer to.");
+        }
+        spill_directory_ = directories[0];
+      }
+      TF_RETURN_IF_ERROR(ctx->env()->RecursivelyCreateDir(spill_directory_));
+      return dataset()->input_->MakeIterator(ctx, this, prefix(),
+                                             &input_impl_);
+    }
+
+    Status GetNextInternal(IteratorContext* ctx,
+                           std::vector<Tensor>* out_tensors,
+                           bool* end_of_sequence) override {
+      mutex_lock l(mu_);
+      if (num_elements_ == 0) {
+        DeleteRuns();
+        TF_RETURN_IF_ERROR(FillWindow(ctx));
+        if (num_elements_ == 0) {
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+      }
+      *end_of_sequence = false;
+      int64 index = Random() % num_elements_;
+      num_elements_--;
+      for (auto& run : runs_) {
+        if (index < run->num_elements) {
+          run->num_elements--;
+          return ReadElement(run.get(), out_tensors);
+        }
+        index -= run->num_elements;
+      }
+      DCHECK_LT(index, static_cast<int64>(buffer_.size()));
+      std::swap(buffer_[index], buffer_.back());
+      *out_tensors = std::move(buffer_.back());
+      buffer_.pop_back();
+      RecordBufferDequeue(ctx, *out_tensors);
+      return Status::OK();
+    }
+
+   protected:
+    std::shared_ptr<model::Node> CreateNode(
+        IteratorContext* ctx, model::Node::Args args) const override {
+      return model::MakeKnownRatioNode(std::move(args),
+                                       /*ratio=*/1);
+    }
+
+    Status SaveInternal(SerializationContext* ctx,
+                        IteratorStateWriter* writer) override {
+      return errors::Unimplemented(
+          "Checkpointing is not supported for shuffle datasets with a "
+          "positive `max_buffer_bytes`.");
+    }
+
+    Status RestoreInternal(IteratorContext* ctx,
+                           IteratorStateReader* reader) override {
+      return errors::Unimplemented(
+          "Checkpointing is not supported for shuffle datasets with a "
+          "positive `max_buffer_bytes`.");
+    }
+
+    TraceMeMetadata GetTraceMeMetadata() const override {
+      return dataset()->traceme_metadata_;
+    }
+
+   private:
+    // A shuffled run of elements written to a file.
+    struct Run {
+      std::string filename;
+      // Number of elements not yet read.
+      int64 num_elements = 0;
+      std::unique_ptr<RandomAccessFile> file;
+      std::unique_ptr<io::SequentialRecordReader> reader;
+    };
+
+    // Reads the next window of the input, spilling it to runs as needed.
+    Status FillWindow(IteratorContext* ctx) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      int64 buffer_bytes = 0;
+      while (input_impl_ && num_elements_ < dataset()->buffer_size_) {
+        std::vector<Tensor> element;
+        bool end_of_input_sequence = false;
+        TF_RETURN_IF_ERROR(
+            input_impl_->GetNext(ctx, &element, &end_of_input_sequence));
+        if (end_of_input_sequence) {
+          input_impl_.reset();
+          break;
+        }
+        for (const Tensor& t : element) {
+          buffer_bytes += t.TotalBytes();
+        }
+        RecordBufferEnqueue(ctx, element);
+        buffer_.push_back(std::move(element));
+        num_elements_++;
+        if (buffer_bytes > dataset()->max_buffer_bytes_) {
+          TF_RETURN_IF_ERROR(SpillBuffer(ctx));
+          buffer_bytes = 0;
+        }
+      }
+      if (!runs_.empty()) {
+        VLOG(2) << "Spilled " << num_elements_ - buffer_.size()
+                << " elements of a shuffle window of " << num_elements_
+                << " elements to " << runs_.size() << " runs.";
+      }
+      return Status::OK();
+    }
+
+    // Shuffles `buffer_` and writes it to a new run.
+    Status SpillBuffer(IteratorContext* ctx) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      for (int64 i = buffer_.size() - 1; i > 0; --i) {
+        std::swap(buffer_[i], buffer_[Random() % (i + 1)]);
+      }
+      runs_.push_back(absl::make_unique<Run>());
+      Run* run = runs_.back().get();
+      run->filename = io::JoinPath(
+          spill_directory_,
+          strings::StrCat("tf_data_shuffle_", random::New64(), ".run"));
+      {
+        std::unique_ptr<WritableFile> file;
+        TF_RETURN_IF_ERROR(ctx->env()->NewWritableFile(run->filename, &file));
+        io::RecordWriter writer(file.get());
+        for (const auto& element : buffer_) {
+          CompressedElement compressed;
+          TF_RETURN_IF_ERROR(CompressElement(element, &compressed));
+          TF_RETURN_IF_ERROR(writer.WriteRecord(compressed.SerializeAsString()));
+          RecordBufferDequeue(ctx, element);
+        }
+        TF_RETURN_IF_ERROR(writer.Close());
+        TF_RETURN_IF_ERROR(file->Close());
+      }
+      run->num_elements = buffer_.size();
+      buffer_.clear();
+      TF_RETURN_IF_ERROR(
+          ctx->env()->NewRandomAccessFile(run->filename, &run->file));
+      io::RecordReaderOptions options;
+      options.buffer_size = kSpillReadBufferSize;
+      run->reader =
+          absl::make_unique<io::SequentialRecordReader>(run->file.get(),
+                                                        options);
+      return Status::OK();
+    }
+
+    Status ReadElement(Run* run, std::vector<Tensor>* out_tensors)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      tstring record;
+      TF_RETURN_IF_ERROR(run->reader->ReadRecord(&record));
+      CompressedElement compressed;
+      if (!compressed.ParseFromArray(record.data(), record.size())) {
+        return errors::DataLoss("Failed to parse an element of ",
+                                run->filename);
+      }
+      return UncompressElement(compressed, out_tensors);
+    }
+
+    void DeleteRuns() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      for (auto& run : runs_) {
+        run->reader.reset();
+        run->file.reset();
+        Status s = Env::Default()->DeleteFile(run->filename);
+        if (!s.ok() && !errors::IsNotFound(s)) {
+          LOG(WARNING) << "Failed to delete " << run->filename << ": " << s;
+        }
+      }
+      runs_.clear();
+    }
+
+    random::SingleSampleAdapter<random::PhiloxRandom>::ResultType Random()
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      return generator_();
+    }
+
+    mutex mu_;
+    SeedGenerator* const seed_generator_ TF_GUARDED_BY(mu_);  // Not owned.
+    std::string spill_directory_ TF_GUARDED_BY(mu_);
+    std::unique_ptr<IteratorBase> input_impl_ TF_GUARDED_BY(mu_);
+    // Number of elements of the current window not yet produced, in `runs_`
+    // and `buffer_`.
+    int64 num_elements_ TF_GUARDED_BY(mu_) = 0;
+    std::vector<std::unique_ptr<Run>> runs_ TF_GUARDED_BY(mu_);
+    // Elements of the current window that have not been spilled.
+    std::vector<std::vector<Tensor>> buffer_ TF_GUARDED_BY(mu_);
+    int64 seed_ TF_GUARDED_BY(mu_) = 0;
+    int64 seed2_ TF_GUARDED_BY(mu_) = 0;
+    random::PhiloxRandom parent_generator_ TF_GUARDED_BY(mu_);
+    random::SingleSampleAdapter<random::PhiloxRandom> generator_
+        TF_GUARDED_BY(mu_);
+  };
+
   const DatasetBase* const input_;
   const int64 buffer_size_;
   const std::shared_ptr<SeedGenerator> seed_generator_;
@@ -431,6 +678,8 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
   // fuse shuffle and repeat together, and make the shuffle dataset op
   // responsible for repeating as well.
   const int64 count_;
+  const int64 max_buffer_bytes_;
+  const std::string spill_directory_;
   const TraceMeMetadata traceme_metadata_;
 };  // ShuffleDatasetBase
 
@@ -554,8 +803,10 @@ class ShuffleDatasetOp::DatasetV3 : public ShuffleDatasetBase {
  public:
   DatasetV3(OpKernelContext* ctx, const DatasetBase* input, int64 buffer_size,
             int64 count, RandomSeeds&& seeds, SeedGeneratorManager* manager,
-            ResourceHandle&& resource_handle, bool owns_resource)
-      : ShuffleDatasetBase(ctx, input, buffer_size, manager->get(), count),
+            ResourceHandle&& resource_handle, bool owns_resource,
+            int64 max_buffer_bytes, const std::string& spill_directory)
+      : ShuffleDatasetBase(ctx, input, buffer_size, manager->get(), count,
+                           max_buffer_bytes, spill_directory),
         manager_(manager),
         owns_resource_(owns_resource),
         resource_handle_(std::move(resource_handle)),
@@ -594,13 +845,23 @@ class ShuffleDatasetOp::DatasetV3 : public ShuffleDatasetBase {
     AttrValue reshuffle_each_iteration;
     b->BuildAttrValue(seed_generator_->reshuffle_each_iteration(),
                       &reshuffle_each_iteration);
+    std::vector<std::pair<StringPiece, AttrValue>> attrs = {
+        std::make_pair(kReshuffleEachIteration, reshuffle_each_iteration)};
+    // Only set when spilling, so that the graphs of other shuffle datasets
+    // can still be read by binaries that predate these attrs.
+    if (max_buffer_bytes_ > 0) {
+      AttrValue max_buffer_bytes;
+      b->BuildAttrValue(max_buffer_bytes_, &max_buffer_bytes);
+      attrs.emplace_back(kMaxBufferBytes, max_buffer_bytes);
+      AttrValue spill_directory;
+      b->BuildAttrValue(spill_directory_, &spill_directory);
+      attrs.emplace_back(kSpillDirectory, spill_directory);
+    }
     TF_RETURN_IF_ERROR(
         b->AddDataset(this,
                       {input_graph_node, buffer_size_node, seed_node,
                        seed2_node, resource_handle_node},  // Inputs
-                      {std::make_pair(kReshuffleEachIteration,
-                                      reshuffle_each_iteration)},  // Attrs
-                      output));
+                      attrs, output));
     return Status::OK();
   }
 
@@ -626,6 +887,14 @@ ShuffleDatasetOp::ShuffleDatasetOp(OpKernelConstruction* ctx)
     OP_REQUIRES_OK(
         ctx, ctx->GetAttr(kReshuffleEachIteration, &reshuffle_each_iteration_));
   }
+  if (ctx->HasAttr(kMaxBufferBytes)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kMaxBufferBytes, &max_buffer_bytes_));
+    OP_REQUIRES(ctx, max_buffer_bytes_ >= 0,
+                errors::InvalidArgument("max_buffer_bytes must be >= 0."));
+  }
+  if (ctx->HasAttr(kSpillDirectory)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kSpillDirectory, &spill_directory_));
+  }
 }
 
 void ShuffleDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
@@ -676,9 +945,9 @@ void ShuffleDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
     }
 
     // Ownership of manager is transferred onto `DatasetV3`.
-    *output = new ShuffleDatasetOp::DatasetV3(ctx, input, buffer_size, count,
-                                              std::move(seeds), manager,
-                                              std::move(handle), owns_resource);
+    *output = new ShuffleDatasetOp::DatasetV3(
+        ctx, input, buffer_size, count, std::move(seeds), manager,
+        std::move(handle), owns_resource, max_buffer_bytes_, spill_directory_);
   } else if (op_version_ == 2) {
     auto handle = HandleFromInput(ctx, 2);
     SeedGeneratorManager* manager = nullptr;
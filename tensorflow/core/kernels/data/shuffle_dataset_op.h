@@ -30,6 +30,8 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
   static constexpr const char* const kOutputShapes = "output_shapes";
   static constexpr const char* const kReshuffleEachIteration =
       "reshuffle_each_iteration";
+  static constexpr const char* const kMaxBufferBytes = "max_buffer_bytes";
+  static constexpr const char* const kSpillDirectory = "spill_directory";
 
   explicit ShuffleDatasetOpBase(OpKernelConstruction* ctx);
 
@@ -53,6 +55,9 @@ class ShuffleDatasetOp : public ShuffleDatasetOpBase {
   class DatasetV3;
   int op_version_ = 0;
   bool reshuffle_each_iteration_ = true;
+  // Only supported by `ShuffleDatasetV3`.
+  int64 max_buffer_bytes_ = 0;
+  std::string spill_directory_;
 };
 
 class ShuffleAndRepeatDatasetOp : public ShuffleDatasetOpBase {
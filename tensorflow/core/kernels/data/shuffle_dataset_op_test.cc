@@ -11,8 +11,17 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/shuffle_dataset_op.h"
 
+#include "tensorflow/core/data/standalone.h"
+#include "tensorflow/core/framework/function_testlib.h"
 #include "tensorflow/core/kernels/data/dataset_test_base.h"
 #include "tensorflow/core/kernels/data/dataset_utils.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
 
 namespace tensorflow {
 namespace data {
@@ -20,6 +29,7 @@ namespace {
 
 constexpr char kShuffleNodeName[] = "shuffle_dataset";
 constexpr char kShuffleAndRepeatNodeName[] = "shuffle_and_repeat_dataset";
+constexpr char kSeedGenerator[] = "seed_generator";
 
 class ShuffleDatasetParams : public DatasetParams {
  public:
@@ -560,6 +570,270 @@ TEST_F(ShuffleDatasetOpTest, InvalidArguments) {
   }
 }
 
+// Parameters of a `ShuffleDatasetV3` that spills shuffled runs to disk once
+// its buffer holds more than `max_buffer_bytes`.
+class SpillingShuffleDatasetParams : public DatasetParams {
+ public:
+  template <typename T>
+  SpillingShuffleDatasetParams(T input_dataset_params, int64 buffer_size,
+                               int64 seed, int64 seed2,
+                               bool reshuffle_each_iteration,
+                               int64 max_buffer_bytes, string spill_directory,
+                               DataTypeVector output_dtypes,
+                               std::vector<PartialTensorShape> output_shapes,
+                               string node_name)
+      : DatasetParams(std::move(output_dtypes), std::move(output_shapes),
+                      std::move(node_name)),
+        buffer_size_(buffer_size),
+        seed_(seed),
+        seed2_(seed2),
+        reshuffle_each_iteration_(reshuffle_each_iteration),
+        max_buffer_bytes_(max_buffer_bytes),
+        spill_directory_(std::move(spill_directory)) {
+    op_version_ = 3;
+    input_dataset_params_.push_back(absl::make_unique<T>(input_dataset_params));
+    iterator_prefix_ =
+        name_utils::IteratorPrefix(input_dataset_params.dataset_type(),
+                                   input_dataset_params.iterator_prefix());
+  }
+
+  std::vector<Tensor> GetInputTensors() const override {
+    // An empty handle does not name a seed generator, so the dataset creates
+    // its own.
+    Tensor seed_generator(DT_RESOURCE, TensorShape({}));
+    seed_generator.scalar<ResourceHandle>()() = ResourceHandle();
+    return {CreateTensor<int64>(TensorShape({}), {buffer_size_}),
+            CreateTensor<int64>(TensorShape({}), {seed_}),
+            CreateTensor<int64>(TensorShape({}), {seed2_}), seed_generator};
+  }
+
+  Status GetInputNames(std::vector<string>* input_names) const override {
+    *input_names = {ShuffleDatasetOpBase::kInputDataset,
+                    ShuffleDatasetOpBase::kBufferSize,
+                    ShuffleDatasetOpBase::kSeed, ShuffleDatasetOpBase::kSeed2,
+                    kSeedGenerator};
+    return Status::OK();
+  }
+
+  Status GetAttributes(AttributeVector* attr_vector) const override {
+    *attr_vector = {
+        {ShuffleDatasetOpBase::kOutputTypes, output_dtypes_},
+        {ShuffleDatasetOpBase::kOutputShapes, output_shapes_},
+        {ShuffleDatasetOp::kReshuffleEachIteration, reshuffle_each_iteration_},
+        {ShuffleDatasetOp::kMaxBufferBytes, max_buffer_bytes_},
+        {ShuffleDatasetOp::kSpillDirectory, spill_directory_}};
+    return Status::OK();
+  }
+
+  string dataset_type() const override {
+    return ShuffleDatasetOp::kDatasetType;
+  }
+
+ private:
+  int64 buffer_size_;
+  int64 seed_;
+  int64 seed2_;
+  bool reshuffle_each_iteration_;
+  int64 max_buffer_bytes_;
+  string spill_directory_;
+};
+
+string SpillDirectory() {
+  return io::JoinPath(testing::TmpDir(), "shuffle_dataset_op_test_spill");
+}
+
+// Spills after every 9 elements of a 40-element window, leaving 4 elements in
+// memory at the end of each full window.
+SpillingShuffleDatasetParams SpillingShuffleDatasetParams1() {
+  return SpillingShuffleDatasetParams(RangeDatasetParams(0, 100, 1),
+                                      /*buffer_size=*/40,
+                                      /*seed=*/1,
+                                      /*seed2=*/2,
+                                      /*reshuffle_each_iteration=*/false,
+                                      /*max_buffer_bytes=*/64,
+                                      /*spill_directory=*/SpillDirectory(),
+                                      /*output_dtypes=*/{DT_INT64},
+                                      /*output_shapes=*/{PartialTensorShape({})},
+                                      /*node_name=*/kShuffleNodeName);
+}
+
+SpillingShuffleDatasetParams SpillingShuffleDatasetParamsWithNegativeLimit() {
+  return SpillingShuffleDatasetParams(RangeDatasetParams(0, 100, 1),
+                                      /*buffer_size=*/40,
+                                      /*seed=*/1,
+                                      /*seed2=*/2,
+                                      /*reshuffle_each_iteration=*/false,
+                                      /*max_buffer_bytes=*/-1,
+                                      /*spill_directory=*/SpillDirectory(),
+                                      /*output_dtypes=*/{DT_INT64},
+                                      /*output_shapes=*/{PartialTensorShape({})},
+                                      /*node_name=*/kShuffleNodeName);
+}
+
+Status GetAll(IteratorContext* ctx, IteratorBase* iterator,
+              std::vector<int64>* values) {
+  bool end_of_sequence = false;
+  while (!end_of_sequence) {
+    std::vector<Tensor> next;
+    TF_RETURN_IF_ERROR(iterator->GetNext(ctx, &next, &end_of_sequence));
+    for (const Tensor& t : next) {
+      values->push_back(t.scalar<int64>()());
+    }
+  }
+  return Status::OK();
+}
+
+TEST_F(ShuffleDatasetOpTest, SpillToDisk) {
+  auto dataset_params = SpillingShuffleDatasetParams1();
+  TF_ASSERT_OK(Initialize(dataset_params));
+  std::vector<int64> shuffled;
+  TF_ASSERT_OK(GetAll(iterator_ctx_.get(), iterator_.get(), &shuffled));
+
+  // Each window of `buffer_size` input elements is shuffled on its own.
+  ASSERT_EQ(shuffled.size(), 100);
+  std::vector<int64> identity(100);
+  for (int i = 0; i < 100; ++i) identity[i] = i;
+  EXPECT_NE(shuffled, identity);
+  for (int64 start : {0, 40, 80}) {
+    int64 end = std::min<int64>(start + 40, 100);
+    std::vector<int64> window(shuffled.begin() + start,
+                              shuffled.begin() + end);
+    std::sort(window.begin(), window.end());
+    EXPECT_EQ(window, std::vector<int64>(identity.begin() + start,
+                                         identity.begin() + end));
+  }
+
+  // Without reshuffling, a new iterator produces the same order.
+  TF_ASSERT_OK(dataset_->MakeIterator(iterator_ctx_.get(), /*parent=*/nullptr,
+                                      dataset_params.iterator_prefix(),
+                                      &iterator_));
+  std::vector<int64> reshuffled;
+  TF_ASSERT_OK(GetAll(iterator_ctx_.get(), iterator_.get(), &reshuffled));
+  EXPECT_EQ(shuffled, reshuffled);
+
+  // Runs are deleted once they have been read.
+  iterator_.reset();
+  std::vector<string> runs;
+  TF_ASSERT_OK(Env::Default()->GetMatchingPaths(
+      io::JoinPath(SpillDirectory(), "*.run"), &runs));
+  EXPECT_TRUE(runs.empty());
+}
+
+TEST_F(ShuffleDatasetOpTest, SpillToDiskNegativeLimit) {
+  EXPECT_EQ(Initialize(SpillingShuffleDatasetParamsWithNegativeLimit()).code(),
+            tensorflow::error::INVALID_ARGUMENT);
+}
+
+// Returns the resident set size of this process, or 0 if it is not known.
+int64 ResidentBytes() {
+#if defined(__linux__)
+  string statm;
+  if (!ReadFileToString(Env::Default(), "/proc/self/statm", &statm).ok()) {
+    return 0;
+  }
+  int64 pages = 0;
+  std::vector<string> fields = str_util::Split(statm, ' ');
+  if (fields.size() < 2 || !strings::safe_strto64(fields[1], &pages)) {
+    return 0;
+  }
+  return pages * sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+// Returns a graph shuffling an unbounded range of `element_bytes`-byte
+// elements, with at most `max_buffer_bytes` in memory if it is positive.
+GraphDef SpillingShuffleGraph(int64 element_bytes, int64 buffer_size,
+                              int64 max_buffer_bytes) {
+  using test::function::GDef;
+  using test::function::NDef;
+  FunctionDef fill = FunctionDefHelper::Create(
+      "FillElement", {"x: int64"}, {"y: int64"}, {},
+      {{{"dims"},
+        "Const",
+        {},
+        {{"value", test::AsTensor<int64>({element_bytes / 8})},
+         {"dtype", DT_INT64}}},
+       {{"fill"},
+        "Fill",
+        {"dims:output:0", "x"},
+        {{"T", DT_INT64}, {"index_type", DT_INT64}}}},
+      {{"y", "fill:output:0"}});
+  std::vector<PartialTensorShape> scalar_shape = {PartialTensorShape({})};
+  std::vector<PartialTensorShape> vector_shape = {PartialTensorShape({-1})};
+  auto scalar = [](int64 value) {
+    return std::vector<std::pair<string, FunctionDefHelper::AttrValueWrapper>>{
+        {"value", test::AsScalar<int64>(value)}, {"dtype", DT_INT64}};
+  };
+  return GDef(
+      {NDef("start", "Const", {}, scalar(0)),
+       NDef("stop", "Const", {}, scalar(kint64max)),
+       NDef("step", "Const", {}, scalar(1)),
+       NDef("range", "RangeDataset", {"start", "stop", "step"},
+            {{"output_types", DataTypeSlice{DT_INT64}},
+             {"output_shapes", scalar_shape}}),
+       NDef("map", "MapDataset", {"range"},
+            {{"f", FunctionDefHelper::FunctionRef("FillElement")},
+             {"Targuments", DataTypeSlice{}},
+             {"output_types", DataTypeSlice{DT_INT64}},
+             {"output_shapes", vector_shape}}),
+       NDef("buffer_size", "Const", {}, scalar(buffer_size)),
+       NDef("seed", "Const", {}, scalar(1)),
+       NDef("seed2", "Const", {}, scalar(2)),
+       NDef("seed_generator", "DummySeedGenerator", {}, {}),
+       NDef("shuffle", "ShuffleDatasetV3",
+            {"map", "buffer_size", "seed", "seed2", "seed_generator"},
+            {{"output_types", DataTypeSlice{DT_INT64}},
+             {"output_shapes", vector_shape},
+             {"reshuffle_each_iteration", true},
+             {"max_buffer_bytes", max_buffer_bytes},
+             {"spill_directory", SpillDirectory()}}),
+       NDef("dataset", "_Retval", {"shuffle"},
+            {{"T", DT_VARIANT}, {"index", 0}})},
+      {fill});
+}
+
+// Reports the throughput and peak resident set size of shuffling 64KB
+// elements with a buffer of `state.range(0)` elements, holding at most
+// `state.range(1)` bytes of it in memory (or all of it, if 0).
+static void BM_SpillingShuffle(::testing::benchmark::State& state) {
+  constexpr int64 kElementBytes = 64 << 10;
+  const int64 buffer_size = state.range(0);
+  const int64 max_buffer_bytes = state.range(1);
+  std::unique_ptr<standalone::Dataset> dataset;
+  TF_CHECK_OK(standalone::Dataset::FromGraph(
+      {}, SpillingShuffleGraph(kElementBytes, buffer_size, max_buffer_bytes),
+      &dataset));
+  std::unique_ptr<standalone::Iterator> iterator;
+  TF_CHECK_OK(dataset->MakeIterator(&iterator));
+
+  const int64 rss_before = ResidentBytes();
+  int64 peak_rss = rss_before;
+  int64 num_elements = 0;
+  for (auto s : state) {
+    std::vector<Tensor> outputs;
+    bool end_of_input = false;
+    TF_CHECK_OK(iterator->GetNext(&outputs, &end_of_input));
+    if (++num_elements % 64 == 0) {
+      peak_rss = std::max(peak_rss, ResidentBytes());
+    }
+  }
+  state.SetBytesProcessed(num_elements * kElementBytes);
+  state.SetLabel(strings::StrCat("peak_rss_growth_mb=",
+                                 (peak_rss - rss_before) >> 20));
+}
+
+BENCHMARK(BM_SpillingShuffle)
+    ->UseRealTime()
+    ->ArgPair(256, 0)
+    ->ArgPair(256, 4 << 20)
+    ->ArgPair(1024, 0)
+    ->ArgPair(1024, 4 << 20)
+    ->ArgPair(4096, 0)
+    ->ArgPair(4096, 4 << 20)
+    ->ArgPair(4096, 16 << 20);
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
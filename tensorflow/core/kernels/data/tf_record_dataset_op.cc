@@ -14,13 +14,17 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/tf_record_dataset_op.h"
 
+#include <list>
+
 #include "tensorflow/core/common_runtime/metrics.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/data/async_readahead_file.h"
 #include "tensorflow/core/kernels/data/name_utils.h"
 #include "tensorflow/core/lib/io/buffered_inputstream.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
+#include "tensorflow/core/lib/io/record_index.h"
 #include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/io/zlib_compression_options.h"
 #include "tensorflow/core/lib/io/zlib_inputstream.h"
@@ -38,10 +42,76 @@ namespace data {
 
 constexpr char kCurrentFileIndex[] = "current_file_index";
 constexpr char kOffset[] = "offset";
+constexpr char kPosition[] = "position";
+constexpr char kEpoch[] = "epoch";
 constexpr char kGcsFsPrefix[] = "gs://";
 constexpr char kS3FsPrefix[] = "s3://";
 constexpr int64 kCloudTpuBlockSize = 127LL << 20;  // 127MB.
 constexpr int64 kS3BlockSize = kCloudTpuBlockSize;
+// Local files are read ahead asynchronously in `kReadaheadBlocks` blocks that
+// together hold `buffer_size` bytes.
+constexpr int kReadaheadBlocks = 4;
+// Files read in shuffled order through their record indexes are kept open, up
+// to this many, so that reads do not reopen a file for every record.
+constexpr int kMaxOpenIndexedFiles = 16;
+// Compressed files are decompressed and verified up to this many bytes ahead
+// of the iterator, off of its thread.
+constexpr int64 kCompressedPrefetchBytes = 4 << 20;  // 4MB.
+
+namespace {
+
+// Scrambles the bits of `x` (the finalizer of SplitMix64).
+uint64 Mix(uint64 x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// A pseudo-random permutation of [0, n), evaluated one position at a time
+// without being materialized. It applies a Feistel network to the smallest
+// domain of 4^k >= n positions, repeatedly until the result is in range.
+class IndexPermutation {
+ public:
+  IndexPermutation(uint64 n, uint64 seed) : n_(n) {
+    while (half_bits_ < 31 && (uint64{1} << (2 * half_bits_)) < n) {
+      ++half_bits_;
+    }
+    mask_ = (uint64{1} << half_bits_) - 1;
+    for (int i = 0; i < kNumRounds; ++i) {
+      keys_[i] = Mix(seed + i * 0x9e3779b97f4a7c15ULL);
+    }
+  }
+
+  // Returns the position that `i` is mapped to.
+  uint64 operator()(uint64 i) const {
+    DCHECK_LT(i, n_);
+    do {
+      i = Encrypt(i);
+    } while (i >= n_);
+    return i;
+  }
+
+ private:
+  static constexpr int kNumRounds = 4;
+
+  uint64 Encrypt(uint64 x) const {
+    uint64 left = x >> half_bits_;
+    uint64 right = x & mask_;
+    for (int i = 0; i < kNumRounds; ++i) {
+      const uint64 next = left ^ (Mix(keys_[i] ^ right) & mask_);
+      left = right;
+      right = next;
+    }
+    return (left << half_bits_) | right;
+  }
+
+  const uint64 n_;
+  int half_bits_ = 1;
+  uint64 mask_;
+  uint64 keys_[kNumRounds];
+};
+
+}  // namespace
 
 bool is_cloud_tpu_gcs_fs() {
 #if defined(PLATFORM_CLOUD_TPU) && defined(TPU_GCS_FS)
@@ -53,15 +123,22 @@ bool is_cloud_tpu_gcs_fs() {
 class TFRecordDatasetOp::Dataset : public DatasetBase {
  public:
   explicit Dataset(OpKernelContext* ctx, std::vector<string> filenames,
-                   const string& compression_type, int64 buffer_size)
+                   const string& compression_type, int64 buffer_size,
+                   int64 num_shards, int64 shard_index, int64 shuffle_seed)
       : DatasetBase(DatasetContext(ctx)),
         filenames_(std::move(filenames)),
         compression_type_(compression_type),
         options_(io::RecordReaderOptions::CreateRecordReaderOptions(
-            compression_type)) {
+            compression_type)),
+        num_shards_(num_shards),
+        shard_index_(shard_index),
+        shuffle_seed_(shuffle_seed) {
     if (buffer_size > 0) {
       options_.buffer_size = buffer_size;
     }
+    if (options_.compression_type != io::RecordReaderOptions::NONE) {
+      options_.prefetch_bytes = kCompressedPrefetchBytes;
+    }
   }
 
   std::unique_ptr<IteratorBase> MakeIteratorInternal(
@@ -101,22 +178,98 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     TF_RETURN_IF_ERROR(b->AddScalar(compression_type_, &compression_type));
     Node* buffer_size = nullptr;
     TF_RETURN_IF_ERROR(b->AddScalar(options_.buffer_size, &buffer_size));
+    // The attrs are only added when the indexes are used, so that other
+    // graphs remain readable by older binaries.
+    std::vector<std::pair<StringPiece, AttrValue>> attrs;
+    if (reads_by_index()) {
+      AttrValue num_shards;
+      b->BuildAttrValue(num_shards_, &num_shards);
+      attrs.emplace_back(kNumShards, num_shards);
+      AttrValue shard_index;
+      b->BuildAttrValue(shard_index_, &shard_index);
+      attrs.emplace_back(kShardIndex, shard_index);
+      AttrValue shuffle_seed;
+      b->BuildAttrValue(shuffle_seed_, &shuffle_seed);
+      attrs.emplace_back(kShuffleSeed, shuffle_seed);
+    }
     TF_RETURN_IF_ERROR(b->AddDataset(
-        this, {filenames, compression_type, buffer_size}, output));
+        this, {filenames, compression_type, buffer_size}, attrs, output));
     return Status::OK();
   }
 
  private:
+  // The record indexes of all files.
+  struct RecordIndexes {
+    // The offsets of the records of each file, followed by its size.
+    std::vector<std::vector<uint64>> offsets;
+    // The number of the first record of each file among the records of all
+    // files, followed by the total number of records.
+    std::vector<int64> first_records;
+  };
+
+  // Whether records are read through the indexes of the files, to shard them
+  // by record range or to shuffle them.
+  bool reads_by_index() const { return num_shards_ > 1 || shuffle_seed_ >= 0; }
+
+  // Returns the record indexes of all files, which are loaded on first use
+  // and then shared by all iterators.
+  Status GetRecordIndexes(Env* env,
+                          std::shared_ptr<const RecordIndexes>* result) const {
+    mutex_lock l(mu_);
+    if (!record_indexes_) {
+      auto indexes = std::make_shared<RecordIndexes>();
+      indexes->offsets.resize(filenames_.size());
+      indexes->first_records.push_back(0);
+      for (size_t i = 0; i < filenames_.size(); ++i) {
+        Status s = io::LoadRecordIndex(env, filenames_[i],
+                                       &indexes->offsets[i]);
+        if (errors::IsNotFound(s)) {
+          return errors::FailedPrecondition(
+              "Sharding or shuffling TFRecord files requires a record index "
+              "for each file, but ",
+              filenames_[i], " has no index ",
+              io::RecordIndexFilename(filenames_[i]), ".");
+        }
+        TF_RETURN_IF_ERROR(s);
+        indexes->first_records.push_back(indexes->first_records.back() +
+                                         indexes->offsets[i].size() - 1);
+      }
+      record_indexes_ = std::move(indexes);
+    }
+    *result = record_indexes_;
+    return Status::OK();
+  }
+
+  // Returns the number of the next iteration, which determines its shuffled
+  // order.
+  int64 NextEpoch() const {
+    mutex_lock l(mu_);
+    return next_epoch_++;
+  }
+
   class Iterator : public DatasetIterator<Dataset> {
    public:
     explicit Iterator(const Params& params)
         : DatasetIterator<Dataset>(params) {}
 
+    Status Initialize(IteratorContext* ctx) override {
+      if (!dataset()->reads_by_index()) {
+        return Status::OK();
+      }
+      mutex_lock l(mu_);
+      TF_RETURN_IF_ERROR(dataset()->GetRecordIndexes(ctx->env(), &indexes_));
+      InitializePositionsLocked(dataset()->NextEpoch());
+      return Status::OK();
+    }
+
     Status GetNextInternal(IteratorContext* ctx,
                            std::vector<Tensor>* out_tensors,
                            bool* end_of_sequence) override {
       out_tensors->reserve(1);
       mutex_lock l(mu_);
+      if (indexes_) {
+        return GetNextByIndexLocked(ctx, out_tensors, end_of_sequence);
+      }
       do {
         // We are currently processing a file, so try to read the next record.
         if (reader_) {
@@ -164,9 +317,43 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
       return model::MakeSourceNode(std::move(args));
     }
 
+    Status SkipInternal(IteratorContext* ctx, int num_to_skip,
+                        bool* end_of_sequence, int* num_skipped) override {
+      *num_skipped = 0;
+      while (true) {
+        {
+          mutex_lock l(mu_);
+          if (indexes_) {
+            *num_skipped = std::min<int64>(num_to_skip,
+                                           end_position_ - position_);
+            position_ += *num_skipped;
+            *end_of_sequence = *num_skipped < num_to_skip;
+            return Status::OK();
+          }
+          TF_RETURN_IF_ERROR(SkipWithFileIndexLocked(
+              ctx->env(), num_to_skip, end_of_sequence, num_skipped));
+          if (*end_of_sequence || *num_skipped == num_to_skip) {
+            return Status::OK();
+          }
+        }
+        // The current file has no index, so its next record is read.
+        std::vector<Tensor> out_tensors;
+        TF_RETURN_IF_ERROR(GetNextInternal(ctx, &out_tensors, end_of_sequence));
+        if (*end_of_sequence) {
+          return Status::OK();
+        }
+        RecordElement(ctx, &out_tensors);
+        ++*num_skipped;
+      }
+    }
+
     Status SaveInternal(SerializationContext* ctx,
                         IteratorStateWriter* writer) override {
       mutex_lock l(mu_);
+      if (indexes_) {
+        TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kEpoch), epoch_));
+        return writer->WriteScalar(full_name(kPosition), position_);
+      }
       TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kCurrentFileIndex),
                                              current_file_index_));
 
@@ -181,6 +368,12 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
                            IteratorStateReader* reader) override {
       mutex_lock l(mu_);
       ResetStreamsLocked();
+      if (indexes_) {
+        int64 epoch;
+        TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kEpoch), &epoch));
+        InitializePositionsLocked(epoch);
+        return reader->ReadScalar(full_name(kPosition), &position_);
+      }
       int64 current_file_index;
       TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kCurrentFileIndex),
                                             &current_file_index));
@@ -204,19 +397,198 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
       }
 
       // Actually move on to next file.
-      const string& next_filename = dataset()->filenames_[current_file_index_];
-      TF_RETURN_IF_ERROR(env->NewRandomAccessFile(next_filename, &file_));
+      TF_RETURN_IF_ERROR(
+          OpenFile(env, dataset()->filenames_[current_file_index_],
+                   /*read_ahead=*/true, &file_));
       reader_ = absl::make_unique<io::SequentialRecordReader>(
           file_.get(), dataset()->options_);
       return Status::OK();
     }
 
+    // Opens `filename` into `file`, reading ahead of sequential reads if
+    // `read_ahead` is true.
+    Status OpenFile(Env* env, const string& filename, bool read_ahead,
+                    std::unique_ptr<RandomAccessFile>* file) const {
+      TF_RETURN_IF_ERROR(env->NewRandomAccessFile(filename, file));
+      if (read_ahead && dataset()->options_.buffer_size > 0 &&
+          AsyncReadaheadFile::IsLocalFile(filename)) {
+        TF_RETURN_IF_ERROR(AsyncReadaheadFile::Create(
+            filename, std::move(*file),
+            (dataset()->options_.buffer_size + kReadaheadBlocks - 1) /
+                kReadaheadBlocks,
+            kReadaheadBlocks, /*use_io_uring=*/true, file));
+      }
+      return Status::OK();
+    }
+
     // Resets all reader streams.
     void ResetStreamsLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       reader_.reset();
+      indexed_files_.clear();
       file_.reset();
+      file_index_loaded_ = false;
+      file_offsets_.clear();
+    }
+
+    // Sets the range of positions of this shard, and the order of the records
+    // in iteration `epoch`.
+    void InitializePositionsLocked(int64 epoch)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      const int64 num_records = indexes_->first_records.back();
+      position_ =
+          num_records * dataset()->shard_index_ / dataset()->num_shards_;
+      end_position_ =
+          num_records * (dataset()->shard_index_ + 1) / dataset()->num_shards_;
+      epoch_ = epoch;
+      if (dataset()->shuffle_seed_ >= 0 && num_records > 0) {
+        permutation_ = absl::make_unique<IndexPermutation>(
+            num_records, Mix(dataset()->shuffle_seed_) ^ Mix(Mix(epoch)));
+      }
+    }
+
+    // Reads the record at `position_` through the record indexes.
+    Status GetNextByIndexLocked(IteratorContext* ctx,
+                                std::vector<Tensor>* out_tensors,
+                                bool* end_of_sequence)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      if (position_ >= end_position_) {
+        *end_of_sequence = true;
+        return Status::OK();
+      }
+      const int64 record = permutation_ ? (*permutation_)(position_)
+                                        : position_;
+      ++position_;
+      const std::vector<int64>& first_records = indexes_->first_records;
+      const size_t file_index = std::upper_bound(first_records.begin(),
+                                                 first_records.end(), record) -
+                                first_records.begin() - 1;
+      io::RecordReader* reader;
+      TF_RETURN_IF_ERROR(
+          GetIndexedReaderLocked(ctx->env(), file_index, &reader));
+      uint64 offset =
+          indexes_->offsets[file_index][record - first_records[file_index]];
+      out_tensors->emplace_back(ctx->allocator({}), DT_STRING,
+                                TensorShape({}));
+      Status s =
+          reader->ReadRecord(&offset, &out_tensors->back().scalar<tstring>()());
+      if (!s.ok()) {
+        out_tensors->pop_back();
+        if (errors::IsOutOfRange(s)) {
+          s = errors::DataLoss("The index of ",
+                               dataset()->filenames_[file_index],
+                               " refers to records past its end.");
+        }
+        return s;
+      }
+      static monitoring::CounterCell* bytes_counter =
+          metrics::GetTFDataBytesReadCounter(kDatasetType);
+      bytes_counter->IncrementBy(
+          out_tensors->back().scalar<tstring>()().size());
+      *end_of_sequence = false;
+      return Status::OK();
+    }
+
+    // Returns a reader of the file at `file_index` for reads through the
+    // record indexes, opening the file if it is not among the files opened
+    // most recently.
+    Status GetIndexedReaderLocked(Env* env, size_t file_index,
+                                  io::RecordReader** reader)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      for (auto it = indexed_files_.begin(); it != indexed_files_.end();
+           ++it) {
+        if (it->file_index == file_index) {
+          indexed_files_.splice(indexed_files_.begin(), indexed_files_, it);
+          *reader = it->reader.get();
+          return Status::OK();
+        }
+      }
+      // Records in file order only need the current file.
+      const size_t max_open_files = permutation_ ? kMaxOpenIndexedFiles : 1;
+      while (indexed_files_.size() >= max_open_files) {
+        indexed_files_.pop_back();
+      }
+      // Shuffled records are read at random offsets, which buffering or
+      // reading ahead would only slow down.
+      io::RecordReaderOptions options = dataset()->options_;
+      if (permutation_) {
+        options.buffer_size = 0;
+      }
+      IndexedFile indexed_file;
+      indexed_file.file_index = file_index;
+      TF_RETURN_IF_ERROR(OpenFile(env, dataset()->filenames_[file_index],
+                                  /*read_ahead=*/!permutation_,
+                                  &indexed_file.file));
+      indexed_file.reader =
+          absl::make_unique<io::RecordReader>(indexed_file.file.get(), options);
+      indexed_files_.push_front(std::move(indexed_file));
+      *reader = indexed_files_.front().reader.get();
+      return Status::OK();
     }
 
+    // Skips up to `num_to_skip` records, counted in `*num_skipped`, without
+    // reading them, as long as the files have record indexes. Stops early at
+    // a file without an index.
+    Status SkipWithFileIndexLocked(Env* env, int num_to_skip,
+                                   bool* end_of_sequence, int* num_skipped)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      *end_of_sequence = false;
+      while (*num_skipped < num_to_skip) {
+        if (!reader_) {
+          if (current_file_index_ == dataset()->filenames_.size()) {
+            *end_of_sequence = true;
+            return Status::OK();
+          }
+          TF_RETURN_IF_ERROR(SetupStreamsLocked(env));
+        }
+        if (!file_index_loaded_) {
+          file_index_loaded_ = true;
+          // Compressed files cannot be read from an offset.
+          if (dataset()->options_.compression_type ==
+              io::RecordReaderOptions::NONE) {
+            const string& filename = dataset()->filenames_[current_file_index_];
+            Status s = io::LoadRecordIndex(env, filename, &file_offsets_);
+            if (!s.ok()) {
+              if (!errors::IsNotFound(s)) {
+                LOG(WARNING) << "Ignoring the record index of " << filename
+                             << ": " << s;
+              }
+              file_offsets_.clear();
+            }
+          }
+        }
+        if (file_offsets_.empty()) {
+          return Status::OK();
+        }
+        const uint64 offset = reader_->TellOffset();
+        auto it = std::lower_bound(file_offsets_.begin(),
+                                   file_offsets_.end(), offset);
+        if (it == file_offsets_.end() || *it != offset) {
+          return errors::DataLoss(
+              "Offset ", offset, " of ",
+              dataset()->filenames_[current_file_index_],
+              " is not the offset of a record in its index.");
+        }
+        const int64 num_remaining = file_offsets_.end() - 1 - it;
+        const int64 n =
+            std::min<int64>(num_remaining, num_to_skip - *num_skipped);
+        TF_RETURN_IF_ERROR(reader_->SeekOffset(*(it + n)));
+        *num_skipped += n;
+        if (n == num_remaining) {
+          ResetStreamsLocked();
+          ++current_file_index_;
+        }
+      }
+      return Status::OK();
+    }
+
+    // A file opened for reads through the record indexes.
+    struct IndexedFile {
+      size_t file_index;
+      // `reader` borrows `file`, so it is declared after it.
+      std::unique_ptr<RandomAccessFile> file;
+      std::unique_ptr<io::RecordReader> reader;
+    };
+
     mutex mu_;
     size_t current_file_index_ TF_GUARDED_BY(mu_) = 0;
 
@@ -224,15 +596,53 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     // we must destroy `reader_` before `file_`.
     std::unique_ptr<RandomAccessFile> file_ TF_GUARDED_BY(mu_);
     std::unique_ptr<io::SequentialRecordReader> reader_ TF_GUARDED_BY(mu_);
+    // The record index of the current file, loaded when records are skipped.
+    bool file_index_loaded_ TF_GUARDED_BY(mu_) = false;
+    std::vector<uint64> file_offsets_ TF_GUARDED_BY(mu_);
+
+    // When reading through the record indexes, records are numbered across
+    // all files, and this iterator reads the records at positions
+    // [`position_`, `end_position_`) of their (shuffled) order.
+    std::shared_ptr<const RecordIndexes> indexes_;
+    int64 position_ TF_GUARDED_BY(mu_) = 0;
+    int64 end_position_ TF_GUARDED_BY(mu_) = 0;
+    int64 epoch_ TF_GUARDED_BY(mu_) = 0;
+    std::unique_ptr<IndexPermutation> permutation_ TF_GUARDED_BY(mu_);
+    // The files read through the record indexes, most recently used first.
+    std::list<IndexedFile> indexed_files_ TF_GUARDED_BY(mu_);
   };
 
   const std::vector<string> filenames_;
   const tstring compression_type_;
   io::RecordReaderOptions options_;
+  const int64 num_shards_;
+  const int64 shard_index_;
+  const int64 shuffle_seed_;
+
+  mutable mutex mu_;
+  mutable std::shared_ptr<const RecordIndexes> record_indexes_
+      TF_GUARDED_BY(mu_);
+  mutable int64 next_epoch_ TF_GUARDED_BY(mu_) = 0;
 };
 
 TFRecordDatasetOp::TFRecordDatasetOp(OpKernelConstruction* ctx)
-    : DatasetOpKernel(ctx) {}
+    : DatasetOpKernel(ctx) {
+  if (ctx->HasAttr(kNumShards)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kNumShards, &num_shards_));
+  }
+  if (ctx->HasAttr(kShardIndex)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kShardIndex, &shard_index_));
+  }
+  if (ctx->HasAttr(kShuffleSeed)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kShuffleSeed, &shuffle_seed_));
+  }
+  OP_REQUIRES(ctx, num_shards_ > 0,
+              errors::InvalidArgument("`num_shards` must be > 0 but is ",
+                                      num_shards_));
+  OP_REQUIRES(ctx, shard_index_ >= 0 && shard_index_ < num_shards_,
+              errors::InvalidArgument("`shard_index` must be in [0, ",
+                                      num_shards_, ") but is ", shard_index_));
+}
 
 void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
                                     DatasetBase** output) {
@@ -279,8 +689,14 @@ void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
     buffer_size = kS3BlockSize;
   }
 
-  *output =
-      new Dataset(ctx, std::move(filenames), compression_type, buffer_size);
+  OP_REQUIRES(ctx,
+              (num_shards_ == 1 && shuffle_seed_ < 0) ||
+                  compression_type.empty(),
+              errors::InvalidArgument("Sharding or shuffling TFRecord files "
+                                      "requires uncompressed files."));
+
+  *output = new Dataset(ctx, std::move(filenames), compression_type,
+                        buffer_size, num_shards_, shard_index_, shuffle_seed_);
 }
 
 namespace {
@@ -26,6 +26,9 @@ class TFRecordDatasetOp : public DatasetOpKernel {
   static constexpr const char* const kFileNames = "filenames";
   static constexpr const char* const kCompressionType = "compression_type";
   static constexpr const char* const kBufferSize = "buffer_size";
+  static constexpr const char* const kNumShards = "num_shards";
+  static constexpr const char* const kShardIndex = "shard_index";
+  static constexpr const char* const kShuffleSeed = "shuffle_seed";
 
   explicit TFRecordDatasetOp(OpKernelConstruction* ctx);
 
@@ -34,6 +37,10 @@ class TFRecordDatasetOp : public DatasetOpKernel {
 
  private:
   class Dataset;
+
+  int64 num_shards_ = 1;
+  int64 shard_index_ = 0;
+  int64 shuffle_seed_ = -1;
 };
 
 }  // namespace data
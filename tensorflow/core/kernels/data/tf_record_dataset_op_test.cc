@@ -12,6 +12,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/data/tf_record_dataset_op.h"
 
 #include "tensorflow/core/kernels/data/dataset_test_base.h"
+#include "tensorflow/core/lib/io/record_index.h"
 
 namespace tensorflow {
 namespace data {
@@ -23,12 +24,16 @@ class TFRecordDatasetParams : public DatasetParams {
  public:
   TFRecordDatasetParams(std::vector<tstring> filenames,
                         CompressionType compression_type, int64 buffer_size,
-                        string node_name)
+                        string node_name, int64 num_shards = 1,
+                        int64 shard_index = 0, int64 shuffle_seed = -1)
       : DatasetParams({DT_STRING}, {PartialTensorShape({})},
                       std::move(node_name)),
         filenames_(std::move(filenames)),
         compression_type_(compression_type),
-        buffer_size_(buffer_size) {}
+        buffer_size_(buffer_size),
+        num_shards_(num_shards),
+        shard_index_(shard_index),
+        shuffle_seed_(shuffle_seed) {}
 
   std::vector<Tensor> GetInputTensors() const override {
     int num_files = filenames_.size();
@@ -49,7 +54,9 @@ class TFRecordDatasetParams : public DatasetParams {
   }
 
   Status GetAttributes(AttributeVector* attr_vector) const override {
-    *attr_vector = {};
+    *attr_vector = {{TFRecordDatasetOp::kNumShards, num_shards_},
+                    {TFRecordDatasetOp::kShardIndex, shard_index_},
+                    {TFRecordDatasetOp::kShuffleSeed, shuffle_seed_}};
     return Status::OK();
   }
 
@@ -61,6 +68,9 @@ class TFRecordDatasetParams : public DatasetParams {
   std::vector<tstring> filenames_;
   CompressionType compression_type_;
   int64 buffer_size_;
+  int64 num_shards_;
+  int64 shard_index_;
+  int64 shuffle_seed_;
 };
 
 class TFRecordDatasetOpTest : public DatasetOpsTestBase {};
@@ -137,6 +147,32 @@ TFRecordDatasetParams TFRecordDatasetParams3() {
                                /*node_name=*/kNodeName);
 }
 
+// Test case 4: multiple text files without compression, with record indexes,
+// read as shard `shard_index` of `num_shards`, shuffled if `shuffle_seed` is
+// non-negative.
+TFRecordDatasetParams IndexedTFRecordDatasetParams(int64 num_shards,
+                                                   int64 shard_index,
+                                                   int64 shuffle_seed) {
+  std::vector<tstring> filenames = {
+      absl::StrCat(testing::TmpDir(), "/tf_record_INDEXED_1"),
+      absl::StrCat(testing::TmpDir(), "/tf_record_INDEXED_2")};
+  std::vector<std::vector<string>> contents = {{"1", "22", "333"},
+                                               {"a", "bb", "ccc"}};
+  CompressionType compression_type = CompressionType::UNCOMPRESSED;
+  if (!CreateTestFiles(filenames, contents, compression_type).ok()) {
+    VLOG(WARNING) << "Failed to create the test files: "
+                  << absl::StrJoin(filenames, ", ");
+  }
+  for (const auto& filename : filenames) {
+    TF_CHECK_OK(io::BuildRecordIndex(Env::Default(), filename));
+  }
+  return TFRecordDatasetParams(filenames,
+                               /*compression_type=*/compression_type,
+                               /*buffer_size=*/10,
+                               /*node_name=*/kNodeName, num_shards,
+                               shard_index, shuffle_seed);
+}
+
 std::vector<GetNextTestCase<TFRecordDatasetParams>> GetNextTestCases() {
   return {
       {/*dataset_params=*/TFRecordDatasetParams1(),
@@ -148,7 +184,22 @@ std::vector<GetNextTestCase<TFRecordDatasetParams>> GetNextTestCases() {
            TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})},
       {/*dataset_params=*/TFRecordDatasetParams3(),
        CreateTensors<tstring>(
-           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})}};
+           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})},
+      {/*dataset_params=*/IndexedTFRecordDatasetParams(
+           /*num_shards=*/1, /*shard_index=*/0, /*shuffle_seed=*/-1),
+       CreateTensors<tstring>(
+           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})},
+      {/*dataset_params=*/IndexedTFRecordDatasetParams(
+           /*num_shards=*/3, /*shard_index=*/1, /*shuffle_seed=*/-1),
+       CreateTensors<tstring>(TensorShape({}), {{"333"}, {"a"}})},
+      {/*dataset_params=*/IndexedTFRecordDatasetParams(
+           /*num_shards=*/4, /*shard_index=*/3, /*shuffle_seed=*/-1),
+       CreateTensors<tstring>(TensorShape({}), {{"bb"}, {"ccc"}})},
+      {/*dataset_params=*/IndexedTFRecordDatasetParams(
+           /*num_shards=*/1, /*shard_index=*/0, /*shuffle_seed=*/7),
+       CreateTensors<tstring>(
+           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}}),
+       /*compare_order=*/false}};
 }
 
 ITERATOR_GET_NEXT_TEST_P(TFRecordDatasetOpTest, TFRecordDatasetParams,
@@ -219,12 +270,93 @@ IteratorSaveAndRestoreTestCases() {
       {/*dataset_params=*/TFRecordDatasetParams3(),
        /*breakpoints=*/{0, 2, 7},
        CreateTensors<tstring>(
-           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})}};
+           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}})},
+      {/*dataset_params=*/IndexedTFRecordDatasetParams(
+           /*num_shards=*/2, /*shard_index=*/0, /*shuffle_seed=*/-1),
+       /*breakpoints=*/{0, 2, 4},
+       CreateTensors<tstring>(TensorShape({}), {{"1"}, {"22"}, {"333"}})},
+      {/*dataset_params=*/IndexedTFRecordDatasetParams(
+           /*num_shards=*/1, /*shard_index=*/0, /*shuffle_seed=*/7),
+       /*breakpoints=*/{0, 2, 7},
+       CreateTensors<tstring>(
+           TensorShape({}), {{"1"}, {"22"}, {"333"}, {"a"}, {"bb"}, {"ccc"}}),
+       /*compare_order=*/false}};
 }
 
 ITERATOR_SAVE_AND_RESTORE_TEST_P(TFRecordDatasetOpTest, TFRecordDatasetParams,
                                  IteratorSaveAndRestoreTestCases())
 
+TEST_F(TFRecordDatasetOpTest, ShardsOfShuffledRecordsArePartition) {
+  std::vector<string> records;
+  for (int shard_index = 0; shard_index < 4; ++shard_index) {
+    auto dataset_params = IndexedTFRecordDatasetParams(
+        /*num_shards=*/4, shard_index, /*shuffle_seed=*/11);
+    TF_ASSERT_OK(Initialize(dataset_params));
+    bool end_of_sequence = false;
+    while (!end_of_sequence) {
+      std::vector<Tensor> out_tensors;
+      TF_ASSERT_OK(iterator_->GetNext(iterator_ctx_.get(), &out_tensors,
+                                      &end_of_sequence));
+      if (!end_of_sequence) {
+        records.push_back(out_tensors[0].scalar<tstring>()());
+      }
+    }
+  }
+  std::sort(records.begin(), records.end());
+  EXPECT_EQ(records,
+            std::vector<string>({"1", "22", "333", "a", "bb", "ccc"}));
+}
+
+TEST_F(TFRecordDatasetOpTest, SkipWithRecordIndex) {
+  // Reads the files sequentially, using the indexes only to skip records.
+  auto dataset_params = IndexedTFRecordDatasetParams(
+      /*num_shards=*/1, /*shard_index=*/0, /*shuffle_seed=*/-1);
+  TF_ASSERT_OK(Initialize(dataset_params));
+  bool end_of_sequence = false;
+  int num_skipped = 0;
+  TF_ASSERT_OK(iterator_->Skip(iterator_ctx_.get(), /*num_to_skip=*/1,
+                               &end_of_sequence, &num_skipped));
+  EXPECT_EQ(num_skipped, 1);
+  std::vector<Tensor> out_tensors;
+  TF_ASSERT_OK(
+      iterator_->GetNext(iterator_ctx_.get(), &out_tensors, &end_of_sequence));
+  test::ExpectEqual(out_tensors[0], CreateTensor<tstring>(TensorShape({}),
+                                                          {"22"}));
+  TF_ASSERT_OK(iterator_->Skip(iterator_ctx_.get(), /*num_to_skip=*/2,
+                               &end_of_sequence, &num_skipped));
+  EXPECT_EQ(num_skipped, 2);
+  out_tensors.clear();
+  TF_ASSERT_OK(
+      iterator_->GetNext(iterator_ctx_.get(), &out_tensors, &end_of_sequence));
+  test::ExpectEqual(out_tensors[0], CreateTensor<tstring>(TensorShape({}),
+                                                          {"bb"}));
+  TF_ASSERT_OK(iterator_->Skip(iterator_ctx_.get(), /*num_to_skip=*/5,
+                               &end_of_sequence, &num_skipped));
+  EXPECT_TRUE(end_of_sequence);
+  EXPECT_EQ(num_skipped, 1);
+}
+
+TEST_F(TFRecordDatasetOpTest, ShardingRequiresRecordIndexes) {
+  std::vector<tstring> filenames = {
+      absl::StrCat(testing::TmpDir(), "/tf_record_UNINDEXED")};
+  TF_ASSERT_OK(
+      CreateTestFiles(filenames, {{"1", "22"}}, CompressionType::UNCOMPRESSED));
+  TFRecordDatasetParams dataset_params(
+      filenames, CompressionType::UNCOMPRESSED, /*buffer_size=*/10, kNodeName,
+      /*num_shards=*/2, /*shard_index=*/0);
+  EXPECT_EQ(Initialize(dataset_params).code(), error::FAILED_PRECONDITION);
+}
+
+TEST_F(TFRecordDatasetOpTest, ShardingRequiresUncompressedFiles) {
+  std::vector<tstring> filenames = {
+      absl::StrCat(testing::TmpDir(), "/tf_record_UNINDEXED_ZLIB")};
+  TF_ASSERT_OK(CreateTestFiles(filenames, {{"1", "22"}}, CompressionType::ZLIB));
+  TFRecordDatasetParams dataset_params(filenames, CompressionType::ZLIB,
+                                       /*buffer_size=*/10, kNodeName,
+                                       /*num_shards=*/2, /*shard_index=*/0);
+  EXPECT_EQ(Initialize(dataset_params).code(), error::INVALID_ARGUMENT);
+}
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
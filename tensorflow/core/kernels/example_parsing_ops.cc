@@ -40,6 +40,8 @@ namespace tensorflow {
 namespace {
 constexpr char kParseExampleV2[] = "ParseExampleV2";
 constexpr char kParseSequenceExampleV2[] = "ParseSequenceExampleV2";
+// Batches of at least this many examples are parsed column by column.
+constexpr int64 kMinColumnarParseBatchSize = 256;
 }  // namespace
 
 // Note: this kernel is used by both the ParseExample op and the ParseExampleV2
@@ -85,6 +87,7 @@ class ParseExampleOp : public OpKernel {
 
     example::FastParseExampleConfig config =
         MakeConfig(dense_keys_t, sparse_keys_t, ragged_keys_t, dense_defaults);
+    config.columnar = serialized->NumElements() >= kMinColumnarParseBatchSize;
 
     example::Result result;
     if (TensorShapeUtils::IsVector(serialized->shape())) {
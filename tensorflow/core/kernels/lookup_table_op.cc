@@ -16,9 +16,15 @@ limitations under the License.
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <numeric>
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/types.h"
@@ -30,11 +36,198 @@ limitations under the License.
 namespace tensorflow {
 namespace lookup {
 
-// Lookup table that wraps an unordered_map, where the key and value data type
-// is specified. Each individual value must be a scalar. If vector values are
-// required, use MutableHashTableOfTensors.
+namespace {
+
+// Hash map split into kNumShards independently locked open-addressing maps.
+//
+// Readers take a shared lock on each shard they touch, so concurrent Find calls
+// never block each other, and writers only block the shards they modify. The
+// batch operations group the keys of a tensor by shard so that every shard lock
+// is acquired at most once per call, and prefetch upcoming probes while the
+// current key is being resolved.
+template <class K, class V>
+class ShardedHashMap {
+ public:
+  typedef absl::flat_hash_map<K, V> Map;
+
+  size_t size() const {
+    size_t total = 0;
+    for (const Shard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      total += shard.map.size();
+    }
+    return total;
+  }
+
+  // Calls `fn(i, value)` for every i in [0, n) where `value` is a pointer to
+  // the value stored for `key_at(i)`, or nullptr if the key is absent.
+  template <typename KeyAt, typename Fn>
+  void BatchFind(int64 n, KeyAt key_at, Fn fn) const {
+    ShardedIndices indices;
+    GroupByShard(n, key_at, &indices);
+    for (int s = 0; s < kNumShards; ++s) {
+      const int64 begin = indices.shard_start[s];
+      const int64 end = indices.shard_start[s + 1];
+      if (begin == end) continue;
+      const Shard& shard = shards_[s];
+      tf_shared_lock l(shard.mu);
+      for (int64 j = begin; j < end; ++j) {
+        if (j + kPrefetchDistance < end) {
+          shard.map.prefetch(key_at(indices.order[j + kPrefetchDistance]));
+        }
+        const int64 i = indices.order[j];
+        auto it = shard.map.find(key_at(i), indices.hashes[i]);
+        fn(i, it == shard.map.end() ? nullptr : &it->second);
+      }
+    }
+  }
+
+  // Inserts or updates `key_at(i) -> value_at(i)` for every i in [0, n). If
+  // `clear` is true the previous contents are dropped atomically with respect
+  // to concurrent readers.
+  template <typename KeyAt, typename ValueAt>
+  void BatchInsertOrUpdate(bool clear, int64 n, KeyAt key_at, ValueAt value_at)
+      TF_NO_THREAD_SAFETY_ANALYSIS {
+    ShardedIndices indices;
+    GroupByShard(n, key_at, &indices);
+    if (clear) {
+      LockAll();
+      for (Shard& shard : shards_) {
+        shard.map.clear();
+      }
+    }
+    for (int s = 0; s < kNumShards; ++s) {
+      const int64 begin = indices.shard_start[s];
+      const int64 end = indices.shard_start[s + 1];
+      if (begin == end) continue;
+      Shard& shard = shards_[s];
+      if (!clear) shard.mu.lock();
+      for (int64 j = begin; j < end; ++j) {
+        const int64 i = indices.order[j];
+        shard.map.insert_or_assign(key_at(i), value_at(i));
+      }
+      if (!clear) shard.mu.unlock();
+    }
+    if (clear) {
+      UnlockAll();
+    }
+  }
+
+  // Erases `key_at(i)` for every i in [0, n).
+  template <typename KeyAt>
+  void BatchErase(int64 n, KeyAt key_at) {
+    ShardedIndices indices;
+    GroupByShard(n, key_at, &indices);
+    for (int s = 0; s < kNumShards; ++s) {
+      const int64 begin = indices.shard_start[s];
+      const int64 end = indices.shard_start[s + 1];
+      if (begin == end) continue;
+      Shard& shard = shards_[s];
+      mutex_lock l(shard.mu);
+      for (int64 j = begin; j < end; ++j) {
+        shard.map.erase(key_at(indices.order[j]));
+      }
+    }
+  }
+
+  // Calls `size_fn(num_entries)` once and then `entry_fn(i, key, value)` for
+  // every entry, with all shards held in shared mode so that the snapshot is
+  // consistent.
+  template <typename SizeFn, typename EntryFn>
+  Status Export(SizeFn size_fn, EntryFn entry_fn) const
+      TF_NO_THREAD_SAFETY_ANALYSIS {
+    for (const Shard& shard : shards_) shard.mu.lock_shared();
+    Status s = [&]() -> Status {
+      int64 num_entries = 0;
+      for (const Shard& shard : shards_) num_entries += shard.map.size();
+      TF_RETURN_IF_ERROR(size_fn(num_entries));
+      int64 i = 0;
+      for (const Shard& shard : shards_) {
+        for (const auto& entry : shard.map) {
+          entry_fn(i++, entry.first, entry.second);
+        }
+      }
+      return Status::OK();
+    }();
+    for (const Shard& shard : shards_) shard.mu.unlock_shared();
+    return s;
+  }
+
+  // Approximate number of slots (used or not) held by all shards.
+  int64 capacity() const {
+    int64 ret = 0;
+    for (const Shard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      ret += shard.map.capacity();
+    }
+    return ret;
+  }
+
+ private:
+  static constexpr int kShardBits = 4;
+  static constexpr int kNumShards = 1 << kShardBits;
+  static constexpr int64 kPrefetchDistance = 4;
+
+  struct Shard {
+    mutable mutex mu;
+    Map map TF_GUARDED_BY(mu);
+  };
+
+  // Key indices of a batch reordered so that the keys of shard s live in
+  // order[shard_start[s], shard_start[s + 1]).
+  struct ShardedIndices {
+    std::vector<size_t> hashes;
+    std::vector<int64> order;
+    std::array<int64, kNumShards + 1> shard_start;
+  };
+
+  // The maps consume the low bits of the hash, so shards use the high ones.
+  static int ShardOf(size_t hash) {
+    return static_cast<int>(hash >> (sizeof(size_t) * 8 - kShardBits));
+  }
+
+  template <typename KeyAt>
+  static void GroupByShard(int64 n, KeyAt key_at, ShardedIndices* indices) {
+    typename Map::hasher hasher;
+    indices->hashes.resize(n);
+    indices->order.resize(n);
+    std::array<int64, kNumShards> counts{};
+    for (int64 i = 0; i < n; ++i) {
+      indices->hashes[i] = hasher(key_at(i));
+      ++counts[ShardOf(indices->hashes[i])];
+    }
+    indices->shard_start[0] = 0;
+    for (int s = 0; s < kNumShards; ++s) {
+      indices->shard_start[s + 1] = indices->shard_start[s] + counts[s];
+    }
+    std::array<int64, kNumShards> next;
+    std::copy(indices->shard_start.begin(), indices->shard_start.end() - 1,
+              next.begin());
+    for (int64 i = 0; i < n; ++i) {
+      indices->order[next[ShardOf(indices->hashes[i])]++] = i;
+    }
+  }
+
+  void LockAll() TF_NO_THREAD_SAFETY_ANALYSIS {
+    for (Shard& shard : shards_) shard.mu.lock();
+  }
+
+  void UnlockAll() TF_NO_THREAD_SAFETY_ANALYSIS {
+    for (Shard& shard : shards_) shard.mu.unlock();
+  }
+
+  std::array<Shard, kNumShards> shards_;
+};
+
+}  // namespace
+
+// Lookup table that wraps a sharded flat_hash_map, where the key and value data
+// type is specified. Each individual value must be a scalar. If vector values
+// are required, use MutableHashTableOfTensors.
 //
 // This table is mutable and thread safe - Insert can be called at any time.
+// Keys are spread over independently locked shards, so lookups never contend
+// with each other and only contend with writers touching the same shard.
 //
 // Sample use case:
 //
@@ -49,10 +242,7 @@ class MutableHashTableOfScalars final : public LookupInterface {
  public:
   MutableHashTableOfScalars(OpKernelContext* ctx, OpKernel* kernel) {}
 
-  size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
-  }
+  size_t size() const override { return table_.size(); }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
@@ -64,18 +254,23 @@ class MutableHashTableOfScalars final : public LookupInterface {
     int64 default_total = default_flat.size();
     bool is_full_size_default = (total == default_total);
 
-    tf_shared_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      // is_full_size_default is true:
-      //   Each key has an independent default value, key_values(i)
-      //   corresponding uses default_flat(i) as its default value.
-      //
-      // is_full_size_default is false:
-      //   All keys will share the default_flat(0) as default value.
-      value_values(i) = gtl::FindWithDefault(
-          table_, SubtleMustCopyIfIntegral(key_values(i)),
-          is_full_size_default ? default_flat(i) : default_flat(0));
-    }
+    table_.BatchFind(
+        key_values.size(),
+        [&key_values](int64 i) -> decltype(auto) {
+          return SubtleMustCopyIfIntegral(key_values(i));
+        },
+        [&](int64 i, const V* found) {
+          // is_full_size_default is true:
+          //   Each key has an independent default value, key_values(i)
+          //   corresponding uses default_flat(i) as its default value.
+          //
+          // is_full_size_default is false:
+          //   All keys will share the default_flat(0) as default value.
+          value_values(i) =
+              found != nullptr
+                  ? *found
+                  : (is_full_size_default ? default_flat(i) : default_flat(0));
+        });
 
     return Status::OK();
   }
@@ -84,14 +279,14 @@ class MutableHashTableOfScalars final : public LookupInterface {
     const auto key_values = keys.flat<K>();
     const auto value_values = values.flat<V>();
 
-    mutex_lock l(mu_);
-    if (clear) {
-      table_.clear();
-    }
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
-                          SubtleMustCopyIfIntegral(value_values(i)));
-    }
+    table_.BatchInsertOrUpdate(
+        clear, key_values.size(),
+        [&key_values](int64 i) -> decltype(auto) {
+          return SubtleMustCopyIfIntegral(key_values(i));
+        },
+        [&value_values](int64 i) {
+          return SubtleMustCopyIfIntegral(value_values(i));
+        });
     return Status::OK();
   }
 
@@ -103,10 +298,10 @@ class MutableHashTableOfScalars final : public LookupInterface {
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
     const auto key_values = keys.flat<K>();
 
-    mutex_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
-    }
+    table_.BatchErase(key_values.size(),
+                      [&key_values](int64 i) -> decltype(auto) {
+                        return SubtleMustCopyIfIntegral(key_values(i));
+                      });
     return Status::OK();
   }
 
@@ -116,24 +311,24 @@ class MutableHashTableOfScalars final : public LookupInterface {
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    tf_shared_lock l(mu_);
-    int64 size = table_.size();
-
-    Tensor* keys;
-    Tensor* values;
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("keys", TensorShape({size}), &keys));
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("values", TensorShape({size}), &values));
-
-    auto keys_data = keys->flat<K>();
-    auto values_data = values->flat<V>();
-    int64 i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      keys_data(i) = it->first;
-      values_data(i) = it->second;
-    }
-    return Status::OK();
+    K* keys_data = nullptr;
+    V* values_data = nullptr;
+    return table_.Export(
+        [&](int64 size) -> Status {
+          Tensor* keys;
+          Tensor* values;
+          TF_RETURN_IF_ERROR(
+              ctx->allocate_output("keys", TensorShape({size}), &keys));
+          TF_RETURN_IF_ERROR(
+              ctx->allocate_output("values", TensorShape({size}), &values));
+          keys_data = keys->flat<K>().data();
+          values_data = values->flat<V>().data();
+          return Status::OK();
+        },
+        [&](int64 i, const K& key, const V& value) {
+          keys_data[i] = key;
+          values_data[i] = value;
+        });
   }
 
   DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
@@ -145,25 +340,14 @@ class MutableHashTableOfScalars final : public LookupInterface {
   TensorShape value_shape() const override { return TensorShape(); }
 
   int64 MemoryUsed() const override {
-    int64 ret = 0;
-    tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
-      }
-    }
-    return sizeof(MutableHashTableOfScalars) + ret;
+    return sizeof(MutableHashTableOfScalars) + table_.capacity();
   }
 
  private:
-  mutable mutex mu_;
-  std::unordered_map<K, V> table_ TF_GUARDED_BY(mu_);
+  ShardedHashMap<K, V> table_;
 };
 
-// Lookup table that wraps an unordered_map. Behaves identical to
+// Lookup table that wraps a sharded flat_hash_map. Behaves identical to
 // MutableHashTableOfScalars except that each value must be a vector.
 template <class K, class V>
 class MutableHashTableOfTensors final : public LookupInterface {
@@ -177,10 +361,7 @@ class MutableHashTableOfTensors final : public LookupInterface {
                                 value_shape_.DebugString()));
   }
 
-  size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
-  }
+  size_t size() const override { return table_.size(); }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
@@ -193,27 +374,29 @@ class MutableHashTableOfTensors final : public LookupInterface {
     int64 default_total = default_flat.size();
     bool is_full_size_default = (total == default_total);
 
-    tf_shared_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      ValueArray* value_vec =
-          gtl::FindOrNull(table_, SubtleMustCopyIfIntegral(key_values(i)));
-      if (value_vec != nullptr) {
-        for (int64 j = 0; j < value_dim; j++) {
-          value_values(i, j) = value_vec->at(j);
-        }
-      } else {
-        // is_full_size_default is true:
-        //   Each key has an independent default value, key_values(i)
-        //   corresponding uses default_flat(i) as its default value.
-        //
-        // is_full_size_default is false:
-        //   All keys will share the default_flat(0) as default value.
-        for (int64 j = 0; j < value_dim; j++) {
-          value_values(i, j) =
-              is_full_size_default ? default_flat(i, j) : default_flat(0, j);
-        }
-      }
-    }
+    table_.BatchFind(
+        key_values.size(),
+        [&key_values](int64 i) -> decltype(auto) {
+          return SubtleMustCopyIfIntegral(key_values(i));
+        },
+        [&](int64 i, const ValueArray* value_vec) {
+          if (value_vec != nullptr) {
+            for (int64 j = 0; j < value_dim; j++) {
+              value_values(i, j) = value_vec->at(j);
+            }
+          } else {
+            // is_full_size_default is true:
+            //   Each key has an independent default value, key_values(i)
+            //   corresponding uses default_flat(i) as its default value.
+            //
+            // is_full_size_default is false:
+            //   All keys will share the default_flat(0) as default value.
+            for (int64 j = 0; j < value_dim; j++) {
+              value_values(i, j) = is_full_size_default ? default_flat(i, j)
+                                                        : default_flat(0, j);
+            }
+          }
+        });
 
     return Status::OK();
   }
@@ -223,19 +406,19 @@ class MutableHashTableOfTensors final : public LookupInterface {
     const auto value_values = values.flat_inner_dims<V, 2>();
     int64 value_dim = value_shape_.dim_size(0);
 
-    mutex_lock l(mu_);
-    if (clear) {
-      table_.clear();
-    }
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      ValueArray value_vec;
-      for (int64 j = 0; j < value_dim; j++) {
-        V value = value_values(i, j);
-        value_vec.push_back(value);
-      }
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
-                          value_vec);
-    }
+    table_.BatchInsertOrUpdate(
+        clear, key_values.size(),
+        [&key_values](int64 i) -> decltype(auto) {
+          return SubtleMustCopyIfIntegral(key_values(i));
+        },
+        [&value_values, value_dim](int64 i) {
+          ValueArray value_vec;
+          for (int64 j = 0; j < value_dim; j++) {
+            V value = value_values(i, j);
+            value_vec.push_back(value);
+          }
+          return value_vec;
+        });
     return Status::OK();
   }
 
@@ -247,10 +430,10 @@ class MutableHashTableOfTensors final : public LookupInterface {
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
     const auto key_values = keys.flat<K>();
 
-    mutex_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
-    }
+    table_.BatchErase(key_values.size(),
+                      [&key_values](int64 i) -> decltype(auto) {
+                        return SubtleMustCopyIfIntegral(key_values(i));
+                      });
     return Status::OK();
   }
 
@@ -260,29 +443,28 @@ class MutableHashTableOfTensors final : public LookupInterface {
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    tf_shared_lock l(mu_);
-    int64 size = table_.size();
     int64 value_dim = value_shape_.dim_size(0);
 
-    Tensor* keys;
-    Tensor* values;
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("keys", TensorShape({size}), &keys));
-    TF_RETURN_IF_ERROR(ctx->allocate_output(
-        "values", TensorShape({size, value_dim}), &values));
-
-    auto keys_data = keys->flat<K>();
-    auto values_data = values->matrix<V>();
-    int64 i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      K key = it->first;
-      ValueArray value = it->second;
-      keys_data(i) = key;
-      for (int64 j = 0; j < value_dim; j++) {
-        values_data(i, j) = value[j];
-      }
-    }
-    return Status::OK();
+    K* keys_data = nullptr;
+    V* values_data = nullptr;
+    return table_.Export(
+        [&](int64 size) -> Status {
+          Tensor* keys;
+          Tensor* values;
+          TF_RETURN_IF_ERROR(
+              ctx->allocate_output("keys", TensorShape({size}), &keys));
+          TF_RETURN_IF_ERROR(ctx->allocate_output(
+              "values", TensorShape({size, value_dim}), &values));
+          keys_data = keys->flat<K>().data();
+          values_data = values->flat<V>().data();
+          return Status::OK();
+        },
+        [&](int64 i, const K& key, const ValueArray& value) {
+          keys_data[i] = key;
+          for (int64 j = 0; j < value_dim; j++) {
+            values_data[i * value_dim + j] = value[j];
+          }
+        });
   }
 
   DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
@@ -294,24 +476,13 @@ class MutableHashTableOfTensors final : public LookupInterface {
   TensorShape value_shape() const override { return value_shape_; }
 
   int64 MemoryUsed() const override {
-    int64 ret = 0;
-    tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
-      }
-    }
-    return sizeof(MutableHashTableOfTensors) + ret;
+    return sizeof(MutableHashTableOfTensors) + table_.capacity();
   }
 
  private:
-  TensorShape value_shape_;
-  mutable mutex mu_;
   typedef gtl::InlinedVector<V, 4> ValueArray;
-  std::unordered_map<K, ValueArray> table_ TF_GUARDED_BY(mu_);
+  TensorShape value_shape_;
+  ShardedHashMap<K, ValueArray> table_;
 };
 
 namespace {
@@ -334,6 +505,17 @@ TensorShape MaybeVectorizeShape(const TensorShape& shape) {
 }  // namespace
 
 // Modeled after densehashtable in https://github.com/sparsehash/sparsehash
+//
+// Growing the table does not rehash all entries at once. The old buckets are
+// kept next to the new ones and every following Insert migrates a slice of
+// them, so the cost of a resize is spread over the inserts that follow it.
+// While a migration is in progress, lookups consult the new buckets first and
+// fall back to the old ones.
+//
+// For arithmetic keys and values, Find takes no lock at all. It reads the
+// buckets optimistically and validates each lookup against a sequence counter
+// that writers bump around every bucket mutation (a seqlock), retrying or
+// falling back to the shared lock if a writer raced with it.
 template <class K, class V>
 class MutableDenseHashTable final : public LookupInterface {
  public:
@@ -394,7 +576,9 @@ class MutableDenseHashTable final : public LookupInterface {
     int64 initial_num_buckets;
     OP_REQUIRES_OK(ctx, GetNodeAttr(kernel->def(), "initial_num_buckets",
                                     &initial_num_buckets));
+    num_entries_ = 0;
     OP_REQUIRES_OK(ctx, AllocateBuckets(ctx, initial_num_buckets));
+    PublishSnapshot(ctx);
   }
 
   size_t size() const override TF_LOCKS_EXCLUDED(mu_) {
@@ -418,17 +602,11 @@ class MutableDenseHashTable final : public LookupInterface {
     auto value_matrix = value->shaped<V, 2>({num_elements, value_size});
     const auto default_flat = default_value.flat<V>();
 
-    tf_shared_lock l(mu_);
-    const auto key_buckets_matrix =
-        key_buckets_.AccessTensor(ctx)->template matrix<K>();
-    const auto value_buckets_matrix =
-        value_buckets_.AccessTensor(ctx)->template matrix<V>();
     const auto empty_key_matrix =
         empty_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
     const auto deleted_key_matrix =
         deleted_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
-    const int64 bit_mask = num_buckets_ - 1;
-    // TODO(andreasst): parallelize using work_sharder
+    std::vector<uint64> key_hashes(num_elements);
     for (int64 i = 0; i < num_elements; ++i) {
       const uint64 key_hash = HashKey(key_matrix, i);
       if (empty_key_hash_ == key_hash &&
@@ -441,32 +619,61 @@ class MutableDenseHashTable final : public LookupInterface {
         return errors::InvalidArgument(
             "Using the deleted_key as a table key is not allowed");
       }
-      int64 bucket_index = key_hash & bit_mask;
-      int64 num_probes = 0;
-      while (true) {
-        if (IsEqualKey(key_buckets_matrix, bucket_index, key_matrix, i)) {
-          for (int64 j = 0; j < value_size; ++j) {
-            // TODO(andreasst): check if we can get rid of SubtleMustCopy
-            // here and elsewhere in this file.
-            value_matrix(i, j) =
-                SubtleMustCopyIfIntegral(value_buckets_matrix(bucket_index, j));
-          }
-          break;
-        }
-        if (IsEqualKey(key_buckets_matrix, bucket_index, empty_key_matrix, 0)) {
-          for (int64 j = 0; j < value_size; ++j) {
-            value_matrix(i, j) = SubtleMustCopyIfIntegral(default_flat(j));
+      key_hashes[i] = key_hash;
+    }
+
+    // Rows that could not be read optimistically are looked up under mu_.
+    std::vector<int64> locked_rows;
+    if (kOptimisticReads) {
+      // While registered as a reader, no snapshot loaded below is freed.
+      const int64 epoch = EnterOptimisticRead();
+      const Snapshot* snapshot = snapshot_.load();
+      BucketsView current(snapshot->current);
+      BucketsView old(snapshot->old);
+      // TODO(andreasst): parallelize using work_sharder
+      for (int64 i = 0; i < num_elements; ++i) {
+        bool done = false;
+        for (int attempt = 0; !done && attempt < kMaxOptimisticReadAttempts;
+             ++attempt) {
+          const int64 seq = seq_.load(std::memory_order_acquire);
+          if (seq & 1) continue;  // A writer is mutating the buckets.
+          const Snapshot* latest = snapshot_.load(std::memory_order_acquire);
+          if (latest != snapshot) {
+            snapshot = latest;
+            current = BucketsView(snapshot->current);
+            old = BucketsView(snapshot->old);
+            continue;
           }
-          break;
+          const bool probed =
+              LookupRow(current, old, empty_key_matrix, key_matrix, i,
+                        key_hashes[i], default_flat, &value_matrix);
+          std::atomic_thread_fence(std::memory_order_acquire);
+          done = probed && seq_.load(std::memory_order_relaxed) == seq;
         }
-        ++num_probes;
-        bucket_index =
-            (bucket_index + num_probes) & bit_mask;  // quadratic probing
-        if (num_probes >= num_buckets_) {
-          return errors::Internal(
-              "Internal error in MutableDenseHashTable lookup");
+        if (!done) {
+          locked_rows.push_back(i);
         }
       }
+      ExitOptimisticRead(epoch);
+      if (locked_rows.empty()) {
+        return Status::OK();
+      }
+    } else {
+      locked_rows.resize(num_elements);
+      std::iota(locked_rows.begin(), locked_rows.end(), 0);
+    }
+
+    tf_shared_lock l(mu_);
+    const Buckets current = CurrentBuckets(ctx);
+    const Buckets old = OldBuckets(ctx);
+    const BucketsView current_view(current);
+    const BucketsView old_view(old);
+    for (const int64 i : locked_rows) {
+      if (!LookupRow(current_view, old_view, empty_key_matrix, key_matrix, i,
+                     key_hashes[i], default_flat, &value_matrix)) {
+        return errors::Internal(
+            "Internal error in MutableDenseHashTable lookup");
+      }
     }
     return Status::OK();
   }
@@ -481,20 +688,50 @@ class MutableDenseHashTable final : public LookupInterface {
                                      expected_shape.DebugString(), " got ",
                                      key.shape().DebugString());
     }
-    mutex_lock l(mu_);
-    // For simplicity we assume that all keys in the input result in inserts
-    // rather than updates. That means we may grow the table even though we
-    // don't need to. As long as the number of keys inserted in one call is
-    // small compared to the size of the map, the impact of this is minimal.
-    const int64 pending_num_entries = num_entries_ + batch_size;
-    if (pending_num_entries > num_buckets_ * max_load_factor_) {
-      int64 new_num_buckets = num_buckets_;
-      do {
-        new_num_buckets <<= 1;
-      } while (pending_num_entries > new_num_buckets * max_load_factor_);
-      TF_RETURN_IF_ERROR(Rebucket(ctx, new_num_buckets));
+    PersistentTensor new_key_buckets;
+    PersistentTensor new_value_buckets;
+    int64 new_num_buckets = 0;
+    while (true) {
+      {
+        mutex_lock l(mu_);
+        // For simplicity we assume that all keys in the input result in
+        // inserts rather than updates. That means we may grow the table even
+        // though we don't need to. As long as the number of keys inserted in
+        // one call is small compared to the size of the map, the impact of
+        // this is minimal.
+        const int64 pending_num_entries = num_entries_ + batch_size;
+        int64 wanted_num_buckets = num_buckets_;
+        while (pending_num_entries > wanted_num_buckets * max_load_factor_) {
+          wanted_num_buckets <<= 1;
+        }
+        if (wanted_num_buckets == num_buckets_ ||
+            wanted_num_buckets == new_num_buckets) {
+          if (wanted_num_buckets != num_buckets_) {
+            TF_RETURN_IF_ERROR(StartRehash(ctx, new_num_buckets,
+                                           std::move(new_key_buckets),
+                                           std::move(new_value_buckets)));
+          }
+          TF_RETURN_IF_ERROR(DoInsert(ctx, key, value));
+          ReleaseRetiredSnapshots();
+          // Once the table has grown, at least
+          // num_buckets_ * max_load_factor_ / 2 entries have to be inserted
+          // before it grows again. Migrating 2 / max_load_factor_ old buckets
+          // per inserted key thus finishes the migration well before the next
+          // resize would have to wait for it.
+          int64 num_rehash_buckets = 2 * batch_size / max_load_factor_;
+          if (num_rehash_buckets < kMinRehashBucketsPerInsert) {
+            num_rehash_buckets = kMinRehashBucketsPerInsert;
+          }
+          return AdvanceRehash(ctx, num_rehash_buckets);
+        }
+        new_num_buckets = wanted_num_buckets;
+      }
+      // Fill the grown buckets without holding mu_. If another writer resizes
+      // the table in the meantime, the check above sizes them again.
+      TF_RETURN_IF_ERROR(AllocateEmptyBuckets(ctx, new_num_buckets,
+                                              &new_key_buckets,
+                                              &new_value_buckets));
     }
-    return DoInsert(ctx, key, value, false);
   }
 
   Status Remove(OpKernelContext* ctx, const Tensor& key) override
@@ -516,6 +753,11 @@ class MutableDenseHashTable final : public LookupInterface {
     num_buckets_ = keys.dim_size(0);
     key_buckets_ = PersistentTensor(keys);
     value_buckets_ = PersistentTensor(values);
+    // Any in-flight migration is superseded by the imported buckets.
+    old_num_buckets_ = 0;
+    rehash_cursor_ = 0;
+    old_key_buckets_ = PersistentTensor();
+    old_value_buckets_ = PersistentTensor();
     // Count the number of keys that are not the empty_key or deleted_key.
     // This requires iterating through the whole table but that is OK as we
     // only execute it during checkpoint restore.
@@ -534,11 +776,14 @@ class MutableDenseHashTable final : public LookupInterface {
         ++num_entries_;
       }
     }
+    PublishSnapshot(ctx);
     return Status::OK();
   }
 
   Status ExportValues(OpKernelContext* ctx) override TF_LOCKS_EXCLUDED(mu_) {
-    tf_shared_lock l(mu_);
+    mutex_lock l(mu_);
+    // The exported buckets must hold every entry, so finish any migration.
+    TF_RETURN_IF_ERROR(AdvanceRehash(ctx, old_num_buckets_));
     Tensor key_buckets_tensor = *key_buckets_.AccessTensor(ctx);
     Tensor value_buckets_tensor = *value_buckets_.AccessTensor(ctx);
     TF_RETURN_IF_ERROR(ctx->set_output("keys", key_buckets_tensor));
@@ -582,12 +827,332 @@ class MutableDenseHashTable final : public LookupInterface {
   int64 MemoryUsed() const override TF_LOCKS_EXCLUDED(mu_) {
     tf_shared_lock l(mu_);
     return sizeof(MutableDenseHashTable) + key_buckets_.AllocatedBytes() +
-           value_buckets_.AllocatedBytes() + empty_key_.AllocatedBytes();
+           value_buckets_.AllocatedBytes() + old_key_buckets_.AllocatedBytes() +
+           old_value_buckets_.AllocatedBytes() + empty_key_.AllocatedBytes();
   }
 
  private:
-  Status DoInsert(OpKernelContext* ctx, const Tensor& key, const Tensor& value,
-                  bool ignore_empty_and_deleted_key)
+  // Only keys and values that std::atomic can load and store in place may use
+  // the lock-free read path.
+  static constexpr bool kOptimisticReads =
+      std::is_arithmetic<K>::value && std::is_arithmetic<V>::value;
+  static constexpr int kMaxOptimisticReadAttempts = 8;
+  static constexpr int64 kMinRehashBucketsPerInsert = 64;
+
+  // One generation of bucket tensors. Holding a copy keeps the underlying
+  // buffers alive even if a writer replaces them.
+  struct Buckets {
+    Tensor keys;
+    Tensor values;
+    int64 num_buckets = 0;
+  };
+
+  // The bucket tensors published to optimistic readers.
+  struct Snapshot {
+    Buckets current;
+    Buckets old;
+  };
+
+  // Row-major accessor for the elements of a bucket tensor. With
+  // kOptimisticReads, optimistic readers may load an element while a writer
+  // stores it, so both go through relaxed atomics; the seqlock discards any
+  // torn lookup.
+  template <typename T>
+  class BucketMatrix {
+   public:
+    using Element = typename std::remove_const<T>::type;
+    using Reference = typename std::conditional<kOptimisticReads, Element,
+                                                const Element&>::type;
+
+    BucketMatrix() = default;
+    BucketMatrix(T* data, int64 num_columns)
+        : data_(data), num_columns_(num_columns) {}
+
+    Reference operator()(int64 row, int64 column) const {
+      return Load(data_[row * num_columns_ + column],
+                  std::integral_constant<bool, kOptimisticReads>());
+    }
+
+    void Store(int64 row, int64 column, const Element& value) const {
+      Store(&data_[row * num_columns_ + column], value,
+            std::integral_constant<bool, kOptimisticReads>());
+    }
+
+   private:
+    static Element Load(const Element& element, std::true_type) {
+      static_assert(sizeof(std::atomic<Element>) == sizeof(Element),
+                    "Buckets must be loadable as atomics in place");
+      return reinterpret_cast<const std::atomic<Element>&>(element).load(
+          std::memory_order_relaxed);
+    }
+    static const Element& Load(const Element& element, std::false_type) {
+      return element;
+    }
+    static void Store(Element* element, const Element& value,
+                      std::true_type) {
+      reinterpret_cast<std::atomic<Element>*>(element)->store(
+          value, std::memory_order_relaxed);
+    }
+    static void Store(Element* element, const Element& value,
+                      std::false_type) {
+      *element = value;
+    }
+
+    T* data_ = nullptr;
+    int64 num_columns_ = 0;
+  };
+
+  // Read-only views of Buckets, built once per batch rather than once per key.
+  struct BucketsView {
+    BucketsView() = default;
+    explicit BucketsView(const Buckets& buckets)
+        : num_buckets(buckets.num_buckets) {
+      if (num_buckets > 0) {
+        keys = BucketMatrix<const K>(buckets.keys.template flat<K>().data(),
+                                     buckets.keys.dim_size(1));
+        values = BucketMatrix<const V>(buckets.values.template flat<V>().data(),
+                                       buckets.values.dim_size(1));
+      }
+    }
+
+    int64 num_buckets = 0;
+    BucketMatrix<const K> keys;
+    BucketMatrix<const V> values;
+  };
+
+  Buckets CurrentBuckets(OpKernelContext* ctx) TF_SHARED_LOCKS_REQUIRED(mu_) {
+    return {*key_buckets_.AccessTensor(ctx), *value_buckets_.AccessTensor(ctx),
+            num_buckets_};
+  }
+
+  Buckets OldBuckets(OpKernelContext* ctx) TF_SHARED_LOCKS_REQUIRED(mu_) {
+    if (old_num_buckets_ == 0) {
+      return Buckets();
+    }
+    return {*old_key_buckets_.AccessTensor(ctx),
+            *old_value_buckets_.AccessTensor(ctx), old_num_buckets_};
+  }
+
+  // Makes the current bucket tensors visible to optimistic readers. Must be
+  // called whenever key_buckets_, value_buckets_ or the old buckets are
+  // replaced.
+  void PublishSnapshot(OpKernelContext* ctx) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    std::unique_ptr<const Snapshot> snapshot(
+        new Snapshot{CurrentBuckets(ctx), OldBuckets(ctx)});
+    BeginWrite();
+    snapshot_.store(snapshot.get());
+    EndWrite();
+    if (published_snapshot_ != nullptr) {
+      retired_snapshots_.push_back(
+          {std::move(published_snapshot_), epoch_.load()});
+    }
+    published_snapshot_ = std::move(snapshot);
+    ReleaseRetiredSnapshots();
+  }
+
+  // Registers an optimistic reader in the current epoch and returns it. The
+  // epoch is read again after registering, so that a writer that advanced it
+  // in the meantime either sees the reader or is seen by it.
+  int64 EnterOptimisticRead() {
+    while (true) {
+      const int64 epoch = epoch_.load();
+      epoch_readers_[epoch & 1].fetch_add(1);
+      if (epoch_.load() == epoch) {
+        return epoch;
+      }
+      epoch_readers_[epoch & 1].fetch_sub(1);
+    }
+  }
+
+  void ExitOptimisticRead(int64 epoch) {
+    epoch_readers_[epoch & 1].fetch_sub(1, std::memory_order_release);
+  }
+
+  // Advances the epoch as far as the registered readers allow and frees the
+  // snapshots that no reader can still hold. The epoch only moves from e to
+  // e + 1 once the readers of e - 1, which share a counter with e + 1, are
+  // gone. A snapshot retired in epoch r can only be held by readers of
+  // epochs up to r, so it is freed once the epoch reaches r + 2. Readers only
+  // delay the snapshots retired while they run, not later ones.
+  void ReleaseRetiredSnapshots() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    for (int i = 0; i < 2 && !retired_snapshots_.empty(); ++i) {
+      const int64 epoch = epoch_.load();
+      if (epoch_readers_[(epoch + 1) & 1].load() != 0) {
+        break;
+      }
+      epoch_.store(epoch + 1);
+    }
+    const int64 epoch = epoch_.load();
+    auto it = retired_snapshots_.begin();
+    while (it != retired_snapshots_.end() && it->epoch + 2 <= epoch) {
+      ++it;
+    }
+    retired_snapshots_.erase(retired_snapshots_.begin(), it);
+  }
+
+  // Brackets a mutation of bucket contents. Readers that observe seq_ change
+  // across their lookup discard the result.
+  void BeginWrite() {
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1,
+               std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void EndWrite() {
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1,
+               std::memory_order_release);
+  }
+
+  // Returns the index of the bucket holding row `index` of `key_matrix`, -1 if
+  // the key is not present and -2 if probing wrapped around the whole table.
+  template <typename MT0, typename MT1, typename MT2>
+  int64 FindBucket(MT0 key_buckets_matrix, int64 num_buckets,
+                   MT1 empty_key_matrix, MT2 key_matrix, int64 index,
+                   uint64 key_hash) const {
+    const int64 bit_mask = num_buckets - 1;
+    int64 bucket_index = key_hash & bit_mask;
+    int64 num_probes = 0;
+    while (true) {
+      if (IsEqualKey(key_buckets_matrix, bucket_index, key_matrix, index)) {
+        return bucket_index;
+      }
+      if (IsEqualKey(key_buckets_matrix, bucket_index, empty_key_matrix, 0)) {
+        return -1;
+      }
+      ++num_probes;
+      bucket_index =
+          (bucket_index + num_probes) & bit_mask;  // quadratic probing
+      if (num_probes >= num_buckets) {
+        return -2;
+      }
+    }
+  }
+
+  // Writes the value stored for row `index` of `key_matrix`, or the default
+  // value, into row `index` of `value_matrix`. Returns false if probing
+  // failed.
+  template <typename MT1>
+  bool LookupRow(const BucketsView& current, const BucketsView& old,
+                 MT1 empty_key_matrix,
+                 typename TTypes<K>::ConstMatrix key_matrix, int64 index,
+                 uint64 key_hash, typename TTypes<V>::ConstFlat default_flat,
+                 typename TTypes<V>::Matrix* value_matrix) const {
+    const int64 value_size = value_shape_.num_elements();
+    for (const BucketsView* buckets : {&current, &old}) {
+      if (buckets->num_buckets == 0) continue;
+      const int64 bucket_index =
+          FindBucket(buckets->keys, buckets->num_buckets, empty_key_matrix,
+                     key_matrix, index, key_hash);
+      if (bucket_index == -2) {
+        return false;
+      }
+      if (bucket_index >= 0) {
+        for (int64 j = 0; j < value_size; ++j) {
+          // TODO(andreasst): check if we can get rid of SubtleMustCopy
+          // here and elsewhere in this file.
+          (*value_matrix)(index, j) =
+              SubtleMustCopyIfIntegral(buckets->values(bucket_index, j));
+        }
+        return true;
+      }
+    }
+    for (int64 j = 0; j < value_size; ++j) {
+      (*value_matrix)(index, j) = SubtleMustCopyIfIntegral(default_flat(j));
+    }
+    return true;
+  }
+
+  // Inserts or updates row `index` of `key_matrix` in the current buckets.
+  // Sets `*inserted` to whether a new bucket was taken.
+  template <typename MT2, typename VT2>
+  Status InsertRow(OpKernelContext* ctx, MT2 key_matrix, VT2 value_matrix,
+                   int64 index, uint64 key_hash, bool* inserted)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const int64 key_size = key_shape_.num_elements();
+    const int64 value_size = value_shape_.num_elements();
+    const BucketMatrix<K> key_buckets_matrix(
+        key_buckets_.AccessTensor(ctx)->template flat<K>().data(), key_size);
+    const BucketMatrix<V> value_buckets_matrix(
+        value_buckets_.AccessTensor(ctx)->template flat<V>().data(),
+        value_size);
+    const auto empty_key_tensor =
+        empty_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
+    const auto deleted_key_tensor =
+        deleted_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
+    const int64 bit_mask = num_buckets_ - 1;
+    int64 bucket_index = key_hash & bit_mask;
+    int64 num_probes = 0;
+    while (true) {
+      if (IsEqualKey(key_buckets_matrix, bucket_index, key_matrix, index)) {
+        BeginWrite();
+        for (int64 j = 0; j < value_size; ++j) {
+          value_buckets_matrix.Store(bucket_index, j,
+                                     SubtleMustCopyIfIntegral(
+                                         value_matrix(index, j)));
+        }
+        EndWrite();
+        *inserted = false;
+        return Status::OK();
+      }
+      if (IsEqualKey(key_buckets_matrix, bucket_index, empty_key_tensor, 0) ||
+          IsEqualKey(key_buckets_matrix, bucket_index, deleted_key_tensor,
+                     0)) {
+        BeginWrite();
+        for (int64 j = 0; j < key_size; ++j) {
+          key_buckets_matrix.Store(
+              bucket_index, j, SubtleMustCopyIfIntegral(key_matrix(index, j)));
+        }
+        for (int64 j = 0; j < value_size; ++j) {
+          value_buckets_matrix.Store(bucket_index, j,
+                                     SubtleMustCopyIfIntegral(
+                                         value_matrix(index, j)));
+        }
+        EndWrite();
+        *inserted = true;
+        return Status::OK();
+      }
+      ++num_probes;
+      bucket_index =
+          (bucket_index + num_probes) & bit_mask;  // quadratic probing
+      if (num_probes >= num_buckets_) {
+        return errors::Internal(
+            "Internal error in MutableDenseHashTable insert");
+      }
+    }
+  }
+
+  // Marks the bucket holding row `index` of `key_matrix` in `buckets` as
+  // deleted. Sets `*removed` to whether the key was found.
+  Status RemoveRow(OpKernelContext* ctx, Buckets buckets,
+                   typename TTypes<K>::ConstMatrix key_matrix, int64 index,
+                   uint64 key_hash, bool* removed)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const int64 key_size = key_shape_.num_elements();
+    const BucketMatrix<K> key_buckets_matrix(
+        buckets.keys.template flat<K>().data(), key_size);
+    const auto empty_key_tensor =
+        empty_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
+    const auto deleted_key_flat =
+        deleted_key_.AccessTensor(ctx)->template flat<K>();
+    const int64 bucket_index =
+        FindBucket(key_buckets_matrix, buckets.num_buckets, empty_key_tensor,
+                   key_matrix, index, key_hash);
+    if (bucket_index == -2) {
+      return errors::Internal("Internal error in MutableDenseHashTable remove");
+    }
+    *removed = bucket_index >= 0;
+    if (*removed) {
+      BeginWrite();
+      for (int64 j = 0; j < key_size; ++j) {
+        key_buckets_matrix.Store(bucket_index, j,
+                                 SubtleMustCopyIfIntegral(deleted_key_flat(j)));
+      }
+      EndWrite();
+    }
+    return Status::OK();
+  }
+
+  Status DoInsert(OpKernelContext* ctx, const Tensor& key, const Tensor& value)
       TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
     const int64 num_elements = (key.dims() == 0) ? 1 : key.dim_size(0);
     const int64 value_size = value_shape_.num_elements();
@@ -595,63 +1160,37 @@ class MutableDenseHashTable final : public LookupInterface {
     const auto key_matrix = key.shaped<K, 2>({num_elements, key_size});
     auto value_matrix = value.shaped<V, 2>({num_elements, value_size});
 
-    auto key_buckets_matrix =
-        key_buckets_.AccessTensor(ctx)->template matrix<K>();
-    auto value_buckets_matrix =
-        value_buckets_.AccessTensor(ctx)->template matrix<V>();
     const auto empty_key_tensor =
         empty_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
     const auto deleted_key_tensor =
         deleted_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
-    const int64 bit_mask = num_buckets_ - 1;
+    const Buckets old = OldBuckets(ctx);
     for (int64 i = 0; i < num_elements; ++i) {
       const uint64 key_hash = HashKey(key_matrix, i);
       if (empty_key_hash_ == key_hash &&
           IsEqualKey(empty_key_tensor, 0, key_matrix, i)) {
-        if (ignore_empty_and_deleted_key) {
-          continue;
-        }
         return errors::InvalidArgument(
             "Using the empty_key as a table key is not allowed");
       }
       if (deleted_key_hash_ == key_hash &&
           IsEqualKey(deleted_key_tensor, 0, key_matrix, i)) {
-        if (ignore_empty_and_deleted_key) {
-          continue;
-        }
         return errors::InvalidArgument(
             "Using the deleted_key as a table key is not allowed");
       }
-      int64 bucket_index = key_hash & bit_mask;
-      int64 num_probes = 0;
-      while (true) {
-        if (IsEqualKey(key_buckets_matrix, bucket_index, key_matrix, i)) {
-          for (int64 j = 0; j < value_size; ++j) {
-            value_buckets_matrix(bucket_index, j) =
-                SubtleMustCopyIfIntegral(value_matrix(i, j));
-          }
-          break;
-        }
-        if (IsEqualKey(key_buckets_matrix, bucket_index, empty_key_tensor, 0) ||
-            IsEqualKey(key_buckets_matrix, bucket_index, deleted_key_tensor,
-                       0)) {
-          ++num_entries_;
-          for (int64 j = 0; j < key_size; ++j) {
-            key_buckets_matrix(bucket_index, j) =
-                SubtleMustCopyIfIntegral(key_matrix(i, j));
-          }
-          for (int64 j = 0; j < value_size; ++j) {
-            value_buckets_matrix(bucket_index, j) =
-                SubtleMustCopyIfIntegral(value_matrix(i, j));
+      bool inserted;
+      TF_RETURN_IF_ERROR(
+          InsertRow(ctx, key_matrix, value_matrix, i, key_hash, &inserted));
+      if (inserted) {
+        ++num_entries_;
+        // A key that has not been migrated yet now lives in the current
+        // buckets, so its stale copy must not be migrated later on.
+        if (old.num_buckets > 0) {
+          bool removed;
+          TF_RETURN_IF_ERROR(
+              RemoveRow(ctx, old, key_matrix, i, key_hash, &removed));
+          if (removed) {
+            --num_entries_;
           }
-          break;
-        }
-        ++num_probes;
-        bucket_index =
-            (bucket_index + num_probes) & bit_mask;  // quadratic probing
-        if (num_probes >= num_buckets_) {
-          return errors::Internal(
-              "Internal error in MutableDenseHashTable insert");
         }
       }
     }
@@ -664,15 +1203,12 @@ class MutableDenseHashTable final : public LookupInterface {
     const int64 key_size = key_shape_.num_elements();
     const auto key_matrix = key.shaped<K, 2>({num_elements, key_size});
 
-    auto key_buckets_matrix =
-        key_buckets_.AccessTensor(ctx)->template matrix<K>();
     const auto empty_key_tensor =
         empty_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
     const auto deleted_key_tensor =
         deleted_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
-    const auto deleted_key_flat =
-        deleted_key_.AccessTensor(ctx)->template flat<K>();
-    const int64 bit_mask = num_buckets_ - 1;
+    const Buckets current = CurrentBuckets(ctx);
+    const Buckets old = OldBuckets(ctx);
     for (int64 i = 0; i < num_elements; ++i) {
       const uint64 key_hash = HashKey(key_matrix, i);
       if (empty_key_hash_ == key_hash &&
@@ -685,27 +1221,18 @@ class MutableDenseHashTable final : public LookupInterface {
         return errors::InvalidArgument(
             "Using the deleted_key as a table key is not allowed");
       }
-      int64 bucket_index = key_hash & bit_mask;
-      int64 num_probes = 0;
-      while (true) {
-        if (IsEqualKey(key_buckets_matrix, bucket_index, key_matrix, i)) {
-          --num_entries_;
-          for (int64 j = 0; j < key_size; ++j) {
-            key_buckets_matrix(bucket_index, j) =
-                SubtleMustCopyIfIntegral(deleted_key_flat(j));
-          }
-          break;
-        }
-        if (IsEqualKey(key_buckets_matrix, bucket_index, empty_key_tensor, 0)) {
-          break;
-        }
-        ++num_probes;
-        bucket_index =
-            (bucket_index + num_probes) & bit_mask;  // quadratic probing
-        if (num_probes >= num_buckets_) {
-          return errors::Internal(
-              "Internal error in MutableDenseHashTable remove");
-        }
+      // During a migration a key may be in the old buckets, the current ones,
+      // or both (once migrated); it counts as a single entry either way.
+      bool removed_current;
+      TF_RETURN_IF_ERROR(
+          RemoveRow(ctx, current, key_matrix, i, key_hash, &removed_current));
+      bool removed_old = false;
+      if (old.num_buckets > 0) {
+        TF_RETURN_IF_ERROR(
+            RemoveRow(ctx, old, key_matrix, i, key_hash, &removed_old));
+      }
+      if (removed_current || removed_old) {
+        --num_entries_;
       }
     }
     return Status::OK();
@@ -713,24 +1240,32 @@ class MutableDenseHashTable final : public LookupInterface {
 
   Status AllocateBuckets(OpKernelContext* ctx, int64 new_num_buckets)
       TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-    if (new_num_buckets < 4 ||
-        ((new_num_buckets & (new_num_buckets - 1)) != 0)) {
+    TF_RETURN_IF_ERROR(AllocateEmptyBuckets(ctx, new_num_buckets,
+                                            &key_buckets_, &value_buckets_));
+    num_buckets_ = new_num_buckets;
+    return Status::OK();
+  }
+
+  // Allocates `num_buckets` buckets that all hold the empty key. Only reads
+  // state that is fixed at construction, so callers need not hold mu_.
+  Status AllocateEmptyBuckets(OpKernelContext* ctx, int64 num_buckets,
+                              PersistentTensor* key_buckets,
+                              PersistentTensor* value_buckets) {
+    if (num_buckets < 4 || ((num_buckets & (num_buckets - 1)) != 0)) {
       return errors::InvalidArgument(
           "Number of buckets must be at least 4 and a power of 2, got: ",
-          new_num_buckets);
+          num_buckets);
     }
-    num_buckets_ = new_num_buckets;
-    num_entries_ = 0;
 
     const int64 key_size = key_shape_.num_elements();
     Tensor* key_buckets_tensor;
     TF_RETURN_IF_ERROR(ctx->allocate_persistent(
-        key_dtype(), TensorShape({num_buckets_, key_size}), &key_buckets_,
+        key_dtype(), TensorShape({num_buckets, key_size}), key_buckets,
         &key_buckets_tensor));
     auto key_buckets_matrix = key_buckets_tensor->matrix<K>();
     const auto empty_key_flat =
         empty_key_.AccessTensor(ctx)->template flat<K>();
-    for (int64 i = 0; i < num_buckets_; ++i) {
+    for (int64 i = 0; i < num_buckets; ++i) {
       for (int64 j = 0; j < key_size; ++j) {
         key_buckets_matrix(i, j) = empty_key_flat(j);
       }
@@ -739,10 +1274,10 @@ class MutableDenseHashTable final : public LookupInterface {
     const int64 value_size = value_shape_.num_elements();
     Tensor* value_buckets_tensor;
     TF_RETURN_IF_ERROR(ctx->allocate_persistent(
-        value_dtype(), TensorShape({num_buckets_, value_size}), &value_buckets_,
+        value_dtype(), TensorShape({num_buckets, value_size}), value_buckets,
         &value_buckets_tensor));
     auto value_buckets_matrix = value_buckets_tensor->matrix<V>();
-    for (int64 i = 0; i < num_buckets_; ++i) {
+    for (int64 i = 0; i < num_buckets; ++i) {
       for (int64 j = 0; j < value_size; ++j) {
         // Initialize values to the default value for the type to avoid
         // exposing uninitialized memory in ExportValues().
@@ -752,12 +1287,62 @@ class MutableDenseHashTable final : public LookupInterface {
     return Status::OK();
   }
 
-  Status Rebucket(OpKernelContext* ctx, int64 num_new_buckets)
+  // Swaps in `num_new_buckets` empty buckets, allocated by
+  // AllocateEmptyBuckets, and starts migrating the current ones into them. Any
+  // migration still in progress is completed first.
+  Status StartRehash(OpKernelContext* ctx, int64 num_new_buckets,
+                     PersistentTensor new_key_buckets,
+                     PersistentTensor new_value_buckets)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    TF_RETURN_IF_ERROR(AdvanceRehash(ctx, old_num_buckets_));
+    old_key_buckets_ = std::move(key_buckets_);
+    old_value_buckets_ = std::move(value_buckets_);
+    old_num_buckets_ = num_buckets_;
+    rehash_cursor_ = 0;
+    key_buckets_ = std::move(new_key_buckets);
+    value_buckets_ = std::move(new_value_buckets);
+    num_buckets_ = num_new_buckets;
+    PublishSnapshot(ctx);
+    return Status::OK();
+  }
+
+  // Migrates up to `max_buckets` old buckets into the current ones, releasing
+  // the old buckets once all of them have been migrated.
+  Status AdvanceRehash(OpKernelContext* ctx, int64 max_buckets)
       TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-    Tensor old_key_buckets = *key_buckets_.AccessTensor(ctx);
-    Tensor old_value_buckets = *value_buckets_.AccessTensor(ctx);
-    TF_RETURN_IF_ERROR(AllocateBuckets(ctx, num_new_buckets));
-    return DoInsert(ctx, old_key_buckets, old_value_buckets, true);
+    if (old_num_buckets_ == 0) {
+      return Status::OK();
+    }
+    const int64 key_size = key_shape_.num_elements();
+    const Buckets old = OldBuckets(ctx);
+    const auto old_key_matrix = old.keys.template matrix<K>();
+    const auto old_value_matrix = old.values.template matrix<V>();
+    const auto empty_key_tensor =
+        empty_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
+    const auto deleted_key_tensor =
+        deleted_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
+    const int64 end = std::min(old_num_buckets_, rehash_cursor_ + max_buckets);
+    for (; rehash_cursor_ < end; ++rehash_cursor_) {
+      if (IsEqualKey(empty_key_tensor, 0, old_key_matrix, rehash_cursor_) ||
+          IsEqualKey(deleted_key_tensor, 0, old_key_matrix, rehash_cursor_)) {
+        continue;
+      }
+      // Keys in the old buckets are never in the current ones before being
+      // migrated (see DoInsert), so this always takes a new bucket.
+      bool inserted;
+      TF_RETURN_IF_ERROR(InsertRow(ctx, old_key_matrix, old_value_matrix,
+                                   rehash_cursor_,
+                                   HashKey(old_key_matrix, rehash_cursor_),
+                                   &inserted));
+    }
+    if (rehash_cursor_ == old_num_buckets_) {
+      old_num_buckets_ = 0;
+      rehash_cursor_ = 0;
+      old_key_buckets_ = PersistentTensor();
+      old_value_buckets_ = PersistentTensor();
+      PublishSnapshot(ctx);
+    }
+    return Status::OK();
   }
 
   uint64 HashKey(typename TTypes<K>::ConstMatrix key, int64 index) const {
@@ -773,9 +1358,8 @@ class MutableDenseHashTable final : public LookupInterface {
 
   // Use a template to allow this function to be used both with Matrix and
   // ConstMatrix types.
-  template <typename MT2>
-  bool IsEqualKey(typename TTypes<K>::Matrix tensor1, int64 index1, MT2 tensor2,
-                  int64 index2) const {
+  template <typename MT1, typename MT2>
+  bool IsEqualKey(MT1 tensor1, int64 index1, MT2 tensor2, int64 index2) const {
     for (int64 i = 0; i < key_shape_.num_elements(); ++i) {
       if (tensor1(index1, i) != tensor2(index2, i)) {
         return false;
@@ -792,10 +1376,33 @@ class MutableDenseHashTable final : public LookupInterface {
   int64 num_buckets_ TF_GUARDED_BY(mu_);
   PersistentTensor key_buckets_ TF_GUARDED_BY(mu_);
   PersistentTensor value_buckets_ TF_GUARDED_BY(mu_);
+  // Buckets being migrated into key_buckets_ and value_buckets_. Old buckets
+  // below rehash_cursor_ have been migrated already. old_num_buckets_ is 0
+  // when no migration is in progress.
+  int64 old_num_buckets_ TF_GUARDED_BY(mu_) = 0;
+  int64 rehash_cursor_ TF_GUARDED_BY(mu_) = 0;
+  PersistentTensor old_key_buckets_ TF_GUARDED_BY(mu_);
+  PersistentTensor old_value_buckets_ TF_GUARDED_BY(mu_);
   PersistentTensor empty_key_;
   uint64 empty_key_hash_;
   PersistentTensor deleted_key_;
   uint64 deleted_key_hash_;
+  // A replaced snapshot and the epoch it was replaced in.
+  struct RetiredSnapshot {
+    std::unique_ptr<const Snapshot> snapshot;
+    int64 epoch;
+  };
+
+  // State for the optimistic read path. seq_ is odd while a writer mutates
+  // bucket contents. snapshot_ points to published_snapshot_; the snapshots
+  // it pointed to before are kept in retired_snapshots_, oldest first, until
+  // the readers registered in epoch_readers_ for their epoch are gone.
+  std::atomic<int64> seq_{0};
+  std::atomic<const Snapshot*> snapshot_{nullptr};
+  std::atomic<int64> epoch_{0};
+  std::atomic<int64> epoch_readers_[2] = {{0}, {0}};
+  std::unique_ptr<const Snapshot> published_snapshot_ TF_GUARDED_BY(mu_);
+  std::vector<RetiredSnapshot> retired_snapshots_ TF_GUARDED_BY(mu_);
 };
 
 }  // namespace lookup
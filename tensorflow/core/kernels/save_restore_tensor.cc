@@ -30,6 +30,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 #include "tensorflow/core/util/tensor_slice_reader.h"
 #include "tensorflow/core/util/tensor_slice_reader_cache.h"
@@ -257,7 +258,7 @@ struct RestoreOp {
 
   // Run this restore operation using a new BundleReader.
   void run_with_new_reader() {
-    BundleReader reader(Env::Default(), reader_prefix);
+    BundleReader reader(Env::Default(), reader_prefix, reader_options);
     if (!reader.status().ok()) {
       status = reader.status();
       return;
@@ -274,7 +275,14 @@ struct RestoreOp {
     VLOG(1) << "Restoring tensor " << idx << " : " << tensor_name << " : "
             << restored_full_shape.num_elements();
     Tensor* restored_tensor;
-    if (shape_and_slice.empty()) {
+    if (shape_and_slice.empty() && reader_options.use_mmap) {
+      // Lookup the full tensor, letting the reader alias the mapped data file
+      // rather than filling a freshly allocated output.
+      Tensor restored;
+      TF_RETURN_IF_ERROR(reader->Lookup(tensor_name, &restored));
+      context->set_output(idx, restored);
+      restored_tensor = context->mutable_output(idx);
+    } else if (shape_and_slice.empty()) {
       // Lookup the full tensor.
       TF_RETURN_IF_ERROR(
           context->allocate_output(idx, restored_full_shape, &restored_tensor));
@@ -327,6 +335,7 @@ struct RestoreOp {
   string tensor_name;
   string shape_and_slice;
   string reader_prefix;
+  BundleReader::Options reader_options;
 
   ::tensorflow::Status status;
 };
@@ -351,9 +360,14 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
             });
 
   std::vector<std::unique_ptr<RestoreOp> > pool_restore_ops;
+  std::vector<std::unique_ptr<RestoreOp> > pool_lookup_ops;
   std::vector<std::unique_ptr<RestoreOp> > direct_restore_ops;
 
-  BundleReader default_reader(Env::Default(), prefix_string);
+  BundleReader::Options reader_options;
+  TF_RETURN_IF_ERROR(ReadBoolFromEnvVar("TF_CHECKPOINT_RESTORE_USE_MMAP",
+                                        /*default_val=*/false,
+                                        &reader_options.use_mmap));
+  BundleReader default_reader(Env::Default(), prefix_string, reader_options);
   TF_RETURN_IF_ERROR(default_reader.status());
 
   std::vector<string> mismatched_errors;
@@ -379,10 +393,17 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
   for (auto i : sorted_name_idx) {
     const string& tensor_name = tensor_names_flat(i);
     const string& shape_and_slice = shape_and_slices_flat(i);
-    auto op =
-        new RestoreOp{context, i, tensor_name, shape_and_slice, prefix_string};
+    auto op = new RestoreOp{context,       i,
+                            tensor_name,   shape_and_slice,
+                            prefix_string, reader_options};
     if (op->should_run_in_pool(&default_reader)) {
-      pool_restore_ops.emplace_back(op);
+      // Large full tensors are all read concurrently through the default
+      // reader; slices need a reader of their own.
+      if (shape_and_slice.empty()) {
+        pool_lookup_ops.emplace_back(op);
+      } else {
+        pool_restore_ops.emplace_back(op);
+      }
     } else {
       direct_restore_ops.emplace_back(op);
     }
@@ -392,7 +413,7 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
     // Schedule any threaded operations first, skipping thread pool creation if
     // we don't have any expensive operations.
     std::unique_ptr<thread::ThreadPool> reader_pool;
-    if (!pool_restore_ops.empty()) {
+    if (!pool_restore_ops.empty() || !pool_lookup_ops.empty()) {
       reader_pool.reset(
           new thread::ThreadPool(Env::Default(), "restore_tensors", 8));
       for (auto& op : pool_restore_ops) {
@@ -400,6 +421,35 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
       }
     }
 
+    if (!pool_lookup_ops.empty()) {
+      std::vector<tstring> keys;
+      std::vector<Tensor> restored(pool_lookup_ops.size());
+      std::vector<Tensor*> vals;
+      for (size_t k = 0; k < pool_lookup_ops.size(); ++k) {
+        const RestoreOp& op = *pool_lookup_ops[k];
+        keys.emplace_back(op.tensor_name);
+        if (reader_options.use_mmap) {
+          // Let the reader alias the mapped data files.
+          vals.push_back(&restored[k]);
+        } else {
+          TensorShape restored_full_shape;
+          TF_RETURN_IF_ERROR(default_reader.LookupTensorShape(
+              op.tensor_name, &restored_full_shape));
+          Tensor* restored_tensor;
+          TF_RETURN_IF_ERROR(context->allocate_output(
+              op.idx, restored_full_shape, &restored_tensor));
+          vals.push_back(restored_tensor);
+        }
+      }
+      TF_RETURN_IF_ERROR(
+          default_reader.LookupMany(keys, vals, reader_pool.get()));
+      if (reader_options.use_mmap) {
+        for (size_t k = 0; k < pool_lookup_ops.size(); ++k) {
+          context->set_output(pool_lookup_ops[k]->idx, restored[k]);
+        }
+      }
+    }
+
     // Read small tensors from the op thread
     for (auto& op : direct_restore_ops) {
       TF_RETURN_IF_ERROR(op->run(&default_reader));
@@ -29,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/saved_tensor_slice_util.h"
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 #include "tensorflow/core/util/tensor_slice_reader.h"
@@ -90,7 +91,12 @@ void ValidateInputs(bool is_save_op, OpKernelContext* context,
 // Saves a list of named tensors using the tensor bundle library.
 class SaveV2 : public OpKernel {
  public:
-  explicit SaveV2(OpKernelConstruction* context) : OpKernel(context) {}
+  explicit SaveV2(OpKernelConstruction* context) : OpKernel(context) {
+    // When set, tensors are spread over this many data files and checksummed
+    // and written concurrently on the intra-op thread pool.
+    OP_REQUIRES_OK(context, ReadInt64FromEnvVar("TF_CHECKPOINT_SAVE_NUM_SHARDS",
+                                                0, &parallel_num_shards_));
+  }
 
   void Compute(OpKernelContext* context) override {
     const Tensor& prefix = context->input(0);
@@ -105,7 +111,13 @@ class SaveV2 : public OpKernel {
     const auto& tensor_names_flat = tensor_names.flat<tstring>();
     const auto& shape_and_slices_flat = shape_and_slices.flat<tstring>();
 
-    BundleWriter writer(Env::Default(), prefix_string);
+    BundleWriter::Options writer_options;
+    if (parallel_num_shards_ > 0) {
+      writer_options.num_shards = parallel_num_shards_;
+      writer_options.pool =
+          context->device()->tensorflow_cpu_worker_threads()->workers;
+    }
+    BundleWriter writer(Env::Default(), prefix_string, writer_options);
     OP_REQUIRES_OK(context, writer.status());
     VLOG(1) << "BundleWriter, prefix_string: " << prefix_string;
 
@@ -157,6 +169,9 @@ class SaveV2 : public OpKernel {
     OP_REQUIRES_OK(context, writer.Finish());
     VLOG(1) << "Done BundleWriter, prefix_string: " << prefix_string;
   }
+
+ private:
+  int64 parallel_num_shards_;
 };
 REGISTER_KERNEL_BUILDER(Name("SaveV2").Device(DEVICE_CPU), SaveV2);
 
@@ -0,0 +1,129 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/lib/io/record_index.h"
+
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/strcat.h"
+
+namespace tensorflow {
+namespace io {
+namespace {
+
+constexpr uint64 kRecordIndexMagic = 0x5845444e49524654;  // "TFRINDEX"
+// The directory, next to the indexed files, that holds their indexes.
+constexpr char kRecordIndexDirectory[] = ".tfrecord_index";
+constexpr size_t kHeaderSize = 2 * sizeof(uint64);
+
+// The buffer size used to scan files that are indexed.
+constexpr int64 kScanBufferSize = 256 << 10;  // 256KB.
+
+}  // namespace
+
+string RecordIndexFilename(const string& filename) {
+  return JoinPath(Dirname(filename), kRecordIndexDirectory,
+                  Basename(filename));
+}
+
+Status WriteRecordIndex(Env* env, const string& index_filename,
+                        const std::vector<uint64>& offsets) {
+  if (offsets.empty()) {
+    return errors::InvalidArgument(
+        "A record index must end with the size of the file.");
+  }
+  string contents;
+  contents.reserve(kHeaderSize + offsets.size() * sizeof(uint64) +
+                   sizeof(uint32));
+  core::PutFixed64(&contents, kRecordIndexMagic);
+  core::PutFixed64(&contents, offsets.size() - 1);
+  for (uint64 offset : offsets) {
+    core::PutFixed64(&contents, offset);
+  }
+  core::PutFixed32(
+      &contents, crc32c::Mask(crc32c::Value(contents.data(), contents.size())));
+  TF_RETURN_IF_ERROR(
+      env->RecursivelyCreateDir(string(Dirname(index_filename))));
+  // Writes to a temporary file first, so that readers never see a partial
+  // index.
+  const string temp_filename = strings::StrCat(index_filename, ".tmp");
+  TF_RETURN_IF_ERROR(WriteStringToFile(env, temp_filename, contents));
+  return env->RenameFile(temp_filename, index_filename);
+}
+
+Status ReadRecordIndex(Env* env, const string& index_filename,
+                       std::vector<uint64>* offsets) {
+  string contents;
+  TF_RETURN_IF_ERROR(ReadFileToString(env, index_filename, &contents));
+  if (contents.size() < kHeaderSize + sizeof(uint64) + sizeof(uint32) ||
+      core::DecodeFixed64(contents.data()) != kRecordIndexMagic) {
+    return errors::DataLoss(index_filename, " is not a record index.");
+  }
+  const uint64 num_records = core::DecodeFixed64(contents.data() + 8);
+  const size_t crc_offset = contents.size() - sizeof(uint32);
+  if ((crc_offset - kHeaderSize) / sizeof(uint64) != num_records + 1 ||
+      (crc_offset - kHeaderSize) % sizeof(uint64) != 0) {
+    return errors::DataLoss("Truncated record index ", index_filename);
+  }
+  if (crc32c::Unmask(core::DecodeFixed32(contents.data() + crc_offset)) !=
+      crc32c::Value(contents.data(), crc_offset)) {
+    return errors::DataLoss("Corrupted record index ", index_filename);
+  }
+  offsets->resize(num_records + 1);
+  for (uint64 i = 0; i <= num_records; ++i) {
+    (*offsets)[i] =
+        core::DecodeFixed64(contents.data() + kHeaderSize + i * sizeof(uint64));
+  }
+  return Status::OK();
+}
+
+Status LoadRecordIndex(Env* env, const string& filename,
+                       std::vector<uint64>* offsets) {
+  const string index_filename = RecordIndexFilename(filename);
+  TF_RETURN_IF_ERROR(env->FileExists(index_filename));
+  TF_RETURN_IF_ERROR(ReadRecordIndex(env, index_filename, offsets));
+  uint64 file_size;
+  TF_RETURN_IF_ERROR(env->GetFileSize(filename, &file_size));
+  if (file_size != offsets->back()) {
+    return errors::FailedPrecondition(
+        "The index of ", filename, " is for a file of ", offsets->back(),
+        " bytes, but the file has ", file_size, " bytes.");
+  }
+  return Status::OK();
+}
+
+Status BuildRecordIndex(Env* env, const string& filename) {
+  std::unique_ptr<RandomAccessFile> file;
+  TF_RETURN_IF_ERROR(env->NewRandomAccessFile(filename, &file));
+  RecordReaderOptions options;
+  options.buffer_size = kScanBufferSize;
+  RecordReader reader(file.get(), options);
+  std::vector<uint64> offsets;
+  uint64 offset = 0;
+  while (true) {
+    offsets.push_back(offset);
+    int num_skipped;
+    Status s = reader.SkipRecords(&offset, 1, &num_skipped);
+    if (errors::IsOutOfRange(s)) break;
+    TF_RETURN_IF_ERROR(s);
+  }
+  // A file that does not end at a record boundary fails `LoadRecordIndex()`.
+  return WriteRecordIndex(env, RecordIndexFilename(filename), offsets);
+}
+
+}  // namespace io
+}  // namespace tensorflow
@@ -0,0 +1,63 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_LIB_IO_RECORD_INDEX_H_
+#define TENSORFLOW_CORE_LIB_IO_RECORD_INDEX_H_
+
+#include <vector>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace io {
+
+// A record index is a sidecar file of an uncompressed TFRecord file that holds
+// the offset of each of its records, so that readers can seek to any record
+// without reading the ones before it. Its format is:
+//
+//  uint64    magic
+//  uint64    number of records n
+//  uint64    offsets[n + 1]: the offset of each record, then the file size
+//  uint32    masked crc of all the preceding bytes
+
+// Returns the name of the index of the TFRecord file `filename`. Indexes are
+// kept in a ".tfrecord_index" directory next to the files they index, so that
+// patterns that match the files, such as "train-*", never match the indexes.
+string RecordIndexFilename(const string& filename);
+
+// Writes the index `offsets`, which holds the offset of each record followed
+// by the size of the file, to `index_filename`, creating its directory if
+// needed.
+Status WriteRecordIndex(Env* env, const string& index_filename,
+                        const std::vector<uint64>& offsets);
+
+// Reads the index `index_filename` into `*offsets`.
+Status ReadRecordIndex(Env* env, const string& index_filename,
+                       std::vector<uint64>* offsets);
+
+// Reads the index of the TFRecord file `filename` into `*offsets`. Returns
+// NOT_FOUND if the file has no index, and FAILED_PRECONDITION if the file has
+// changed since it was indexed.
+Status LoadRecordIndex(Env* env, const string& filename,
+                       std::vector<uint64>* offsets);
+
+// Scans the uncompressed TFRecord file `filename` and writes its index.
+Status BuildRecordIndex(Env* env, const string& filename);
+
+}  // namespace io
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_LIB_IO_RECORD_INDEX_H_
@@ -0,0 +1,105 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/lib/io/record_index.h"
+
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/strcat.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace io {
+namespace {
+
+// Writes `num_records` records of increasing size to `filename`.
+void WriteRecords(const string& filename, int num_records) {
+  std::unique_ptr<WritableFile> file;
+  TF_ASSERT_OK(Env::Default()->NewWritableFile(filename, &file));
+  RecordWriter writer(file.get());
+  for (int i = 0; i < num_records; ++i) {
+    TF_ASSERT_OK(writer.WriteRecord(string(i, 'a' + i % 26)));
+  }
+  TF_ASSERT_OK(writer.Close());
+  TF_ASSERT_OK(file->Close());
+}
+
+TEST(RecordIndexTest, BuildAndLoad) {
+  const string filename = JoinPath(testing::TmpDir(), "build_and_load");
+  WriteRecords(filename, 100);
+  TF_ASSERT_OK(BuildRecordIndex(Env::Default(), filename));
+
+  std::vector<uint64> offsets;
+  TF_ASSERT_OK(LoadRecordIndex(Env::Default(), filename, &offsets));
+  ASSERT_EQ(offsets.size(), 101);
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(Env::Default()->NewRandomAccessFile(filename, &file));
+  RecordReader reader(file.get());
+  for (int i : {57, 0, 99, 3}) {
+    uint64 offset = offsets[i];
+    tstring record;
+    TF_ASSERT_OK(reader.ReadRecord(&offset, &record));
+    EXPECT_EQ(record, string(i, 'a' + i % 26));
+    EXPECT_EQ(offset, offsets[i + 1]);
+  }
+}
+
+TEST(RecordIndexTest, EmptyFile) {
+  const string filename = JoinPath(testing::TmpDir(), "empty");
+  WriteRecords(filename, 0);
+  TF_ASSERT_OK(BuildRecordIndex(Env::Default(), filename));
+  std::vector<uint64> offsets;
+  TF_ASSERT_OK(LoadRecordIndex(Env::Default(), filename, &offsets));
+  EXPECT_EQ(offsets, std::vector<uint64>({0}));
+}
+
+TEST(RecordIndexTest, MissingIndex) {
+  const string filename = JoinPath(testing::TmpDir(), "missing");
+  WriteRecords(filename, 10);
+  std::vector<uint64> offsets;
+  EXPECT_EQ(LoadRecordIndex(Env::Default(), filename, &offsets).code(),
+            error::NOT_FOUND);
+}
+
+TEST(RecordIndexTest, StaleIndex) {
+  const string filename = JoinPath(testing::TmpDir(), "stale");
+  WriteRecords(filename, 10);
+  TF_ASSERT_OK(BuildRecordIndex(Env::Default(), filename));
+  WriteRecords(filename, 20);
+  std::vector<uint64> offsets;
+  EXPECT_EQ(LoadRecordIndex(Env::Default(), filename, &offsets).code(),
+            error::FAILED_PRECONDITION);
+}
+
+TEST(RecordIndexTest, CorruptedIndex) {
+  const string filename = JoinPath(testing::TmpDir(), "corrupted");
+  WriteRecords(filename, 10);
+  TF_ASSERT_OK(BuildRecordIndex(Env::Default(), filename));
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), RecordIndexFilename(filename),
+                                &contents));
+  contents[20] ^= 1;
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), RecordIndexFilename(filename),
+                                 contents));
+  std::vector<uint64> offsets;
+  EXPECT_EQ(LoadRecordIndex(Env::Default(), filename, &offsets).code(),
+            error::DATA_LOSS);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace tensorflow
@@ -17,6 +17,10 @@ limitations under the License.
 
 #include <limits.h>
 
+#include <algorithm>
+#include <deque>
+#include <vector>
+
 #include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/hash/crc32c.h"
@@ -24,9 +28,191 @@ limitations under the License.
 #include "tensorflow/core/lib/io/compression.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/threadpool.h"
 
 namespace tensorflow {
 namespace io {
+namespace {
+
+// Number of threads shared by all readers to verify prefetched records.
+constexpr int kNumVerifyThreads = 4;
+
+// Number of batches that the prefetched bytes are split into; each batch is
+// verified by one task.
+constexpr int64 kNumPrefetchBatches = 8;
+
+thread::ThreadPool* VerifyThreadPool() {
+  static thread::ThreadPool* pool = new thread::ThreadPool(
+      Env::Default(), "record_verify", kNumVerifyThreads);
+  return pool;
+}
+
+}  // namespace
+
+// Reads records ahead of the caller on a background thread, in batches whose
+// data checksums are verified on `VerifyThreadPool()`.
+class RecordReader::Prefetcher {
+ public:
+  // Starts reading the records of `reader` at `offset`, where its input
+  // stream must be positioned.
+  Prefetcher(RecordReader* reader, uint64 offset, int64 prefetch_bytes)
+      : reader_(reader),
+        batch_bytes_(std::max<int64>(prefetch_bytes / kNumPrefetchBatches, 1)),
+        prefetch_bytes_(prefetch_bytes),
+        next_offset_(offset) {
+    thread_.reset(Env::Default()->StartThread(
+        {}, "record_prefetch", [this, offset]() { Run(offset); }));
+  }
+
+  ~Prefetcher() {
+    {
+      mutex_lock l(mu_);
+      cancelled_ = true;
+      cond_var_.notify_all();
+    }
+    thread_.reset();
+    mutex_lock l(mu_);
+    while (num_batches_verifying_ > 0) {
+      cond_var_.wait(l);
+    }
+  }
+
+  // The offset of the record that the next call to `ReadRecord()` returns.
+  uint64 next_offset() const { return next_offset_; }
+
+  // Reads the record at `next_offset()` and advances `*offset` past it. Once
+  // an error is returned, all further calls return it.
+  Status ReadRecord(uint64* offset, tstring* record) {
+    DCHECK_EQ(*offset, next_offset_);
+    mutex_lock l(mu_);
+    while (true) {
+      while (batches_.empty()) {
+        cond_var_.wait(l);
+      }
+      const std::shared_ptr<Batch> batch = batches_.front();
+      while (!batch->verified) {
+        cond_var_.wait(l);
+      }
+      if (next_record_ < batch->records.size()) {
+        Record& next = batch->records[next_record_++];
+        *record = std::move(next.data);
+        *offset += kHeaderSize + record->size() + kFooterSize;
+        next_offset_ = *offset;
+        return Status::OK();
+      }
+      if (!batch->status.ok()) {
+        return batch->status;
+      }
+      buffered_bytes_ -= batch->bytes;
+      batches_.pop_front();
+      next_record_ = 0;
+      cond_var_.notify_all();
+    }
+  }
+
+ private:
+  struct Record {
+    uint64 offset;
+    // The data of the record followed by its masked checksum, until verified.
+    tstring data;
+  };
+
+  struct Batch {
+    std::vector<Record> records;
+    // The status of reading past the last record, which is not OK only for
+    // the last batch.
+    Status status;
+    int64 bytes = 0;
+    bool verified = false;
+  };
+
+  // Reads batches of records starting at `offset` until an error, the end of
+  // the input, or cancellation.
+  void Run(uint64 offset) {
+    while (true) {
+      auto batch = std::make_shared<Batch>();
+      Status s;
+      while (batch->bytes < batch_bytes_) {
+        tstring header;
+        s = reader_->ReadChecksummed(offset, sizeof(uint64), &header);
+        if (!s.ok()) break;
+        const uint64 length = core::DecodeFixed64(header.data());
+        if (length >= SIZE_MAX - kFooterSize) {
+          s = errors::DataLoss("record size too large");
+          break;
+        }
+        Record record;
+        record.offset = offset;
+        s = reader_->input_stream_->ReadNBytes(length + kFooterSize,
+                                               &record.data);
+        if (s.ok() && record.data.size() != length + kFooterSize) {
+          s = errors::OutOfRange("eof");
+        }
+        if (!s.ok()) {
+          if (errors::IsOutOfRange(s)) {
+            s = errors::DataLoss("truncated record at ", offset,
+                                 "' failed with ", s.error_message());
+          }
+          break;
+        }
+        batch->records.push_back(std::move(record));
+        batch->bytes += kHeaderSize + length + kFooterSize;
+        offset += kHeaderSize + length + kFooterSize;
+      }
+      batch->status = s;
+
+      mutex_lock l(mu_);
+      ++num_batches_verifying_;
+      VerifyThreadPool()->Schedule([this, batch]() { Verify(batch.get()); });
+      batches_.push_back(batch);
+      buffered_bytes_ += batch->bytes;
+      cond_var_.notify_all();
+      if (!s.ok()) return;
+      while (!cancelled_ && buffered_bytes_ >= prefetch_bytes_) {
+        cond_var_.wait(l);
+      }
+      if (cancelled_) return;
+    }
+  }
+
+  // Verifies the data checksums of the records of `batch`, dropping the
+  // records from the first corrupted one on.
+  void Verify(Batch* batch) {
+    for (size_t i = 0; i < batch->records.size(); ++i) {
+      Record& record = batch->records[i];
+      const size_t n = record.data.size() - kFooterSize;
+      const uint32 masked_crc = core::DecodeFixed32(record.data.data() + n);
+      if (crc32c::Unmask(masked_crc) != crc32c::Value(record.data.data(), n)) {
+        batch->status = errors::DataLoss("corrupted record at ",
+                                         record.offset + kHeaderSize);
+        batch->records.resize(i);
+        break;
+      }
+      record.data.resize(n);
+    }
+    mutex_lock l(mu_);
+    batch->verified = true;
+    --num_batches_verifying_;
+    cond_var_.notify_all();
+  }
+
+  RecordReader* const reader_;
+  const int64 batch_bytes_;
+  const int64 prefetch_bytes_;
+  // Only accessed by the caller of `ReadRecord()`.
+  uint64 next_offset_;
+  size_t next_record_ = 0;
+
+  mutex mu_;
+  condition_variable cond_var_;
+  std::deque<std::shared_ptr<Batch>> batches_ TF_GUARDED_BY(mu_);
+  int64 buffered_bytes_ TF_GUARDED_BY(mu_) = 0;
+  int64 num_batches_verifying_ TF_GUARDED_BY(mu_) = 0;
+  bool cancelled_ TF_GUARDED_BY(mu_) = false;
+  std::unique_ptr<Thread> thread_;
+};
 
 RecordReaderOptions RecordReaderOptions::CreateRecordReaderOptions(
     const string& compression_type) {
@@ -85,6 +271,8 @@ RecordReader::RecordReader(RandomAccessFile* file,
 #endif
 }
 
+RecordReader::~RecordReader() = default;
+
 // Read n+4 bytes from file, verify that checksum of first n bytes is
 // stored in the last 4 bytes and store the first n bytes in *result.
 //
@@ -122,6 +310,7 @@ Status RecordReader::GetMetadata(Metadata* md) {
 
   // Compute the metadata of the TFRecord file if not cached.
   if (!cached_metadata_) {
+    prefetcher_.reset();
     TF_RETURN_IF_ERROR(input_stream_->Reset());
 
     int64 data_size = 0;
@@ -183,6 +372,25 @@ Status RecordReader::PositionInputStream(uint64 offset) {
 }
 
 Status RecordReader::ReadRecord(uint64* offset, tstring* record) {
+  if (options_.prefetch_bytes > 0) {
+    if (prefetcher_ && prefetcher_->next_offset() != *offset) {
+      prefetcher_.reset();
+    }
+    if (!prefetcher_) {
+      TF_RETURN_IF_ERROR(PositionInputStream(*offset));
+      prefetcher_.reset(
+          new Prefetcher(this, *offset, options_.prefetch_bytes));
+    }
+    Status s = prefetcher_->ReadRecord(offset, record);
+    if (!s.ok()) {
+      // Restarts from the stream's start on the next read, as retrying the
+      // failed read must not lose records.
+      prefetcher_.reset();
+      last_read_failed_ = true;
+    }
+    return s;
+  }
+
   TF_RETURN_IF_ERROR(PositionInputStream(*offset));
 
   // Read header data.
@@ -211,6 +419,7 @@ Status RecordReader::ReadRecord(uint64* offset, tstring* record) {
 
 Status RecordReader::SkipRecords(uint64* offset, int num_to_skip,
                                  int* num_skipped) {
+  prefetcher_.reset();
   TF_RETURN_IF_ERROR(PositionInputStream(*offset));
 
   Status s;
@@ -47,6 +47,13 @@ struct RecordReaderOptions {
   // compressed files.) Consider using SequentialRecordReader.
   int64 buffer_size = 0;
 
+  // If non-zero, a background thread reads, and if needed decompresses, up to
+  // about `prefetch_bytes` bytes of records ahead of the caller, and their
+  // checksums are verified on a shared pool of threads. Records are still
+  // returned in order. Reading at any offset other than the one following the
+  // last record read discards the prefetched records.
+  int64 prefetch_bytes = 0;
+
   static RecordReaderOptions CreateRecordReaderOptions(
       const string& compression_type);
 
@@ -90,7 +97,7 @@ class RecordReader {
       RandomAccessFile* file,
       const RecordReaderOptions& options = RecordReaderOptions());
 
-  virtual ~RecordReader() = default;
+  virtual ~RecordReader();
 
   // Read the record at "*offset" into *record and update *offset to
   // point to the offset of the next record.  Returns OK on success,
@@ -116,12 +123,17 @@ class RecordReader {
   Status GetMetadata(Metadata* md);
 
  private:
+  class Prefetcher;
+
   Status ReadChecksummed(uint64 offset, size_t n, tstring* result);
   Status PositionInputStream(uint64 offset);
 
   RecordReaderOptions options_;
   std::unique_ptr<InputStreamInterface> input_stream_;
   bool last_read_failed_;
+  // Reads ahead of the last record read when `options_.prefetch_bytes` is
+  // non-zero. It reads `input_stream_`, so must be destroyed first.
+  std::unique_ptr<Prefetcher> prefetcher_;
 
   std::unique_ptr<Metadata> cached_metadata_;
 
@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace io {
@@ -298,6 +299,89 @@ TEST_F(RecordioTest, NonSequentialReadsWithCompression) {
       RecordReaderOptions::CreateRecordReaderOptions("ZLIB"));
 }
 
+TEST_F(RecordioTest, NonSequentialReadsWithPrefetch) {
+  RecordReaderOptions options;
+  options.prefetch_bytes = 64;
+  TestNonSequentialReads(RecordWriterOptions(), options);
+}
+
+TEST_F(RecordioTest, NonSequentialReadsWithPrefetchAndCompression) {
+  RecordReaderOptions options =
+      RecordReaderOptions::CreateRecordReaderOptions("ZLIB");
+  options.prefetch_bytes = 64;
+  TestNonSequentialReads(
+      RecordWriterOptions::CreateRecordWriterOptions("ZLIB"), options);
+}
+
+void TestPrefetchedReads(const RecordWriterOptions& writer_options,
+                         RecordReaderOptions reader_options) {
+  constexpr int kNumRecords = 10000;
+  string contents;
+  StringDest dst(&contents);
+  RecordWriter writer(&dst, writer_options);
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<string> records;
+  for (int i = 0; i < kNumRecords; ++i) {
+    records.push_back(RandomSkewedString(i, &rnd));
+    TF_ASSERT_OK(writer.WriteRecord(records.back()));
+  }
+  TF_ASSERT_OK(writer.Close());
+
+  StringSource file(&contents);
+  reader_options.prefetch_bytes = 4096;
+  SequentialRecordReader reader(&file, reader_options);
+  tstring record;
+  for (int i = 0; i < kNumRecords; ++i) {
+    TF_ASSERT_OK(reader.ReadRecord(&record)) << i;
+    ASSERT_EQ(records[i], record) << i;
+  }
+  EXPECT_TRUE(errors::IsOutOfRange(reader.ReadRecord(&record)));
+  EXPECT_TRUE(errors::IsOutOfRange(reader.ReadRecord(&record)));
+}
+
+TEST_F(RecordioTest, PrefetchedReads) {
+  TestPrefetchedReads(RecordWriterOptions(), RecordReaderOptions());
+}
+
+TEST_F(RecordioTest, PrefetchedReadsWithZlib) {
+  TestPrefetchedReads(RecordWriterOptions::CreateRecordWriterOptions("ZLIB"),
+                      RecordReaderOptions::CreateRecordReaderOptions("ZLIB"));
+}
+
+TEST_F(RecordioTest, PrefetchedReadsWithSnappy) {
+  TestPrefetchedReads(
+      RecordWriterOptions::CreateRecordWriterOptions("SNAPPY"),
+      RecordReaderOptions::CreateRecordReaderOptions("SNAPPY"));
+}
+
+TEST_F(RecordioTest, PrefetchedReadsStopAtCorruptedRecord) {
+  string contents;
+  StringDest dst(&contents);
+  RecordWriter writer(&dst);
+  uint64 corrupted_offset = 0;
+  for (int i = 0; i < 100; ++i) {
+    if (i == 50) {
+      corrupted_offset = contents.size() + RecordReader::kHeaderSize;
+    }
+    TF_ASSERT_OK(writer.WriteRecord(NumberString(i)));
+  }
+  contents[corrupted_offset] ^= 1;
+
+  StringSource file(&contents);
+  RecordReaderOptions options;
+  options.prefetch_bytes = 256;
+  SequentialRecordReader reader(&file, options);
+  tstring record;
+  for (int i = 0; i < 50; ++i) {
+    TF_ASSERT_OK(reader.ReadRecord(&record)) << i;
+    ASSERT_EQ(NumberString(i), record);
+  }
+  Status s = reader.ReadRecord(&record);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+  EXPECT_TRUE(absl::StrContains(s.error_message(), "corrupted record")) << s;
+}
+
 // Tests of all the error paths in log_reader.cc follow:
 void AssertHasSubstr(StringPiece s, StringPiece expected) {
   EXPECT_TRUE(absl::StrContains(s, expected))
@@ -344,6 +428,12 @@ TEST_F(RecordioTest, ReadErrorWithCompression) {
                 RecordReaderOptions::CreateRecordReaderOptions("ZLIB"));
 }
 
+TEST_F(RecordioTest, ReadErrorWithPrefetch) {
+  RecordReaderOptions options;
+  options.prefetch_bytes = 1 << 20;
+  TestReadError(RecordWriterOptions(), options);
+}
+
 TEST_F(RecordioTest, CorruptLength) {
   Write("foo");
   IncrementByte(6, 100);
@@ -372,6 +462,53 @@ TEST_F(RecordioTest, ReadEnd) { CheckOffsetPastEndReturnsNoRecords(0); }
 
 TEST_F(RecordioTest, ReadPastEnd) { CheckOffsetPastEndReturnsNoRecords(5); }
 
+// Reads 10000 records of 16KB, compressed with ZLIB if `state.range(0)` is
+// non-zero, prefetching if `state.range(1)` is non-zero.
+static void BM_ReadRecords(::testing::benchmark::State& state) {
+  constexpr int kNumRecords = 10000;
+  constexpr int kRecordSize = 16384;
+  const string compression = state.range(0) ? "ZLIB" : "";
+  string contents;
+  StringDest dst(&contents);
+  RecordWriter writer(&dst,
+                      RecordWriterOptions::CreateRecordWriterOptions(
+                          compression));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  string record(kRecordSize, 0);
+  for (int i = 0; i < kNumRecords; ++i) {
+    // Compressible but not constant data.
+    for (int j = 0; j < kRecordSize; j += 8) {
+      record[j] = rnd.Uniform(16);
+    }
+    TF_CHECK_OK(writer.WriteRecord(record));
+  }
+  TF_CHECK_OK(writer.Close());
+
+  StringSource file(&contents);
+  RecordReaderOptions options =
+      RecordReaderOptions::CreateRecordReaderOptions(compression);
+  if (state.range(1)) {
+    options.prefetch_bytes = 4 << 20;
+  }
+  for (auto s : state) {
+    SequentialRecordReader reader(&file, options);
+    tstring read;
+    for (int i = 0; i < kNumRecords; ++i) {
+      TF_CHECK_OK(reader.ReadRecord(&read));
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * kNumRecords * kRecordSize);
+  state.SetLabel(strings::StrCat(compression.empty() ? "none" : compression,
+                                 state.range(1) ? "/prefetch" : ""));
+}
+
+BENCHMARK(BM_ReadRecords)
+    ->ArgPair(0, 0)
+    ->ArgPair(0, 1)
+    ->ArgPair(1, 0)
+    ->ArgPair(1, 1);
+
 }  // namespace
 }  // namespace io
 }  // namespace tensorflow
@@ -494,6 +494,8 @@ REGISTER_OP("ShuffleDatasetV3")
     .Attr("reshuffle_each_iteration: bool = true")
     .Attr("output_types: list(type) >= 1")
     .Attr("output_shapes: list(shape) >= 1")
+    .Attr("max_buffer_bytes: int = 0")
+    .Attr("spill_directory: string = ''")
     .SetShapeFn([](shape_inference::InferenceContext* c) {
       shape_inference::ShapeHandle unused;
       // buffer_size, seed, seed2, and seed_generator should be scalars.
@@ -587,6 +589,9 @@ REGISTER_OP("CacheDatasetV2")
     .Output("handle: variant")
     .Attr("output_types: list(type) >= 1")
     .Attr("output_shapes: list(shape) >= 1")
+    .Attr("file_format: string = 'bundle'")
+    .Attr("compression: string = ''")
+    .Attr("max_memory_bytes: int = 0")
     .SetShapeFn([](shape_inference::InferenceContext* c) {
       shape_inference::ShapeHandle unused;
       // filename should be a scalar.
@@ -664,6 +669,9 @@ REGISTER_OP("TFRecordDataset")
     .Input("compression_type: string")
     .Input("buffer_size: int64")
     .Output("handle: variant")
+    .Attr("num_shards: int = 1")
+    .Attr("shard_index: int = 0")
+    .Attr("shuffle_seed: int = -1")
     .SetDoNotOptimize()  // TODO(b/123753214): Source dataset ops must
                          // disable constant folding.
     .SetShapeFn([](shape_inference::InferenceContext* c) {
@@ -166,6 +166,89 @@ class Feature {
     return true;
   }
 
+  // Counts the values that ParseFloatList() would parse, without decoding
+  // them.
+  bool GetNumElementsInFloatList(int* num_elements) {
+    protobuf::io::CodedInputStream stream(
+        reinterpret_cast<const uint8*>(serialized_.data()), serialized_.size());
+    EnableAliasing(&stream);
+    uint32 length = 0;
+    if (!stream.ReadVarint32(&length)) return false;
+    auto limit = stream.PushLimit(length);
+    *num_elements = 0;
+    if (!stream.ExpectAtEnd()) {
+      constexpr int32 kNumFloatBytes = 4;
+      uint8 peek_tag = PeekTag(&stream);
+      if (peek_tag == kDelimitedTag(1)) {                       // packed
+        if (!stream.ExpectTag(kDelimitedTag(1))) return false;  // packed tag
+        uint32 packed_length;
+        if (!stream.ReadVarint32(&packed_length)) return false;
+        if (!stream.Skip(packed_length)) return false;
+        *num_elements = packed_length / kNumFloatBytes;
+      } else if (peek_tag == kFixed32Tag(1)) {  // non-packed
+        while (!stream.ExpectAtEnd()) {
+          if (!stream.ExpectTag(kFixed32Tag(1))) return false;
+          if (!stream.Skip(kNumFloatBytes)) return false;
+          ++*num_elements;
+        }
+      } else {
+        return false;
+      }
+    }
+    stream.PopLimit(limit);
+    return true;
+  }
+
+  // Counts the values that ParseInt64List() would parse, without decoding
+  // them.
+  bool GetNumElementsInInt64List(int* num_elements) {
+    protobuf::io::CodedInputStream stream(
+        reinterpret_cast<const uint8*>(serialized_.data()), serialized_.size());
+    EnableAliasing(&stream);
+    uint32 length = 0;
+    if (!stream.ReadVarint32(&length)) return false;
+    auto limit = stream.PushLimit(length);
+    *num_elements = 0;
+    if (!stream.ExpectAtEnd()) {
+      uint8 peek_tag = PeekTag(&stream);
+      if (peek_tag == kDelimitedTag(1)) {                       // packed
+        if (!stream.ExpectTag(kDelimitedTag(1))) return false;  // packed tag
+        uint32 packed_length;
+        if (!stream.ReadVarint32(&packed_length)) return false;
+        if (packed_length > 0) {
+          const void* data;
+          int size;
+          if (!stream.GetDirectBufferPointer(&data, &size) ||
+              static_cast<uint32>(size) < packed_length) {
+            return false;
+          }
+          // The last byte of each varint is the only one with its high bit
+          // clear, so counting those bytes counts the values. This loop is
+          // simple enough for the compiler to vectorize.
+          const uint8* bytes = static_cast<const uint8*>(data);
+          if (bytes[packed_length - 1] & 0x80) return false;
+          int count = 0;
+          for (uint32 i = 0; i < packed_length; ++i) {
+            count += bytes[i] < 0x80;
+          }
+          *num_elements = count;
+          stream.Skip(packed_length);
+        }
+      } else if (peek_tag == kVarintTag(1)) {  // non-packed
+        while (!stream.ExpectAtEnd()) {
+          if (!stream.ExpectTag(kVarintTag(1))) return false;
+          protobuf_uint64 n;  // There is no API for int64
+          if (!stream.ReadVarint64(&n)) return false;
+          ++*num_elements;
+        }
+      } else {
+        return false;
+      }
+    }
+    stream.PopLimit(limit);
+    return true;
+  }
+
   // Helper methods
   tstring* construct_at_end(LimitedArraySlice<tstring>* bytes_list) {
     if (bytes_list->EndDistance() <= 0) {
@@ -1109,6 +1192,421 @@ void CopySparseBufferToTensor(DataType dtype, size_t offset, SparseBuffer* src,
   }
 }
 
+// Columnar parsing.
+//
+// FastParseExampleColumnar() parses a batch in two passes. The first pass
+// locates the configured features of every example and counts their values
+// without decoding them. Once the size of every output is known, the outputs
+// are allocated and the second pass decodes each feature directly into its
+// place in them, one feature at a time. Unlike the row-wise parser, values
+// are never buffered in SparseBuffers and then copied.
+
+// The configured feature `d` of type `type` in every example of a batch.
+struct FeatureColumn {
+  Type type;
+  size_t d;
+  DataType dtype;
+  const tstring* feature_name;
+  // The feature of each example, or an empty feature if the example does not
+  // have it or it has no values.
+  std::vector<parsed::Feature> features;
+  // In the first pass, `value_offsets[e + 1]` is set to the number of values
+  // of example `e`, or -1 until the feature is found in the example. The
+  // counts are then accumulated, so that the values of example `e` are at
+  // [value_offsets[e], value_offsets[e + 1]).
+  std::vector<int64> value_offsets;
+};
+
+const char* ValuesTypeString(DataType dtype) {
+  switch (dtype) {
+    case DT_INT64:
+      return "int64";
+    case DT_FLOAT:
+      return "float";
+    case DT_STRING:
+      return "bytes";
+    default:
+      ReportUnexpectedDataType(dtype);
+      return "";
+  }
+}
+
+// Counts the values of `feature`, whose data type has been parsed to be
+// `dtype`.
+bool CountFeatureValues(DataType dtype, parsed::Feature* feature,
+                        int* num_values) {
+  switch (dtype) {
+    case DT_INT64:
+      return feature->GetNumElementsInInt64List(num_values);
+    case DT_FLOAT:
+      return feature->GetNumElementsInFloatList(num_values);
+    case DT_STRING:
+      return feature->GetNumElementsInBytesList(num_values);
+    default:
+      ReportUnexpectedDataType(dtype);
+      return false;
+  }
+}
+
+bool ParseFeatureValues(parsed::Feature* feature,
+                        LimitedArraySlice<int64>* values) {
+  return feature->ParseInt64List(values);
+}
+bool ParseFeatureValues(parsed::Feature* feature,
+                        LimitedArraySlice<float>* values) {
+  return feature->ParseFloatList(values);
+}
+bool ParseFeatureValues(parsed::Feature* feature,
+                        LimitedArraySlice<tstring>* values) {
+  return feature->ParseBytesList(values);
+}
+
+// First pass: records the configured features of example `example_index` in
+// `columns`, and counts their values.
+Status LocateExampleFeatures(
+    const tstring& serialized_example, const tstring& example_name,
+    const size_t example_index, const Config& config,
+    const PresizedCuckooMap<std::pair<size_t, Type>>& config_index,
+    SeededHasher hasher, std::vector<FeatureColumn>* columns,
+    PerExampleFeatureStats* output_stats) {
+  parsed::Example parsed_example;
+  if (!ParseExample(serialized_example, &parsed_example)) {
+    return errors::InvalidArgument("Could not parse example input, value: '",
+                                   serialized_example, "'");
+  }
+  const size_t parsed_example_size = parsed_example.size();
+  if (output_stats) {
+    output_stats->features_count = parsed_example_size;
+  }
+
+  const size_t first_sparse_column = config.dense.size();
+  const size_t first_ragged_column = first_sparse_column + config.sparse.size();
+  for (size_t i = 0; i < parsed_example_size; ++i) {
+    // As in FastParseSerializedExample(), the last entry of a feature in the
+    // map overwrites all the previous ones.
+    parsed::FeatureMapEntry& name_and_feature =
+        parsed_example[parsed_example_size - i - 1];
+    const StringPiece feature_name = name_and_feature.first;
+    parsed::Feature& feature = name_and_feature.second;
+
+    std::pair<size_t, Type> d_and_type;
+    if (!config_index.Find(hasher(feature_name), &d_and_type)) continue;
+    const size_t d = d_and_type.first;
+    FeatureColumn& column =
+        (*columns)[d_and_type.second == Type::Dense
+                       ? d
+                       : (d_and_type.second == Type::Sparse
+                              ? first_sparse_column + d
+                              : first_ragged_column + d)];
+    // Testing for PresizedCuckooMap collision.
+    if (feature_name != *column.feature_name) continue;
+
+    auto example_error = [&](StringPiece suffix) {
+      return errors::InvalidArgument("Name: ", example_name,
+                                     ", Key: ", feature_name,
+                                     ", Index: ", example_index, ".  ", suffix);
+    };
+
+    DataType example_dtype;
+    TF_RETURN_IF_ERROR(feature.ParseDataType(&example_dtype));
+    int64& num_values = column.value_offsets[example_index + 1];
+    if (column.type == Type::Dense) {
+      if (example_dtype == DT_INVALID) continue;
+      if (num_values >= 0) {
+        LogDenseFeatureDataLoss(feature_name);
+        continue;
+      }
+      if (example_dtype != column.dtype) {
+        return example_error(strings::StrCat(
+            "Data types don't match. Data type: ",
+            DataTypeString(example_dtype),
+            " but expected type: ", DataTypeString(column.dtype)));
+      }
+    } else {
+      if (num_values >= 0) {
+        LogSparseFeatureDataLoss(feature_name);
+        continue;
+      }
+      if (example_dtype != DT_INVALID && example_dtype != column.dtype) {
+        return example_error(
+            strings::StrCat("Data types don't match. ",
+                            "Expected type: ", DataTypeString(column.dtype),
+                            ", Actual type: ", DataTypeString(example_dtype)));
+      }
+      if (example_dtype == DT_INVALID) {
+        num_values = 0;
+        continue;
+      }
+    }
+
+    int count;
+    if (!CountFeatureValues(column.dtype, &feature, &count)) {
+      return example_error("Can't parse serialized Example.");
+    }
+    if (column.type == Type::Dense) {
+      const Config::Dense& dense = config.dense[d];
+      if (!dense.variable_length &&
+          static_cast<size_t>(count) != dense.elements_per_stride) {
+        return example_error(strings::StrCat(
+            "Number of ", ValuesTypeString(column.dtype),
+            " values != expected.  Values size: ", count,
+            " but output shape: ", dense.shape.DebugString()));
+      }
+      if (dense.variable_length && count % dense.elements_per_stride != 0) {
+        return example_error(strings::StrCat(
+            "Number of ", ValuesTypeString(column.dtype),
+            " values is not a multiple of stride length. Saw ", count,
+            " values but output shape is: ", dense.shape.DebugString()));
+      }
+    }
+    column.features[example_index] = feature;
+    num_values = count;
+    if (output_stats) {
+      output_stats->feature_values_count += count;
+    }
+  }
+
+  // Handle missing features.
+  for (FeatureColumn& column : *columns) {
+    int64& num_values = column.value_offsets[example_index + 1];
+    if (num_values >= 0) continue;
+    if (column.type == Type::Dense &&
+        !config.dense[column.d].variable_length &&
+        config.dense[column.d].default_value.NumElements() == 0) {
+      return errors::InvalidArgument(
+          "Name: ", example_name, ", Feature: ", *column.feature_name,
+          " (data type: ", DataTypeString(column.dtype), ")",
+          " is required but could not be found.");
+    }
+    num_values = 0;
+  }
+  return Status::OK();
+}
+
+// Second pass: decodes the values of examples [start, end) of `column` into
+// `values`. The values of an example start at `value_offsets` for sparse and
+// ragged features, and at the example's row of `values` for dense features,
+// whose missing values are filled in from the default value.
+template <typename T>
+Status DecodeColumnValues(const Config& config, size_t start, size_t end,
+                          gtl::ArraySlice<tstring> example_names,
+                          FeatureColumn* column, Tensor* values) {
+  if (values->NumElements() == 0) return Status::OK();
+  T* out = values->flat<T>().data();
+  const bool is_dense = column->type == Type::Dense;
+  const bool is_varlen = is_dense && config.dense[column->d].variable_length;
+  // Number of values in each row of a dense output.
+  const int64 row_size =
+      is_dense ? values->NumElements() / values->dim_size(0) : 0;
+  for (size_t e = start; e < end; ++e) {
+    const int64 num_values =
+        column->value_offsets[e + 1] - column->value_offsets[e];
+    T* example_out = out + (is_dense ? e * row_size : column->value_offsets[e]);
+    parsed::Feature& feature = column->features[e];
+    if (!feature.GetSerialized().empty()) {
+      LimitedArraySlice<T> slice(example_out, num_values);
+      if (!ParseFeatureValues(&feature, &slice) || slice.EndDistance() != 0) {
+        return errors::InvalidArgument(
+            "Name: ",
+            (!example_names.empty() ? example_names[e] : "<unknown>"),
+            ", Key: ", *column->feature_name, ", Index: ", e,
+            ".  Can't parse serialized Example.");
+      }
+    }
+    if (is_varlen) {
+      std::fill(example_out + num_values, example_out + row_size,
+                config.dense[column->d].default_value.flat<T>()(0));
+    } else if (is_dense && feature.GetSerialized().empty()) {
+      std::copy_n(config.dense[column->d].default_value.flat<T>().data(),
+                  row_size, example_out);
+    }
+  }
+  return Status::OK();
+}
+
+Status DecodeColumnValues(const Config& config, size_t start, size_t end,
+                          gtl::ArraySlice<tstring> example_names,
+                          FeatureColumn* column, Tensor* values) {
+  switch (column->dtype) {
+    case DT_INT64:
+      return DecodeColumnValues<int64>(config, start, end, example_names,
+                                       column, values);
+    case DT_FLOAT:
+      return DecodeColumnValues<float>(config, start, end, example_names,
+                                       column, values);
+    case DT_STRING:
+      return DecodeColumnValues<tstring>(config, start, end, example_names,
+                                         column, values);
+    default:
+      ReportUnexpectedDataType(column->dtype);
+      return Status::OK();
+  }
+}
+
+template <typename T>
+void WriteRowSplits(const std::vector<int64>& value_offsets, Tensor* splits) {
+  std::copy(value_offsets.begin(), value_offsets.end(),
+            splits->flat<T>().data());
+}
+
+// Parses `serialized` column by column into `result`. The outputs of fixed
+// length dense features are preallocated in `fixed_dense_values`.
+Status FastParseExampleColumnar(
+    const Config& config, gtl::ArraySlice<tstring> serialized,
+    gtl::ArraySlice<tstring> example_names,
+    const PresizedCuckooMap<std::pair<size_t, Type>>& config_index,
+    SeededHasher hasher, size_t num_minibatches,
+    thread::ThreadPool* thread_pool, std::vector<Tensor>* fixed_dense_values,
+    Result* result) {
+  const size_t batch_size = serialized.size();
+  std::vector<FeatureColumn> columns;
+  columns.reserve(config.dense.size() + config.sparse.size() +
+                  config.ragged.size());
+  auto add_column = [&](Type type, size_t d, DataType dtype,
+                        const tstring& feature_name) {
+    columns.emplace_back();
+    FeatureColumn& column = columns.back();
+    column.type = type;
+    column.d = d;
+    column.dtype = dtype;
+    column.feature_name = &feature_name;
+    column.features.resize(batch_size);
+    column.value_offsets.assign(batch_size + 1, -1);
+    column.value_offsets[0] = 0;
+  };
+  for (size_t d = 0; d < config.dense.size(); ++d) {
+    add_column(Type::Dense, d, config.dense[d].dtype,
+               config.dense[d].feature_name);
+  }
+  for (size_t d = 0; d < config.sparse.size(); ++d) {
+    add_column(Type::Sparse, d, config.sparse[d].dtype,
+               config.sparse[d].feature_name);
+  }
+  for (size_t d = 0; d < config.ragged.size(); ++d) {
+    add_column(Type::Ragged, d, config.ragged[d].dtype,
+               config.ragged[d].feature_name);
+  }
+
+  auto first_example_of_minibatch = [&](size_t minibatch) -> size_t {
+    return (batch_size * minibatch) / num_minibatches;
+  };
+  std::vector<Status> status_of_minibatch(num_minibatches);
+
+  // First pass: locate and count the values of every feature.
+  auto LocateMiniBatch = [&](size_t minibatch) {
+    size_t start = first_example_of_minibatch(minibatch);
+    size_t end = first_example_of_minibatch(minibatch + 1);
+    for (size_t e = start; e < end; ++e) {
+      status_of_minibatch[minibatch] = LocateExampleFeatures(
+          serialized[e],
+          (!example_names.empty() ? example_names[e] : "<unknown>"), e, config,
+          config_index, hasher, &columns,
+          config.collect_feature_stats ? &result->feature_stats[e] : nullptr);
+      if (!status_of_minibatch[minibatch].ok()) break;
+    }
+  };
+  ParallelFor(LocateMiniBatch, num_minibatches, thread_pool);
+  for (Status& status : status_of_minibatch) {
+    TF_RETURN_IF_ERROR(status);
+  }
+
+  // Allocate the outputs.
+  std::vector<Tensor*> column_values(columns.size());
+  result->dense_values = std::move(*fixed_dense_values);
+  result->sparse_indices.reserve(config.sparse.size());
+  result->sparse_values.reserve(config.sparse.size());
+  result->sparse_shapes.reserve(config.sparse.size());
+  result->ragged_values.reserve(config.ragged.size());
+  result->ragged_splits.reserve(config.ragged.size());
+  for (size_t c = 0; c < columns.size(); ++c) {
+    FeatureColumn& column = columns[c];
+    int64 max_num_values = 0;
+    for (size_t e = 0; e < batch_size; ++e) {
+      max_num_values = std::max(max_num_values, column.value_offsets[e + 1]);
+      column.value_offsets[e + 1] += column.value_offsets[e];
+    }
+    const int64 total_num_values = column.value_offsets[batch_size];
+
+    switch (column.type) {
+      case Type::Dense: {
+        const Config::Dense& dense = config.dense[column.d];
+        if (dense.variable_length) {
+          TensorShape values_shape;
+          values_shape.AddDim(batch_size);
+          values_shape.AddDim(max_num_values / dense.elements_per_stride);
+          for (int i = 1; i < dense.shape.dims(); ++i) {
+            values_shape.AddDim(dense.shape.dim_size(i));
+          }
+          result->dense_values[column.d] = Tensor(dense.dtype, values_shape);
+        }
+        column_values[c] = &result->dense_values[column.d];
+        break;
+      }
+      case Type::Sparse: {
+        result->sparse_indices.emplace_back(
+            DT_INT64, TensorShape({total_num_values, 2}));
+        result->sparse_values.emplace_back(column.dtype,
+                                           TensorShape({total_num_values}));
+        result->sparse_shapes.emplace_back(DT_INT64, TensorShape({2}));
+        auto shape_t = result->sparse_shapes.back().vec<int64>();
+        shape_t(0) = batch_size;
+        shape_t(1) = max_num_values;
+        column_values[c] = &result->sparse_values.back();
+        break;
+      }
+      case Type::Ragged: {
+        const Config::Ragged& ragged = config.ragged[column.d];
+        result->ragged_values.emplace_back(column.dtype,
+                                           TensorShape({total_num_values}));
+        result->ragged_splits.emplace_back(
+            ragged.splits_dtype,
+            TensorShape({static_cast<int64>(batch_size) + 1}));
+        if (ragged.splits_dtype == DT_INT64) {
+          WriteRowSplits<int64>(column.value_offsets,
+                                &result->ragged_splits.back());
+        } else {
+          WriteRowSplits<int32>(column.value_offsets,
+                                &result->ragged_splits.back());
+        }
+        column_values[c] = &result->ragged_values.back();
+        break;
+      }
+    }
+  }
+
+  // Second pass: decode the values of every feature into the outputs.
+  auto DecodeMiniBatch = [&](size_t minibatch) {
+    size_t start = first_example_of_minibatch(minibatch);
+    size_t end = first_example_of_minibatch(minibatch + 1);
+    for (size_t c = 0; c < columns.size(); ++c) {
+      FeatureColumn& column = columns[c];
+      Status s = DecodeColumnValues(config, start, end, example_names, &column,
+                                    column_values[c]);
+      if (!s.ok()) {
+        status_of_minibatch[minibatch] = s;
+        return;
+      }
+      if (column.type == Type::Sparse) {
+        // Column 0 of the indices is the example, and column 1 the position
+        // of the value in the example.
+        int64* ix_p = result->sparse_indices[column.d].flat<int64>().data();
+        for (size_t e = start; e < end; ++e) {
+          for (int64 i = column.value_offsets[e];
+               i < column.value_offsets[e + 1]; ++i) {
+            ix_p[2 * i] = e;
+            ix_p[2 * i + 1] = i - column.value_offsets[e];
+          }
+        }
+      }
+    }
+  };
+  ParallelFor(DecodeMiniBatch, num_minibatches, thread_pool);
+  for (Status& status : status_of_minibatch) {
+    TF_RETURN_IF_ERROR(status);
+  }
+  return Status::OK();
+}
+
 }  // namespace
 
 Status FastParseExample(const Config& config,
@@ -1192,6 +1690,12 @@ Status FastParseExample(const Config& config,
                             std::min<size_t>(max_minibatches, result));
   }();
 
+  if (config.columnar) {
+    return FastParseExampleColumnar(config, serialized, example_names,
+                                    config_index, hasher, num_minibatches,
+                                    thread_pool, &fixed_dense_values, result);
+  }
+
   auto first_example_of_minibatch = [&](size_t minibatch) -> size_t {
     return (serialized.size() * minibatch) / num_minibatches;
   };
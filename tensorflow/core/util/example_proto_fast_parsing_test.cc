@@ -19,6 +19,9 @@ limitations under the License.
 
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/protobuf.h"
@@ -423,6 +426,275 @@ TEST(TestFastParseExample, Empty) {
   EXPECT_TRUE(status.ok()) << status;
 }
 
+// Returns a tensor of `shape` with values 0, 1, 2, ...
+Tensor RangeTensor(DataType dtype, const TensorShape& shape) {
+  Tensor tensor(dtype, shape);
+  for (int64 i = 0; i < tensor.NumElements(); ++i) {
+    switch (dtype) {
+      case DT_INT64:
+        tensor.flat<int64>()(i) = i;
+        break;
+      case DT_FLOAT:
+        tensor.flat<float>()(i) = i;
+        break;
+      case DT_STRING:
+        tensor.flat<tstring>()(i) = strings::StrCat(i);
+        break;
+      default:
+        LOG(FATAL) << "Unexpected dtype";
+    }
+  }
+  return tensor;
+}
+
+// A config with dense, variable length dense, sparse and ragged features of
+// every type. Feature "<kind>_<type>" has `num_values` values (for dense
+// features) or a multiple of `num_values` values (for the other ones).
+FastParseExampleConfig MixedConfig() {
+  FastParseExampleConfig config;
+  for (DataType dtype : {DT_INT64, DT_FLOAT, DT_STRING}) {
+    const string type = DataTypeString(dtype);
+    config.dense.emplace_back(strings::StrCat("dense_", type), dtype,
+                              PartialTensorShape({3}),
+                              RangeTensor(dtype, TensorShape({3})),
+                              /*variable_length=*/false,
+                              /*elements_per_stride=*/3);
+    config.dense.emplace_back(strings::StrCat("varlen_", type), dtype,
+                              PartialTensorShape({-1, 2}),
+                              RangeTensor(dtype, TensorShape({})),
+                              /*variable_length=*/true,
+                              /*elements_per_stride=*/2);
+    config.sparse.emplace_back(strings::StrCat("sparse_", type), dtype);
+    config.ragged.emplace_back(strings::StrCat("ragged_", type), dtype,
+                               dtype == DT_FLOAT ? DT_INT32 : DT_INT64);
+  }
+  return config;
+}
+
+void AddValues(DataType dtype, int num_values, random::SimplePhilox* rng,
+               Feature* feature) {
+  switch (dtype) {
+    case DT_INT64:
+      feature->mutable_int64_list();
+      for (int i = 0; i < num_values; ++i) {
+        // Values of different lengths once varint encoded.
+        feature->mutable_int64_list()->add_value(rng->Rand64() >>
+                                                 (rng->Rand32() % 64));
+      }
+      break;
+    case DT_FLOAT:
+      feature->mutable_float_list();
+      for (int i = 0; i < num_values; ++i) {
+        feature->mutable_float_list()->add_value(rng->RandFloat());
+      }
+      break;
+    case DT_STRING:
+      feature->mutable_bytes_list();
+      for (int i = 0; i < num_values; ++i) {
+        feature->mutable_bytes_list()->add_value(RandStr(rng));
+      }
+      break;
+    default:
+      LOG(FATAL) << "Unexpected dtype";
+  }
+}
+
+// Returns a random example for `MixedConfig()`, in which every feature is
+// missing, empty or has values.
+string RandomMixedExample(random::SimplePhilox* rng) {
+  Example example;
+  auto* features = example.mutable_features()->mutable_feature();
+  for (DataType dtype : {DT_INT64, DT_FLOAT, DT_STRING}) {
+    const string type = DataTypeString(dtype);
+    for (const char* kind : {"dense", "varlen", "sparse", "ragged"}) {
+      const int presence = rng->Uniform(4);
+      if (presence == 0) continue;
+      Feature* feature = &(*features)[strings::StrCat(kind, "_", type)];
+      // Features without a kind are allowed, and have no values.
+      if (presence == 1 && string(kind) != "dense") continue;
+      const int num_values =
+          string(kind) == "dense" ? 3 : 2 * rng->Uniform(4);
+      AddValues(dtype, num_values, rng, feature);
+    }
+  }
+  (*features)["unused"].mutable_int64_list()->add_value(1);
+  string serialized = Serialize(example);
+  if (rng->Uniform(8) == 0) {
+    // Concatenated examples, in which the last value of a feature wins.
+    serialized += RandomMixedExample(rng);
+  }
+  return serialized;
+}
+
+void ExpectEqualTensors(const std::vector<Tensor>& expected,
+                        const std::vector<Tensor>& actual) {
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    test::ExpectEqual(expected[i], actual[i]);
+  }
+}
+
+// Checks that the columnar parser returns the same result as the row-wise
+// parser.
+void TestColumnarParsing(FastParseExampleConfig config,
+                         const std::vector<tstring>& serialized,
+                         thread::ThreadPool* thread_pool) {
+  config.collect_feature_stats = true;
+  Result expected;
+  Status expected_status =
+      FastParseExample(config, serialized, {}, thread_pool, &expected);
+  config.columnar = true;
+  Result actual;
+  Status actual_status =
+      FastParseExample(config, serialized, {}, thread_pool, &actual);
+  ASSERT_EQ(expected_status.code(), actual_status.code())
+      << expected_status << " vs. " << actual_status;
+  if (!expected_status.ok()) return;
+
+  ExpectEqualTensors(expected.dense_values, actual.dense_values);
+  ExpectEqualTensors(expected.sparse_indices, actual.sparse_indices);
+  ExpectEqualTensors(expected.sparse_values, actual.sparse_values);
+  ExpectEqualTensors(expected.sparse_shapes, actual.sparse_shapes);
+  ExpectEqualTensors(expected.ragged_values, actual.ragged_values);
+  ExpectEqualTensors(expected.ragged_splits, actual.ragged_splits);
+  ASSERT_EQ(expected.feature_stats.size(), actual.feature_stats.size());
+  for (size_t i = 0; i < expected.feature_stats.size(); ++i) {
+    EXPECT_EQ(expected.feature_stats[i].features_count,
+              actual.feature_stats[i].features_count);
+    EXPECT_EQ(expected.feature_stats[i].feature_values_count,
+              actual.feature_stats[i].feature_values_count);
+  }
+}
+
+TEST(FastParseColumnar, MatchesRowWiseParsing) {
+  random::PhiloxRandom philox(1337);
+  random::SimplePhilox rng(&philox);
+  thread::ThreadPool thread_pool(Env::Default(), "parse", 4);
+  for (int batch_size : {0, 1, 7, 100, 1000}) {
+    std::vector<tstring> serialized;
+    for (int i = 0; i < batch_size; ++i) {
+      serialized.push_back(RandomMixedExample(&rng));
+    }
+    TestColumnarParsing(MixedConfig(), serialized, nullptr);
+    TestColumnarParsing(MixedConfig(), serialized, &thread_pool);
+  }
+}
+
+TEST(FastParseColumnar, ParsesPackedAndNonPackedValues) {
+  // Feature "age" as packed and non-packed int64 lists.
+  const string int64_packed(
+      "\x0a\x0e\x0a\x0c\x0a\x03\x61\x67\x65\x12\x05\x1a\x03\x0a\x01\x0d");
+  const string int64_non_packed(
+      "\x0a\x0d\x0a\x0b\x0a\x03\x61\x67\x65\x12\x04\x1a\x02\x08\x0d");
+  FastParseExampleConfig int64_config;
+  AddSparseFeature("age", DT_INT64, &int64_config);
+  TestColumnarParsing(int64_config, {int64_packed, int64_non_packed}, nullptr);
+
+  // Feature "age" as packed and non-packed float lists.
+  const string float_packed(
+      "\x0a\x11\x0a\x0f\x0a\x03\x61\x67\x65\x12\x08\x12\x06\x0a\x04\x00\x00"
+      "\x80\x3f",
+      19);
+  const string float_non_packed(
+      "\x0a\x10\x0a\x0e\x0a\x03\x61\x67\x65\x12\x07\x12\x05\x0d\x00\x00\x80"
+      "\x3f",
+      18);
+  FastParseExampleConfig float_config;
+  AddDenseFeature("age", DT_FLOAT, {-1}, true, 1, &float_config);
+  TestColumnarParsing(float_config, {float_packed, float_non_packed}, nullptr);
+}
+
+TEST(FastParseColumnar, Errors) {
+  random::PhiloxRandom philox(42);
+  random::SimplePhilox rng(&philox);
+  std::vector<tstring> serialized;
+  for (int i = 0; i < 10; ++i) {
+    serialized.push_back(RandomMixedExample(&rng));
+  }
+
+  // A dense feature without a default value is required.
+  FastParseExampleConfig missing_config = MixedConfig();
+  missing_config.dense.emplace_back("missing", DT_INT64,
+                                    PartialTensorShape({1}), Tensor(DT_INT64),
+                                    false, 1);
+  TestColumnarParsing(missing_config, serialized, nullptr);
+
+  // The type of a feature does not match the config.
+  FastParseExampleConfig type_config;
+  type_config.sparse.emplace_back("sparse_int64", DT_FLOAT);
+  TestColumnarParsing(type_config, serialized, nullptr);
+
+  // A dense feature has the wrong number of values.
+  FastParseExampleConfig shape_config;
+  shape_config.dense.emplace_back(
+      "dense_float", DT_FLOAT, PartialTensorShape({2}),
+      RangeTensor(DT_FLOAT, TensorShape({2})), false, 2);
+  TestColumnarParsing(shape_config, serialized, nullptr);
+
+  // A varlen dense feature is not a multiple of the stride.
+  FastParseExampleConfig stride_config;
+  stride_config.dense.emplace_back(
+      "sparse_string", DT_STRING, PartialTensorShape({-1, 4}),
+      RangeTensor(DT_STRING, TensorShape({})), true, 4);
+  TestColumnarParsing(stride_config, serialized, nullptr);
+
+  // The example is not a serialized proto.
+  serialized.push_back("\xff\xff");
+  TestColumnarParsing(MixedConfig(), serialized, nullptr);
+}
+
+// Parses a batch of 4096 examples with 100 features: 25 each of fixed length
+// int64 and float features, and of variable length float and string features.
+// Uses the columnar parser if `state.range(0)` is non-zero.
+static void BM_FastParseExample(::testing::benchmark::State& state) {
+  constexpr int kBatchSize = 4096;
+  constexpr int kNumFeatures = 100;
+  random::PhiloxRandom philox(1);
+  random::SimplePhilox rng(&philox);
+
+  FastParseExampleConfig config;
+  config.columnar = state.range(0);
+  Example example;
+  auto* features = example.mutable_features()->mutable_feature();
+  for (int i = 0; i < kNumFeatures; ++i) {
+    const string name = strings::StrCat("feature_", i);
+    switch (i % 4) {
+      case 0:
+        config.dense.emplace_back(name, DT_INT64, PartialTensorShape({1}),
+                                  RangeTensor(DT_INT64, TensorShape({1})),
+                                  false, 1);
+        AddValues(DT_INT64, 1, &rng, &(*features)[name]);
+        break;
+      case 1:
+        config.dense.emplace_back(name, DT_FLOAT, PartialTensorShape({8}),
+                                  RangeTensor(DT_FLOAT, TensorShape({8})),
+                                  false, 8);
+        AddValues(DT_FLOAT, 8, &rng, &(*features)[name]);
+        break;
+      case 2:
+        config.sparse.emplace_back(name, DT_FLOAT);
+        AddValues(DT_FLOAT, 1 + rng.Uniform(16), &rng, &(*features)[name]);
+        break;
+      case 3:
+        config.ragged.emplace_back(name, DT_STRING, DT_INT64);
+        AddValues(DT_STRING, 1 + rng.Uniform(4), &rng, &(*features)[name]);
+        break;
+    }
+  }
+  std::vector<tstring> serialized(kBatchSize, Serialize(example));
+
+  size_t bytes = 0;
+  for (const auto& s : serialized) bytes += s.size();
+  for (auto s : state) {
+    Result result;
+    TF_CHECK_OK(FastParseExample(config, serialized, {}, nullptr, &result));
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+BENCHMARK(BM_FastParseExample)->Arg(0)->Arg(1);
+
 }  // namespace
 }  // namespace example
 }  // namespace tensorflow
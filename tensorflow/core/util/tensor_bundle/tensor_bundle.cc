@@ -19,8 +19,10 @@ limitations under the License.
 #include <cstdlib>
 #include <cstring>
 #include <memory>
+#include <numeric>
 #include <utility>
 
+#include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
@@ -31,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/framework/variant_tensor_data.h"
 #include "tensorflow/core/framework/versions.h"
 #include "tensorflow/core/framework/versions.pb.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
@@ -403,21 +406,46 @@ Status PadAlignment(FileOutputBuffer* out, int alignment, int64* size) {
   return status;
 }
 
+// A TensorBuffer aliasing [offset, offset + size) of a memory-mapped data
+// file.  Keeps the mapping alive for as long as the buffer is referenced.
+class MappedTensorBuffer : public TensorBuffer {
+ public:
+  MappedTensorBuffer(std::shared_ptr<ReadOnlyMemoryRegion> region,
+                     uint64 offset, size_t size)
+      : TensorBuffer(const_cast<char*>(
+                         static_cast<const char*>(region->data()) + offset)),
+        region_(std::move(region)),
+        size_(size) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocated_bytes(size_);
+    proto->set_allocator_name("tensor_bundle_mmap");
+  }
+  // The mapping is read-only, so it must never be written through.
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  const size_t size_;
+};
+
 }  // namespace
 
 BundleWriter::BundleWriter(Env* env, StringPiece prefix, const Options& options)
-    : env_(env),
-      options_(options),
-      prefix_(prefix),
-      out_(nullptr),
-      size_(0) {
+    : env_(env), options_(options), prefix_(prefix) {
+  if (options_.num_shards < 1) {
+    status_ = errors::InvalidArgument("num_shards must be >= 1, got ",
+                                      options_.num_shards);
+    return;
+  }
   status_ = env_->HasAtomicMove(prefix_, &use_temp_file_);
   if (!status_.ok()) return;
 
-  data_path_ = DataFilename(prefix_, 0, 1);
   metadata_path_ = MetaFilename(prefix_);
   if (use_temp_file_) {
-    data_path_ = strings::StrCat(data_path_, ".tempstate", random::New64());
     metadata_path_ =
         strings::StrCat(metadata_path_, ".tempstate", random::New64());
   }
@@ -427,13 +455,41 @@ BundleWriter::BundleWriter(Env* env, StringPiece prefix, const Options& options)
     return;
   }
 
-  std::unique_ptr<WritableFile> wrapper;
-  status_ = env_->NewWritableFile(data_path_, &wrapper);
-  if (!status_.ok()) return;
-  out_ = std::unique_ptr<FileOutputBuffer>(
-      new FileOutputBuffer(wrapper.release(), 8 << 20 /* 8MB write buffer */));
+  for (int32 i = 0; i < options_.num_shards; ++i) {
+    std::unique_ptr<DataShard> shard(new DataShard);
+    shard->id = i;
+    shard->path = DataFilename(prefix_, i, options_.num_shards);
+    if (use_temp_file_) {
+      shard->path = strings::StrCat(shard->path, ".tempstate", random::New64());
+    }
+    std::unique_ptr<WritableFile> wrapper;
+    status_ = env_->NewWritableFile(shard->path, &wrapper);
+    if (!status_.ok()) {
+      // Removes the data files already created for the preceding shards.
+      for (const auto& created : shards_) {
+        mutex_lock l(created->mu);
+        created->out = nullptr;
+        env_->DeleteFile(created->path).IgnoreError();
+      }
+      shards_.clear();
+      return;
+    }
+    if (options_.pool != nullptr) {
+      shard->flush_thread.reset(
+          new thread::ThreadPool(env_, "bundle_writer_flush", 1));
+    }
+    mutex_lock l(shard->mu);
+    shard->out.reset(new FileOutputBuffer(wrapper.release(),
+                                          8 << 20 /* 8MB write buffer */,
+                                          shard->flush_thread.get()));
+    VLOG(1) << "Writing to file " << shard->path;
+    shards_.push_back(std::move(shard));
+  }
+}
 
-  VLOG(1) << "Writing to file " << data_path_;
+BundleWriter::~BundleWriter() {
+  // Queued writes refer to this writer.
+  WaitForPendingWrites().IgnoreError();
 }
 
 Status BundleWriter::Add(StringPiece key, const Tensor& val) {
@@ -448,29 +504,72 @@ Status BundleWriter::Add(StringPiece key, const Tensor& val) {
   BundleEntryProto* entry = &entries_[key_string];
   entry->set_dtype(val.dtype());
   val.shape().AsProto(entry->mutable_shape());
-  entry->set_shard_id(0);
-  entry->set_offset(size_);
+  DataShard* shard = shards_[next_shard_].get();
+  next_shard_ = (next_shard_ + 1) % shards_.size();
+  entry->set_shard_id(shard->id);
+
+  if (options_.pool == nullptr) {
+    status_ = WriteToShard(val, shard, entry);
+    return status_;
+  }
+
+  // Only "entry" is handed to the pool; the pointer stays valid because
+  // std::map never moves its elements.
+  const int64 bytes = val.TotalBytes();
+  {
+    mutex_lock l(mu_);
+    status_ = write_status_;
+    if (!status_.ok()) return status_;
+    pending_writes_.push_back({val, bytes, shard, entry});
+    in_flight_bytes_ += bytes;
+  }
+  options_.pool->Schedule([this]() { RunOnePendingWrite(); });
+
+  // Over budget: help with the backlog instead of queueing unboundedly.  The
+  // writes this thread cannot take are already running on the pool.
+  while (true) {
+    {
+      mutex_lock l(mu_);
+      if (in_flight_bytes_ <= options_.max_in_flight_bytes) {
+        status_ = write_status_;
+        return status_;
+      }
+      if (pending_writes_.empty()) {
+        writes_done_cv_.wait(l);
+        continue;
+      }
+    }
+    RunOnePendingWrite();
+  }
+}
+
+Status BundleWriter::WriteToShard(const Tensor& val, DataShard* shard,
+                                  BundleEntryProto* entry) {
+  mutex_lock l(shard->mu);
+  FileOutputBuffer* out = shard->out.get();
+  entry->set_offset(shard->size);
 
   // Updates the data file.
   size_t data_bytes_written = 0;
   uint32 crc32c = 0;
-  out_->clear_crc32c();
+  out->clear_crc32c();
+  Status status;
   if (val.dtype() == DT_STRING) {
-    status_ = WriteStringTensor(val, out_.get(), &data_bytes_written, &crc32c);
+    status = WriteStringTensor(val, out, &data_bytes_written, &crc32c);
   } else if (val.dtype() == DT_VARIANT) {
-    status_ = WriteVariantTensor(val, out_.get(), &data_bytes_written, &crc32c);
+    status = WriteVariantTensor(val, out, &data_bytes_written, &crc32c);
   } else {
-    status_ = WriteTensor(val, out_.get(), &data_bytes_written);
-    crc32c = out_->crc32c();
+    status = WriteTensor(val, out, &data_bytes_written);
+    crc32c = out->crc32c();
   }
 
-  if (status_.ok()) {
+  if (status.ok()) {
     entry->set_size(data_bytes_written);
     entry->set_crc32c(crc32c::Mask(crc32c));
-    size_ += data_bytes_written;
-    status_ = PadAlignment(out_.get(), options_.data_alignment, &size_);
+    shard->size += data_bytes_written;
+    status = PadAlignment(out, options_.data_alignment, &shard->size);
   }
-  return status_;
+  return status;
 }
 
 Status BundleWriter::AddSlice(StringPiece full_tensor_key,
@@ -507,27 +606,88 @@ Status BundleWriter::AddSlice(StringPiece full_tensor_key,
   slice_spec.AsProto(slice_proto);
 
   // The slice itself is handled by a regular Add(), which includes adding its
-  // own metadata entry, and writing out the slice's values.
+  // own metadata entry, and writing out the slice's values (on the pool, if
+  // one is set).
   const string slice_name =
       checkpoint::EncodeTensorNameSlice(full_tensor_key_string, slice_spec);
   status_ = Add(slice_name, slice_tensor);
   return status_;
 }
 
+bool BundleWriter::RunOnePendingWrite() {
+  PendingWrite write;
+  bool failed;
+  {
+    mutex_lock l(mu_);
+    if (pending_writes_.empty()) return false;
+    write = std::move(pending_writes_.front());
+    pending_writes_.pop_front();
+    ++num_running_writes_;
+    failed = !write_status_.ok();
+  }
+  // Once one write fails the rest are skipped; the bundle is discarded.
+  Status s;
+  if (!failed) s = WriteToShard(write.val, write.shard, write.entry);
+  mutex_lock l(mu_);
+  write_status_.Update(s);
+  in_flight_bytes_ -= write.bytes;
+  --num_running_writes_;
+  writes_done_cv_.notify_all();
+  return true;
+}
+
+Status BundleWriter::WaitForPendingWrites() {
+  while (RunOnePendingWrite()) {
+  }
+  mutex_lock l(mu_);
+  while (num_running_writes_ > 0) {
+    writes_done_cv_.wait(l);
+  }
+  return write_status_;
+}
+
 // TODO(zongheng): on metadata write failure or !status_.ok(), consider removing
 // the orphaned data file.
 Status BundleWriter::Finish() {
-  if (out_) {
-    status_.Update(out_->Close());
-    out_ = nullptr;
-    if (status_.ok()) {
-      if (use_temp_file_) {
-        status_ =
-            Env::Default()->RenameFile(data_path_, DataFilename(prefix_, 0, 1));
+  int32 num_shards = 1;
+  if (!shards_.empty()) {
+    status_.Update(WaitForPendingWrites());
+    for (auto& shard : shards_) {
+      mutex_lock l(shard->mu);
+      status_.Update(shard->out->Close());
+      shard->out = nullptr;
+    }
+
+    // Data files without any tensor are dropped, and the remaining ones
+    // renumbered, so that the header's shard count matches the files present
+    // (MergeBundles() relies on this).  A bundle always keeps one data file.
+    std::vector<int32> new_shard_ids(shards_.size(), -1);
+    for (const auto& p : entries_) {
+      if (p.second.slices().empty()) new_shard_ids[p.second.shard_id()] = 0;
+    }
+    new_shard_ids[0] = 0;
+    num_shards = 0;
+    for (int32& id : new_shard_ids) {
+      if (id >= 0) id = num_shards++;
+    }
+    for (auto& p : entries_) {
+      if (p.second.slices().empty()) {
+        p.second.set_shard_id(new_shard_ids[p.second.shard_id()]);
       }
-    } else {
-      Env::Default()->DeleteFile(data_path_).IgnoreError();
     }
+
+    for (const auto& shard : shards_) {
+      const int32 new_id = new_shard_ids[shard->id];
+      const string final_path = DataFilename(prefix_, new_id, num_shards);
+      if (status_.ok() && new_id >= 0) {
+        if (shard->path != final_path) {
+          status_ = Env::Default()->RenameFile(shard->path, final_path);
+        }
+      } else {
+        Env::Default()->DeleteFile(shard->path).IgnoreError();
+      }
+    }
+    shards_.clear();
   }
   if (!status_.ok()) return status_;
   // Build key -> BundleEntryProto table.
@@ -542,7 +702,7 @@ Status BundleWriter::Finish() {
     table::TableBuilder builder(options, file.get());
     // Header entry.
     BundleHeaderProto header;
-    header.set_num_shards(1);
+    header.set_num_shards(num_shards);
     header.set_endianness(BundleHeaderProto::LITTLE);
     if (!port::kLittleEndian) header.set_endianness(BundleHeaderProto::BIG);
     VersionDef* version = header.mutable_version();
@@ -589,11 +749,15 @@ struct MergeState {
   std::unordered_map<string, int32> shard_ids;
 };
 
-// Merges entries of "prefix" into the accumulator state "merge".
-// Returns OK iff the merge succeeds.
-static Status MergeOneBundle(Env* env, StringPiece prefix,
-                             MergeState* merge_state) {
-  VLOG(1) << "Merging bundle:" << prefix;
+// The parsed metadata table of one bundle being merged.
+struct BundleMetadata {
+  BundleHeaderProto header;
+  std::vector<std::pair<string, BundleEntryProto>> entries;
+};
+
+// Reads and parses the metadata table of "prefix" into "metadata".
+static Status ReadBundleMetadata(Env* env, StringPiece prefix,
+                                 BundleMetadata* metadata) {
   const string filename = MetaFilename(prefix);
   uint64 file_size;
   TF_RETURN_IF_ERROR(env->GetFileSize(filename, &file_size));
@@ -606,47 +770,57 @@ static Status MergeOneBundle(Env* env, StringPiece prefix,
   std::unique_ptr<table::Table> table_deleter(table);
   std::unique_ptr<table::Iterator> iter(table->NewIterator());
 
-  int num_shards;
+  iter->Seek(kHeaderEntryKey);
+  if (!iter->Valid()) {
+    return CorruptFileError(iter->status(), filename,
+                            "failed to seek to header entry");
+  }
+  Status s = ParseEntryProto(iter->key(), iter->value(), &metadata->header);
+  if (!s.ok()) return CorruptFileError(s, filename, "unable to parse header");
+
+  for (iter->Next(); iter->Valid(); iter->Next()) {
+    metadata->entries.emplace_back(string(iter->key()), BundleEntryProto());
+    TF_RETURN_IF_ERROR(ParseEntryProto(iter->key(), iter->value(),
+                                       &metadata->entries.back().second));
+  }
+  return iter->status();
+}
+
+// Merges the metadata of "prefix" into the accumulator state "merge".
+// Returns OK iff the merge succeeds.
+static Status MergeOneBundle(StringPiece prefix, BundleMetadata* metadata,
+                             MergeState* merge_state) {
+  VLOG(1) << "Merging bundle:" << prefix;
+  const BundleHeaderProto& header = metadata->header;
+
   // Process header.
-  {
-    iter->Seek(kHeaderEntryKey);
-    if (!iter->Valid()) {
-      return CorruptFileError(iter->status(), filename,
-                              "failed to seek to header entry");
+  merge_state->num_shards += header.num_shards();
+  if (!merge_state->seen_first_bundle) {
+    merge_state->seen_first_bundle = true;
+    merge_state->endianness = header.endianness();
+    merge_state->version = header.version();
+  } else {
+    // Validates "endianness".
+    if (merge_state->endianness != header.endianness()) {
+      return errors::InvalidArgument(
+          "Merging bundles with conflicting endianness; inputs corrupted?");
     }
-    BundleHeaderProto header;
-    Status s = ParseEntryProto(iter->key(), iter->value(), &header);
-    if (!s.ok()) return CorruptFileError(s, filename, "unable to parse header");
-
-    merge_state->num_shards += header.num_shards();
-    if (!merge_state->seen_first_bundle) {
-      merge_state->seen_first_bundle = true;
-      merge_state->endianness = header.endianness();
-      merge_state->version = header.version();
-    } else {
-      // Validates "endianness".
-      if (merge_state->endianness != header.endianness()) {
-        return errors::InvalidArgument(
-            "Merging bundles with conflicting endianness; inputs corrupted?");
-      }
-      // Validates "version".
-      string curr_version, merge_version;
-      header.version().SerializeToString(&curr_version);
-      merge_state->version.SerializeToString(&merge_version);
-      if (curr_version != merge_version) {
-        return errors::InvalidArgument(
-            "Merging bundles with different format versions: merged ",
-            merge_version, " vs. curr ", curr_version);
-      }
+    // Validates "version".
+    string curr_version, merge_version;
+    header.version().SerializeToString(&curr_version);
+    merge_state->version.SerializeToString(&merge_version);
+    if (curr_version != merge_version) {
+      return errors::InvalidArgument(
+          "Merging bundles with different format versions: merged ",
+          merge_version, " vs. curr ", curr_version);
     }
-    num_shards = header.num_shards();
-    iter->Next();
   }
+  const int num_shards = header.num_shards();
 
   // Loops through the non-header to-merge entries.
-  BundleEntryProto to_merge_entry;
-  for (; iter->Valid(); iter->Next()) {
-    const string key(iter->key());
+  for (auto& key_and_entry : metadata->entries) {
+    const string& key = key_and_entry.first;
+    BundleEntryProto& to_merge_entry = key_and_entry.second;
     const auto entry_iter = merge_state->entries.find(key);
 
     // Illegal: the duplicated entry is a non-slice tensor.
@@ -657,9 +831,6 @@ static Status MergeOneBundle(Env* env, StringPiece prefix,
           " encountered, when merging prefix: ", prefix);
     }
 
-    TF_RETURN_IF_ERROR(
-        ParseEntryProto(iter->key(), iter->value(), &to_merge_entry));
-
     // The duplicated entry holds metadata for a sliced full tensor.
     // Allows the duplication and merges "slices".
     if (entry_iter != merge_state->entries.end()) {
@@ -685,7 +856,7 @@ static Status MergeOneBundle(Env* env, StringPiece prefix,
         {DataFilename(prefix, to_merge_entry.shard_id(), num_shards),
          merge_state->shard_ids.size()});
     to_merge_entry.set_shard_id(result.first->second);
-    merge_state->entries[key] = to_merge_entry;
+    merge_state->entries[key] = std::move(to_merge_entry);
   }
   return Status::OK();
 }
@@ -697,8 +868,28 @@ Status MergeBundles(Env* env, gtl::ArraySlice<tstring> prefixes,
   MergeState merge;
   Status status = env->CreateDir(string(io::Dirname(merged_prefix)));
   if (!status.ok() && !errors::IsAlreadyExists(status)) return status;
+
+  // Reading and parsing the metadata tables dominates for many-worker saves,
+  // so that part runs concurrently; the merge itself is sequential so that
+  // shard ids and error precedence follow the order of "prefixes".
+  std::vector<BundleMetadata> metadata(prefixes.size());
+  std::vector<Status> read_status(prefixes.size());
+  auto read = [&](int i) {
+    read_status[i] = ReadBundleMetadata(env, prefixes[i], &metadata[i]);
+  };
+  if (prefixes.size() > 1) {
+    thread::ThreadPool pool(env, "merge_bundles",
+                            std::min<int>(prefixes.size(), 16));
+    for (int i = 0; i < prefixes.size(); ++i) {
+      pool.Schedule([&read, i]() { read(i); });
+    }
+  } else if (!prefixes.empty()) {
+    read(0);
+  }
   for (int i = 0; i < prefixes.size(); ++i) {
-    TF_RETURN_IF_ERROR(MergeOneBundle(env, prefixes[i], &merge));
+    TF_RETURN_IF_ERROR(read_status[i]);
+    TF_RETURN_IF_ERROR(MergeOneBundle(prefixes[i], &metadata[i], &merge));
+    metadata[i] = BundleMetadata();
   }
 
   // Renames data files to contain the merged bundle prefix.
@@ -741,9 +932,11 @@ Status MergeBundles(Env* env, gtl::ArraySlice<tstring> prefixes,
 
 // Interface for reading a tensor bundle.
 
-BundleReader::BundleReader(Env* env, StringPiece prefix)
+BundleReader::BundleReader(Env* env, StringPiece prefix,
+                           const Options& options)
     : env_(env),
       prefix_(prefix),
+      options_(options),
       metadata_(nullptr),
       table_(nullptr),
       index_cache_(nullptr),
@@ -841,16 +1034,46 @@ Status BundleReader::GetBundleEntryProto(StringPiece key,
 }
 
 Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
+  TF_RETURN_IF_ERROR(OpenDataFile(entry.shard_id()));
+  return ReadValue(key(), entry, data_[entry.shard_id()], val);
+}
+
+Status BundleReader::OpenDataFile(int32 shard_id) {
+  // Open the data file if it has not been opened.
+  io::InputBuffer*& buffered_file = data_[shard_id];
+  if (buffered_file != nullptr) return Status::OK();
+  const string filename = DataFilename(prefix_, shard_id, num_shards_);
+  std::unique_ptr<RandomAccessFile> file = nullptr;
+  TF_RETURN_IF_ERROR(env_->NewRandomAccessFile(filename, &file));
+  buffered_file = new io::InputBuffer(file.release(), kBufferSize);
+  // The InputBuffer and RandomAccessFile objects are both released in dtor.
+
+  if (options_.use_mmap) {
+    std::unique_ptr<ReadOnlyMemoryRegion> region;
+    Status s = env_->NewReadOnlyMemoryRegionFromFile(filename, &region);
+    if (!s.ok()) {
+      // Not every file system can map files; fall back to buffered reads.
+      VLOG(1) << "Unable to memory-map " << filename << ": " << s;
+    }
+    mapped_data_[shard_id] = std::move(region);
+  }
+  return Status::OK();
+}
+
+Status BundleReader::ReadValue(StringPiece key, const BundleEntryProto& entry,
+                               io::InputBuffer* buffered_file, Tensor* val) {
   Tensor* ret = val;
   const TensorShape stored_shape(TensorShape(entry.shape()));
   if (val->NumElements() == 0) {
     ret = new Tensor(entry.dtype(), stored_shape);
   }
+  // Owns "ret" unless it is the caller's tensor.
+  std::unique_ptr<Tensor> ret_deleter(ret != val ? ret : nullptr);
 
   // Validates the "size" field.
   if (entry.dtype() != DT_STRING && entry.dtype() != DT_VARIANT) {
     if (entry.size() != ret->TotalBytes()) {
-      return errors::DataLoss("Invalid size in bundle entry: key ", key(),
+      return errors::DataLoss("Invalid size in bundle entry: key ", key,
                               "; stored size ", entry.size(),
                               "; expected size ", ret->TotalBytes());
     }
@@ -863,28 +1086,53 @@ Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
     const size_t lower_bound = ret->NumElements() + ret->TotalBytes() -
                                sizeof(tstring) * ret->NumElements();
     if (entry.size() < lower_bound) {
-      return errors::DataLoss("Invalid size in bundle entry: key ", key(),
+      return errors::DataLoss("Invalid size in bundle entry: key ", key,
                               "; stored size ", entry.size(),
                               "; expected size is at least ", lower_bound);
     }
   }
 
-  // Open the data file if it has not been opened.
-  io::InputBuffer* buffered_file = data_[entry.shard_id()];
+  io::InputBuffer* shared_file = data_.at(entry.shard_id());
+  CHECK(shared_file != nullptr);
+  std::unique_ptr<io::InputBuffer> private_file;
   if (buffered_file == nullptr) {
-    std::unique_ptr<RandomAccessFile> file = nullptr;
-    TF_RETURN_IF_ERROR(env_->NewRandomAccessFile(
-        DataFilename(prefix_, entry.shard_id(), num_shards_), &file));
-    buffered_file = new io::InputBuffer(file.release(), kBufferSize);
-    // The InputBuffer and RandomAccessFile objects are both released in dtor.
-    data_[entry.shard_id()] = buffered_file;
+    private_file.reset(new io::InputBuffer(
+        shared_file->file(),
+        std::max<size_t>(1, std::min<uint64>(kBufferSize, entry.size()))));
+    buffered_file = private_file.get();
+  }
+  std::shared_ptr<ReadOnlyMemoryRegion> region;
+  if (options_.use_mmap) {
+    region = mapped_data_.at(entry.shard_id());
   }
-  CHECK(buffered_file != nullptr);
 
-  TF_RETURN_IF_ERROR(buffered_file->Seek(entry.offset()));
   uint32 actual_crc32c = 0;
 
-  if (DataTypeCanUseMemcpy(entry.dtype())) {
+  if (DataTypeCanUseMemcpy(entry.dtype()) && region != nullptr &&
+      !need_to_swap_bytes_) {
+    if (entry.offset() > region->length() ||
+        entry.size() > region->length() - entry.offset()) {
+      return errors::DataLoss("TensorBundle at ", prefix_, " shard ",
+                              entry.shard_id(), ": entry for key ", key,
+                              " extends past the end of the data file");
+    }
+    const char* mapped_data =
+        static_cast<const char*>(region->data()) + entry.offset();
+    actual_crc32c = crc32c::Value(mapped_data, entry.size());
+    TensorBuffer* mapped_buf =
+        new MappedTensorBuffer(region, entry.offset(), entry.size());
+    Tensor mapped_tensor(entry.dtype(), ret->shape(), mapped_buf);
+    mapped_buf->Unref();
+    if (mapped_tensor.IsAligned()) {
+      *ret = mapped_tensor;
+    } else {
+      // Eigen requires aligned buffers; the data was written without enough
+      // padding, so copy it out of the mapping instead.
+      memcpy(const_cast<char*>(ret->tensor_data().data()), mapped_data,
+             entry.size());
+    }
+  } else if (DataTypeCanUseMemcpy(entry.dtype())) {
+    TF_RETURN_IF_ERROR(buffered_file->Seek(entry.offset()));
     char* backing_buffer = const_cast<char*>((ret->tensor_data().data()));
     size_t unused_bytes_read;
     if (entry.size() > kBufferSize) {
@@ -932,7 +1180,6 @@ Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
   }
 
   *val = *ret;
-  if (ret != val) delete ret;
   return Status::OK();
 }
 
@@ -950,6 +1197,63 @@ Status BundleReader::Lookup(StringPiece key, Tensor* val) {
   }
 }
 
+Status BundleReader::LookupMany(gtl::ArraySlice<tstring> keys,
+                                gtl::ArraySlice<Tensor*> vals,
+                                thread::ThreadPool* pool) {
+  if (keys.size() != vals.size()) {
+    return errors::InvalidArgument("Got ", keys.size(), " keys but ",
+                                   vals.size(), " output tensors");
+  }
+
+  // Resolves the entries in key order so that the index is read front to
+  // back, and opens every shard that will be read from the pool.
+  std::vector<size_t> sorted_idx(keys.size());
+  std::iota(sorted_idx.begin(), sorted_idx.end(), 0);
+  std::sort(sorted_idx.begin(), sorted_idx.end(),
+            [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+  std::vector<BundleEntryProto> entries(keys.size());
+  std::vector<size_t> pool_reads;
+  for (size_t i : sorted_idx) {
+    CHECK(vals[i] != nullptr);
+    TF_RETURN_IF_ERROR(GetBundleEntryProto(keys[i], &entries[i]));
+    if (entries[i].slices().empty()) {
+      TF_RETURN_IF_ERROR(OpenDataFile(entries[i].shard_id()));
+      pool_reads.push_back(i);
+    } else {
+      const TensorSlice full_slice(TensorShape(entries[i].shape()).dims());
+      TF_RETURN_IF_ERROR(
+          GetSliceValue(keys[i], entries[i], full_slice, vals[i]));
+    }
+  }
+
+  if (pool == nullptr) {
+    for (size_t i : pool_reads) {
+      TF_RETURN_IF_ERROR(
+          ReadValue(keys[i], entries[i], /*buffered_file=*/nullptr, vals[i]));
+    }
+    return Status::OK();
+  }
+
+  // Reads the data.  Each read uses its own InputBuffer over the shared
+  // (thread-safe) RandomAccessFile, or the shared mapping.
+  std::vector<Status> statuses(pool_reads.size());
+  BlockingCounter counter(pool_reads.size());
+  for (size_t r = 0; r < pool_reads.size(); ++r) {
+    pool->Schedule([this, &keys, &vals, &entries, &pool_reads, &statuses,
+                    &counter, r]() {
+      const size_t i = pool_reads[r];
+      statuses[r] =
+          ReadValue(keys[i], entries[i], /*buffered_file=*/nullptr, vals[i]);
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  for (const Status& s : statuses) {
+    TF_RETURN_IF_ERROR(s);
+  }
+  return Status::OK();
+}
+
 Status BundleReader::ReadCurrent(Tensor* val) {
   CHECK(val != nullptr);
   BundleEntryProto entry;
@@ -1138,7 +1442,11 @@ string BundleReader::DebugString() {
   return shape_str;
 }
 
-FileOutputBuffer::~FileOutputBuffer() { delete file_; }
+FileOutputBuffer::~FileOutputBuffer() {
+  // The file must outlive any append still running on "flush_thread_".
+  WaitForFlush().IgnoreError();
+  delete file_;
+}
 
 Status FileOutputBuffer::Append(StringPiece data) {
   // In the below, it is critical to calculate the checksum on the actually
@@ -1172,15 +1480,43 @@ Status FileOutputBuffer::Append(StringPiece data) {
 
 Status FileOutputBuffer::Close() {
   TF_RETURN_IF_ERROR(FlushBuffer());
+  TF_RETURN_IF_ERROR(WaitForFlush());
   return file_->Close();
 }
 
 Status FileOutputBuffer::FlushBuffer() {
-  if (position_ > 0) {
+  if (position_ == 0) return Status::OK();
+  if (flush_thread_ == nullptr) {
     TF_RETURN_IF_ERROR(file_->Append(StringPiece(&buffer_[0], position_)));
     position_ = 0;
+    return Status::OK();
+  }
+  // Hands the full buffer to the flush thread and continues in the spare one
+  // once the previous flush is done with it.
+  TF_RETURN_IF_ERROR(WaitForFlush());
+  buffer_.swap(flush_buffer_);
+  const size_t nbytes = position_;
+  position_ = 0;
+  {
+    mutex_lock l(flush_mu_);
+    flush_pending_ = true;
   }
+  flush_thread_->Schedule([this, nbytes]() {
+    Status s = file_->Append(StringPiece(&flush_buffer_[0], nbytes));
+    mutex_lock l(flush_mu_);
+    flush_status_.Update(s);
+    flush_pending_ = false;
+    flush_cv_.notify_all();
+  });
   return Status::OK();
 }
 
+Status FileOutputBuffer::WaitForFlush() {
+  mutex_lock l(flush_mu_);
+  while (flush_pending_) {
+    flush_cv_.wait(l);
+  }
+  return flush_status_;
+}
+
 }  // namespace tensorflow
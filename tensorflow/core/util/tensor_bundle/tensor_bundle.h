@@ -39,9 +39,10 @@ limitations under the License.
 //   reader.Lookup("name", &tensor);
 //
 // A tensor bundle can be built using BundleWriter.  Each BundleWriter builds a
-// single data file bundle.  Multiple bundles can then be merged by
-// MergeBundles() without reading and writing large chunk of data: it reads the
-// metadata files and outputs a single merged metadata.  Typical usage:
+// bundle with BundleWriter::Options::num_shards data files (a single one by
+// default).  Multiple bundles can then be merged by MergeBundles() without
+// reading and writing large chunk of data: it reads the metadata files and
+// outputs a single merged metadata.  Typical usage:
 //
 //   worker 0:
 //     BundleWriter writer(env, "/fs/model/train/ckpt-step/tmp/worker0-step");
@@ -61,7 +62,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_TENSOR_BUNDLE_H_
 #define TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_TENSOR_BUNDLE_H_
 
+#include <deque>
 #include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -69,6 +72,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_slice.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/io/cache.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
@@ -76,6 +80,8 @@ limitations under the License.
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/protobuf/tensor_bundle.pb.h"
 #include "tensorflow/core/util/tensor_bundle/naming.h"
@@ -112,9 +118,29 @@ class BundleWriter {
     // Alignment, in bytes, for tensor data.
     // Must be >= 1. The default size of 1 densely packs tensors.
     int data_alignment{1};
+
+    // Number of data files tensors are spread across, round-robin.  Each one
+    // has its own write buffer, so with a "pool" they are written
+    // concurrently.  Data files that end up empty are dropped by Finish().
+    // Must be >= 1.
+    int num_shards{1};
+
+    // If set, tensors are checksummed and written on this pool (not owned)
+    // instead of on the calling thread, and each data file flushes its write
+    // buffer on a background thread while the other buffer fills.  Add() and
+    // AddSlice() may return before the tensor is written: the caller must not
+    // modify the tensor until Finish(), and write errors are reported by a
+    // later Add(), AddSlice() or Finish().
+    thread::ThreadPool* pool{nullptr};
+
+    // With a "pool", upper bound on the bytes of tensors that have been added
+    // but not yet written.  Beyond it Add() writes pending tensors on the
+    // calling thread rather than queueing more.
+    int64 max_in_flight_bytes{256 << 20};
   };
   BundleWriter(Env* env, StringPiece prefix,
                const Options& options = Options());
+  ~BundleWriter();
 
   // Adds the tensor "val" under key "key".
   // Across calls "key" must be unique but can be added in any order.
@@ -146,17 +172,56 @@ class BundleWriter {
   Status status() const { return status_; }
 
  private:
+  // One data file being written.
+  struct DataShard {
+    int32 id;
+    string path;
+    // Set when writing with a pool; outlives "out", which flushes on it.
+    std::unique_ptr<thread::ThreadPool> flush_thread;
+    mutex mu;
+    std::unique_ptr<FileOutputBuffer> out TF_GUARDED_BY(mu);
+    int64 size TF_GUARDED_BY(mu) = 0;  // Number of bytes written into out.
+  };
+
+  // A tensor added with a "pool" whose data is not yet written.
+  struct PendingWrite {
+    Tensor val;
+    int64 bytes;
+    DataShard* shard;
+    BundleEntryProto* entry;
+  };
+
+  // Appends the data of "val" to "shard" and fills in the location, size and
+  // checksum fields of "entry".
+  Status WriteToShard(const Tensor& val, DataShard* shard,
+                      BundleEntryProto* entry);
+
+  // Pops one pending write, if any, and performs it on the calling thread.
+  // Returns false if there was nothing to write.
+  bool RunOnePendingWrite();
+
+  // Performs or waits for all pending writes and returns the first error any
+  // of them hit.
+  Status WaitForPendingWrites();
+
   Env* const env_;  // Not owned.
   const Options options_;
   const string prefix_;
   string metadata_path_;
-  string data_path_;
   bool use_temp_file_;
-  std::unique_ptr<FileOutputBuffer> out_;
-  int64 size_;  // Number of bytes written into out_.
+  std::vector<std::unique_ptr<DataShard>> shards_;
+  int next_shard_ = 0;
   std::map<string, BundleEntryProto> entries_;
   Status status_;
 
+  // State of the writes queued on "options_.pool".
+  mutex mu_;
+  condition_variable writes_done_cv_;
+  std::deque<PendingWrite> pending_writes_ TF_GUARDED_BY(mu_);
+  int num_running_writes_ TF_GUARDED_BY(mu_) = 0;
+  int64 in_flight_bytes_ TF_GUARDED_BY(mu_) = 0;
+  Status write_status_ TF_GUARDED_BY(mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(BundleWriter);
 };
 
@@ -182,7 +247,20 @@ Status MergeBundles(Env* env, gtl::ArraySlice<tstring> prefixes,
 // All threads accessing the same BundleReader must synchronize.
 class BundleReader {
  public:
-  BundleReader(Env* const env, StringPiece prefix);
+  struct Options {
+    Options() {}
+    // If true, data files are memory-mapped where the file system supports
+    // it. Lookups of numeric tensors whose data is suitably aligned in the
+    // file (see BundleWriter::Options::data_alignment) then return tensors
+    // that alias the mapping instead of copying into a fresh buffer, even if
+    // "val" was pre-allocated by the caller. Such tensors are read-only: they
+    // report that they do not own their memory, so kernels never forward them
+    // as writable outputs. The data files must not be modified while any of
+    // them is alive.
+    bool use_mmap{false};
+  };
+  BundleReader(Env* const env, StringPiece prefix,
+               const Options& options = Options());
   ~BundleReader();
 
   // Is ok() iff the reader construction is successful (completed the read of
@@ -219,6 +297,19 @@ class BundleReader {
   // REQUIRES: status().ok()
   Status Lookup(StringPiece key, Tensor* val) TF_MUST_USE_RESULT;
 
+  // Looks up the tensors keyed by "keys", as if by calling Lookup(keys[i],
+  // vals[i]) for each i.  The index is consulted on the calling thread, after
+  // which the data of all non-partitioned tensors, which may live in many
+  // shards, is read concurrently on "pool".  Partitioned tensors, and all
+  // tensors if "pool" is null, are read on the calling thread.
+  //
+  // Returns the first error encountered, in which case any of "vals" may
+  // contain nonsense data.
+  // REQUIRES: status().ok(), keys.size() == vals.size()
+  Status LookupMany(gtl::ArraySlice<tstring> keys,
+                    gtl::ArraySlice<Tensor*> vals,
+                    thread::ThreadPool* pool) TF_MUST_USE_RESULT;
+
   // Looks up the tensor pointed to by the internal iterator.
   //
   // On error, "val" may contain nonsense data.
@@ -275,6 +366,18 @@ class BundleReader {
   Status GetValue(const BundleEntryProto& entry,
                   Tensor* val) TF_MUST_USE_RESULT;
 
+  // Opens (and, if requested, maps) data file "shard_id" unless it already
+  // is.
+  Status OpenDataFile(int32 shard_id) TF_MUST_USE_RESULT;
+
+  // Reads the tensor value described by "entry", whose key is "key", from an
+  // already opened data file.  Reads go through "buffered_file" if it is not
+  // null; otherwise a private buffer is used, which makes concurrent calls
+  // safe.
+  Status ReadValue(StringPiece key, const BundleEntryProto& entry,
+                   io::InputBuffer* buffered_file,
+                   Tensor* val) TF_MUST_USE_RESULT;
+
   // Reads the slice described by "slice_spec".  The corresponding full tensor
   // has key "ful_tensor_key" and metadata proto "full_tensor_entry".
   // REQUIRES: full_tensor_entry.slices_size() > 0
@@ -285,6 +388,7 @@ class BundleReader {
 
   Env* env_;  // Not owned.
   const string prefix_;
+  const Options options_;
 
   Status status_;
   RandomAccessFile* metadata_;  // Owned.
@@ -293,6 +397,11 @@ class BundleReader {
   table::Iterator* iter_;
   // Owned the InputBuffer objects and their underlying RandomAccessFile's.
   std::unordered_map<int32, io::InputBuffer*> data_;
+  // Memory-mapped data files, if options_.use_mmap.  Holds null for shards
+  // the file system could not map; those are read through data_.  Shared
+  // with the tensors that alias the mappings.
+  std::unordered_map<int32, std::shared_ptr<ReadOnlyMemoryRegion>>
+      mapped_data_;
 
   // Maps each partitioned tensor's key to its stored slices (represented in a
   // TensorSliceSet).  Populated on-demand.
@@ -316,10 +425,18 @@ class BundleReader {
 // External synchronization must be used in the presence of concurrent callers.
 class FileOutputBuffer {
  public:
-  FileOutputBuffer(WritableFile* file, size_t buffer_size)
-      : file_(file), position_(0), buffer_size_(buffer_size) {
+  // If "flush_thread" is set (not owned), full buffers are appended to the
+  // file on it while appends continue into a second buffer.  The thread must
+  // not be shared with work that waits on this buffer.
+  FileOutputBuffer(WritableFile* file, size_t buffer_size,
+                   thread::ThreadPool* flush_thread = nullptr)
+      : file_(file),
+        position_(0),
+        buffer_size_(buffer_size),
+        flush_thread_(flush_thread) {
     DCHECK_GT(buffer_size, 0);
     buffer_.resize(buffer_size);
+    if (flush_thread_ != nullptr) flush_buffer_.resize(buffer_size);
   }
   ~FileOutputBuffer();
 
@@ -338,6 +455,10 @@ class FileOutputBuffer {
   // Appends the buffered data to the underlying file. Does NOT flush the file.
   Status FlushBuffer();
 
+  // Waits for the append scheduled by the last FlushBuffer() on
+  // "flush_thread_", and returns the first error any such append hit.
+  Status WaitForFlush();
+
   WritableFile* file_;  // Owned.
 
   // buffer_[0, position_) holds the buffered data not yet appended to the
@@ -348,6 +469,15 @@ class FileOutputBuffer {
 
   // Checksum of all appended bytes since construction or last clear_crc32c().
   uint32 crc32c_ = 0;
+
+  // Double buffering: while "flush_pending_", flush_buffer_ is being appended
+  // to the file on "flush_thread_".
+  thread::ThreadPool* const flush_thread_;  // Not owned.
+  std::vector<char> flush_buffer_;
+  mutex flush_mu_;
+  condition_variable flush_cv_;
+  bool flush_pending_ TF_GUARDED_BY(flush_mu_) = false;
+  Status flush_status_ TF_GUARDED_BY(flush_mu_);
 };
 
 }  // namespace tensorflow
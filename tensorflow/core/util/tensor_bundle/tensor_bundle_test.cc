@@ -1056,6 +1056,191 @@ TEST(TensorBundleTest, VersionTest) {
   }
 }
 
+TEST(TensorBundleTest, MemoryMappedLookup) {
+  for (int alignment : {1, 64}) {
+    {
+      BundleWriter::Options opts;
+      opts.data_alignment = alignment;
+      BundleWriter writer(Env::Default(), Prefix("mmap"), opts);
+      TF_EXPECT_OK(writer.Add("bool", Constant(true, TensorShape({3}))));
+      TF_EXPECT_OK(writer.Add("float", Constant_2x3<float>(1.5)));
+      TF_EXPECT_OK(writer.Add("int64", Constant_2x3<int64>(7)));
+      Tensor strings(DT_STRING, TensorShape({2}));
+      strings.flat<tstring>()(0) = "hello";
+      strings.flat<tstring>()(1) = "world";
+      TF_EXPECT_OK(writer.Add("string", strings));
+      TF_ASSERT_OK(writer.Finish());
+    }
+    BundleReader::Options opts;
+    opts.use_mmap = true;
+    BundleReader reader(Env::Default(), Prefix("mmap"), opts);
+    TF_ASSERT_OK(reader.status());
+    Expect<bool>(&reader, "bool", Constant(true, TensorShape({3})));
+    Expect<float>(&reader, "float", Constant_2x3<float>(1.5));
+    Expect<int64>(&reader, "int64", Constant_2x3<int64>(7));
+    Tensor expected_strings(DT_STRING, TensorShape({2}));
+    expected_strings.flat<tstring>()(0) = "hello";
+    expected_strings.flat<tstring>()(1) = "world";
+    Expect<tstring>(&reader, "string", expected_strings);
+
+    // Tensors read from an aligned mapping alias it, and so must never be
+    // forwarded as writable.
+    Tensor val;
+    TF_ASSERT_OK(reader.Lookup("float", &val));
+    test::ExpectTensorEqual<float>(val, Constant_2x3<float>(1.5));
+    if (val.IsAligned() && alignment % EIGEN_MAX_ALIGN_BYTES == 0) {
+      EXPECT_FALSE(val.RefCountIsOne());
+    }
+  }
+}
+
+TEST(TensorBundleTest, LookupMany) {
+  const TensorShape kFullShape({5, 10});
+  {
+    BundleWriter writer(Env::Default(), Prefix("many0"));
+    TF_EXPECT_OK(writer.Add("a", Constant_2x3<float>(0)));
+    TF_EXPECT_OK(writer.Add("c", Constant_2x3<float>(2)));
+    TF_EXPECT_OK(writer.AddSlice("part", kFullShape,
+                                 TensorSlice::ParseOrDie("-:0,5"),
+                                 Constant<float>(3., TensorShape({5, 5}))));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  {
+    BundleWriter writer(Env::Default(), Prefix("many1"));
+    TF_EXPECT_OK(writer.Add("b", Constant_2x3<int32>(1)));
+    TF_EXPECT_OK(writer.Add("d", Constant(int64{4}, TensorShape({100}))));
+    TF_EXPECT_OK(writer.AddSlice("part", kFullShape,
+                                 TensorSlice::ParseOrDie("-:5,5"),
+                                 Constant<float>(3., TensorShape({5, 5}))));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  TF_ASSERT_OK(MergeBundles(Env::Default(), {Prefix("many0"), Prefix("many1")},
+                            Prefix("many")));
+
+  thread::ThreadPool thread_pool(Env::Default(), "lookup_many", 4);
+  // Without a pool, all tensors are read on the calling thread.
+  thread::ThreadPool* const pools[] = {&thread_pool, nullptr};
+  for (bool use_mmap : {false, true}) {
+    for (thread::ThreadPool* pool : pools) {
+      BundleReader::Options opts;
+      opts.use_mmap = use_mmap;
+      BundleReader reader(Env::Default(), Prefix("many"), opts);
+      TF_ASSERT_OK(reader.status());
+
+      // Unsorted keys, a partitioned tensor, and a mix of pre-allocated and
+      // empty outputs.
+      std::vector<tstring> keys = {"d", "part", "a", "c", "b"};
+      std::vector<Tensor> vals(keys.size());
+      vals[2] = Tensor(DT_FLOAT, TensorShape({2, 3}));
+      vals[1] = Tensor(DT_FLOAT, kFullShape);
+      std::vector<Tensor*> val_ptrs;
+      for (Tensor& val : vals) val_ptrs.push_back(&val);
+      TF_ASSERT_OK(reader.LookupMany(keys, val_ptrs, pool));
+      test::ExpectTensorEqual<int64>(vals[0],
+                                     Constant(int64{4}, TensorShape({100})));
+      test::ExpectTensorEqual<float>(vals[1], Constant<float>(3., kFullShape));
+      test::ExpectTensorEqual<float>(vals[2], Constant_2x3<float>(0));
+      test::ExpectTensorEqual<float>(vals[3], Constant_2x3<float>(2));
+      test::ExpectTensorEqual<int32>(vals[4], Constant_2x3<int32>(1));
+
+      std::vector<tstring> missing = {"a", "nonexistent"};
+      std::vector<Tensor> missing_vals(missing.size());
+      EXPECT_TRUE(errors::IsNotFound(reader.LookupMany(
+          missing, {&missing_vals[0], &missing_vals[1]}, pool)));
+    }
+  }
+}
+
+TEST(TensorBundleTest, ParallelWriter) {
+  Env* env = Env::Default();
+  thread::ThreadPool pool(env, "bundle_writer", 4);
+  const TensorShape kFullShape({4, 3});
+  {
+    BundleWriter::Options opts;
+    opts.num_shards = 3;
+    opts.pool = &pool;
+    // Small enough that Add() has to write on the calling thread too.
+    opts.max_in_flight_bytes = 1 << 10;
+    opts.data_alignment = 8;
+    BundleWriter writer(env, Prefix("parallel"), opts);
+    TF_ASSERT_OK(writer.status());
+    for (int i = 0; i < 20; ++i) {
+      TF_EXPECT_OK(writer.Add(strings::StrCat("float", i),
+                              Constant(float(i), TensorShape({10, 10}))));
+    }
+    Tensor strings(DT_STRING, TensorShape({2}));
+    strings.flat<tstring>()(0) = "hello";
+    strings.flat<tstring>()(1) = string(1 << 12, 'x');
+    TF_EXPECT_OK(writer.Add("string", strings));
+    TF_EXPECT_OK(writer.AddSlice("part", kFullShape,
+                                 TensorSlice::ParseOrDie("0,2:-"),
+                                 Constant<int32>(5, TensorShape({2, 3}))));
+    TF_EXPECT_OK(writer.AddSlice("part", kFullShape,
+                                 TensorSlice::ParseOrDie("2,2:-"),
+                                 Constant<int32>(5, TensorShape({2, 3}))));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  for (int i = 0; i < 3; ++i) {
+    TF_EXPECT_OK(env->FileExists(DataFilename(Prefix("parallel"), i, 3)));
+  }
+
+  BundleReader reader(env, Prefix("parallel"));
+  TF_ASSERT_OK(reader.status());
+  for (int i = 0; i < 20; ++i) {
+    Expect<float>(&reader, strings::StrCat("float", i),
+                  Constant(float(i), TensorShape({10, 10})));
+  }
+  Tensor expected_strings(DT_STRING, TensorShape({2}));
+  expected_strings.flat<tstring>()(0) = "hello";
+  expected_strings.flat<tstring>()(1) = string(1 << 12, 'x');
+  Expect<tstring>(&reader, "string", expected_strings);
+  Expect<int32>(&reader, "part", Constant<int32>(5, kFullShape));
+
+  // Multi-file bundles merge like any other.
+  {
+    BundleWriter writer(env, Prefix("parallel_other"));
+    TF_EXPECT_OK(writer.Add("other", Constant_2x3<double>(1.)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  TF_ASSERT_OK(MergeBundles(
+      env, {Prefix("parallel"), Prefix("parallel_other")},
+      Prefix("parallel_merged")));
+  BundleReader merged(env, Prefix("parallel_merged"));
+  TF_ASSERT_OK(merged.status());
+  Expect<float>(&merged, "float7", Constant(7.f, TensorShape({10, 10})));
+  Expect<double>(&merged, "other", Constant_2x3<double>(1.));
+}
+
+TEST(TensorBundleTest, ParallelWriterDropsEmptyShards) {
+  Env* env = Env::Default();
+  thread::ThreadPool pool(env, "bundle_writer", 2);
+  {
+    BundleWriter::Options opts;
+    opts.num_shards = 8;
+    opts.pool = &pool;
+    BundleWriter writer(env, Prefix("few"), opts);
+    TF_EXPECT_OK(writer.Add("a", Constant_2x3<float>(1.)));
+    TF_EXPECT_OK(writer.Add("b", Constant_2x3<float>(2.)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  TF_EXPECT_OK(env->FileExists(DataFilename(Prefix("few"), 0, 2)));
+  TF_EXPECT_OK(env->FileExists(DataFilename(Prefix("few"), 1, 2)));
+  EXPECT_TRUE(
+      errors::IsNotFound(env->FileExists(DataFilename(Prefix("few"), 2, 8))));
+
+  BundleReader reader(env, Prefix("few"));
+  TF_ASSERT_OK(reader.status());
+  Expect<float>(&reader, "a", Constant_2x3<float>(1.));
+  Expect<float>(&reader, "b", Constant_2x3<float>(2.));
+
+  {
+    BundleWriter::Options opts;
+    opts.num_shards = 0;
+    BundleWriter writer(env, Prefix("invalid"), opts);
+    EXPECT_TRUE(errors::IsInvalidArgument(writer.status()));
+  }
+}
+
 class TensorBundleAlignmentTest : public ::testing::Test {
  protected:
   template <typename T>
@@ -1141,4 +1326,27 @@ BM_BundleAlignment(4096, 512);
 BM_BundleAlignment(4096, 4096);
 BM_BundleAlignment(4096, 1048576);
 
+static void BM_BundleWriter(::testing::benchmark::State& state) {
+  const int num_shards = state.range(0);
+  constexpr int kNumTensors = 16;
+  const Tensor val = Constant(1.f, TensorShape({1 << 20}));
+  thread::ThreadPool pool(Env::Default(), "bundle_writer", 4);
+  for (auto s : state) {
+    BundleWriter::Options opts;
+    if (num_shards > 0) {
+      opts.num_shards = num_shards;
+      opts.pool = &pool;
+    }
+    BundleWriter writer(Env::Default(), Prefix("bm_writer"), opts);
+    for (int i = 0; i < kNumTensors; ++i) {
+      TF_CHECK_OK(writer.Add(strings::StrCat("t", i), val));
+    }
+    TF_CHECK_OK(writer.Finish());
+  }
+  state.SetBytesProcessed(static_cast<int64>(state.iterations()) *
+                          kNumTensors * val.TotalBytes());
+}
+// 0 writes sequentially on the calling thread.
+BENCHMARK(BM_BundleWriter)->Arg(0)->Arg(1)->Arg(4);
+
 }  // namespace tensorflow
@@ -29,6 +29,7 @@ from tensorflow.python.data.util import nest
 from tensorflow.python.framework import constant_op
 from tensorflow.python.framework import dtypes
 from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import image_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import parsing_ops
 from tensorflow.python.platform import test
@@ -92,6 +93,22 @@ def _generate_parse_single_example_test_case():
   return parse_single_example_fn, parse_example_factory
 
 
+def _generate_image_preprocessing_test_case():
+  """Generates an image preprocessing test case."""
+
+  def image_factory():
+    images = np.random.randint(0, 256, (100, 64, 64, 3)).astype(np.uint8)
+    return dataset_ops.Dataset.from_tensor_slices(images)
+
+  def preprocess_fn(x):
+    image = math_ops.cast(x, dtypes.float32)
+    image = image_ops.resize_images_v2(image, [32, 32])
+    mean = math_ops.reduce_mean(image, axis=[0, 1], keepdims=True)
+    return (image - mean) / 255.0
+
+  return preprocess_fn, image_factory
+
+
 # TODO(rachelim): Add a benchmark for more expensive transformations, such as
 # vgg_preprocessing.
 class MapVectorizationBenchmark(test.Benchmark):
@@ -177,6 +194,11 @@ class MapVectorizationBenchmark(test.Benchmark):
     self._benchmark_helper(parse_fn, "parse_single_example",
                            lambda: [parse_factory()])
 
+  def benchmark_image_preprocessing(self):
+    preprocess_fn, image_factory = _generate_image_preprocessing_test_case()
+    self._benchmark_helper(preprocess_fn, "image_preprocessing",
+                           lambda: [image_factory()])
+
   def _default_dataset_factory(self):
     input_sizes = [(10, 10, 3), (10, 100, 300)]
     for sz in input_sizes:
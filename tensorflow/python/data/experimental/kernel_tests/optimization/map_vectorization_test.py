@@ -40,6 +40,7 @@ from tensorflow.python.ops import bitwise_ops
 from tensorflow.python.ops import check_ops
 from tensorflow.python.ops import clip_ops
 from tensorflow.python.ops import control_flow_ops
+from tensorflow.python.ops import image_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import nn
 from tensorflow.python.ops import parsing_ops
@@ -132,6 +133,21 @@ def _unary_real_test_combinations():
   return _generate_test_combinations(cases)
 
 
+def _reduction_test_combinations():
+  cases = [
+      ("All", lambda x: math_ops.reduce_all(x > 0.5, axis=0)),
+      ("Any", lambda x: math_ops.reduce_any(x > 0.5, axis=-1)),
+      ("ArgMax", lambda x: math_ops.argmax(x, axis=1)),
+      ("ArgMin", lambda x: math_ops.argmin(x, axis=-1)),
+      ("Max", lambda x: math_ops.reduce_max(x, axis=[0, 1])),
+      ("Mean", lambda x: math_ops.reduce_mean(x, axis=-1, keepdims=True)),
+      ("Min", lambda x: math_ops.reduce_min(x, axis=0)),
+      ("Prod", lambda x: math_ops.reduce_prod(x, axis=[-2])),
+      ("Sum", math_ops.reduce_sum),
+  ]
+  return _generate_test_combinations(cases)
+
+
 def _binary_bitwise_test_combinations():
   cases = [("BitwiseAnd", bitwise_ops.bitwise_and),
            ("BitwiseOr", bitwise_ops.bitwise_or),
@@ -414,6 +430,74 @@ class MapVectorizationTest(test_base.DatasetTestBase, parameterized.TestCase):
 
     self._testOptimization(decode_csv_fn, dataset_factory, num_parallel_calls)
 
+  @combinations.generate(
+      combinations.times(test_base.default_test_combinations(),
+                         _reduction_test_combinations(),
+                         combinations.combine(num_parallel_calls=[None, 12])))
+  def testReductions(self, map_fn, num_parallel_calls):
+    x = np.random.rand(7, 3, 5)
+    dataset_factory = lambda: dataset_ops.Dataset.from_tensor_slices(x)
+    self._testOptimization(map_fn, dataset_factory, num_parallel_calls)
+
+  @combinations.generate(
+      combinations.times(test_base.default_test_combinations(),
+                         combinations.combine(num_parallel_calls=[None, 12])))
+  def testExpandDimsAndSqueeze(self, num_parallel_calls):
+    data = np.random.rand(10, 3)
+    dataset_factory = lambda: dataset_ops.Dataset.from_tensors(data).repeat(5)
+    map_fns = [
+        lambda x: array_ops.expand_dims(x, 0),
+        lambda x: array_ops.expand_dims(x, -1),
+        lambda x: array_ops.squeeze(array_ops.expand_dims(x, 1), axis=[1]),
+        lambda x: array_ops.squeeze(array_ops.expand_dims(x, 0), axis=[-3]),
+    ]
+    for map_fn in map_fns:
+      self._testOptimization(map_fn, dataset_factory, num_parallel_calls)
+
+  @combinations.generate(
+      combinations.times(test_base.default_test_combinations(),
+                         combinations.combine(num_parallel_calls=[None, 12])))
+  def testImageResize(self, num_parallel_calls):
+    images = np.random.rand(10, 8, 6, 3).astype(np.float32)
+    dataset_factory = lambda: dataset_ops.Dataset.from_tensor_slices(images)
+    methods = [
+        image_ops.ResizeMethod.AREA,
+        image_ops.ResizeMethod.BICUBIC,
+        image_ops.ResizeMethod.BILINEAR,
+        image_ops.ResizeMethod.NEAREST_NEIGHBOR,
+    ]
+    for method in methods:
+      map_fn = lambda x, m=method: image_ops.resize_images_v2(x, [4, 5], m)
+      self._testOptimization(map_fn, dataset_factory, num_parallel_calls)
+
+  @combinations.generate(
+      combinations.times(test_base.default_test_combinations(),
+                         combinations.combine(num_parallel_calls=[None, 12])))
+  def testImagePreprocessing(self, num_parallel_calls):
+    images = np.random.randint(0, 256, (10, 8, 6, 3)).astype(np.uint8)
+
+    dataset_factory = lambda: dataset_ops.Dataset.from_tensor_slices(images)
+
+    def map_fn(x):
+      image = math_ops.cast(x, dtypes.float32)
+      image = image_ops.resize_images_v2(image, [4, 4])
+      mean = math_ops.reduce_mean(image, axis=[0, 1], keepdims=True)
+      return (image - mean) / 255.0
+
+    self._testOptimization(map_fn, dataset_factory, num_parallel_calls)
+
+  @combinations.generate(
+      combinations.times(test_base.default_test_combinations(),
+                         combinations.combine(num_parallel_calls=[None, 12])))
+  def testDecodeRawWithDifferentLengths(self, num_parallel_calls):
+    # The strings decode to vectors of different lengths, so DecodeRaw cannot
+    # run on the whole batch at once and must be left to run per element.
+    data = [np.arange(i, dtype=np.int16).tobytes() for i in range(1, 11)]
+    dataset_factory = lambda: dataset_ops.Dataset.from_tensor_slices(data)
+    map_fn = lambda x: math_ops.reduce_sum(
+        parsing_ops.decode_raw(x, dtypes.int16))
+    self._testOptimization(map_fn, dataset_factory, num_parallel_calls)
+
   @combinations.generate(
       combinations.times(test_base.default_test_combinations(),
                          combinations.combine(num_parallel_calls=[None, 12])))
@@ -30,6 +30,7 @@ class _AutotuneAlgorithm(enum.Enum):
   """Controls what algorithm is used in the autotune implementation."""
   HILL_CLIMB = 0
   GRADIENT_DESCENT = 1
+  BAYESIAN_OPTIMIZATION = 2
 
 
 @tf_export("data.experimental.MapVectorizationOptions")
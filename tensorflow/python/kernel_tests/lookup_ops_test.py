@@ -23,6 +23,7 @@ import tempfile
 import numpy as np
 import six
 
+from tensorflow.core.protobuf import config_pb2
 from tensorflow.python import tf2
 from tensorflow.python.client import session
 from tensorflow.python.data.experimental.ops import counter
@@ -44,6 +45,8 @@ from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import control_flow_ops
 from tensorflow.python.ops import lookup_ops
 from tensorflow.python.ops import map_fn
+from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import random_ops
 from tensorflow.python.ops import string_ops
 from tensorflow.python.ops import variables
 from tensorflow.python.ops.ragged import ragged_tensor
@@ -1538,6 +1541,50 @@ class DenseHashTableOpTest(test.TestCase):
     output = table.lookup(keys4)
     self.assertAllEqual([-1, 0, -1, 3, 4, 5, 6, 7, -1], self.evaluate(output))
 
+  def testIncrementalResize(self):
+    table = lookup_ops.DenseHashTable(
+        dtypes.int64,
+        dtypes.int64,
+        default_value=-1,
+        empty_key=0,
+        deleted_key=-1,
+        initial_num_buckets=256)
+    keys = np.arange(1, 201, dtype=np.int64)
+    self.evaluate(table.insert(keys, keys * 10))
+    self.assertAllEqual(200, self.evaluate(table.size()))
+
+    # Growing the table only migrates part of the old buckets, so the
+    # following operations run while entries are split across both.
+    keys2 = np.arange(201, 221, dtype=np.int64)
+    self.evaluate(table.insert(keys2, keys2 * 10))
+    self.assertAllEqual(220, self.evaluate(table.size()))
+
+    all_keys = np.arange(1, 231, dtype=np.int64)
+    expected = np.where(all_keys <= 220, all_keys * 10, -1)
+    self.assertAllEqual(expected, self.evaluate(table.lookup(all_keys)))
+
+    removed_keys = np.arange(1, 221, 3, dtype=np.int64)
+    self.evaluate(table.remove(removed_keys))
+    expected[removed_keys - 1] = -1
+    self.assertAllEqual(220 - len(removed_keys),
+                        self.evaluate(table.size()))
+    self.assertAllEqual(expected, self.evaluate(table.lookup(all_keys)))
+
+    updated_keys = np.arange(2, 221, 3, dtype=np.int64)
+    self.evaluate(table.insert(updated_keys, updated_keys * 100))
+    expected[updated_keys - 1] = updated_keys * 100
+    self.assertAllEqual(220 - len(removed_keys),
+                        self.evaluate(table.size()))
+    self.assertAllEqual(expected, self.evaluate(table.lookup(all_keys)))
+
+    exported_keys, exported_values = self.evaluate(table.export())
+    self.assertAllEqual(512, len(exported_keys))
+    exported = dict(zip(exported_keys.flatten(), exported_values.flatten()))
+    for key, value in zip(all_keys, expected):
+      if value != -1:
+        self.assertEqual(value, exported[key])
+    self.assertAllEqual(expected, self.evaluate(table.lookup(all_keys)))
+
   def testExport(self):
     keys = constant_op.constant([11, 12, 13, 14], dtypes.int64)
     values = constant_op.constant([1, 2, 3, 4], dtypes.int64)
@@ -3724,6 +3771,43 @@ class MutableHashTableBenchmark(test.Benchmark):
       self.run_op_benchmark(sess, insert, burn_iters=10, min_iters=1000)
       assert sess.run(size) >= 1000 * 32
 
+  def _benchmark_concurrent_batch_1024_find(self, num_threads):
+    # Each iteration issues one independent lookup per inter-op thread, so the
+    # wall time per iteration only stays flat as `num_threads` grows if
+    # concurrent lookups on the same table do not serialize.
+    num_keys = 1 << 16
+    batch_size = 1024
+    table = self._create_table()
+    keys = math_ops.range(num_keys, dtype=dtypes.int64)
+    insert = table.insert(keys, math_ops.cast(keys, dtypes.float32))
+    finds = []
+    for _ in range(num_threads):
+      query = random_ops.random_uniform([batch_size],
+                                        maxval=num_keys,
+                                        dtype=dtypes.int64)
+      finds.append(math_ops.reduce_sum(table.lookup(query)))
+    find_all = control_flow_ops.group(*finds)
+    config = config_pb2.ConfigProto(
+        inter_op_parallelism_threads=num_threads,
+        intra_op_parallelism_threads=1)
+    with session.Session(config=config) as sess:
+      sess.run(insert)
+      self.run_op_benchmark(
+          sess,
+          find_all,
+          burn_iters=10,
+          min_iters=1000,
+          extras={"lookups_per_iter": num_threads * batch_size})
+
+  def benchmark_concurrent_batch_1024_find_1_thread(self):
+    self._benchmark_concurrent_batch_1024_find(1)
+
+  def benchmark_concurrent_batch_1024_find_4_threads(self):
+    self._benchmark_concurrent_batch_1024_find(4)
+
+  def benchmark_concurrent_batch_1024_find_16_threads(self):
+    self._benchmark_concurrent_batch_1024_find(16)
+
 
 class DenseHashTableBenchmark(MutableHashTableBenchmark):
 
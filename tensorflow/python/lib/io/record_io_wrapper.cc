@@ -20,6 +20,7 @@ limitations under the License.
 #include "pybind11/pybind11.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/io/record_index.h"
 #include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/io/record_writer.h"
 #include "tensorflow/core/lib/io/zlib_compression_options.h"
@@ -324,6 +325,16 @@ PYBIND11_MODULE(_pywrap_record_io, m) {
       .def("close", [](PyRecordWriter* self) {
         MaybeRaiseRegisteredFromStatus(self->Close());
       });
+
+  m.def("build_record_index", [](const std::string& filename) {
+    tensorflow::Status status;
+    {
+      py::gil_scoped_release release;
+      status = tensorflow::io::BuildRecordIndex(tensorflow::Env::Default(),
+                                                filename);
+    }
+    MaybeRaiseRegisteredFromStatus(status);
+  });
 }
 
 }  // namespace
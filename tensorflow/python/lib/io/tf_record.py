@@ -212,6 +212,27 @@ def tf_record_random_reader(path):
   return _pywrap_record_io.RandomRecordReader(path)
 
 
+def tf_record_build_index(path):
+  """Writes an index of the records of an uncompressed TFRecords file.
+
+  The index is written to a `.tfrecord_index` directory next to the file, under
+  the file's name: the index of `dir/train-00000` is
+  `dir/.tfrecord_index/train-00000`. Patterns that match the files, such as
+  `dir/train-*`, therefore do not match their indexes. `TFRecordDataset` uses
+  the index to skip records without reading them, to shard files by record
+  range and to shuffle records globally. An index goes stale when the file is
+  rewritten, and must then be rebuilt.
+
+  Args:
+    path: The path to the TFRecords file.
+
+  Raises:
+    IOError: If `path` cannot be read or the index cannot be written.
+    DataLossError: If the file is corrupted.
+  """
+  _pywrap_record_io.build_record_index(path)
+
+
 @tf_export(
     "io.TFRecordWriter", v1=["io.TFRecordWriter", "python_io.TFRecordWriter"])
 @deprecation.deprecated_endpoints("python_io.TFRecordWriter")
@@ -18,6 +18,7 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import glob
 import gzip
 import os
 import random
@@ -515,6 +516,26 @@ class TFRecordRandomReaderTest(TFCompressionTestCase):
       reader.read(0)
 
 
+class TFRecordBuildIndexTest(TFCompressionTestCase):
+
+  def testBuildIndex(self):
+    records = [self._Record(0, i) for i in range(self._num_records)]
+    fn = self._WriteRecordsToFile(records, "indexed_records")
+    tf_record.tf_record_build_index(fn)
+    index_fn = os.path.join(
+        os.path.dirname(fn), ".tfrecord_index", os.path.basename(fn))
+    self.assertTrue(os.path.exists(index_fn))
+    # A pattern that matches the file does not match its index.
+    self.assertEqual(glob.glob(fn + "*"), [fn])
+
+  def testBuildIndexOfCorruptedFile(self):
+    fn = os.path.join(self.get_temp_dir(), "corrupted_records")
+    with open(fn, "wb") as f:
+      f.write(b"not a record")
+    with self.assertRaises(errors_impl.DataLossError):
+      tf_record.tf_record_build_index(fn)
+
+
 class TFRecordWriterCloseAndFlushTests(test.TestCase):
   """TFRecordWriter close and flush tests"""
 